@@ -34,9 +34,12 @@
 #include <ctype.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <libgen.h> /* basename(3) */
 #include <ifaddrs.h>
 #include <err.h>
@@ -58,6 +61,12 @@
 #include "tcpkali_syslimits.h"
 #include "tcpkali_logging.h"
 #include "tcpkali_ssl.h"
+#include "tcpkali_sweep.h"
+#include "tcpkali_scenario.h"
+#include "tcpkali_hdr_log.h"
+#include "tcpkali_metrics.h"
+#include "tcpkali_json.h"
+#include "tcpkali_capture.h"
 
 /*
  * Describe the command line options.
@@ -70,11 +79,26 @@
 #define CLI_LATENCY (1 << 13)
 #define CLI_DUMP (1 << 14)
 #define SSL_OPT (1 << 15)
+#define CLI_SWEEP (1 << 16)
+#define CLI_SCENARIO (1 << 17)
+#define CLI_METRICS (1 << 18)
+#define CLI_OUTPUT (1 << 19)
+#define CLI_PCAP (1 << 20)
+#define CLI_CORPUS (1 << 21)
+#define CLI_STREAM (1 << 22)
+#define CLI_WEBSOCKET (1 << 23)
 static struct option cli_long_options[] = {
+    {"capture", 1, 0, CLI_DUMP + 'c'},
+    {"capture-buffer", 1, 0, CLI_DUMP + 'b'},
     {"channel-lifetime", 1, 0, CLI_CHAN_OFFSET + 't'},
     {"channel-bandwidth-upstream", 1, 0, 'U'},
     {"channel-bandwidth-downstream", 1, 0, 'D'},
     {"connections", 1, 0, 'c'},
+    {"corpus", 1, 0, CLI_CORPUS + 'f'},
+    {"corpus-delimiter", 1, 0, CLI_CORPUS + 'd'},
+    {"corpus-length-prefixed", 0, 0, CLI_CORPUS + 'l'},
+    {"corpus-order", 1, 0, CLI_CORPUS + 'o'},
+    {"corpus-start", 1, 0, CLI_CORPUS + 's'},
     {"connect-rate", 1, 0, 'R'},
     {"connect-timeout", 1, 0, CLI_CONN_OFFSET + 't'},
     {"delay-send", 1, 0, CLI_CONN_OFFSET + 'z'},
@@ -89,30 +113,50 @@ static struct option cli_long_options[] = {
     {"first-message-file", 1, 0, 'F'},
     {"help", 0, 0, 'E'},
     {"header", 1, 0, 'H'},
+    {"hdr-log", 1, 0, CLI_LATENCY + 'l'},
+    {"hdr-log-interval", 1, 0, CLI_LATENCY + 'i'},
+    {"http", 0, 0, CLI_LATENCY + 'h'},
+    {"json-stream", 1, 0, CLI_OUTPUT + 's'},
     {"latency-connect", 0, 0, CLI_LATENCY + 'c'},
     {"latency-first-byte", 0, 0, CLI_LATENCY + 'f'},
     {"latency-marker", 1, 0, CLI_LATENCY + 'm'},
     {"latency-marker-skip", 1, 0, CLI_LATENCY + 's'},
+    {"latency-phases", 0, 0, CLI_LATENCY + 'P'},
     {"latency-percentiles", 1, 0, CLI_LATENCY + 'p'},
+    {"latency-target-percentile", 1, 0, CLI_LATENCY + 't'},
     {"listen-port", 1, 0, 'l'},
     {"listen-mode", 1, 0, 'L'},
     {"message", 1, 0, 'm'},
     {"message-file", 1, 0, 'f'},
     {"message-rate", 1, 0, 'r'},
     {"message-stop", 1, 0, 's'},
+    {"metrics-listen", 1, 0, CLI_METRICS + 'l'},
     {"nagle", 1, 0, 'N'},
+    {"output-format", 1, 0, CLI_OUTPUT + 'f'},
+    {"pcap", 1, 0, CLI_PCAP + 'f'},
+    {"pcap-timing", 1, 0, CLI_PCAP + 't'},
+    {"per-destination", 0, 0, CLI_CONN_OFFSET + 'd'},
+    {"pipeline-depth", 1, 0, CLI_CONN_OFFSET + 'p'},
     {"rcvbuf", 1, 0, CLI_SOCKET_OPT + 'R'},
+    {"scenario", 1, 0, CLI_SCENARIO},
     {"server", 1, 0, 'S'},
     {"sndbuf", 1, 0, CLI_SOCKET_OPT + 'S'},
     {"source-ip", 1, 0, 'I'},
     {"ssl", 0, 0, SSL_OPT},
     {"ssl-cert", 1, 0, SSL_OPT + 'c'},
     {"ssl-key", 1, 0, SSL_OPT + 'k'},
+    {"ssl-resume", 1, 0, SSL_OPT + 'r'},
+    {"ssl-ktls", 0, 0, SSL_OPT + 't'},
     {"statsd", 0, 0, CLI_STATSD_OFFSET + 'e'},
     {"statsd-host", 1, 0, CLI_STATSD_OFFSET + 'h'},
     {"statsd-port", 1, 0, CLI_STATSD_OFFSET + 'p'},
     {"statsd-namespace", 1, 0, CLI_STATSD_OFFSET + 'n'},
     {"statsd-latency-window", 1, 0, CLI_STATSD_OFFSET + 'w'},
+    {"stream-file", 1, 0, CLI_STREAM + 'f'},
+    {"sweep-rate", 1, 0, CLI_SWEEP + 'r'},
+    {"sweep-connections", 1, 0, CLI_SWEEP + 'c'},
+    {"sweep-warmup", 1, 0, CLI_SWEEP + 'w'},
+    {"sweep-step", 1, 0, CLI_SWEEP + 's'},
     {"unescape-message-args", 0, 0, 'e'},
     {"version", 0, 0, 'V'},
     {"verbose", 1, 0, CLI_VERBOSE_OFFSET + 'v'},
@@ -120,6 +164,8 @@ static struct option cli_long_options[] = {
     {"write-combine", 1, 0, 'C'},
     {"websocket", 0, 0, 'W'},
     {"ws", 0, 0, 'W'},
+    {"ws-deflate", 0, 0, CLI_WEBSOCKET + 'd'},
+    {"ws-premasked", 0, 0, CLI_WEBSOCKET + 'm'},
     {"message-marker", 0, 0, 'M'},
     {0, 0, 0, 0}};
 
@@ -128,6 +174,20 @@ static struct tcpkali_config {
     double connect_rate;  /* New connects per second. */
     double test_duration; /* Seconds for the full test. */
     double latency_window;  /* Seconds */
+    char *hdr_log_file;     /* --hdr-log */
+    double hdr_log_interval; /* Seconds */
+    int latency_phases;     /* --latency-phases */
+    char *metrics_listen;   /* --metrics-listen */
+    struct addrinfo *metrics_listen_addrs;
+    char *json_stream_file; /* --json-stream */
+    char *pcap_file;        /* --pcap */
+    char *corpus_file;      /* --corpus */
+    char *corpus_delimiter; /* --corpus-delimiter */
+    size_t corpus_delimiter_size;
+    int corpus_length_prefixed; /* --corpus-length-prefixed */
+    char *stream_file;      /* --stream-file */
+    char *capture_file;     /* --capture */
+    size_t capture_buffer;  /* --capture-buffer */
     int statsd_enable;
     char *statsd_host;
     int statsd_port;
@@ -143,6 +203,10 @@ static struct tcpkali_config {
 } default_config = {.max_connections = 1,
                     .connect_rate = 100.0,
                     .test_duration = 10.0,
+                    .hdr_log_interval = 1.0,
+                    .capture_buffer = 8 * 1024 * 1024,
+                    .corpus_delimiter = "\n",
+                    .corpus_delimiter_size = 1,
                     .statsd_enable = 0,
                     .statsd_host = "127.0.0.1",
                     .statsd_port = 8125,
@@ -161,6 +225,10 @@ static double parse_with_multipliers(const char *, char *str,
                                      struct multiplier *, int n);
 static int parse_percentile_values(const char *option, char *str,
                                    struct percentile_values *array);
+static int parse_sweep_values(const char *option, char *str,
+                              struct sweep_spec *sweep);
+static int parse_scenario_file(const char *filename, struct scenario *,
+                               int unescape);
 
 /* clang-format off */
 static struct multiplier km_multiplier[] = { { "k", 1000 }, { "m", 1000000 } };
@@ -220,7 +288,8 @@ main(int argc, char **argv) {
                                           .ssl_cert = "cert.pem",
                                           .ssl_key = "key.pem",
                                           .write_combine = WRCOMB_ON};
-    struct rate_modulator rate_modulator = {.state = RM_UNMODULATED};
+    struct rate_modulator rate_modulator = {.mode = RM_UNMODULATED,
+                                            .latency_percentile = 95.0};
     int unescape_message_data = 0;
 
     struct orchestration_args orch_args = {.enabled = 0,
@@ -237,6 +306,12 @@ main(int argc, char **argv) {
         .size = 0, .values = NULL,
     };
 
+    struct sweep_spec sweep = {
+        .kind = SWEEP_NONE, .warmup_time = 2.0, .step_time = 10.0,
+    };
+
+    struct scenario scenario = {.phases = NULL, .phases_count = 0};
+
     while(1) {
         char *option = argv[optind];
         int longindex = -1;
@@ -334,7 +409,43 @@ main(int argc, char **argv) {
         case CLI_DUMP + 'O': /* --dump-all-out */
             engine_params.dump_setting |= DS_DUMP_ALL_OUT;
             break;
+        case CLI_DUMP + 'c': /* --capture */
+            conf.capture_file = strdup(optarg);
+            break;
+        case CLI_DUMP + 'b': { /* --capture-buffer */
+            long size = parse_with_multipliers(
+                option, optarg, kb_multiplier,
+                sizeof(kb_multiplier) / sizeof(kb_multiplier[0]));
+            if(size < 128 * 1024) {
+                fprintf(stderr, "Expecting --capture-buffer of at least 128k\n");
+                exit(EX_USAGE);
+            }
+            conf.capture_buffer = size;
+        } break;
         case 'c':
+            if(optarg[0] == '@') {
+                double latency = parse_with_multipliers(
+                    option, optarg + 1, s_multiplier,
+                    sizeof(s_multiplier) / sizeof(s_multiplier[0]));
+                if(latency <= 0) {
+                    fprintf(stderr, "Expecting --connections @<Latency>\n");
+                    exit(EX_USAGE);
+                }
+                if(rate_modulator.mode == RM_MAX_RATE_AT_TARGET_LATENCY) {
+                    fprintf(stderr,
+                            "--connections @<Latency> and "
+                            "--message-rate @<Latency> are mutually "
+                            "exclusive\n");
+                    exit(EX_USAGE);
+                }
+                /* Start searching from the previous -c<N> spec. */
+                if(conf.max_connections < 1) conf.max_connections = 1;
+                rate_modulator.mode = RM_MAX_CONNECTIONS_AT_TARGET_LATENCY;
+                rate_modulator.latency_target = latency;
+                rate_modulator.latency_target_s = strdup(optarg + 1);
+                conf.test_duration = INFINITY;
+                break;
+            }
             conf.max_connections = parse_with_multipliers(
                 option, optarg, km_multiplier,
                 sizeof(km_multiplier) / sizeof(km_multiplier[0]));
@@ -342,6 +453,14 @@ main(int argc, char **argv) {
                 fprintf(stderr, "Expecting --connections > 0\n");
                 exit(EX_USAGE);
             }
+            /* Override -c@<Latency> spec. */
+            if(rate_modulator.mode == RM_MAX_CONNECTIONS_AT_TARGET_LATENCY) {
+                warning(
+                    "--connections %s overrides previous dynamic "
+                    "--connections specification.\n",
+                    optarg);
+                rate_modulator.mode = RM_UNMODULATED;
+            }
             break;
         case 'R':
             conf.connect_rate = parse_with_multipliers(
@@ -462,6 +581,13 @@ main(int argc, char **argv) {
                     fprintf(stderr, "Expecting --message-rate @<Latency>\n");
                     exit(EX_USAGE);
                 }
+                if(rate_modulator.mode == RM_MAX_CONNECTIONS_AT_TARGET_LATENCY) {
+                    fprintf(stderr,
+                            "--connections @<Latency> and "
+                            "--message-rate @<Latency> are mutually "
+                            "exclusive\n");
+                    exit(EX_USAGE);
+                }
 
                 /* Override -r<Rate> spec. */
                 if(rate_modulator.mode == RM_UNMODULATED
@@ -487,7 +613,7 @@ main(int argc, char **argv) {
                 }
                 engine_params.channel_send_rate = RATE_MPS(rate);
                 /* Override -r@<Time> spec. */
-                if(rate_modulator.mode != RM_UNMODULATED) {
+                if(rate_modulator.mode == RM_MAX_RATE_AT_TARGET_LATENCY) {
                     warning(
                         "--message-rate %s overrides previous dynamic "
                         "--message-rate specification.\n",
@@ -635,6 +761,19 @@ main(int argc, char **argv) {
                 option, optarg, s_multiplier,
                 sizeof(s_multiplier) / sizeof(s_multiplier[0]));
             break;
+        case CLI_CONN_OFFSET + 'p': { /* --pipeline-depth */
+            double depth = parse_with_multipliers(
+                option, optarg, km_multiplier,
+                sizeof(km_multiplier) / sizeof(km_multiplier[0]));
+            if(depth < 1 || depth > 1000000) {
+                fprintf(stderr, "Expected --pipeline-depth in range 1..1m\n");
+                exit(EX_USAGE);
+            }
+            engine_params.pipeline_depth = depth;
+        } break;
+        case CLI_CONN_OFFSET + 'd': /* --per-destination */
+            engine_params.per_destination = 1;
+            break;
         case CLI_CHAN_OFFSET + 't':
             engine_params.channel_lifetime = parse_with_multipliers(
                 option, optarg, s_multiplier,
@@ -648,6 +787,19 @@ main(int argc, char **argv) {
         case 'W': /* --websocket: Enable WebSocket framing */
             engine_params.websocket_enable = 1;
             break;
+        case CLI_WEBSOCKET + 'd': /* --ws-deflate */
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+            engine_params.websocket_enable = 1;
+            engine_params.websocket_deflate = 1;
+#else
+            fprintf(stderr, "Compiled without zlib support\n");
+            exit(EX_USAGE);
+#endif
+            break;
+        case CLI_WEBSOCKET + 'm': /* --ws-premasked */
+            engine_params.websocket_enable = 1;
+            engine_params.websocket_premasked = 1;
+            break;
         case SSL_OPT: /* --ssl: Enable TLS */
 #ifdef HAVE_OPENSSL
             engine_params.ssl_enable = 1;
@@ -672,12 +824,40 @@ main(int argc, char **argv) {
             exit(EX_USAGE);
 #endif
             break;
+        case SSL_OPT + 't': /* --ssl-ktls: Kernel TLS offload */
+#ifdef TCPKALI_SSL_KTLS
+            engine_params.ssl_ktls = 1;
+#else
+            fprintf(stderr, "Compiled without kernel TLS support\n");
+            exit(EX_USAGE);
+#endif
+            break;
+        case SSL_OPT + 'r': { /* --ssl-resume: Resumed sessions percentage */
+#ifdef HAVE_OPENSSL
+            char *end;
+            double p = strtod(optarg, &end);
+            if(*end == '%') end++;
+            if(end == optarg || *end != '\0' || !(p >= 0 && p <= 100)) {
+                fprintf(stderr,
+                        "--ssl-resume: "
+                        "Expected a percentage in range [0..100]\n");
+                exit(EX_USAGE);
+            }
+            engine_params.ssl_resume_ratio = p / 100;
+#else
+            fprintf(stderr, "Compiled without TLS support\n");
+            exit(EX_USAGE);
+#endif
+        } break;
         case CLI_LATENCY + 'c': /* --latency-connect */
             engine_params.latency_setting |= SLT_CONNECT;
             break;
         case CLI_LATENCY + 'f': /* --latency-first-byte */
             engine_params.latency_setting |= SLT_FIRSTBYTE;
             break;
+        case CLI_LATENCY + 'P': /* --latency-phases */
+            conf.latency_phases = 1;
+            break;
         case CLI_LATENCY + 'm': { /* --latency-marker */
             if(engine_params.message_marker) {
                 fprintf(stderr,
@@ -701,6 +881,10 @@ main(int argc, char **argv) {
                 exit(EX_USAGE);
             }
         } break;
+        case CLI_LATENCY + 'h': /* --http */
+            engine_params.http_mode = 1;
+            engine_params.latency_setting |= SLT_MARKER;
+            break;
         case CLI_LATENCY + 's': { /* --latency-marker-skip */
             engine_params.latency_marker_skip = parse_with_multipliers(
                 option, optarg, km_multiplier,
@@ -717,6 +901,72 @@ main(int argc, char **argv) {
                                        optarg, &latency_percentiles))
                 exit(EX_USAGE);
         } break;
+        case CLI_LATENCY + 't': { /* --latency-target-percentile */
+            char *end;
+            double p = strtod(optarg, &end);
+            if(end == optarg || *end != '\0' || !(p > 0 && p < 100)) {
+                fprintf(stderr,
+                        "--latency-target-percentile: "
+                        "Expected a percentile in range (0..100)\n");
+                exit(EX_USAGE);
+            }
+            rate_modulator.latency_percentile = p;
+        } break;
+        case CLI_LATENCY + 'l': /* --hdr-log */
+            conf.hdr_log_file = strdup(optarg);
+            break;
+        case CLI_LATENCY + 'i': /* --hdr-log-interval */
+            conf.hdr_log_interval = parse_with_multipliers(
+                option, optarg, s_multiplier,
+                sizeof(s_multiplier) / sizeof(s_multiplier[0]));
+            if(conf.hdr_log_interval <= 0) {
+                fprintf(stderr, "Expected positive --hdr-log-interval=%s\n",
+                        optarg);
+                exit(EX_USAGE);
+            }
+            break;
+        case CLI_SWEEP + 'r': /* --sweep-rate */
+        case CLI_SWEEP + 'c': /* --sweep-connections */
+            if(sweep.kind != SWEEP_NONE) {
+                fprintf(stderr, "--%s: Only one --sweep-* list is allowed\n",
+                        cli_long_options[longindex].name);
+                exit(EX_USAGE);
+            }
+            sweep.kind = (c == CLI_SWEEP + 'r') ? SWEEP_MESSAGE_RATE
+                                                : SWEEP_CONNECTIONS;
+            if(parse_sweep_values(cli_long_options[longindex].name, optarg,
+                                  &sweep)
+               == -1)
+                exit(EX_USAGE);
+            break;
+        case CLI_SWEEP + 'w': /* --sweep-warmup */
+            sweep.warmup_time = parse_with_multipliers(
+                option, optarg, s_multiplier,
+                sizeof(s_multiplier) / sizeof(s_multiplier[0]));
+            if(sweep.warmup_time < 0) {
+                fprintf(stderr, "Expected non-negative --sweep-warmup=%s\n",
+                        optarg);
+                exit(EX_USAGE);
+            }
+            break;
+        case CLI_SWEEP + 's': /* --sweep-step */
+            sweep.step_time = parse_with_multipliers(
+                option, optarg, s_multiplier,
+                sizeof(s_multiplier) / sizeof(s_multiplier[0]));
+            if(sweep.step_time <= 0) {
+                fprintf(stderr, "Expected positive --sweep-step=%s\n", optarg);
+                exit(EX_USAGE);
+            }
+            break;
+        case CLI_SCENARIO: /* --scenario */
+            if(scenario.phases_count) {
+                fprintf(stderr, "--scenario: Only one scenario is allowed\n");
+                exit(EX_USAGE);
+            }
+            if(parse_scenario_file(optarg, &scenario, unescape_message_data)
+               == -1)
+                exit(EX_USAGE);
+            break;
         case 'I': { /* --source-ip */
             if(add_source_ip(&engine_params.source_addresses, optarg) < 0) {
                 fprintf(stderr, "--source-ip=%s: local IP address expected\n",
@@ -724,6 +974,82 @@ main(int argc, char **argv) {
                 exit(EX_USAGE);
             }
         } break;
+        case CLI_OUTPUT + 'f': /* --output-format */
+            if(strcmp(optarg, "text") == 0) {
+                engine_params.output_format = OUTPUT_FORMAT_TEXT;
+            } else if(strcmp(optarg, "json") == 0) {
+                engine_params.output_format = OUTPUT_FORMAT_JSON;
+            } else {
+                fprintf(stderr,
+                        "--output-format=%s is not one of {text|json}\n",
+                        optarg);
+                exit(EX_USAGE);
+            }
+            break;
+        case CLI_OUTPUT + 's': /* --json-stream */
+            conf.json_stream_file = strdup(optarg);
+            break;
+        case CLI_PCAP + 'f': /* --pcap */
+            conf.pcap_file = strdup(optarg);
+            break;
+        case CLI_PCAP + 't': /* --pcap-timing */
+            if(strcmp(optarg, "original") == 0) {
+                engine_params.pcap_timing = PCAP_TIMING_ORIGINAL;
+            } else if(strcmp(optarg, "fast") == 0) {
+                engine_params.pcap_timing = PCAP_TIMING_FAST;
+            } else {
+                fprintf(stderr,
+                        "--pcap-timing=%s is not one of {original|fast}\n",
+                        optarg);
+                exit(EX_USAGE);
+            }
+            break;
+        case CLI_CORPUS + 'f': /* --corpus */
+            conf.corpus_file = strdup(optarg);
+            break;
+        case CLI_CORPUS + 'd': /* --corpus-delimiter */
+            conf.corpus_delimiter = strdup(optarg);
+            conf.corpus_delimiter_size = strlen(optarg);
+            unescape_data(conf.corpus_delimiter, &conf.corpus_delimiter_size);
+            if(conf.corpus_delimiter_size == 0) {
+                fprintf(stderr, "--corpus-delimiter must not be empty\n");
+                exit(EX_USAGE);
+            }
+            break;
+        case CLI_CORPUS + 'l': /* --corpus-length-prefixed */
+            conf.corpus_length_prefixed = 1;
+            break;
+        case CLI_CORPUS + 'o': /* --corpus-order */
+            if(strcmp(optarg, "sequential") == 0) {
+                engine_params.corpus_order = CORPUS_SEQUENTIAL;
+            } else if(strcmp(optarg, "random") == 0) {
+                engine_params.corpus_order = CORPUS_RANDOM;
+            } else {
+                fprintf(stderr,
+                        "--corpus-order=%s is not one of {sequential|random}\n",
+                        optarg);
+                exit(EX_USAGE);
+            }
+            break;
+        case CLI_CORPUS + 's': { /* --corpus-start */
+            char *endptr;
+            errno = 0;
+            unsigned long long n = strtoull(optarg, &endptr, 10);
+            if(errno || *endptr || optarg[0] == '-') {
+                fprintf(stderr,
+                        "--corpus-start=%s: record number expected\n",
+                        optarg);
+                exit(EX_USAGE);
+            }
+            engine_params.corpus_start = n;
+        } break;
+        case CLI_STREAM + 'f': /* --stream-file */
+            conf.stream_file = strdup(optarg);
+            break;
+        case CLI_METRICS + 'l': /* --metrics-listen */
+            conf.metrics_listen = strdup(optarg);
+            resolve_address(optarg, &conf.metrics_listen_addrs);
+            break;
         case 'S': { /* --server */
             orch_args.enabled = 1;
             orch_args.server_addr_str = strdup(optarg);
@@ -779,6 +1105,31 @@ main(int argc, char **argv) {
         exit(EX_USAGE);
     }
 
+    /*
+     * Break down the connection establishment into the phases
+     * this kind of connection goes through.
+     */
+    if(conf.latency_phases) {
+        if(!engine_params.ssl_enable && !engine_params.websocket_enable) {
+            fprintf(stderr, "--latency-phases requires --ssl or --websocket\n");
+            exit(EX_USAGE);
+        }
+        engine_params.latency_setting |= SLT_CONNECT;
+        if(engine_params.ssl_enable)
+            engine_params.latency_setting |= SLT_TLS;
+        if(engine_params.websocket_enable)
+            engine_params.latency_setting |= SLT_UPGRADE | SLT_APPBYTE;
+    }
+
+    if(engine_params.ssl_resume_ratio > 0 && !engine_params.ssl_enable) {
+        fprintf(stderr, "--ssl-resume requires --ssl\n");
+        exit(EX_USAGE);
+    }
+    if(engine_params.ssl_ktls && !engine_params.ssl_enable) {
+        fprintf(stderr, "--ssl-ktls requires --ssl\n");
+        exit(EX_USAGE);
+    }
+
 #ifdef HAVE_OPENSSL
     if(engine_params.ssl_enable) {
             tcpkali_init_ssl();
@@ -800,25 +1151,86 @@ main(int argc, char **argv) {
     }
 #endif
 
+    const char *modulated_option =
+        rate_modulator.mode == RM_MAX_CONNECTIONS_AT_TARGET_LATENCY
+            ? "--connections" : "--message-rate";
     if(rate_modulator.latency_target > 1) {
         char *end = 0;
         strtod(rate_modulator.latency_target_s, &end);
         if(*end == '\0') {
             /* No explicit unit ending, such as "ms" */
             warning(
-                "--message-rate @%s: target latency is greater than one "
+                "%s @%s: target latency is greater than one "
                 "second, which is probably not what you want\n",
-                rate_modulator.latency_target_s);
-            warning("Suggesting using --message-rate @%gms\n",
+                modulated_option, rate_modulator.latency_target_s);
+            warning("Suggesting using %s @%gms\n", modulated_option,
                     rate_modulator.latency_target);
         }
     }
 
+    /*
+     * The sweep starts with the first value in the list and
+     * runs until all steps are done, disregarding --duration.
+     */
+    size_t expected_connections = conf.max_connections;
+    if(sweep.kind != SWEEP_NONE) {
+        if(rate_modulator.mode != RM_UNMODULATED) {
+            fprintf(stderr,
+                    "--sweep-* and --message-rate @<Latency> or "
+                    "--connections @<Latency> are mutually exclusive\n");
+            exit(EX_USAGE);
+        }
+        if(sweep.kind == SWEEP_MESSAGE_RATE) {
+            engine_params.channel_send_rate = RATE_MPS(sweep.values[0]);
+        } else {
+            conf.max_connections = sweep.values[0];
+            for(size_t i = 0; i < sweep.values_count; i++) {
+                if(expected_connections < sweep.values[i])
+                    expected_connections = sweep.values[i];
+            }
+        }
+        conf.test_duration = INFINITY;
+    }
+
+    /*
+     * The scenario starts with the settings of its first phase
+     * and runs for the total duration of all phases.
+     */
+    if(scenario.phases_count) {
+        if(rate_modulator.mode != RM_UNMODULATED || sweep.kind != SWEEP_NONE) {
+            fprintf(stderr,
+                    "--scenario is incompatible with --sweep-*, "
+                    "--message-rate @<Latency> and "
+                    "--connections @<Latency>\n");
+            exit(EX_USAGE);
+        }
+        conf.test_duration = 0;
+        for(size_t i = 0; i < scenario.phases_count; i++) {
+            struct scenario_phase *phase = &scenario.phases[i];
+            /* Let the first phase inherit the command line settings. */
+            if(i == 0 && phase->connections < 0)
+                phase->connections = conf.max_connections;
+            if(phase->connections > 0
+               && expected_connections < (size_t)phase->connections)
+                expected_connections = phase->connections;
+            conf.test_duration += phase->duration;
+        }
+        conf.max_connections = scenario.phases[0].connections;
+        if(scenario.phases[0].message_rate >= 0)
+            engine_params.channel_send_rate =
+                RATE_MPS(scenario.phases[0].message_rate);
+        if(scenario.phases[0].latency_window >= 0)
+            conf.latency_window = scenario.phases[0].latency_window;
+    }
+
     /*
      * Avoid spawning more threads than connections.
      */
     if(engine_params.requested_workers == 0
-       && conf.max_connections < number_of_cpus() && conf.listen_port == 0) {
+       && conf.max_connections < number_of_cpus() && conf.listen_port == 0
+       && rate_modulator.mode != RM_MAX_CONNECTIONS_AT_TARGET_LATENCY
+       && sweep.kind != SWEEP_CONNECTIONS
+       && expected_connections == (size_t)conf.max_connections) {
         engine_params.requested_workers = conf.max_connections;
     }
     if(!engine_params.requested_workers)
@@ -847,17 +1259,17 @@ main(int argc, char **argv) {
     /*
      * Check that the system environment is prepared to handle high load.
      */
-    if(adjust_system_limits_for_highload(conf.max_connections,
+    if(adjust_system_limits_for_highload(expected_connections,
                                          engine_params.requested_workers)
        == -1) {
         /* Print the full set of problems with system limits. */
-        check_system_limits_sanity(conf.max_connections,
+        check_system_limits_sanity(expected_connections,
                                    engine_params.requested_workers);
         fprintf(stderr, "System limits will not support the expected load.\n");
         exit(EX_SOFTWARE);
     } else {
         /* Check other system limits and print out if they might be too low. */
-        check_system_limits_sanity(conf.max_connections,
+        check_system_limits_sanity(expected_connections,
                                    engine_params.requested_workers);
     }
 
@@ -911,24 +1323,175 @@ main(int argc, char **argv) {
         }
     } else {
         conf.max_connections = 0;
+        if(sweep.kind == SWEEP_CONNECTIONS) {
+            fprintf(stderr,
+                    "--sweep-connections requires specifying <host:port>\n");
+            exit(EX_USAGE);
+        }
+        for(size_t i = 0; i < scenario.phases_count; i++) {
+            scenario.phases[i].connections = 0;
+        }
     }
     if(conf.listen_port > 0) {
         engine_params.listen_addresses =
             detect_listen_addresses(conf.listen_host, conf.listen_port);
     }
 
+    /*
+     * The captured client streams take the place of the messages.
+     */
+    if(conf.pcap_file) {
+        if(engine_params.message_collection.snippets_count) {
+            fprintf(stderr,
+                    "--pcap is incompatible with --message, --first-message "
+                    "and their --*-file variants\n");
+            exit(EX_USAGE);
+        }
+        if(engine_params.websocket_enable) {
+            fprintf(stderr, "--pcap is incompatible with --websocket\n");
+            exit(EX_USAGE);
+        }
+        if(argc - optind == 0) {
+            fprintf(stderr, "--pcap requires specifying <host:port>\n");
+            exit(EX_USAGE);
+        }
+        engine_params.pcap_replay = pcap_replay_open(conf.pcap_file);
+        if(!engine_params.pcap_replay) exit(EX_DATAERR);
+        size_t total_size = 0;
+        for(size_t i = 0; i < engine_params.pcap_replay->flows_count; i++)
+            total_size += engine_params.pcap_replay->flows[i].total_size;
+        fprintf(stderr, "Replaying %zu TCP flow%s (%zu bytes) from %s\n",
+                engine_params.pcap_replay->flows_count,
+                engine_params.pcap_replay->flows_count == 1 ? "" : "s",
+                total_size, conf.pcap_file);
+    }
+
+    /*
+     * The corpus records take the place of the --message.
+     */
+    if(conf.corpus_file) {
+        if(engine_params.message_collection.snippets_count) {
+            fprintf(stderr,
+                    "--corpus is incompatible with --message, --first-message "
+                    "and their --*-file variants\n");
+            exit(EX_USAGE);
+        }
+        if(engine_params.websocket_enable) {
+            fprintf(stderr, "--corpus is incompatible with --websocket\n");
+            exit(EX_USAGE);
+        }
+        if(conf.pcap_file) {
+            fprintf(stderr, "--corpus is incompatible with --pcap\n");
+            exit(EX_USAGE);
+        }
+        if(argc - optind == 0) {
+            fprintf(stderr, "--corpus requires specifying <host:port>\n");
+            exit(EX_USAGE);
+        }
+        engine_params.corpus = corpus_open(
+            conf.corpus_file,
+            conf.corpus_length_prefixed ? NULL : conf.corpus_delimiter,
+            conf.corpus_delimiter_size);
+        if(!engine_params.corpus) exit(EX_DATAERR);
+        fprintf(stderr, "Using %zu record%s (%zu bytes) from %s\n",
+                engine_params.corpus->records_count,
+                engine_params.corpus->records_count == 1 ? "" : "s",
+                engine_params.corpus->total_size, conf.corpus_file);
+    }
+
+    /*
+     * The --stream-file is sent after the --first-message, if any.
+     */
+    if(conf.stream_file) {
+        for(size_t i = 0;
+            i < engine_params.message_collection.snippets_count; i++) {
+            if(MSK_PURPOSE(&engine_params.message_collection.snippets[i])
+               == MSK_PURPOSE_MESSAGE) {
+                fprintf(stderr,
+                        "--stream-file is incompatible with --message "
+                        "and --message-file\n");
+                exit(EX_USAGE);
+            }
+        }
+        if(engine_params.websocket_enable || conf.pcap_file
+           || conf.corpus_file) {
+            fprintf(stderr,
+                    "--stream-file is incompatible with --websocket, "
+                    "--pcap and --corpus\n");
+            exit(EX_USAGE);
+        }
+        if(engine_params.ssl_enable && !engine_params.ssl_ktls) {
+            fprintf(stderr, "--stream-file over --ssl requires --ssl-ktls\n");
+            exit(EX_USAGE);
+        }
+        struct stat st;
+        int fd = open(conf.stream_file, O_RDONLY);
+        if(fd == -1 || fstat(fd, &st) == -1) {
+            fprintf(stderr, "%s: %s\n", conf.stream_file, strerror(errno));
+            exit(EX_NOINPUT);
+        }
+        if(!S_ISREG(st.st_mode) || st.st_size == 0) {
+            fprintf(stderr, "%s: Non-empty regular file expected\n",
+                    conf.stream_file);
+            exit(EX_DATAERR);
+        }
+        engine_params.stream_fd = fd;
+        engine_params.stream_size = st.st_size;
+    }
+
     /*
      * Add final touches to the collection:
      * add websocket headers if needed, etc.
      */
     message_collection_finalize(
         &engine_params.message_collection, engine_params.websocket_enable,
-        conf.first_hostport, conf.first_path, conf.http_headers.buffer);
+        engine_params.websocket_deflate, conf.first_hostport, conf.first_path,
+        conf.http_headers.buffer);
+
+    /*
+     * Scenario phases having their own messages become the alternative
+     * message sets. The phases without messages keep sending whatever
+     * the previous phase was sending.
+     */
+    for(size_t i = 0; i < scenario.phases_count; i++) {
+        struct scenario_phase *phase = &scenario.phases[i];
+        if(phase->message_collection.snippets_count == 0) {
+            phase->message_set = i ? scenario.phases[i - 1].message_set : 0;
+            continue;
+        }
+        message_collection_finalize(
+            &phase->message_collection, engine_params.websocket_enable,
+            engine_params.websocket_deflate, conf.first_hostport,
+            conf.first_path, conf.http_headers.buffer);
+        engine_params.message_sets =
+            realloc(engine_params.message_sets,
+                    (engine_params.message_sets_count + 1)
+                        * sizeof(engine_params.message_sets[0]));
+        assert(engine_params.message_sets);
+        struct message_set *ms =
+            &engine_params.message_sets[engine_params.message_sets_count++];
+        memset(ms, 0, sizeof(*ms));
+        ms->message_collection = phase->message_collection;
+        phase->message_set = engine_params.message_sets_count;
+        engine_params.message_marker |= message_collection_has(
+            &ms->message_collection, EXPR_MESSAGE_MARKER);
+    }
+    struct message_collection *initial_collection =
+        &engine_params.message_collection;
+    if(scenario.phases_count) {
+        engine_params.message_set = scenario.phases[0].message_set;
+        if(engine_params.message_set)
+            initial_collection =
+                &engine_params.message_sets[engine_params.message_set - 1]
+                     .message_collection;
+    }
 
     int no_message_to_send =
-        (0 == message_collection_estimate_size(
-                  &engine_params.message_collection, MSK_PURPOSE_MESSAGE,
-                  MSK_PURPOSE_MESSAGE, MCE_MINIMUM_SIZE, WS_SIDE_CLIENT, 0));
+        !engine_params.corpus
+        && (0 == message_collection_estimate_size(
+                     initial_collection, MSK_PURPOSE_MESSAGE,
+                     MSK_PURPOSE_MESSAGE, MCE_MINIMUM_SIZE, WS_SIDE_CLIENT, 0,
+                     NULL));
 
     /*
      * Message marker mode can be explicitly enabled via --message-marker,
@@ -942,13 +1505,30 @@ main(int argc, char **argv) {
         assert(EXPR_IS_TRIVIAL(engine_params.latency_marker_expr));
     }
 
+    /* The --http responses are what delimit the messages received. */
+    if(engine_params.http_mode) {
+        const char *conflict = NULL;
+        if(engine_params.message_marker)
+            conflict = "--message-marker";
+        else if(engine_params.latency_marker_expr)
+            conflict = "--latency-marker";
+        else if(engine_params.websocket_enable)
+            conflict = "--websocket";
+        if(conflict) {
+            fprintf(stderr, "--http: %s is also specified, use one or the other\n",
+                    conflict);
+            exit(EX_USAGE);
+        }
+    }
+
     /*
      * Check that we will actually send messages
      * if we are also told to measure latency.
      */
-    if(engine_params.latency_marker_expr && !engine_params.message_marker) {
-        const char *optname = engine_params.message_marker ?
-                            "--message-marker" : "--latency-marker";
+    if((engine_params.latency_marker_expr && !engine_params.message_marker)
+       || engine_params.http_mode) {
+        const char *optname = engine_params.http_mode ?
+                            "--http" : "--latency-marker";
         if(no_message_to_send) {
             fprintf(stderr,
                     "%s is given, but no messages "
@@ -963,16 +1543,30 @@ main(int argc, char **argv) {
         }
     }
 
+    /*
+     * The closed-loop mode relies on the --latency-marker or --http
+     * to figure out which messages have been responded to.
+     */
+    if(engine_params.pipeline_depth && !engine_params.http_mode
+       && (!engine_params.latency_marker_expr
+           || engine_params.message_marker)) {
+        fprintf(stderr,
+                "--pipeline-depth requires specifying "
+                "--latency-marker or --http as well.\n");
+        exit(EX_USAGE);
+    }
+
     /*
      * If we want to get max rate for specific latency
      * check that we specified the marker for latency measurement
      */
     if(rate_modulator.mode != RM_UNMODULATED
        && !engine_params.latency_marker_expr
-       && !engine_params.message_marker) {
+       && !engine_params.message_marker && !engine_params.http_mode) {
         fprintf(stderr,
-                "--message-rate @<Latency> requires specifying "
-                "--latency-marker or --message-marker as well.\n");
+                "%s @<Latency> requires specifying "
+                "--latency-marker, --message-marker or --http as well.\n",
+                modulated_option);
         exit(EX_USAGE);
     }
 
@@ -984,7 +1578,7 @@ main(int argc, char **argv) {
        && no_message_to_send) {
         if(message_collection_estimate_size(
                &engine_params.message_collection, MSK_PURPOSE_MESSAGE,
-               MSK_PURPOSE_MESSAGE, MCE_MAXIMUM_SIZE, WS_SIDE_CLIENT, 1)
+               MSK_PURPOSE_MESSAGE, MCE_MAXIMUM_SIZE, WS_SIDE_CLIENT, 1, NULL)
            > 0) {
             fprintf(stderr,
                     "--message may resolve "
@@ -1055,6 +1649,16 @@ main(int argc, char **argv) {
     /* Which latency types to report to statsd */
     statsd_report_latency_types requested_latency_types = engine_params.latency_setting;
 
+    /* Sweeps and scenarios report median and tail latencies by default. */
+    struct percentile_values sweep_percentiles = latency_percentiles;
+    if(!sweep_percentiles.size) {
+        static struct percentile_value percentile_values[] = {
+            { 50, "50" }, { 99, "99" }, { 99.9, "99.9" } };
+        sweep_percentiles.size =
+            sizeof(percentile_values) / sizeof(percentile_values[0]);
+        sweep_percentiles.values = percentile_values;
+    }
+
     if(requested_latency_types && !latency_percentiles.size) {
         static struct percentile_value percentile_values[] = {
             { 95, "95" }, { 99, "99" }, { 99.5, "99.5" } };
@@ -1078,6 +1682,33 @@ main(int argc, char **argv) {
         statsd = 0;
     }
 
+    struct hdr_log *hdr_log = NULL;
+    if(conf.hdr_log_file) {
+        if(!requested_latency_types) {
+            fprintf(stderr,
+                    "--hdr-log requires --latency-connect, "
+                    "--latency-first-byte, --latency-phases "
+                    "or --latency-marker\n");
+            exit(EX_USAGE);
+        }
+        hdr_log = hdr_log_open(conf.hdr_log_file, tk_now(TK_DEFAULT));
+        if(!hdr_log) exit(EX_CANTCREAT);
+    }
+
+    FILE *json_stream = NULL;
+    if(conf.json_stream_file) {
+        if(strcmp(conf.json_stream_file, "-") == 0) {
+            json_stream = stdout;
+        } else {
+            json_stream = fopen(conf.json_stream_file, "w");
+            if(!json_stream) {
+                fprintf(stderr, "Can not create --json-stream=%s: %s\n",
+                        conf.json_stream_file, strerror(errno));
+                exit(EX_CANTCREAT);
+            }
+        }
+    }
+
     if(print_stats) {
         /* Stop flashing cursor in the middle of status reporting. */
         tcpkali_disable_cursor();
@@ -1088,8 +1719,25 @@ main(int argc, char **argv) {
     /* Block term signals so they're not scheduled in the worker threads. */
     block_term_signals();
 
+    /* The capture thread is started here to keep the signals blocked. */
+    struct capture *capture = NULL;
+    if(conf.capture_file) {
+        capture = capture_open(conf.capture_file,
+                               engine_params.requested_workers,
+                               conf.capture_buffer);
+        if(!capture) exit(EX_CANTCREAT);
+        engine_params.capture = capture;
+    }
+
     struct engine *eng = engine_start(engine_params);
 
+    struct metrics_server *metrics = NULL;
+    if(conf.metrics_listen) {
+        metrics = metrics_server_start(conf.metrics_listen_addrs,
+                                       conf.metrics_listen, eng);
+        if(!metrics) exit(EX_UNAVAILABLE);
+    }
+
     /*
      * Traffic in/out moving average, smoothing period is 3 seconds.
      */
@@ -1101,7 +1749,12 @@ main(int argc, char **argv) {
         .statsd = statsd,
         .rate_modulator = &rate_modulator,
         .latency_percentiles = &latency_percentiles,
-        .print_stats = print_stats
+        .print_stats = print_stats,
+        .hdr_log = hdr_log,
+        .hdr_log_interval = conf.hdr_log_interval,
+        .metrics = metrics,
+        .json_stream = json_stream,
+        .json_stream_start = tk_now(TK_DEFAULT)
     };
     mavg_init(&oc_args.traffic_mavgs[0], tk_now(TK_DEFAULT), 1.0 / 8, 3.0);
     mavg_init(&oc_args.traffic_mavgs[1], tk_now(TK_DEFAULT), 1.0 / 8, 3.0);
@@ -1148,14 +1801,72 @@ main(int argc, char **argv) {
     oc_args.checkpoint.initial_traffic_stats = engine_traffic(eng);
     oc_args.checkpoint.epoch_start = tk_now(TK_DEFAULT);
 
+    if(sweep.kind != SWEEP_NONE) {
+        double epoch_start = oc_args.checkpoint.epoch_start;
+        struct sweep_step_result *results =
+            calloc(sweep.values_count, sizeof(*results));
+        assert(results);
+        size_t steps = sweep_run(&sweep, &oc_args, &orch_state, results);
+        flush_hdr_log(&oc_args);
+        hdr_log_close(hdr_log);
+        metrics_server_stop(metrics);
+        engine_terminate(eng, epoch_start,
+                         oc_args.checkpoint.initial_traffic_stats,
+                         &latency_percentiles);
+        capture_close(capture);
+        report_to_statsd(statsd, 0, requested_latency_types,
+                         &latency_percentiles);
+        if(engine_params.output_format == OUTPUT_FORMAT_JSON)
+            sweep_print_results_json(&sweep, results, steps,
+                                     &sweep_percentiles);
+        else
+            sweep_print_results(&sweep, results, steps, &sweep_percentiles);
+        sweep_free_results(results, steps);
+        free(results);
+        if(steps < sweep.values_count) exit(EX_USAGE); /* Interrupted */
+        return 0;
+    }
+
+    if(scenario.phases_count) {
+        double epoch_start = oc_args.checkpoint.epoch_start;
+        struct scenario_phase_result *results =
+            calloc(scenario.phases_count, sizeof(*results));
+        assert(results);
+        size_t phases =
+            scenario_run(&scenario, &oc_args, &orch_state, results);
+        flush_hdr_log(&oc_args);
+        hdr_log_close(hdr_log);
+        metrics_server_stop(metrics);
+        engine_terminate(eng, epoch_start,
+                         oc_args.checkpoint.initial_traffic_stats,
+                         &latency_percentiles);
+        capture_close(capture);
+        report_to_statsd(statsd, 0, requested_latency_types,
+                         &latency_percentiles);
+        if(engine_params.output_format == OUTPUT_FORMAT_JSON)
+            scenario_print_results_json(&scenario, results, phases,
+                                        &sweep_percentiles);
+        else
+            scenario_print_results(&scenario, results, phases,
+                                   &sweep_percentiles);
+        scenario_free_results(results, phases);
+        free(results);
+        if(phases < scenario.phases_count) exit(EX_USAGE); /* Interrupted */
+        return 0;
+    }
+
     /* Reset the test duration after ramp-up. */
     oc_args.epoch_end = tk_now(TK_DEFAULT) + conf.test_duration;
     enum oc_return_value orv = open_connections_until_maxed_out(
                                     PHASE_STEADY_STATE, &oc_args, &orch_state);
 
     fprintf(stderr, "%s", tcpkali_clear_eol());
+    flush_hdr_log(&oc_args);
+    hdr_log_close(hdr_log);
+    metrics_server_stop(metrics);
     engine_terminate(eng, oc_args.checkpoint.epoch_start,
                      oc_args.checkpoint.initial_traffic_stats, &latency_percentiles);
+    capture_close(capture);
 
     /* Send zeroes, otherwise graphs would continue showing non-zeroes... */
     report_to_statsd(statsd, 0, requested_latency_types, &latency_percentiles);
@@ -1170,22 +1881,51 @@ main(int argc, char **argv) {
     case OC_TIMEOUT:
         if(rate_modulator.mode != RM_UNMODULATED) {
             fprintf(stderr,
-                    "Failed to find the best --message-rate for latency %s in "
-                    "-T%g seconds\n",
+                    "Failed to find the best %s for latency %s in "
+                    "-T%g seconds\n", modulated_option,
                     rate_modulator.latency_target_s, conf.test_duration);
             exit(EX_UNAVAILABLE);
         }
         break;
     case OC_RATE_GOAL_MET:
-        printf("Best --message-rate for latency %s⁹⁵ᵖ is %g\n",
-               rate_modulator.latency_target_s,
+        if(engine_params.output_format == OUTPUT_FORMAT_JSON) {
+            printf("{\"type\":\"search\",\"option\":\"%s\""
+                   ",\"latency_target\":\"%s\",\"percentile\":%g"
+                   ",\"value\":%g",
+                   modulated_option, rate_modulator.latency_target_s,
+                   rate_modulator.latency_percentile,
+                   rate_modulator.suggested_rate_value);
+            if(isfinite(rate_modulator.rate_max_bound)) {
+                printf(",\"bracket\":[%g,%g]",
+                       rate_modulator.rate_min_bound,
+                       rate_modulator.rate_max_bound);
+            }
+            printf(",\"latency\":%.1f,\"latency_ci\":[%.1f,%.1f]}\n",
+                   1000 * rate_modulator.latency_at_min_bound,
+                   1000 * rate_modulator.latency_at_min_bound_ci[0],
+                   1000 * rate_modulator.latency_at_min_bound_ci[1]);
+            break;
+        }
+        printf("Best %s for latency %s at %g%% is %g\n",
+               modulated_option, rate_modulator.latency_target_s,
+               rate_modulator.latency_percentile,
                rate_modulator.suggested_rate_value);
+        if(isfinite(rate_modulator.rate_max_bound)) {
+            printf("Value is bracketed by %g..%g\n",
+                   rate_modulator.rate_min_bound,
+                   rate_modulator.rate_max_bound);
+        }
+        printf("Latency at %g%% is %.1f ms (95%% CI %.1f..%.1f ms)\n",
+               rate_modulator.latency_percentile,
+               1000 * rate_modulator.latency_at_min_bound,
+               1000 * rate_modulator.latency_at_min_bound_ci[0],
+               1000 * rate_modulator.latency_at_min_bound_ci[1]);
         break;
     case OC_RATE_GOAL_FAILED:
         fprintf(stderr,
-                "Best --message-rate for latency %s can not be determined in "
+                "Best %s for latency %s can not be determined in "
                 "time due to unstable target system behavior\n",
-                rate_modulator.latency_target_s);
+                modulated_option, rate_modulator.latency_target_s);
         exit(EX_UNAVAILABLE);
         break;
     }
@@ -1219,6 +1959,225 @@ parse_with_multipliers(const char *option, char *str, struct multiplier *ms,
     return value;
 }
 
+/*
+ * Parse a comma-separated list of values and ranges, such as
+ * "100,200,1k..5k:1k", into the sweep values.
+ * The step of the From..To range defaults to 1/10th of the range.
+ */
+static int
+parse_sweep_values(const char *option, char *str, struct sweep_spec *sweep) {
+    const size_t max_steps = 10000;
+    char *list = strdup(str);
+    char *saveptr = NULL;
+
+    for(char *tok = strtok_r(list, ",", &saveptr); tok;
+        tok = strtok_r(NULL, ",", &saveptr)) {
+        double from, to, step;
+        char *range = strstr(tok, "..");
+        if(range) {
+            char *to_s = range + 2;
+            char *step_s = strchr(to_s, ':');
+            *range = '\0';
+            if(step_s) *step_s++ = '\0';
+            from = parse_with_multipliers(
+                option, tok, km_multiplier,
+                sizeof(km_multiplier) / sizeof(km_multiplier[0]));
+            to = parse_with_multipliers(
+                option, to_s, km_multiplier,
+                sizeof(km_multiplier) / sizeof(km_multiplier[0]));
+            step = step_s ? parse_with_multipliers(
+                                option, step_s, km_multiplier,
+                                sizeof(km_multiplier) / sizeof(km_multiplier[0]))
+                          : (to - from) / 10;
+            if(from <= 0 || to < from || (step <= 0 && to > from)) {
+                fprintf(stderr,
+                        "--%s: %s: Expected <From>..<To>[:<Step>] "
+                        "with 0 < From <= To\n",
+                        option, str);
+                free(list);
+                return -1;
+            }
+            if(to == from) step = 1;
+        } else {
+            from = to = parse_with_multipliers(
+                option, tok, km_multiplier,
+                sizeof(km_multiplier) / sizeof(km_multiplier[0]));
+            step = 1;
+            if(from <= 0) {
+                fprintf(stderr, "--%s: %s: Positive values expected\n",
+                        option, str);
+                free(list);
+                return -1;
+            }
+        }
+
+        /* Allow for the floating point error accumulation. */
+        for(double v = from; v <= to + step / 1000; v += step) {
+            if(sweep->values_count == max_steps) {
+                fprintf(stderr, "--%s: %s: Too many steps, %zu max\n",
+                        option, str, max_steps);
+                free(list);
+                return -1;
+            }
+            sweep->values =
+                realloc(sweep->values,
+                        (sweep->values_count + 1) * sizeof(sweep->values[0]));
+            assert(sweep->values);
+            sweep->values[sweep->values_count++] =
+                sweep->kind == SWEEP_CONNECTIONS ? round(v) : v;
+        }
+    }
+
+    free(list);
+    if(sweep->values_count == 0) {
+        fprintf(stderr, "--%s: Non-empty list expected\n", option);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Parse the scenario file, which is a sequence of phases:
+ *
+ *  # Comment
+ *  [phase-name]
+ *  duration = 30s
+ *  connections = 100
+ *  message-rate = 10
+ *  message = "PING"
+ *  message-file = payload.bin
+ *  latency-window = 5s
+ *
+ * Everything but the duration is optional and is inherited
+ * from the previous phase, or the command line for the first phase.
+ */
+static int
+parse_scenario_file(const char *filename, struct scenario *scenario,
+                    int unescape) {
+    char *data;
+    size_t size;
+    if(read_in_file(filename, &data, &size) != 0) return -1;
+
+    struct scenario_phase *phase = NULL;
+    int lineno = 0;
+    char *saveptr = NULL;
+    for(char *line = data; line; line = saveptr) {
+        lineno++;
+        saveptr = strchr(line, '\n');
+        if(saveptr) *saveptr++ = '\0';
+
+        /* Strip the leading and trailing whitespace. */
+        while(isspace(*line)) line++;
+        char *end = line + strlen(line);
+        while(end > line && isspace(end[-1])) *--end = '\0';
+        if(*line == '\0' || *line == '#') continue;
+
+        if(*line == '[') {
+            if(end[-1] != ']' || end - line < 3) {
+                fprintf(stderr, "%s:%d: Expected [phase-name]\n", filename,
+                        lineno);
+                free(data);
+                return -1;
+            }
+            end[-1] = '\0';
+            scenario->phases =
+                realloc(scenario->phases, (scenario->phases_count + 1)
+                                              * sizeof(scenario->phases[0]));
+            assert(scenario->phases);
+            phase = &scenario->phases[scenario->phases_count++];
+            memset(phase, 0, sizeof(*phase));
+            phase->name = strdup(line + 1);
+            phase->connections = -1;
+            phase->message_rate = -1;
+            phase->latency_window = -1;
+            continue;
+        }
+
+        char *value = strchr(line, '=');
+        if(!value || !phase) {
+            fprintf(stderr, "%s:%d: Expected key = value inside a [phase]\n",
+                    filename, lineno);
+            free(data);
+            return -1;
+        }
+        char *key_end = value;
+        while(key_end > line && isspace(key_end[-1])) key_end--;
+        *key_end = '\0';
+        for(value++; isspace(*value); value++)
+            ;
+        /* Quotes allow for the leading and trailing whitespace. */
+        if(end - value >= 2 && *value == '"' && end[-1] == '"') {
+            value++;
+            end[-1] = '\0';
+        }
+
+        const char *key = line;
+        int bad_value = 0;
+        if(strcmp(key, "duration") == 0) {
+            phase->duration = parse_with_multipliers(
+                key, value, s_multiplier,
+                sizeof(s_multiplier) / sizeof(s_multiplier[0]));
+            bad_value = (phase->duration <= 0);
+        } else if(strcmp(key, "connections") == 0) {
+            double n = parse_with_multipliers(
+                key, value, km_multiplier,
+                sizeof(km_multiplier) / sizeof(km_multiplier[0]));
+            bad_value = (n < 0 || n > INT_MAX);
+            phase->connections = n;
+        } else if(strcmp(key, "message-rate") == 0) {
+            phase->message_rate = parse_with_multipliers(
+                key, value, km_multiplier,
+                sizeof(km_multiplier) / sizeof(km_multiplier[0]));
+            bad_value = (phase->message_rate <= 0);
+        } else if(strcmp(key, "latency-window") == 0) {
+            phase->latency_window = parse_with_multipliers(
+                key, value, s_multiplier,
+                sizeof(s_multiplier) / sizeof(s_multiplier[0]));
+            bad_value = (phase->latency_window < 0.5);
+        } else if(strcmp(key, "message") == 0) {
+            message_collection_add(&phase->message_collection,
+                                   MSK_PURPOSE_MESSAGE, value, strlen(value),
+                                   unescape, 1);
+        } else if(strcmp(key, "message-file") == 0) {
+            char *msg;
+            size_t msg_size;
+            if(read_in_file(value, &msg, &msg_size) != 0) {
+                free(data);
+                return -1;
+            }
+            message_collection_add(&phase->message_collection,
+                                   MSK_PURPOSE_MESSAGE, msg, msg_size,
+                                   unescape, 1);
+            free(msg);
+        } else {
+            fprintf(stderr, "%s:%d: Unknown setting \"%s\"\n", filename,
+                    lineno, key);
+            free(data);
+            return -1;
+        }
+        if(bad_value) {
+            fprintf(stderr, "%s:%d: Unexpected %s value \"%s\"\n", filename,
+                    lineno, key, value);
+            free(data);
+            return -1;
+        }
+    }
+    free(data);
+
+    if(scenario->phases_count == 0) {
+        fprintf(stderr, "%s: No [phases] defined\n", filename);
+        return -1;
+    }
+    for(size_t i = 0; i < scenario->phases_count; i++) {
+        if(scenario->phases[i].duration <= 0) {
+            fprintf(stderr, "%s: Phase [%s] needs a duration\n", filename,
+                    scenario->phases[i].name);
+            return -1;
+        }
+    }
+    return 0;
+}
+
 static int
 parse_percentile_values(const char *option, char *str,
                        struct percentile_values *array) {
@@ -1306,6 +2265,8 @@ usage_long(char *argv0, struct tcpkali_config *conf) {
     "  --dump-one-in                Dump incoming data for a single connection\n"
     "  --dump-one-out               Dump outgoing data for a single connection\n"
     "  --dump-{all,all-in,all-out}  Dump i/o data for all connections\n"
+    "  --capture <filename>         Capture i/o data of all connections into pcapng\n"
+    "  --capture-buffer <SizeBytes=8m>  Per-thread --capture buffer size\n"
     "  --nagle {on|off}             Control Nagle algorithm (set TCP_NODELAY)\n"
     "  --rcvbuf <SizeBytes>         Set TCP receive buffers (set SO_RCVBUF)\n"
     "  --sndbuf <SizeBytes>         Set TCP send buffers (set SO_SNDBUF)\n"
@@ -1314,11 +2275,17 @@ usage_long(char *argv0, struct tcpkali_config *conf) {
     "  -w, --workers <N=%ld>%s         Number of parallel threads to use\n"
     "\n"
     "  --ws, --websocket            Use RFC6455 WebSocket transport\n"
+    "  --ws-deflate                 Compress WebSocket messages (implies --ws)\n"
+    "  --ws-premasked               Reuse the masking keys, not RFC6455 compliant\n"
     "  --ssl                        Enable TLS\n"
     "  --ssl-cert <filename>        X.509 certificate file (default: cert.pem)\n"
     "  --ssl-key <filename>         Private key file (default: key.pem)\n"
+    "  --ssl-resume <Percent>       Resume TLS sessions in %% of connections\n"
+    "  --ssl-ktls                   Encrypt in the kernel (kTLS) when possible\n"
     "  -H, --header <string>        Add HTTP header into WebSocket handshake\n"
     "  -c, --connections <N=%d>      Connections to keep open to the destinations\n"
+    "  -c, --connections @<Latency> Find max connections at a given latency\n"
+    "  --per-destination            Break down the statistics by destination\n"
     "  --connect-rate <Rate=%g>     Limit number of new connections per second\n"
     "  --connect-timeout <Time=1s>  Limit time spent in a connection attempt\n"
     "  --channel-lifetime <Time>    Shut down each connection after Time seconds\n"
@@ -1339,13 +2306,28 @@ usage_long(char *argv0, struct tcpkali_config *conf) {
     "  -r, --message-rate <Rate>    Messages per second to send in a connection\n"
     "  -r, --message-rate @<Latency> Measure a message rate at a given latency\n"
     "  --message-stop <string>      Abort if this string is found in received data\n"
+    "  --pipeline-depth <N>         Keep at most N unanswered messages per connection\n"
+    "  --pcap <filename>            Replay the client TCP streams from a capture file\n"
+    "  --pcap-timing {original|fast}  Keep the captured packet timing (default)\n"
+    "                               or send the streams as fast as possible\n"
+    "  --corpus <filename>          Send the records of a file as messages\n"
+    "  --corpus-delimiter <string>  Record delimiter, unescaped (default: \\n)\n"
+    "  --corpus-length-prefixed     Records are prefixed by 32-bit BE length\n"
+    "  --corpus-order {sequential|random}  Order of the records sent\n"
+    "  --corpus-start <N>           Record the first connection starts from\n"
+    "  --stream-file <filename>     Send the file contents over and over again\n"
     "\n"
     "  --latency-connect            Measure TCP connection establishment latency\n"
     "  --latency-first-byte         Measure time to first byte latency\n"
+    "  --latency-phases             Measure TCP, TLS and WebSocket upgrade phases\n"
     "  --latency-marker <string>    Measure latency using a per-message marker\n"
     "  --latency-marker-skip <N>    Ignore the first N occurrences of a marker\n"
     "  --latency-percentiles <list> Report latency at specified percentiles\n"
+    "  --latency-target-percentile <P>  Percentile for -r @<Latency> (default 95)\n"
+    "  --hdr-log <filename>         Write latencies to an HdrHistogram interval log\n"
+    "  --hdr-log-interval <Time=1s> Interval of the --hdr-log histograms\n"
     "  --message-marker             Parse markers to calculate latency\n"
+    "  --http                       Parse HTTP/1.1 responses to calculate latency\n"
     "\n"
     "  --statsd                     Enable StatsD output (default %s)\n"
     "  --statsd-host <host>         StatsD host to send data (default is localhost)\n"
@@ -1353,10 +2335,21 @@ usage_long(char *argv0, struct tcpkali_config *conf) {
     "  --statsd-namespace <string>  Metric namespace (default is \"%s\")\n"
     "  --statsd-latency-window <T>  Aggregate latencies in discrete windows\n"
     "\n"
+    "  --metrics-listen <host:port> Serve Prometheus metrics at /metrics\n"
+    "  --output-format {text|json}  Format of the final stats (default text)\n"
+    "  --json-stream <filename>     Write the stats as JSON lines, - for stdout\n"
+    "\n"
+    "  --sweep-rate <list>          Measure latencies at each of the message rates\n"
+    "  --sweep-connections <list>   Measure latencies at each of the connection counts\n"
+    "  --sweep-warmup <Time=2s>     Time to let a sweep step settle before measuring\n"
+    "  --sweep-step <Time=10s>      Time to measure a single sweep step\n"
+    "  --scenario <filename>        Run the phases described in the file\n"
+    "\n"
     "  --server <host:port>         Orchestration server to connect to\n"
     "\n"
     "Variable units and recognized multipliers:\n"
     "  <N>, <Rate>:  k (1000, as in \"5k\" is 5000), m (1000000)\n"
+    "  <list>:       Comma-separated <N> and <From>..<To>[:<Step>] ranges\n"
     "  <SizeBytes>:  k (1024, as in \"5k\" is 5120), m (1024*1024)\n"
     "  <Bandwidth>:  kbps, Mbps (bits per second), kBps, MBps (bytes per second)\n"
     "  <Time>, <Latency>:  ms, s, m, h, d (milliseconds, seconds, minutes, etc)\n"
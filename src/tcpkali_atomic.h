@@ -77,6 +77,11 @@ atomic_inc_and_get(atomic_narrow_t *i) {
     return __sync_add_and_fetch(&i->_atomic_val, 1);
 }
 
+static inline non_atomic_narrow_t UNUSED
+atomic_add_and_get(atomic_narrow_t *i, non_atomic_narrow_t v) {
+    return __sync_add_and_fetch(&i->_atomic_val, v);
+}
+
 static inline non_atomic_narrow_t UNUSED
 atomic_get(const atomic_narrow_t *i) {
     return __sync_add_and_fetch(&((atomic_narrow_t *)i)->_atomic_val, 0);
@@ -140,6 +145,13 @@ atomic_inc_and_get(atomic_narrow_t *i) {
     return 1 + prev;
 }
 
+static inline non_atomic_narrow_t UNUSED
+atomic_add_and_get(atomic_narrow_t *i, non_atomic_narrow_t v) {
+    non_atomic_narrow_t prev = v;
+    asm volatile("lock xaddl %1, %0" : "+m"(i->_atomic_val), "+r"(prev));
+    return v + prev;
+}
+
 #endif /* Builtin atomics */
 
 #endif /* TCPKALI_ATOMIC_H */
@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <sys/types.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "tcpkali_capture.h"
+
+#define CAPTURE_MAX_SEGMENT 65000       /* Fits into an IPv4 packet */
+#define CAPTURE_DRAIN_INTERVAL_US 10000 /* Sleep when the rings are empty */
+#define LINKTYPE_RAW 101
+
+/*
+ * The header of the captured data in the ring.
+ */
+struct capture_record {
+    uint64_t timestamp; /* Microseconds since the Epoch */
+    uint32_t seq;
+    uint32_t ack;
+    uint32_t size; /* Bytes of data following the header */
+    uint8_t outgoing;
+    struct capture_endpoints endpoints;
+};
+
+#define RECORD_SIZE(data_size) \
+    ((sizeof(struct capture_record) + (data_size) + 7) & ~(size_t)7)
+
+struct capture_ring {
+    uint8_t *buf;
+    size_t size; /* Power of 2 */
+    /* Free-running offsets; the producer and the consumer own one each. */
+    volatile size_t head; /* Advanced by the worker */
+    char head_padding[64];
+    volatile size_t tail; /* Advanced by the capture thread */
+    char tail_padding[64];
+    size_t dropped_segments;
+    size_t dropped_bytes;
+};
+
+struct capture {
+    char *filename;
+    FILE *fp;
+    int write_errno;
+    size_t n_rings;
+    struct capture_ring *rings;
+    pthread_t thread;
+    volatile int stopping;
+    size_t segments_written;
+    uint8_t packet[60 + CAPTURE_MAX_SEGMENT]; /* IP + TCP headers + data */
+};
+
+static void
+put_le32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void
+put_n16(uint8_t *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static void
+put_n32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void
+capture_write(struct capture *cap, const void *data, size_t size) {
+    if(cap->write_errno) return;
+    if(fwrite(data, 1, size, cap->fp) != size) {
+        cap->write_errno = errno ? errno : EIO;
+    }
+}
+
+/*
+ * Synthesize the IP and TCP headers around the data
+ * and write it out as a pcapng Enhanced Packet Block.
+ */
+static void
+write_packet(struct capture *cap, const struct capture_record *rec) {
+    const struct capture_endpoints *ep = &rec->endpoints;
+    const uint8_t *src = rec->outgoing ? ep->local_addr : ep->remote_addr;
+    const uint8_t *dst = rec->outgoing ? ep->remote_addr : ep->local_addr;
+    uint16_t sport = rec->outgoing ? ep->local_port : ep->remote_port;
+    uint16_t dport = rec->outgoing ? ep->remote_port : ep->local_port;
+    size_t ip_len = (ep->family == 4) ? 20 : 40;
+    size_t packet_len = ip_len + 20 + rec->size;
+    uint8_t *ip = cap->packet;
+    uint8_t *tcp = cap->packet + ip_len;
+
+    memset(ip, 0, ip_len + 20);
+    if(ep->family == 4) {
+        ip[0] = 0x45;
+        put_n16(ip + 2, packet_len);
+        ip[6] = 0x40; /* Don't fragment */
+        ip[8] = 64;   /* TTL */
+        ip[9] = IPPROTO_TCP;
+        memcpy(ip + 12, src, 4);
+        memcpy(ip + 16, dst, 4);
+        uint32_t sum = 0;
+        for(int i = 0; i < 20; i += 2) sum += (ip[i] << 8) | ip[i + 1];
+        while(sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+        put_n16(ip + 10, ~sum);
+    } else {
+        ip[0] = 0x60;
+        put_n16(ip + 4, 20 + rec->size);
+        ip[6] = IPPROTO_TCP;
+        ip[7] = 64; /* Hop limit */
+        memcpy(ip + 8, src, 16);
+        memcpy(ip + 24, dst, 16);
+    }
+    put_n16(tcp, sport);
+    put_n16(tcp + 2, dport);
+    put_n32(tcp + 4, rec->seq);
+    put_n32(tcp + 8, rec->ack);
+    tcp[12] = 5 << 4;
+    tcp[13] = 0x18; /* PSH, ACK */
+    put_n16(tcp + 14, 65535);
+
+    size_t padded_len = (packet_len + 3) & ~(size_t)3;
+    uint8_t hdr[28];
+    uint8_t trailer[8] = {0};
+    put_le32(hdr, 6); /* Enhanced Packet Block */
+    put_le32(hdr + 4, 32 + padded_len);
+    put_le32(hdr + 8, 0); /* Interface */
+    put_le32(hdr + 12, rec->timestamp >> 32);
+    put_le32(hdr + 16, rec->timestamp);
+    put_le32(hdr + 20, packet_len);
+    put_le32(hdr + 24, packet_len);
+    put_le32(trailer + (padded_len - packet_len), 32 + padded_len);
+    capture_write(cap, hdr, sizeof(hdr));
+    capture_write(cap, cap->packet, packet_len);
+    capture_write(cap, trailer, (padded_len - packet_len) + 4);
+    cap->segments_written++;
+}
+
+static void
+ring_put(struct capture_ring *ring, size_t offset, const void *data,
+         size_t size) {
+    size_t pos = offset & (ring->size - 1);
+    size_t first = ring->size - pos;
+    if(first >= size) {
+        memcpy(ring->buf + pos, data, size);
+    } else {
+        memcpy(ring->buf + pos, data, first);
+        memcpy(ring->buf, (const uint8_t *)data + first, size - first);
+    }
+}
+
+static void
+ring_get(const struct capture_ring *ring, size_t offset, void *data,
+         size_t size) {
+    size_t pos = offset & (ring->size - 1);
+    size_t first = ring->size - pos;
+    if(first >= size) {
+        memcpy(data, ring->buf + pos, size);
+    } else {
+        memcpy(data, ring->buf + pos, first);
+        memcpy((uint8_t *)data + first, ring->buf, size - first);
+    }
+}
+
+void
+capture_data(struct capture_ring *ring, const struct capture_endpoints *ep,
+             int outgoing, uint64_t seq, uint64_t ack, const void *data,
+             size_t size) {
+    const uint8_t *p = data;
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    while(size) {
+        size_t chunk = size < CAPTURE_MAX_SEGMENT ? size : CAPTURE_MAX_SEGMENT;
+        size_t head = ring->head;
+        size_t tail = ring->tail;
+        __sync_synchronize(); /* Don't overwrite what is still being read */
+        if(ring->size - (head - tail) < RECORD_SIZE(chunk)) {
+            ring->dropped_segments++;
+            ring->dropped_bytes += size;
+            return;
+        }
+
+        struct capture_record rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.timestamp = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+        rec.seq = 1 + seq; /* Relative to the SYN */
+        rec.ack = 1 + ack;
+        rec.size = chunk;
+        rec.outgoing = outgoing;
+        rec.endpoints = *ep;
+        ring_put(ring, head, &rec, sizeof(rec));
+        ring_put(ring, head + sizeof(rec), p, chunk);
+        __sync_synchronize(); /* Publish the data before the head */
+        ring->head = head + RECORD_SIZE(chunk);
+
+        p += chunk;
+        size -= chunk;
+        seq += chunk;
+    }
+}
+
+static size_t
+drain_ring(struct capture *cap, struct capture_ring *ring) {
+    size_t head = ring->head;
+    size_t tail = ring->tail;
+    size_t drained = 0;
+
+    __sync_synchronize(); /* Read the data published before the head */
+    while(tail != head) {
+        struct capture_record rec;
+        ring_get(ring, tail, &rec, sizeof(rec));
+        size_t ip_len = (rec.endpoints.family == 4) ? 20 : 40;
+        ring_get(ring, tail + sizeof(rec), cap->packet + ip_len + 20,
+                 rec.size);
+        tail += RECORD_SIZE(rec.size);
+        __sync_synchronize(); /* Done reading before releasing the space */
+        ring->tail = tail;
+        write_packet(cap, &rec);
+        drained++;
+    }
+
+    return drained;
+}
+
+static void *
+capture_thread(void *arg) {
+    struct capture *cap = arg;
+
+    for(;;) {
+        int stopping = cap->stopping;
+        __sync_synchronize();
+        size_t drained = 0;
+        for(size_t i = 0; i < cap->n_rings; i++) {
+            drained += drain_ring(cap, &cap->rings[i]);
+        }
+        if(stopping) break;
+        if(!drained) {
+            if(!cap->write_errno && fflush(cap->fp) != 0)
+                cap->write_errno = errno;
+            usleep(CAPTURE_DRAIN_INTERVAL_US);
+        }
+    }
+
+    return NULL;
+}
+
+struct capture *
+capture_open(const char *filename, size_t n_rings, size_t ring_size) {
+    assert(n_rings > 0);
+    assert(ring_size > RECORD_SIZE(CAPTURE_MAX_SEGMENT));
+
+    FILE *fp = fopen(filename, "wb");
+    if(!fp) {
+        fprintf(stderr, "Can not create --capture=%s: %s\n", filename,
+                strerror(errno));
+        return NULL;
+    }
+    setvbuf(fp, NULL, _IOFBF, 256 * 1024);
+
+    struct capture *cap = calloc(1, sizeof(*cap));
+    assert(cap);
+    cap->filename = strdup(filename);
+    cap->fp = fp;
+    cap->n_rings = n_rings;
+    cap->rings = calloc(n_rings, sizeof(cap->rings[0]));
+    assert(cap->rings);
+
+    size_t size = 1;
+    while(size < ring_size) size <<= 1;
+    for(size_t i = 0; i < n_rings; i++) {
+        cap->rings[i].buf = malloc(size);
+        assert(cap->rings[i].buf);
+        cap->rings[i].size = size;
+    }
+
+    /* Section Header Block */
+    uint8_t shb[28];
+    put_le32(shb, 0x0a0d0d0a);
+    put_le32(shb + 4, sizeof(shb));
+    put_le32(shb + 8, 0x1a2b3c4d);
+    shb[12] = 1; /* Version 1.0 */
+    shb[13] = 0;
+    shb[14] = 0;
+    shb[15] = 0;
+    memset(shb + 16, 0xff, 8); /* Unknown section length */
+    put_le32(shb + 24, sizeof(shb));
+    capture_write(cap, shb, sizeof(shb));
+
+    /* Interface Description Block: raw IP, microsecond timestamps */
+    uint8_t idb[20];
+    put_le32(idb, 1);
+    put_le32(idb + 4, sizeof(idb));
+    put_le32(idb + 8, LINKTYPE_RAW);
+    put_le32(idb + 12, 0); /* No snapshot length limit */
+    put_le32(idb + 16, sizeof(idb));
+    capture_write(cap, idb, sizeof(idb));
+
+    if(cap->write_errno || fflush(fp) != 0) {
+        fprintf(stderr, "Can not write --capture=%s: %s\n", filename,
+                strerror(cap->write_errno ? cap->write_errno : errno));
+        fclose(fp);
+        return NULL;
+    }
+
+    int rc = pthread_create(&cap->thread, 0, capture_thread, cap);
+    assert(rc == 0);
+
+    return cap;
+}
+
+struct capture_ring *
+capture_ring(struct capture *cap, size_t n) {
+    assert(n < cap->n_rings);
+    return &cap->rings[n];
+}
+
+static void
+endpoint_address(const struct sockaddr_storage *ss, uint8_t *addr,
+                 uint16_t *port) {
+    switch(ss->ss_family) {
+    case AF_INET: {
+        const struct sockaddr_in *sin = (const struct sockaddr_in *)ss;
+        memcpy(addr, &sin->sin_addr, 4);
+        *port = ntohs(sin->sin_port);
+    } break;
+    case AF_INET6: {
+        const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)ss;
+        memcpy(addr, &sin6->sin6_addr, 16);
+        *port = ntohs(sin6->sin6_port);
+    } break;
+    }
+}
+
+void
+capture_endpoints_init(struct capture_endpoints *ep, int fd,
+                       const struct sockaddr_storage *remote) {
+    struct sockaddr_storage local;
+    socklen_t local_len = sizeof(local);
+
+    memset(ep, 0, sizeof(*ep));
+    ep->family = (remote->ss_family == AF_INET6) ? 6 : 4;
+    endpoint_address(remote, ep->remote_addr, &ep->remote_port);
+    if(getsockname(fd, (struct sockaddr *)&local, &local_len) == 0
+       && local.ss_family == remote->ss_family) {
+        endpoint_address(&local, ep->local_addr, &ep->local_port);
+    }
+}
+
+void
+capture_close(struct capture *cap) {
+    if(!cap) return;
+
+    __sync_synchronize();
+    cap->stopping = 1;
+    pthread_join(cap->thread, NULL);
+
+    size_t dropped_segments = 0;
+    size_t dropped_bytes = 0;
+    for(size_t i = 0; i < cap->n_rings; i++) {
+        dropped_segments += cap->rings[i].dropped_segments;
+        dropped_bytes += cap->rings[i].dropped_bytes;
+        free(cap->rings[i].buf);
+    }
+
+    if(fclose(cap->fp) != 0 && !cap->write_errno) cap->write_errno = errno;
+    if(cap->write_errno) {
+        fprintf(stderr, "Can not write --capture=%s: %s\n", cap->filename,
+                strerror(cap->write_errno));
+    }
+    if(dropped_segments) {
+        fprintf(stderr,
+                "--capture=%s: %zu of %zu segments (%zu bytes) dropped, "
+                "consider increasing --capture-buffer\n",
+                cap->filename, dropped_segments,
+                dropped_segments + cap->segments_written, dropped_bytes);
+    }
+
+    free(cap->rings);
+    free(cap->filename);
+    free(cap);
+}
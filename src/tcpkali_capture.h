@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef TCPKALI_CAPTURE_H
+#define TCPKALI_CAPTURE_H
+
+#include <sys/socket.h>
+#include <stdint.h>
+
+/*
+ * Binary traffic capture (--capture).
+ * The workers append the data they send and receive to their own
+ * single-producer single-consumer rings, without taking locks.
+ * A background thread drains the rings into a pcapng file, prepending
+ * synthetic IP and TCP headers so that the usual tools could follow
+ * the TCP streams.
+ */
+struct capture;
+struct capture_ring;
+
+/*
+ * The addresses of a captured connection, as they appear on the wire.
+ */
+struct capture_endpoints {
+    uint8_t family; /* 4 or 6 */
+    uint8_t local_addr[16];
+    uint8_t remote_addr[16];
+    uint16_t local_port;
+    uint16_t remote_port;
+};
+
+/*
+ * Create the capture file and start the thread draining (n_rings)
+ * rings of (ring_size) bytes each into it.
+ * Returns NULL and prints the reason if the file can not be created.
+ */
+struct capture *capture_open(const char *filename, size_t n_rings,
+                             size_t ring_size);
+
+/*
+ * Get the ring to be exclusively used by the given worker.
+ */
+struct capture_ring *capture_ring(struct capture *, size_t n);
+
+/*
+ * Fill in the endpoints of a connected socket.
+ */
+void capture_endpoints_init(struct capture_endpoints *, int fd,
+                            const struct sockaddr_storage *remote);
+
+/*
+ * Put the data into the ring. The (seq) and (ack) are the number of bytes
+ * sent and received on the connection before this data, from the point
+ * of view of the data sender. Never blocks: if the ring is full,
+ * the data is dropped and accounted for.
+ */
+void capture_data(struct capture_ring *, const struct capture_endpoints *,
+                  int outgoing, uint64_t seq, uint64_t ack, const void *data,
+                  size_t size);
+
+/*
+ * Drain the rest of the data and close the file.
+ * Must be called after the workers are stopped.
+ */
+void capture_close(struct capture *);
+
+#endif /* TCPKALI_CAPTURE_H */
@@ -41,7 +41,10 @@
 typedef enum {
     SLT_CONNECT = (1 << 0),
     SLT_FIRSTBYTE = (1 << 1),
-    SLT_MARKER = (1 << 2)
+    SLT_MARKER = (1 << 2),
+    SLT_TLS = (1 << 3),     /* --latency-phases with --ssl */
+    SLT_UPGRADE = (1 << 4), /* --latency-phases with --websocket */
+    SLT_APPBYTE = (1 << 5)  /* --latency-phases with --websocket */
 } statsd_report_latency_types;
 
 #define MESSAGE_MARKER_TOKEN "TCPKaliMsgTS-"
@@ -53,6 +56,9 @@ struct latency_snapshot {
     struct hdr_histogram *connect_histogram;
     struct hdr_histogram *firstbyte_histogram;
     struct hdr_histogram *marker_histogram;
+    struct hdr_histogram *tls_histogram;     /* TLS handshake */
+    struct hdr_histogram *upgrade_histogram; /* WebSocket upgrade response */
+    struct hdr_histogram *appbyte_histogram; /* First byte after upgrade */
 };
 
 /*
@@ -13,6 +13,7 @@
 #include "tcpkali_ssl.h"
 #include "tcpkali_traffic_stats.h"
 #include "tcpkali_transport.h"
+#include "tcpkali_websocket.h"
 
 /*
  * A single connection is described by this structure (about 150 bytes).
@@ -31,7 +32,12 @@ struct connection {
     struct pacefier recv_pace;
     bandwidth_limit_t send_limit;
     bandwidth_limit_t recv_limit;
-    struct message_collection message_collection;
+    struct message_collection *message_collection; /* Shared, immutable */
+    struct expr_conn_values expr_values; /* Its "per connection" values */
+    struct transport_template *message_template; /* DS_PER_MESSAGE layout */
+    uint64_t mask_seed; /* Keys of the shared frames, see remasked_chunk() */
+    struct payload *payload; /* Shared DS_PER_CONNECTION data */
+    int data_pending;        /* See prepare_connection_data() */
     enum {
         CW_READ_INTEREST = 0x01,
         CW_READ_BLOCKED = 0x10,
@@ -52,15 +58,36 @@ struct connection {
         WSTATE_SENDING_HTTP_UPGRADE,
         WSTATE_WS_ESTABLISHED,
     } ws_state : 1;
+    /* Receiving the WebSocket frames (--websocket) */
+    struct websocket_decoder *ws_decoder;
+    struct websocket_inflater *ws_inflater; /* --ws-deflate */
+    struct {
+        uint8_t buf[WEBSOCKET_MAX_FRAME_HDR_SIZE + 125];
+        size_t size;   /* Pong frame waiting to be sent, if non-zero */
+        size_t offset; /* Bytes of it already sent */
+    } *ws_pong;
     int16_t remote_index;                     /* \x ->
                                                  loop_arguments.params.remote_addresses.addrs[x] */
     non_atomic_narrow_t connection_unique_id; /* connection.uid */
+    non_atomic_narrow_t message_seq;          /* message.seq */
+    struct global_seq_block *global_seq;      /* global.seq, per worker */
+    size_t message_set; /* engine_params.message_set we're sending */
     TAILQ_ENTRY(connection) hook;
     struct sockaddr_storage peer_name; /* For CONN_INCOMING */
     /* Latency */
     struct {
         double connection_initiated;
+        /* Connection establishment phases, see --latency-phases */
+        enum connection_phase {
+            CPHASE_TCP,     /* TCP handshake */
+            CPHASE_TLS,     /* TLS handshake */
+            CPHASE_UPGRADE, /* Waiting for the WebSocket upgrade response */
+            CPHASE_APPBYTE, /* Waiting for the first byte after the upgrade */
+            CPHASE_DONE
+        } phase;
+        double phase_started; /* When the previous phase ended */
         struct ring_buffer *sent_timestamps;
+        unsigned messages_in_flight;   /* See --pipeline-depth */
         struct hdr_histogram *marker_histogram;
         unsigned message_bytes_credit; /* See (EXPL:1) below. */
         unsigned lm_occurrences_skip;  /* See --latency-marker-skip */
@@ -75,8 +102,27 @@ struct connection {
             enum { MP_DISENGAGED, MP_SLURPING_DIGITS } state;
             uint64_t collected_digits;
         } marker_parser;
+        struct http_response_parser *http_parser; /* --http */
     } latency;
     struct StreamBMH *sbmh_stop_ctx;
+    /* Replaying the captured client stream (--pcap) */
+    struct {
+        const struct pcap_flow *flow;
+        size_t segment; /* Next segment to send */
+        size_t offset;  /* Bytes of that segment already sent */
+    } replay;
+    struct capture_endpoints *capture_endpoints; /* --capture */
+    /* Sending the --corpus records */
+    struct {
+        const struct corpus *corpus;
+        size_t record; /* Record being sent */
+        size_t offset; /* Bytes of it already sent */
+    } corpus;
+    /* Sending the --stream-file */
+    struct {
+        int enabled;
+        off_t offset; /* File position to send next */
+    } stream;
     enum {
         CBLOCKED_ON_INIT  = 0x01,
         CBLOCKED_ON_READ  = 0x10,
@@ -84,12 +130,12 @@ struct connection {
     } conn_blocked : 8;
 #ifdef HAVE_OPENSSL
     /* SSL/TLS support */
-    SSL_CTX *ssl_ctx;
     SSL *ssl_fd;
+    int ssl_ktls_send; /* The kernel encrypts what we write(2), --ssl-ktls */
 #endif
 };
 
-int ssl_setup(struct connection *conn, int sockfd, char *ssl_cert,
-              char *ssl_key);
+int ssl_setup(struct connection *conn, int sockfd,
+              struct tcpkali_ssl_worker *);
 
 #endif /* TCPKALI_CONNECTION_H */
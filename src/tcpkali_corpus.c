@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "tcpkali_corpus.h"
+
+static void
+add_record(struct corpus *corpus, size_t *records_size, const char *data,
+           size_t size) {
+    if(corpus->records_count == *records_size) {
+        *records_size = *records_size ? 2 * *records_size : 1024;
+        corpus->records = realloc(corpus->records,
+                                  *records_size * sizeof(corpus->records[0]));
+        assert(corpus->records);
+    }
+    corpus->records[corpus->records_count].data = data;
+    corpus->records[corpus->records_count].size = size;
+    corpus->records_count++;
+    corpus->total_size += size;
+}
+
+static int
+index_delimited(struct corpus *corpus, const char *delimiter,
+                size_t delimiter_size) {
+    const char *p = corpus->map;
+    const char *end = p + corpus->map_size;
+    size_t records_size = 0;
+
+    while(p < end) {
+        const char *d = memmem(p, end - p, delimiter, delimiter_size);
+        const char *next = d ? d + delimiter_size : end;
+        add_record(corpus, &records_size, p, next - p);
+        p = next;
+    }
+
+    corpus->contiguous = 1;
+    return 0;
+}
+
+static int
+index_length_prefixed(struct corpus *corpus, const char *filename) {
+    const unsigned char *p = corpus->map;
+    const unsigned char *end = p + corpus->map_size;
+    size_t records_size = 0;
+
+    while(p < end) {
+        if(end - p < 4) {
+            fprintf(stderr, "%s: Truncated record length at offset %zu\n",
+                    filename, (size_t)(p - (const unsigned char *)corpus->map));
+            return -1;
+        }
+        size_t size = ((size_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        p += 4;
+        if(size > (size_t)(end - p)) {
+            fprintf(stderr, "%s: Truncated record at offset %zu\n", filename,
+                    (size_t)(p - 4 - (const unsigned char *)corpus->map));
+            return -1;
+        }
+        /* Empty records carry nothing to send. */
+        if(size) add_record(corpus, &records_size, (const char *)p, size);
+        p += size;
+    }
+
+    corpus->contiguous = 0;
+    return 0;
+}
+
+struct corpus *
+corpus_open(const char *filename, const char *delimiter,
+            size_t delimiter_size) {
+    assert(!delimiter || delimiter_size);
+
+    int fd = open(filename, O_RDONLY);
+    if(fd == -1) {
+        fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) == -1) {
+        fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    if(st.st_size == 0) {
+        fprintf(stderr, "%s: File has no content\n", filename);
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) {
+        fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+        return NULL;
+    }
+
+    struct corpus *corpus = calloc(1, sizeof(*corpus));
+    assert(corpus);
+    corpus->map = map;
+    corpus->map_size = st.st_size;
+
+    int ret = delimiter
+                  ? index_delimited(corpus, delimiter, delimiter_size)
+                  : index_length_prefixed(corpus, filename);
+    if(ret == 0 && corpus->records_count == 0) {
+        fprintf(stderr, "%s: No records found\n", filename);
+        ret = -1;
+    }
+    if(ret != 0) {
+        corpus_close(corpus);
+        return NULL;
+    }
+
+    return corpus;
+}
+
+void
+corpus_close(struct corpus *corpus) {
+    if(!corpus) return;
+    munmap(corpus->map, corpus->map_size);
+    free(corpus->records);
+    free(corpus);
+}
+
+#ifdef TCPKALI_CORPUS_UNIT_TEST
+
+static struct corpus *
+corpus_from_string(const char *content, size_t size, const char *delimiter) {
+    char filename[] = "/tmp/check_tcpkali_corpus.XXXXXX";
+    int fd = mkstemp(filename);
+    assert(fd != -1);
+    if(write(fd, content, size) != (ssize_t)size) {
+        fprintf(stderr, "%s: Can not write the test corpus\n", filename);
+        exit(1);
+    }
+    close(fd);
+    struct corpus *corpus = corpus_open(filename, delimiter,
+                                        delimiter ? strlen(delimiter) : 0);
+    unlink(filename);
+    return corpus;
+}
+
+static void
+check_record(struct corpus *corpus, size_t n, const char *expected) {
+    assert(n < corpus->records_count);
+    assert(corpus->records[n].size == strlen(expected));
+    assert(memcmp(corpus->records[n].data, expected, strlen(expected)) == 0);
+}
+
+int
+main() {
+    struct corpus *corpus;
+
+    corpus = corpus_from_string("GET /a\nGET /b\n\nGET /c", 21, "\n");
+    assert(corpus);
+    assert(corpus->records_count == 4);
+    assert(corpus->contiguous);
+    assert(corpus->total_size == 21);
+    check_record(corpus, 0, "GET /a\n");
+    check_record(corpus, 1, "GET /b\n");
+    check_record(corpus, 2, "\n");
+    check_record(corpus, 3, "GET /c");
+    corpus_close(corpus);
+
+    corpus = corpus_from_string("a\r\n\r\nbb\r\n\r\n", 11, "\r\n\r\n");
+    assert(corpus);
+    assert(corpus->records_count == 2);
+    check_record(corpus, 0, "a\r\n\r\n");
+    check_record(corpus, 1, "bb\r\n\r\n");
+    corpus_close(corpus);
+
+    corpus = corpus_from_string("\0\0\0\3abc\0\0\0\0\0\0\0\1z", 16, NULL);
+    assert(corpus);
+    assert(corpus->records_count == 2);
+    assert(!corpus->contiguous);
+    check_record(corpus, 0, "abc");
+    check_record(corpus, 1, "z");
+    corpus_close(corpus);
+
+    /* Truncated record */
+    assert(corpus_from_string("\0\0\0\5abc", 7, NULL) == NULL);
+
+    printf("OK\n");
+    return 0;
+}
+
+#endif /* TCPKALI_CORPUS_UNIT_TEST */
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef TCPKALI_CORPUS_H
+#define TCPKALI_CORPUS_H
+
+#include <stddef.h>
+
+/*
+ * A corpus of messages (--corpus): a file with many distinct records,
+ * memory-mapped once and shared by all workers. The records are sent
+ * straight from the mapping.
+ */
+struct corpus {
+    void *map;
+    size_t map_size;
+    struct corpus_record {
+        const char *data;
+        size_t size;
+    } * records;
+    size_t records_count;
+    size_t total_size; /* Sum of the record sizes */
+    /* Records follow each other in the file, without separators. */
+    int contiguous;
+};
+
+/*
+ * Map the file and index the records. The records are either terminated by
+ * the (delimiter), which is sent as part of the record, or, if (delimiter)
+ * is NULL, prefixed by their 4-byte big-endian length, which is not sent.
+ * Returns NULL and prints the reason if the file can not be used.
+ */
+struct corpus *corpus_open(const char *filename, const char *delimiter,
+                           size_t delimiter_size);
+
+void corpus_close(struct corpus *);
+
+#endif /* TCPKALI_CORPUS_H */
@@ -48,6 +48,9 @@
 #ifdef HAVE_SCHED_H
 #include <sched.h>
 #endif
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 
 #include <StreamBoyerMooreHorspool.h>
 #include <hdr_histogram.h>
@@ -66,6 +69,9 @@
 #include "tcpkali_traffic_stats.h"
 #include "tcpkali_connection.h"
 #include "tcpkali_ssl.h"
+#include "tcpkali_json.h"
+#include "tcpkali_payload.h"
+#include "tcpkali_http.h"
 
 #ifndef TAILQ_FOREACH_SAFE
 #define TAILQ_FOREACH_SAFE(var, head, field, tvar) \
@@ -73,6 +79,9 @@
         (var) && ((tvar) = TAILQ_NEXT((var), field), 1); (var) = (tvar))
 #endif
 
+/* Number of global.seq values a worker reserves at a time. */
+#define GLOBAL_SEQ_BLOCK 64
+
 struct loop_arguments {
     /**************************
      * NON-SHARED WORKER DATA *
@@ -101,13 +110,37 @@ struct loop_arguments {
     struct hdr_histogram *connect_histogram_local;   /* --latency-connect */
     struct hdr_histogram *firstbyte_histogram_local; /* --latency-first-byte */
     struct hdr_histogram *marker_histogram_local;    /* --latency-marker */
+    struct hdr_histogram *tls_histogram_local;       /* --latency-phases */
+    struct hdr_histogram *upgrade_histogram_local;   /* --latency-phases */
+    struct hdr_histogram *appbyte_histogram_local;   /* --latency-phases */
+    struct destination_stats *destination_stats_local; /* --per-destination */
+    struct capture_ring *capture_ring;                 /* --capture */
 
     /* Per-worker scratch buffer allows debugging the last received data */
     char scratch_recv_buf[16384];
     size_t scratch_recv_last_size;
 
+    /* The shared client frames re-keyed before being sent, see below */
+    struct remask_scratch {
+        char buf[REPLICATE_MAX_SIZE];
+        size_t size;
+        const void *data;       /* Connection's data.ptr */
+        uint64_t seed;          /* Connection's mask_seed */
+        size_t offset;          /* Offset of buf[0] in the data */
+        uint64_t stream_offset; /* Position of buf[0] in the stream */
+    } scratch_send;
+
     pcg32_random_t rng;
 
+    /* The per-connection data, deduplicated across connections. */
+    struct payload_cache *payload_cache;
+
+    /* Compresses the per-connection and per-message data (--ws-deflate) */
+    struct websocket_deflater *ws_deflater;
+
+    /* The TLS contexts and the session to resume (--ssl) */
+    struct tcpkali_ssl_worker ssl;
+
     /*******************************************
      * WORKER DATA SHARED WITH OTHER PROCESSES *
      *******************************************/
@@ -121,6 +154,17 @@ struct loop_arguments {
      */
     atomic_narrow_t *connection_unique_id_atomic;
 
+    /*
+     * The global.seq counter is shared in the same way. Each worker
+     * reserves a block of values at a time to avoid contending on it
+     * for every message.
+     */
+    struct global_seq_block {
+        atomic_narrow_t *shared;
+        non_atomic_narrow_t next; /* Last value handed out */
+        non_atomic_narrow_t end;  /* Last value reserved */
+    } global_seq;
+
     /*
      * Reporting histograms should not be touched
      * unless asked through a private control pipe.
@@ -128,6 +172,10 @@ struct loop_arguments {
     struct hdr_histogram *connect_histogram_shared;
     struct hdr_histogram *firstbyte_histogram_shared;
     struct hdr_histogram *marker_histogram_shared;
+    struct hdr_histogram *tls_histogram_shared;
+    struct hdr_histogram *upgrade_histogram_shared;
+    struct hdr_histogram *appbyte_histogram_shared;
+    struct destination_stats *destination_stats_shared;
     pthread_mutex_t shared_histograms_lock;
 
     /*
@@ -154,6 +202,7 @@ struct loop_arguments {
  */
 enum control_message_type_e {
     CONTROL_MESSAGE_CONNECT,
+    CONTROL_MESSAGE_DISCONNECT,
     _CONTROL_MESSAGES_MAXID /* Do not use. */
 };
 
@@ -170,6 +219,7 @@ struct engine {
     int n_workers;
     non_atomic_traffic_stats total_traffic_stats;
     atomic_narrow_t connection_unique_id_global;
+    atomic_narrow_t global_seq_global;
     pthread_mutex_t serialize_output_lock;
 };
 
@@ -207,6 +257,13 @@ static void update_io_interest(TK_P_ struct connection *conn);
 static struct sockaddr_storage *pick_remote_address(
     struct loop_arguments *largs, size_t *remote_index);
 static char *express_bytes(size_t bytes, char *buf, size_t size);
+static void print_json_summary(
+    const struct engine_params *params, double test_duration,
+    const non_atomic_traffic_stats *traffic, long conns, size_t conn_in,
+    size_t conn_out, size_t conn_counter,
+    const struct latency_snapshot *latency,
+    const struct destination_snapshot *destinations,
+    const struct percentile_values *latency_percentiles);
 static int limit_channel_lifetime(struct loop_arguments *largs);
 static void set_nbio(int fd, int onoff);
 static void set_socket_options(int fd, struct loop_arguments *largs);
@@ -218,15 +275,40 @@ static void largest_contiguous_chunk(struct loop_arguments *largs,
                                      const void **position,
                                      size_t *available_header,
                                      size_t *available_body);
+static void replay_captured_flow(TK_P_ struct connection *conn,
+                                 struct sockaddr_storage *remote);
+static void corpus_connection_init(struct loop_arguments *largs,
+                                   struct connection *conn, double now);
+static void corpus_advance(TK_P_ struct connection *conn, size_t wrote);
+static int ssl_write_needed(const struct loop_arguments *largs,
+                            const struct connection *conn);
+static ssize_t stream_file_write(struct loop_arguments *largs,
+                                 struct connection *conn, int sockfd,
+                                 const void **position, size_t size);
 static void debug_dump_data(const char *prefix, int fd, const void *data,
                             size_t size, ssize_t limit);
+static void capture_connection_data(struct loop_arguments *largs,
+                                    struct connection *conn, int outgoing,
+                                    const void *data, size_t size);
 static void debug_dump_data_highlight(const char *prefix, int fd,
                                       const void *data, size_t size,
                                       ssize_t limit, size_t hl_offset,
                                       size_t hl_length);
-static void
+static int
 latency_record_incoming_ts(TK_P_ struct connection *conn, char *buf,
                            size_t size);
+static int websocket_record_incoming(TK_P_ struct connection *conn,
+                                     char *buf, size_t size);
+static int send_websocket_pong(TK_P_ struct connection *conn,
+                               struct sockaddr_storage *remote);
+static struct destination_snapshot *collect_destination_snapshot(
+    struct engine *eng, int from_local);
+static void destination_stats_init(struct destination_stats *ds,
+                                   statsd_report_latency_types latency_setting);
+static struct destination_stats *connection_destination(
+    struct loop_arguments *largs, struct connection *conn);
+static void connection_phase_done(TK_P_ struct connection *conn,
+                                  enum connection_phase phase);
 
 #ifdef USE_LIBUV
 static void
@@ -265,6 +347,35 @@ control_cb_uv(tk_io *w, int UNUSED status, int revents) {
             debug_log(level, largs->params.verbosity_level, fmt, ##args); \
     } while(0)
 
+/*
+ * The data template creation may fail because the message collection
+ * might contain expressions which must be resolved
+ * on a per connection or per message basis.
+ */
+static void
+prepare_data_templates(struct message_collection *mc,
+                       struct transport_data_spec *data_templates[2]) {
+    enum transport_websocket_side tws_side;
+    for(tws_side = TWS_SIDE_CLIENT; tws_side <= TWS_SIDE_SERVER; tws_side++) {
+        assert(data_templates[tws_side] == NULL);
+        pcg32_random_t rng;
+        pcg32_srandom_r(&rng, random(), tws_side);
+        struct websocket_deflater *deflater =
+            mc->ws_deflate ? websocket_deflater_new() : NULL;
+        data_templates[tws_side] = transport_spec_from_message_collection(
+            0, mc, 0, 0, NULL, tws_side, TS_CONVERSION_INITIAL, &rng,
+            deflater);
+        websocket_deflater_free(deflater);
+        assert(data_templates[tws_side]
+               || mc->most_dynamic_expression != DS_GLOBAL_FIXED);
+    }
+
+    if(data_templates[0])
+        replicate_payload(data_templates[0], REPLICATE_MAX_SIZE);
+    if(data_templates[1])
+        replicate_payload(data_templates[1], REPLICATE_MAX_SIZE);
+}
+
 struct engine *
 engine_start(struct engine_params params) {
     int fildes[2];
@@ -291,30 +402,12 @@ engine_start(struct engine_params params) {
         n_workers = n_cpus;
     }
 
-    /*
-     * The data template creation may fail because the message collection
-     * might contain expressions which must be resolved
-     * on a per connection or per message basis.
-     */
-    enum transport_websocket_side tws_side;
-    for(tws_side = TWS_SIDE_CLIENT; tws_side <= TWS_SIDE_SERVER; tws_side++) {
-        assert(params.data_templates[tws_side] == NULL);
-        pcg32_random_t rng;
-        pcg32_srandom_r(&rng, random(), tws_side);
-        params.data_templates[tws_side] =
-            transport_spec_from_message_collection(
-                0, &params.message_collection, 0, 0, tws_side,
-                TS_CONVERSION_INITIAL, &rng);
-        assert(params.data_templates[tws_side]
-               || params.message_collection.most_dynamic_expression
-                      != DS_GLOBAL_FIXED);
+    prepare_data_templates(&params.message_collection, params.data_templates);
+    for(size_t i = 0; i < params.message_sets_count; i++) {
+        prepare_data_templates(&params.message_sets[i].message_collection,
+                               params.message_sets[i].data_templates);
     }
 
-    if(params.data_templates[0])
-        replicate_payload(params.data_templates[0], REPLICATE_MAX_SIZE);
-    if(params.data_templates[1])
-        replicate_payload(params.data_templates[1], REPLICATE_MAX_SIZE);
-
     struct engine *eng = calloc(1, sizeof(*eng));
     eng->params = params;
     eng->loops = calloc(n_workers, sizeof(eng->loops[0]));
@@ -351,10 +444,27 @@ engine_start(struct engine_params params) {
         struct loop_arguments *largs = &eng->loops[n];
         TAILQ_INIT(&largs->open_conns);
         largs->connection_unique_id_atomic = &eng->connection_unique_id_global;
+        largs->global_seq.shared = &eng->global_seq_global;
         largs->params = params;
         largs->shared_eng_params = &eng->params;
         largs->remote_stats = calloc(params.remote_addresses.n_addrs,
                                      sizeof(largs->remote_stats[0]));
+        if(params.per_destination) {
+            size_t n_addrs = params.remote_addresses.n_addrs;
+            largs->destination_stats_local =
+                calloc(n_addrs, sizeof(largs->destination_stats_local[0]));
+            largs->destination_stats_shared =
+                calloc(n_addrs, sizeof(largs->destination_stats_shared[0]));
+            for(size_t i = 0; i < n_addrs; i++) {
+                destination_stats_init(&largs->destination_stats_local[i],
+                                       params.latency_setting);
+                destination_stats_init(&largs->destination_stats_shared[i],
+                                       params.latency_setting);
+            }
+        }
+        if(params.capture) {
+            largs->capture_ring = capture_ring(params.capture, n);
+        }
         largs->address_offset = n;
         largs->thread_no = n;
         largs->serialize_output_lock = &eng->serialize_output_lock;
@@ -373,6 +483,27 @@ engine_start(struct engine_params params) {
                 3, &largs->firstbyte_histogram_local);
             assert(ret == 0);
         }
+        if(params.latency_setting & SLT_TLS) {
+            int ret = hdr_init(
+                1, /* 1/10 milliseconds is the lowest storable value. */
+                100 * decims_in_1s, /* 100 seconds is a max storable value */
+                3, &largs->tls_histogram_local);
+            assert(ret == 0);
+        }
+        if(params.latency_setting & SLT_UPGRADE) {
+            int ret = hdr_init(
+                1, /* 1/10 milliseconds is the lowest storable value. */
+                100 * decims_in_1s, /* 100 seconds is a max storable value */
+                3, &largs->upgrade_histogram_local);
+            assert(ret == 0);
+        }
+        if(params.latency_setting & SLT_APPBYTE) {
+            int ret = hdr_init(
+                1, /* 1/10 milliseconds is the lowest storable value. */
+                100 * decims_in_1s, /* 100 seconds is a max storable value */
+                3, &largs->appbyte_histogram_local);
+            assert(ret == 0);
+        }
         if(params.latency_setting & SLT_MARKER) {
             int ret = hdr_init(
                 1, /* 1/10 milliseconds is the lowest storable value. */
@@ -395,6 +526,13 @@ engine_start(struct engine_params params) {
         largs->global_control_pipe_rd_nbio = gctl_pipe_rd;
         largs->global_feedback_pipe_wr = gfbk_pipe_wr;
         pcg32_srandom_r(&largs->rng, random(), n);
+        largs->payload_cache = payload_cache_new();
+        if(params.websocket_deflate) {
+            largs->ws_deflater = websocket_deflater_new();
+            assert(largs->ws_deflater);
+        }
+        tcpkali_ssl_worker_init(&largs->ssl, params.ssl_cert, params.ssl_key,
+                                params.ssl_resume_ratio, params.ssl_ktls);
 
         rc = pthread_create(&eng->threads[n], 0, single_engine_loop_thread,
                             largs);
@@ -409,13 +547,14 @@ engine_start(struct engine_params params) {
  */
 static void
 print_latency_hdr_histrogram_percentiles(
-    const char *title, const struct percentile_values *report_percentiles,
+    const char *indent, const char *title,
+    const struct percentile_values *report_percentiles,
     struct hdr_histogram *histogram) {
     assert(histogram);
 
     size_t size = report_percentiles->size;
 
-    printf("%s latency at percentiles: ", title);
+    printf("%s%s latency at percentiles: ", indent, title);
     for(size_t i = 0; i < size; i++) {
         double per_d = report_percentiles->values[i].value_d;
         printf("%.1f%s", hdr_value_at_percentile(histogram, per_d) / 10.0,
@@ -430,22 +569,75 @@ print_latency_hdr_histrogram_percentiles(
 }
 
 static void
-latency_snapshot_print(const struct percentile_values *latency_percentiles,
+latency_snapshot_print(const char *indent,
+                       const struct percentile_values *latency_percentiles,
                        const struct latency_snapshot *latency) {
     if(latency->connect_histogram) {
-        print_latency_hdr_histrogram_percentiles(
-            "TCP connect", latency_percentiles, latency->connect_histogram);
+        print_latency_hdr_histrogram_percentiles(indent, "TCP connect",
+                                                 latency_percentiles,
+                                                 latency->connect_histogram);
     }
     if(latency->firstbyte_histogram) {
-        print_latency_hdr_histrogram_percentiles("First byte", latency_percentiles,
+        print_latency_hdr_histrogram_percentiles(indent, "First byte",
+                                                 latency_percentiles,
                                                  latency->firstbyte_histogram);
     }
+    if(latency->tls_histogram) {
+        print_latency_hdr_histrogram_percentiles(indent, "TLS handshake",
+                                                 latency_percentiles,
+                                                 latency->tls_histogram);
+    }
+    if(latency->upgrade_histogram) {
+        print_latency_hdr_histrogram_percentiles(indent, "WebSocket upgrade",
+                                                 latency_percentiles,
+                                                 latency->upgrade_histogram);
+    }
+    if(latency->appbyte_histogram) {
+        print_latency_hdr_histrogram_percentiles(
+            indent, "First WebSocket byte", latency_percentiles,
+            latency->appbyte_histogram);
+    }
     if(latency->marker_histogram) {
-        print_latency_hdr_histrogram_percentiles("Message", latency_percentiles,
+        print_latency_hdr_histrogram_percentiles(indent, "Message",
+                                                 latency_percentiles,
                                                  latency->marker_histogram);
     }
 }
 
+/*
+ * Print the per-destination breakdown (--per-destination).
+ */
+static void
+destination_snapshot_print(const struct percentile_values *latency_percentiles,
+                           const struct destination_snapshot *dsnap,
+                           int message_marker) {
+    for(size_t i = 0; i < dsnap->n_destinations; i++) {
+        struct destination_stats *ds = &dsnap->destinations[i];
+        char addr_buf[INET6_ADDRSTRLEN + 64];
+        char rcvd_buf[64];
+        char sent_buf[64];
+        printf("Destination %s:\n",
+               format_sockaddr(&ds->address, addr_buf, sizeof(addr_buf)));
+        printf("  Connections: %" PRIan " attempted, %" PRIan " failed\n",
+               ds->connection_attempts, ds->connection_failures);
+        printf("  Closed: %" PRIan " clean, %" PRIan " lifetime, %" PRIan
+               " timeout, %" PRIan " remote, %" PRIan " data\n",
+               ds->closed.clean, ds->closed.lifetime, ds->closed.timeout,
+               ds->closed.remote, ds->closed.data);
+        printf("  Data: %s↓, %s↑\n",
+               express_bytes(ds->traffic.bytes_rcvd, rcvd_buf,
+                             sizeof(rcvd_buf)),
+               express_bytes(ds->traffic.bytes_sent, sent_buf,
+                             sizeof(sent_buf)));
+        if(message_marker) {
+            printf("  Messages: %" PRIu64 "↓, %" PRIu64 "↑\n",
+                   (uint64_t)ds->traffic.msgs_rcvd,
+                   (uint64_t)ds->traffic.msgs_sent);
+        }
+        latency_snapshot_print("  ", latency_percentiles, &ds->latency);
+    }
+}
+
 /*
  * Estimate packets per second.
  */
@@ -472,6 +664,16 @@ engine_update_workers_send_rate(struct engine *eng, rate_spec_t rate_spec) {
     }
 }
 
+void
+engine_set_message_set(struct engine *eng, size_t message_set) {
+    assert(message_set <= eng->params.message_sets_count);
+    eng->params.message_set = message_set;
+    for(int n = 0; n < eng->n_workers; n++) {
+        int rc = write(eng->loops[n].private_control_pipe_wr, "m", 1);
+        assert(rc == 1);
+    }
+}
+
 rate_spec_t
 engine_set_message_send_rate(struct engine *eng, double msg_rate) {
     rate_spec_t new_rate = RATE_MPS(msg_rate);
@@ -521,6 +723,14 @@ engine_terminate(struct engine *eng, double epoch,
      */
     struct latency_snapshot *latency = engine_collect_latency_snapshot(eng);
 
+    /*
+     * The workers are gone, so their local per-destination stats
+     * are complete and can be read without locking.
+     */
+    struct destination_snapshot *destinations =
+        eng->params.per_destination ? collect_destination_snapshot(eng, 1)
+                                    : NULL;
+
     eng->n_workers = 0;
 
     /* Data snd/rcv after ramp-up (since epoch) */
@@ -530,6 +740,17 @@ engine_terminate(struct engine *eng, double epoch,
         subtract_traffic_stats(eng->total_traffic_stats, initial_traffic_stats);
     non_atomic_wide_t epoch_data_transmitted =
         epoch_traffic.bytes_sent + epoch_traffic.bytes_rcvd;
+    long conns = (0 * connecting) + conn_in + conn_out;
+    if(!conns) conns = 1; /* Assume a single channel. */
+
+    if(eng->params.output_format == OUTPUT_FORMAT_JSON) {
+        print_json_summary(&eng->params, test_duration, &epoch_traffic,
+                           conns, conn_in, conn_out, conn_counter,
+                           latency, destinations, latency_percentiles);
+        engine_free_latency_snapshot(latency);
+        engine_free_destination_snapshot(destinations);
+        return;
+    }
 
     char buf[64];
 
@@ -539,19 +760,44 @@ engine_terminate(struct engine *eng, double epoch,
     printf("Total data received: %s (%" PRIu64 " bytes)\n",
            express_bytes(epoch_traffic.bytes_rcvd, buf, sizeof(buf)),
            (uint64_t)epoch_traffic.bytes_rcvd);
-    long conns = (0 * connecting) + conn_in + conn_out;
-    if(!conns) conns = 1; /* Assume a single channel. */
     printf("Bandwidth per channel: %.3f⇅ Mbps (%.1f kBps)\n",
            8 * ((epoch_data_transmitted / test_duration) / conns) / 1000000.0,
            (epoch_data_transmitted / test_duration) / conns / 1000.0);
     printf("Aggregate bandwidth: %.3f↓, %.3f↑ Mbps\n",
            8 * (epoch_traffic.bytes_rcvd / test_duration) / 1000000.0,
            8 * (epoch_traffic.bytes_sent / test_duration) / 1000000.0);
-    if(eng->params.message_marker) {
+    if(eng->params.message_marker || eng->params.http_mode
+       || eng->params.websocket_enable) {
         printf("Aggregate message rate: %.3f↓, %.3f↑ mps\n",
                (epoch_traffic.msgs_rcvd / test_duration),
                (epoch_traffic.msgs_sent / test_duration));
     }
+    if(eng->params.http_mode) {
+        printf("HTTP responses:");
+        for(int i = 0; i < 5; i++) {
+            printf("%s %dxx %" PRIu64, i ? "," : "", i + 1,
+                   (uint64_t)epoch_traffic.http_status[i]);
+        }
+        printf("\n");
+    }
+    if(eng->params.websocket_enable) {
+        printf("WebSocket frames received:");
+        for(int i = 0; i < WS_FRAME_KINDS; i++) {
+            printf("%s %" PRIu64 " %s", i ? "," : "",
+                   (uint64_t)epoch_traffic.ws_frames_rcvd[i],
+                   websocket_frame_kind_names[i]);
+        }
+        printf("\n");
+    }
+    if(eng->params.ssl_enable) {
+        printf("TLS handshakes: %" PRIu64 " full, %" PRIu64 " resumed",
+               (uint64_t)epoch_traffic.ssl_handshakes[0],
+               (uint64_t)epoch_traffic.ssl_handshakes[1]);
+        if(eng->params.ssl_ktls)
+            printf(", %" PRIu64 " with kernel TLS",
+                   (uint64_t)epoch_traffic.ssl_ktls);
+        printf("\n");
+    }
     printf("Packet rate estimate: %.1f↓, %.1f↑ (%u↓, %u↑ TCP MSS/op)\n",
            estimate_pps(test_duration, epoch_traffic.num_reads,
                         epoch_traffic.bytes_rcvd),
@@ -561,12 +807,113 @@ engine_terminate(struct engine *eng, double epoch,
                                     epoch_traffic.bytes_rcvd),
            estimate_segments_per_op(epoch_traffic.num_writes,
                                     epoch_traffic.bytes_sent));
-    latency_snapshot_print(latency_percentiles, latency);
+    latency_snapshot_print("", latency_percentiles, latency);
+    if(destinations) {
+        destination_snapshot_print(latency_percentiles, destinations,
+                                   eng->params.message_marker
+                                       || eng->params.http_mode
+                                       || eng->params.websocket_enable);
+    }
 
     engine_free_latency_snapshot(latency);
+    engine_free_destination_snapshot(destinations);
     printf("Test duration: %g s.\n", test_duration);
 }
 
+/*
+ * Print the final stats as a single line JSON object (--output-format=json).
+ */
+static void
+print_json_summary(const struct engine_params *params, double test_duration,
+                   const non_atomic_traffic_stats *traffic, long conns,
+                   size_t conn_in, size_t conn_out, size_t conn_counter,
+                   const struct latency_snapshot *latency,
+                   const struct destination_snapshot *destinations,
+                   const struct percentile_values *latency_percentiles) {
+    non_atomic_wide_t data_transmitted = traffic->bytes_sent
+                                         + traffic->bytes_rcvd;
+
+    printf("{\"type\":\"summary\",\"duration\":%g", test_duration);
+    printf(",\"connections\":{\"in\":%zu,\"out\":%zu,\"seen\":%zu}",
+           conn_in, conn_out, conn_counter);
+    printf(",");
+    json_print_traffic(stdout, "traffic", traffic);
+    printf(",\"bandwidth\":{\"per_channel_bps\":%.0f,\"rcvd_bps\":%.0f"
+           ",\"sent_bps\":%.0f}",
+           8 * ((data_transmitted / test_duration) / conns),
+           8 * (traffic->bytes_rcvd / test_duration),
+           8 * (traffic->bytes_sent / test_duration));
+    if(params->message_marker || params->http_mode
+       || params->websocket_enable) {
+        printf(",\"message_rate\":{\"rcvd\":%.3f,\"sent\":%.3f}",
+               traffic->msgs_rcvd / test_duration,
+               traffic->msgs_sent / test_duration);
+    }
+    if(params->http_mode) {
+        printf(",\"http_responses\":{");
+        for(int i = 0; i < 5; i++) {
+            printf("%s\"%dxx\":%" PRIu64, i ? "," : "", i + 1,
+                   (uint64_t)traffic->http_status[i]);
+        }
+        printf("}");
+    }
+    if(params->websocket_enable) {
+        printf(",\"ws_frames_rcvd\":{");
+        for(int i = 0; i < WS_FRAME_KINDS; i++) {
+            printf("%s\"%s\":%" PRIu64, i ? "," : "",
+                   websocket_frame_kind_names[i],
+                   (uint64_t)traffic->ws_frames_rcvd[i]);
+        }
+        printf("}");
+    }
+    if(params->ssl_enable) {
+        printf(",\"ssl_handshakes\":{\"full\":%" PRIu64
+               ",\"resumed\":%" PRIu64,
+               (uint64_t)traffic->ssl_handshakes[0],
+               (uint64_t)traffic->ssl_handshakes[1]);
+        if(params->ssl_ktls)
+            printf(",\"ktls\":%" PRIu64, (uint64_t)traffic->ssl_ktls);
+        printf("}");
+    }
+    printf(",\"packet_rate_estimate\":{\"rcvd\":%.1f,\"sent\":%.1f"
+           ",\"rcvd_mss_per_op\":%u,\"sent_mss_per_op\":%u}",
+           estimate_pps(test_duration, traffic->num_reads,
+                        traffic->bytes_rcvd),
+           estimate_pps(test_duration, traffic->num_writes,
+                        traffic->bytes_sent),
+           estimate_segments_per_op(traffic->num_reads, traffic->bytes_rcvd),
+           estimate_segments_per_op(traffic->num_writes,
+                                    traffic->bytes_sent));
+    printf(",");
+    json_print_latency(stdout, "latency", latency, latency_percentiles);
+
+    if(destinations) {
+        printf(",\"destinations\":[");
+        for(size_t i = 0; i < destinations->n_destinations; i++) {
+            struct destination_stats *ds = &destinations->destinations[i];
+            char addr_buf[INET6_ADDRSTRLEN + 64];
+            printf("%s{\"address\":\"%s\"", i ? "," : "",
+                   format_sockaddr(&ds->address, addr_buf, sizeof(addr_buf)));
+            printf(",\"connections\":{\"attempted\":%" PRIan
+                   ",\"failed\":%" PRIan "}",
+                   ds->connection_attempts, ds->connection_failures);
+            printf(",\"closed\":{\"clean\":%" PRIan ",\"lifetime\":%" PRIan
+                   ",\"timeout\":%" PRIan ",\"remote\":%" PRIan
+                   ",\"data\":%" PRIan "}",
+                   ds->closed.clean, ds->closed.lifetime, ds->closed.timeout,
+                   ds->closed.remote, ds->closed.data);
+            printf(",");
+            json_print_traffic(stdout, "traffic", &ds->traffic);
+            printf(",");
+            json_print_latency(stdout, "latency", &ds->latency,
+                               latency_percentiles);
+            printf("}");
+        }
+        printf("]");
+    }
+    printf("}\n");
+}
+
 static char *
 express_bytes(size_t bytes, char *buf, size_t size) {
     if(bytes < 2048) {
@@ -609,6 +956,9 @@ engine_free_latency_snapshot(struct latency_snapshot *latency) {
         free(latency->connect_histogram);
         free(latency->firstbyte_histogram);
         free(latency->marker_histogram);
+        free(latency->tls_histogram);
+        free(latency->upgrade_histogram);
+        free(latency->appbyte_histogram);
         free(latency);
     }
 }
@@ -618,7 +968,7 @@ engine_free_latency_snapshot(struct latency_snapshot *latency) {
  */
 void
 engine_prepare_latency_snapshot(struct engine *eng) {
-    if(eng->params.latency_setting != 0) {
+    if(eng->params.latency_setting != 0 || eng->params.per_destination) {
         /*
          * If histogram is requested, we first need to ask each worker to
          * assemble that information among its connections.
@@ -651,7 +1001,8 @@ engine_collect_latency_snapshot(struct engine *eng) {
         int64_t lowest_trackable_value;
         int64_t highest_trackable_value;
         int64_t significant_figures;
-    } conn_init = {0, 0, 0}, fb_init = {0, 0, 0}, mark_init = {0, 0, 0};
+    } conn_init = {0, 0, 0}, fb_init = {0, 0, 0}, mark_init = {0, 0, 0},
+      tls_init = {0, 0, 0}, upgrade_init = {0, 0, 0}, appbyte_init = {0, 0, 0};
 
     /* There's going to be no wait or contention here due
      * to the pipe-driven command-response logic. However,
@@ -684,6 +1035,30 @@ engine_collect_latency_snapshot(struct engine *eng) {
         mark_init.significant_figures =
             eng->loops[0].marker_histogram_shared->significant_figures;
     }
+    if(eng->loops[0].tls_histogram_shared) {
+        tls_init.lowest_trackable_value =
+            eng->loops[0].tls_histogram_shared->lowest_trackable_value;
+        tls_init.highest_trackable_value =
+            eng->loops[0].tls_histogram_shared->highest_trackable_value;
+        tls_init.significant_figures =
+            eng->loops[0].tls_histogram_shared->significant_figures;
+    }
+    if(eng->loops[0].upgrade_histogram_shared) {
+        upgrade_init.lowest_trackable_value =
+            eng->loops[0].upgrade_histogram_shared->lowest_trackable_value;
+        upgrade_init.highest_trackable_value =
+            eng->loops[0].upgrade_histogram_shared->highest_trackable_value;
+        upgrade_init.significant_figures =
+            eng->loops[0].upgrade_histogram_shared->significant_figures;
+    }
+    if(eng->loops[0].appbyte_histogram_shared) {
+        appbyte_init.lowest_trackable_value =
+            eng->loops[0].appbyte_histogram_shared->lowest_trackable_value;
+        appbyte_init.highest_trackable_value =
+            eng->loops[0].appbyte_histogram_shared->highest_trackable_value;
+        appbyte_init.significant_figures =
+            eng->loops[0].appbyte_histogram_shared->significant_figures;
+    }
     pthread_mutex_unlock(&eng->loops[0].shared_histograms_lock);
 
     if(conn_init.significant_figures) {
@@ -704,6 +1079,26 @@ engine_collect_latency_snapshot(struct engine *eng) {
             mark_init.significant_figures, &latency->marker_histogram);
         assert(ret == 0);
     }
+    if(tls_init.significant_figures) {
+        int ret = hdr_init(
+            tls_init.lowest_trackable_value, tls_init.highest_trackable_value,
+            tls_init.significant_figures, &latency->tls_histogram);
+        assert(ret == 0);
+    }
+    if(upgrade_init.significant_figures) {
+        int ret = hdr_init(upgrade_init.lowest_trackable_value,
+                           upgrade_init.highest_trackable_value,
+                           upgrade_init.significant_figures,
+                           &latency->upgrade_histogram);
+        assert(ret == 0);
+    }
+    if(appbyte_init.significant_figures) {
+        int ret = hdr_init(appbyte_init.lowest_trackable_value,
+                           appbyte_init.highest_trackable_value,
+                           appbyte_init.significant_figures,
+                           &latency->appbyte_histogram);
+        assert(ret == 0);
+    }
 
     for(int n = 0; n < eng->n_workers; n++) {
         pthread_mutex_lock(&eng->loops[n].shared_histograms_lock);
@@ -716,12 +1111,42 @@ engine_collect_latency_snapshot(struct engine *eng) {
         if(latency->marker_histogram)
             hdr_add(latency->marker_histogram,
                     eng->loops[n].marker_histogram_shared);
+        if(latency->tls_histogram)
+            hdr_add(latency->tls_histogram,
+                    eng->loops[n].tls_histogram_shared);
+        if(latency->upgrade_histogram)
+            hdr_add(latency->upgrade_histogram,
+                    eng->loops[n].upgrade_histogram_shared);
+        if(latency->appbyte_histogram)
+            hdr_add(latency->appbyte_histogram,
+                    eng->loops[n].appbyte_histogram_shared);
         pthread_mutex_unlock(&eng->loops[n].shared_histograms_lock);
     }
 
     return latency;
 }
 
+/*
+ * The message rate change resets the marker histograms,
+ * so the histogram might have been reset since the base snapshot.
+ * In that case we return everything recorded since the reset.
+ */
+static struct hdr_histogram *
+histogram_diff(struct hdr_histogram *base, struct hdr_histogram *update) {
+    for(int32_t i = 0; i < update->counts_len; i++) {
+        if(update->counts[i] < base->counts[i]) {
+            struct hdr_histogram *copy;
+            int ret = hdr_init(update->lowest_trackable_value,
+                               update->highest_trackable_value,
+                               update->significant_figures, &copy);
+            assert(ret == 0);
+            hdr_add(copy, update);
+            return copy;
+        }
+    }
+    return hdr_diff(base, update);
+}
+
 struct latency_snapshot *
 engine_diff_latency_snapshot(struct latency_snapshot *base, struct latency_snapshot *update) {
 
@@ -733,20 +1158,123 @@ engine_diff_latency_snapshot(struct latency_snapshot *base, struct latency_snaps
 
     if(base->connect_histogram)
         diff->connect_histogram =
-            hdr_diff(base->connect_histogram, update->connect_histogram);
+            histogram_diff(base->connect_histogram, update->connect_histogram);
     if(base->firstbyte_histogram)
-        diff->firstbyte_histogram =
-            hdr_diff(base->firstbyte_histogram, update->firstbyte_histogram);
+        diff->firstbyte_histogram = histogram_diff(
+            base->firstbyte_histogram, update->firstbyte_histogram);
     if(base->marker_histogram)
         diff->marker_histogram =
-            hdr_diff(base->marker_histogram, update->marker_histogram);
+            histogram_diff(base->marker_histogram, update->marker_histogram);
+    if(base->tls_histogram)
+        diff->tls_histogram =
+            histogram_diff(base->tls_histogram, update->tls_histogram);
+    if(base->upgrade_histogram)
+        diff->upgrade_histogram =
+            histogram_diff(base->upgrade_histogram, update->upgrade_histogram);
+    if(base->appbyte_histogram)
+        diff->appbyte_histogram =
+            histogram_diff(base->appbyte_histogram, update->appbyte_histogram);
 
     return diff;
 }
 
+/*
+ * Add the (src) histogram into the (*dst), creating the latter if needed.
+ */
+static void
+histogram_accumulate(struct hdr_histogram **dst, struct hdr_histogram *src) {
+    if(!src) return;
+    if(!*dst) {
+        int ret = hdr_init(src->lowest_trackable_value,
+                           src->highest_trackable_value,
+                           src->significant_figures, dst);
+        assert(ret == 0);
+    }
+    hdr_add(*dst, src);
+}
+
+/*
+ * Merge the per-worker destination stats. The (from_local) stats
+ * may only be used when the workers are not running.
+ */
+static struct destination_snapshot *
+collect_destination_snapshot(struct engine *eng, int from_local) {
+    size_t n_addrs = eng->params.remote_addresses.n_addrs;
+    struct destination_snapshot *dsnap = calloc(1, sizeof(*dsnap));
+    assert(dsnap);
+    dsnap->n_destinations = n_addrs;
+    dsnap->destinations = calloc(n_addrs ? n_addrs : 1,
+                                 sizeof(dsnap->destinations[0]));
+    assert(dsnap->destinations);
+
+    for(size_t i = 0; i < n_addrs; i++) {
+        dsnap->destinations[i].address =
+            eng->params.remote_addresses.addrs[i];
+    }
+
+    for(int n = 0; n < eng->n_workers; n++) {
+        struct loop_arguments *largs = &eng->loops[n];
+        struct destination_stats *wstats = from_local
+                                               ? largs->destination_stats_local
+                                               : largs->destination_stats_shared;
+        if(!from_local) pthread_mutex_lock(&largs->shared_histograms_lock);
+        for(size_t i = 0; i < n_addrs; i++) {
+            struct destination_stats *src = &wstats[i];
+            struct destination_stats *dst = &dsnap->destinations[i];
+            dst->connection_attempts += src->connection_attempts;
+            dst->connection_failures += src->connection_failures;
+            add_traffic_numbers_NtoN(&src->traffic, &dst->traffic);
+            dst->closed.clean += src->closed.clean;
+            dst->closed.lifetime += src->closed.lifetime;
+            dst->closed.timeout += src->closed.timeout;
+            dst->closed.remote += src->closed.remote;
+            dst->closed.data += src->closed.data;
+            histogram_accumulate(&dst->latency.connect_histogram,
+                                 src->latency.connect_histogram);
+            histogram_accumulate(&dst->latency.firstbyte_histogram,
+                                 src->latency.firstbyte_histogram);
+            histogram_accumulate(&dst->latency.marker_histogram,
+                                 src->latency.marker_histogram);
+            histogram_accumulate(&dst->latency.tls_histogram,
+                                 src->latency.tls_histogram);
+            histogram_accumulate(&dst->latency.upgrade_histogram,
+                                 src->latency.upgrade_histogram);
+            histogram_accumulate(&dst->latency.appbyte_histogram,
+                                 src->latency.appbyte_histogram);
+        }
+        if(!from_local) pthread_mutex_unlock(&largs->shared_histograms_lock);
+    }
+
+    return dsnap;
+}
+
+struct destination_snapshot *
+engine_collect_destination_snapshot(struct engine *eng) {
+    if(!eng->params.per_destination) return NULL;
+    return collect_destination_snapshot(eng, 0);
+}
+
+void
+engine_free_destination_snapshot(struct destination_snapshot *dsnap) {
+    if(dsnap) {
+        for(size_t i = 0; i < dsnap->n_destinations; i++) {
+            struct latency_snapshot *latency = &dsnap->destinations[i].latency;
+            free(latency->connect_histogram);
+            free(latency->firstbyte_histogram);
+            free(latency->marker_histogram);
+            free(latency->tls_histogram);
+            free(latency->upgrade_histogram);
+            free(latency->appbyte_histogram);
+        }
+        free(dsnap->destinations);
+        free(dsnap);
+    }
+}
+
 non_atomic_traffic_stats
 engine_traffic(struct engine *eng) {
-    non_atomic_traffic_stats traffic = {0, 0, 0, 0, 0, 0};
+    non_atomic_traffic_stats traffic = {0, 0, 0, 0, 0, 0, {0, 0, 0, 0, 0},
+                                       {0, 0, 0, 0, 0, 0}, {0, 0}, 0};
     for(int n = 0; n < eng->n_workers; n++) {
         add_traffic_numbers_AtoN(&eng->loops[n].worker_traffic_stats, &traffic);
     }
@@ -847,6 +1375,38 @@ engine_initiate_new_connections(struct engine *eng, size_t n_req) {
     return n;
 }
 
+/*
+ * Ask workers to gracefully close (n_req) outgoing connections,
+ * spreading the load fairly across the workers.
+ * A worker without outgoing connections would ignore the request,
+ * so the requests only go to the workers which have some left.
+ */
+void
+engine_terminate_connections(struct engine *eng, size_t n_req) {
+    size_t conns_left[eng->n_workers];
+    size_t total = 0;
+    for(int n = 0; n < eng->n_workers; n++) {
+        conns_left[n] = atomic_get(&eng->loops[n].outgoing_connecting)
+                        + atomic_get(&eng->loops[n].outgoing_established);
+        total += conns_left[n];
+    }
+    if(n_req > total) n_req = total;
+
+    for(size_t n = 0; n < n_req; n++) {
+        int worker;
+        do {
+            worker = eng->next_worker_order[CONTROL_MESSAGE_DISCONNECT]++
+                     % eng->n_workers;
+        } while(conns_left[worker] == 0);
+        conns_left[worker]--;
+        int fd = eng->loops[worker].private_control_pipe_wr;
+        int wrote = write(fd, "d", 1);
+        if(wrote == -1 && errno == EINTR) /* Ctrl+C? */
+            return;
+        assert(wrote == 1);
+    }
+}
+
 static void
 expire_channel_lives(TK_P_ tk_timer UNUSED *w, int UNUSED revents) {
     struct loop_arguments *largs = tk_userdata(TK_A);
@@ -1006,6 +1566,7 @@ single_engine_loop_thread(void *argp) {
     connections_flush_stats(TK_A);
 
     close_all_connections(TK_A_ CCR_CLEAN);
+    tcpkali_ssl_worker_free(&largs->ssl);
 
     /* Avoid mixing debug output from several threads. */
     pthread_mutex_lock(largs->serialize_output_lock);
@@ -1132,7 +1693,8 @@ histogram_data_copy_to_shared(struct hdr_histogram *src,
  */
 static void
 worker_update_shared_histograms(struct loop_arguments *largs) {
-    if(largs->params.latency_setting == 0) return;
+    if(largs->params.latency_setting == 0 && !largs->params.per_destination)
+        return;
 
     pthread_mutex_lock(&largs->shared_histograms_lock);
 
@@ -1148,6 +1710,38 @@ worker_update_shared_histograms(struct loop_arguments *largs) {
     histogram_data_copy_to_shared(largs->marker_histogram_local,
                                   &largs->marker_histogram_shared);
 
+    /* --latency-phases */
+    histogram_data_copy_to_shared(largs->tls_histogram_local,
+                                  &largs->tls_histogram_shared);
+    histogram_data_copy_to_shared(largs->upgrade_histogram_local,
+                                  &largs->upgrade_histogram_shared);
+    histogram_data_copy_to_shared(largs->appbyte_histogram_local,
+                                  &largs->appbyte_histogram_shared);
+
+    /* --per-destination */
+    if(largs->destination_stats_local) {
+        for(size_t i = 0; i < largs->params.remote_addresses.n_addrs; i++) {
+            struct destination_stats *src = &largs->destination_stats_local[i];
+            struct destination_stats *dst = &largs->destination_stats_shared[i];
+            dst->connection_attempts = src->connection_attempts;
+            dst->connection_failures = src->connection_failures;
+            dst->traffic = src->traffic;
+            dst->closed = src->closed;
+            histogram_data_copy_to_shared(src->latency.connect_histogram,
+                                          &dst->latency.connect_histogram);
+            histogram_data_copy_to_shared(src->latency.firstbyte_histogram,
+                                          &dst->latency.firstbyte_histogram);
+            histogram_data_copy_to_shared(src->latency.marker_histogram,
+                                          &dst->latency.marker_histogram);
+            histogram_data_copy_to_shared(src->latency.tls_histogram,
+                                          &dst->latency.tls_histogram);
+            histogram_data_copy_to_shared(src->latency.upgrade_histogram,
+                                          &dst->latency.upgrade_histogram);
+            histogram_data_copy_to_shared(src->latency.appbyte_histogram,
+                                          &dst->latency.appbyte_histogram);
+        }
+    }
+
     if(largs->marker_histogram_local) {
         /*
          * 2. There are connections with accumulated data,
@@ -1162,6 +1756,11 @@ worker_update_shared_histograms(struct loop_arguments *largs) {
                 /* Only active connections might histograms */
                 hdr_add(largs->marker_histogram_shared,
                         conn->latency.marker_histogram);
+                if(connection_destination(largs, conn)) {
+                    hdr_add(largs->destination_stats_shared[conn->remote_index]
+                                .latency.marker_histogram,
+                            conn->latency.marker_histogram);
+                }
                 if(--nmax == 0) break;
             }
         }
@@ -1191,6 +1790,15 @@ control_cb(TK_P_ tk_io *w, int UNUSED revents) {
     case 'c': /* Initiate a new connection */
         start_new_connection(TK_A);
         break;
+    case 'd': { /* Close the oldest outgoing connection */
+        struct connection *conn;
+        TAILQ_FOREACH(conn, &largs->open_conns, hook) {
+            if(conn->conn_type == CONN_OUTGOING) {
+                close_connection(TK_A_ conn, CCR_CLEAN);
+                break;
+            }
+        }
+    } break;
     case 'r': /* Recompute message rate on live connections */
         largs->params.channel_send_rate =
             largs->shared_eng_params->channel_send_rate;
@@ -1210,12 +1818,25 @@ control_cb(TK_P_ tk_io *w, int UNUSED revents) {
             pthread_mutex_lock(&largs->shared_histograms_lock);
             hdr_reset(largs->marker_histogram_local);
             hdr_reset(largs->marker_histogram_shared);
+            if(largs->destination_stats_local) {
+                for(size_t i = 0; i < largs->params.remote_addresses.n_addrs;
+                    i++) {
+                    hdr_reset(largs->destination_stats_local[i]
+                                  .latency.marker_histogram);
+                    hdr_reset(largs->destination_stats_shared[i]
+                                  .latency.marker_histogram);
+                }
+            }
             pthread_mutex_unlock(&largs->shared_histograms_lock);
             TAILQ_FOREACH(conn, &largs->open_conns, hook) {
                 hdr_reset(conn->latency.marker_histogram);
             }
         }
         break;
+    case 'm': /* Switch to a different message set */
+        /* Connections pick it up in largest_contiguous_chunk() */
+        largs->params.message_set = largs->shared_eng_params->message_set;
+        break;
     case 'T': /* Terminate */
         worker_update_shared_histograms(largs);
         tk_stop(TK_A);
@@ -1245,6 +1866,22 @@ expr_callback(char *buf, size_t size, tk_expr_t *expr, void *key, long *v) {
         s = snprintf(buf, size, "%" PRIan, conn->connection_unique_id);
         if(v) *v = (long)conn->connection_unique_id;
         break;
+    case EXPR_MESSAGE_SEQ:
+        s = expr_print_fixed_width(buf, size, EXPR_SEQ_WIDTH,
+                                   ++conn->message_seq);
+        if(v) *v = (long)conn->message_seq;
+        break;
+    case EXPR_GLOBAL_SEQ: {
+        struct global_seq_block *gs = conn->global_seq;
+        if(gs->next == gs->end) {
+            gs->end = atomic_add_and_get(gs->shared, GLOBAL_SEQ_BLOCK);
+            gs->next = gs->end - GLOBAL_SEQ_BLOCK;
+        }
+        non_atomic_narrow_t seq = ++gs->next;
+        s = expr_print_fixed_width(buf, size, EXPR_SEQ_WIDTH, seq);
+        if(v) *v = (long)seq;
+        break;
+    }
     case EXPR_MESSAGE_MARKER: {
 #define MZEROS   "0000000000000000"
         const size_t tok_size = sizeof(MESSAGE_MARKER_TOKEN MZEROS ".")-1;
@@ -1264,6 +1901,59 @@ expr_callback(char *buf, size_t size, tk_expr_t *expr, void *key, long *v) {
     return s;
 }
 
+static void
+replicate_connection_payload(struct transport_data_spec *data) {
+    replicate_payload(data, REPLICATE_MAX_SIZE);
+}
+
+/*
+ * The per-message data compresses into messages of slightly different
+ * sizes. Only the latency measurement can't tolerate that, as it counts
+ * the messages sent by their size, so the data is not compressed then.
+ */
+static struct websocket_deflater *
+connection_deflater(struct loop_arguments *largs, struct connection *conn) {
+    if(conn->message_collection->most_dynamic_expression == DS_PER_MESSAGE
+       && conn->latency.sent_timestamps)
+        return NULL;
+    return largs->ws_deflater;
+}
+
+/*
+ * RFC 6455, 5.3: the client picks a fresh masking key for every frame,
+ * so its messages can't be sent twice as they are,
+ * unless --ws-premasked is given.
+ */
+static int
+masks_afresh(struct loop_arguments *largs, struct message_collection *mc,
+             enum transport_websocket_side tws_side) {
+    return tws_side == TWS_SIDE_CLIENT && mc->state == MC_FINALIZED_WEBSOCKET
+           && !largs->params.websocket_premasked;
+}
+
+/*
+ * The shared data is re-keyed as it is sent, see remasked_chunk().
+ * Returns 0 if the frames can't be found in the (data), and the connection
+ * has to build its own messages and re-mask them as they are sent again,
+ * as the per-message ones are.
+ */
+static int
+share_remasked_data(struct loop_arguments *largs, struct connection *conn,
+                    struct message_collection *mc,
+                    const struct transport_data_spec *data,
+                    enum transport_websocket_side tws_side) {
+    struct transport_template *tpl =
+        transport_template_compile(mc, data, &conn->expr_values, tws_side);
+    if(!tpl->remaskable) {
+        transport_template_free(tpl);
+        return 0;
+    }
+    conn->message_template = tpl;
+    conn->mask_seed = ((uint64_t)pcg32_random_r(&largs->rng) << 32)
+                      | pcg32_random_r(&largs->rng);
+    return 1;
+}
+
 static void
 explode_data_template(struct message_collection *mc,
                       struct transport_data_spec *const data_templates[2],
@@ -1271,7 +1961,12 @@ explode_data_template(struct message_collection *mc,
                       struct transport_data_spec *out_data,
                       struct loop_arguments *largs,
                       struct connection *conn) {
-    if(data_templates[tws_side]) {
+    int afresh = masks_afresh(largs, mc, tws_side);
+
+    if(data_templates[tws_side]
+       && (!afresh
+           || share_remasked_data(largs, conn, mc, data_templates[tws_side],
+                                  tws_side))) {
         assert(mc->most_dynamic_expression == DS_GLOBAL_FIXED);
         /*
          * Return the already once prepared data.
@@ -1283,21 +1978,34 @@ explode_data_template(struct message_collection *mc,
          * We might need a unique ID for a connection, and it is a bit expensive
          * to obtain it. We set it here once during connection establishment.
          */
-        conn->connection_unique_id =
-            atomic_inc_and_get(largs->connection_unique_id_atomic);
+        if(!conn->connection_unique_id)
+            conn->connection_unique_id =
+                atomic_inc_and_get(largs->connection_unique_id_atomic);
 
         struct transport_data_spec *new_data_ptr;
         new_data_ptr = transport_spec_from_message_collection(
-            out_data, mc, expr_callback, conn, tws_side, TS_CONVERSION_INITIAL, &largs->rng);
+            out_data, mc, expr_callback, conn, &conn->expr_values, tws_side,
+            TS_CONVERSION_INITIAL, &largs->rng,
+            connection_deflater(largs, conn));
         assert(new_data_ptr == out_data);
 
         switch(mc->most_dynamic_expression) {
         case DS_GLOBAL_FIXED:
-            assert(!"Unreachable");
+            /* The buffer is refilled with messages once sent, see below. */
+            assert(afresh);
+            break;
         case DS_PER_CONNECTION:
-            if(largs->params.message_marker == 0) {
-                replicate_payload(out_data, REPLICATE_MAX_SIZE);
-            }
+            if(afresh
+               && !share_remasked_data(largs, conn, mc, out_data, tws_side))
+                break;
+            /*
+             * The expressions might produce the same data for many
+             * connections, e.g. \{connection.uid % 16}. Share it.
+             */
+            conn->payload = payload_cache_share(
+                largs->payload_cache, out_data,
+                largs->params.message_marker == 0 ? replicate_connection_payload
+                                                  : NULL);
             break;
         case DS_PER_MESSAGE:
             break;
@@ -1312,13 +2020,32 @@ explode_data_template_override(struct message_collection *mc,
                                struct transport_data_spec *out_data,
                                struct loop_arguments *largs,
                                struct connection *conn) {
-    assert(mc->most_dynamic_expression == DS_PER_MESSAGE);
+    assert(mc->most_dynamic_expression == DS_PER_MESSAGE
+           || masks_afresh(largs, mc, tws_side));
+
+    /*
+     * Once the buffer is filled with messages, only the expression values
+     * need to be replaced in it, if they are of a fixed width.
+     */
+    if(conn->message_template
+       && transport_template_patch(conn->message_template, out_data,
+                                   expr_callback, conn, tws_side, &largs->rng)
+              == 0) {
+        return;
+    }
 
     struct transport_data_spec *new_data_ptr;
     new_data_ptr = transport_spec_from_message_collection(
-        out_data, mc, expr_callback, conn, tws_side,
-        TS_CONVERSION_OVERRIDE_MESSAGES, &largs->rng);
+        out_data, mc, expr_callback, conn, &conn->expr_values, tws_side,
+        TS_CONVERSION_OVERRIDE_MESSAGES, &largs->rng,
+        connection_deflater(largs, conn));
     assert(new_data_ptr == out_data);
+
+    if(!conn->message_template) {
+        conn->message_template =
+            transport_template_compile(mc, out_data, &conn->expr_values,
+                                       tws_side);
+    }
 }
 
 static void
@@ -1326,12 +2053,158 @@ explode_string_expression(char **buf_p, size_t *size, tk_expr_t *expr,
                           struct loop_arguments *largs,
                           struct connection *conn) {
     *buf_p = 0;
-    ssize_t s = eval_expression(buf_p, 0, expr, expr_callback, conn, 0,
+    ssize_t s = eval_expression(buf_p, 0, expr, expr_callback, conn, NULL, 0,
                                 conn->conn_type == CONN_OUTGOING, &largs->rng);
     assert(s >= 0);
     *size = s;
 }
 
+/*
+ * Figure out which message collection and templates make up
+ * the given message set (see engine_set_message_set()).
+ */
+static struct message_collection *
+select_message_set(struct engine_params *params, size_t message_set,
+                   struct transport_data_spec *const **data_templates) {
+    if(message_set == 0) {
+        *data_templates = params->data_templates;
+        return &params->message_collection;
+    } else {
+        assert(message_set <= params->message_sets_count);
+        struct message_set *ms = &params->message_sets[message_set - 1];
+        *data_templates = ms->data_templates;
+        return &ms->message_collection;
+    }
+}
+
+/*
+ * Convert the message rate into the bandwidth, given the message size.
+ */
+static void
+compute_send_limit(struct loop_arguments *largs, struct connection *conn) {
+    enum websocket_side ws_side =
+        (conn->conn_type == CONN_OUTGOING) ? WS_SIDE_CLIENT : WS_SIDE_SERVER;
+    conn->avg_message_size = message_collection_estimate_size(
+        conn->message_collection,
+        MSK_PURPOSE_MESSAGE, MSK_PURPOSE_MESSAGE,
+        MCE_AVERAGE_SIZE, ws_side, largs->params.websocket_enable,
+        &conn->expr_values);
+    /* The compressed messages are only measured once they are built. */
+    if(conn->message_collection->ws_deflate && ws_side == WS_SIDE_CLIENT
+       && conn->data.single_message_size)
+        conn->avg_message_size = conn->data.single_message_size;
+    conn->send_limit = compute_bandwidth_limit_by_message_size(
+        largs->params.channel_send_rate, conn->avg_message_size);
+}
+
+/*
+ * Select the messages to send according to the current message set,
+ * and configure the message rate accordingly. The data itself is rendered
+ * once the connection becomes writable, see prepare_connection_data().
+ */
+static void
+setup_connection_data(struct loop_arguments *largs, struct connection *conn,
+                      double now) {
+    struct transport_data_spec *const *data_templates;
+    struct message_collection *mc = select_message_set(
+        &largs->params, largs->params.message_set, &data_templates);
+
+    conn->message_collection = mc;
+    expr_conn_values_init(&conn->expr_values, mc->conn_values_count);
+    conn->message_set = largs->params.message_set;
+    conn->data_pending = 1;
+    compute_send_limit(largs, conn);
+    pacefier_init(&conn->send_pace, conn->send_limit.bytes_per_second, now);
+}
+
+/*
+ * Render the data set up by setup_connection_data(), if not yet done.
+ * The connections which are still being established don't hold
+ * the (possibly large) buffers.
+ */
+static void
+prepare_connection_data(struct loop_arguments *largs, struct connection *conn) {
+    if(!conn->data_pending) return;
+    conn->data_pending = 0;
+
+    struct transport_data_spec *const *data_templates;
+    (void)select_message_set(&largs->params, conn->message_set,
+                             &data_templates);
+    enum transport_websocket_side tws_side =
+        (conn->conn_type == CONN_OUTGOING) ? TWS_SIDE_CLIENT : TWS_SIDE_SERVER;
+    explode_data_template(conn->message_collection, data_templates, tws_side,
+                          &conn->data, largs, conn);
+
+    /* The per-connection values are known now, so is the message size. */
+    if(conn->message_collection->most_dynamic_expression == DS_PER_CONNECTION
+       || conn->message_collection->ws_deflate) {
+        compute_send_limit(largs, conn);
+        conn->send_pace.events_per_second = conn->send_limit.bytes_per_second;
+    }
+
+    if(conn->latency.sent_timestamps && conn->data.single_message_size) {
+        conn->latency.message_bytes_credit /* See (EXPL:1) below. */
+            = conn->data.single_message_size - 1;
+    }
+}
+
+static void
+release_connection_data(struct loop_arguments *largs,
+                        struct connection *conn) {
+    if(conn->payload) {
+        payload_release(largs->payload_cache, conn->payload);
+        conn->payload = NULL;
+    } else if(conn->data.ptr && !(conn->data.flags & TDS_FLAG_PTR_SHARED)) {
+        free(conn->data.ptr);
+    }
+    memset(&conn->data, 0, sizeof(conn->data));
+}
+
+/*
+ * Whether the next byte to send starts a new message.
+ */
+static int
+at_message_boundary(struct connection *conn) {
+    size_t offset = conn->write_offset;
+    if(offset >= conn->data.total_size) return 1;
+    if(offset < conn->data.once_size) return 0;
+    /* Messages vary in size, wait until the buffer is exhausted. */
+    if(conn->message_collection->most_dynamic_expression == DS_PER_MESSAGE
+       || !conn->data.single_message_size)
+        return 0;
+    return (offset - conn->data.once_size) % conn->data.single_message_size
+           == 0;
+}
+
+/*
+ * Replace the data being sent with the one from the newly selected
+ * message set. Must be called on a message boundary.
+ */
+static void
+switch_message_set(struct loop_arguments *largs, struct connection *conn,
+                   double now) {
+    release_connection_data(largs, conn);
+    transport_template_free(conn->message_template);
+    conn->message_template = NULL;
+    expr_conn_values_free(&conn->expr_values);
+
+    setup_connection_data(largs, conn, now);
+    prepare_connection_data(largs, conn);
+
+    /*
+     * The HTTP upgrade headers, if any, have already been sent.
+     * The --first-message data is not a part of the alternative
+     * message sets.
+     */
+    conn->write_offset = conn->data.once_size;
+    if(conn->latency.sent_timestamps) {
+        /* Restart message accounting, see (EXPL:1). */
+        assert(conn->data.single_message_size);
+        conn->latency.message_bytes_credit =
+            conn->data.single_message_size - 1;
+    }
+}
+
 static void start_new_connection(TK_P) {
     char tmpbuf[INET6_ADDRSTRLEN + 64];
     struct loop_arguments *largs = tk_userdata(TK_A);
@@ -1345,6 +2218,12 @@ static void start_new_connection(TK_P) {
     atomic_increment(&remote_stats->connection_attempts);
     largs->worker_connections_initiated++;
 
+    struct destination_stats *dstats =
+        largs->destination_stats_local
+            ? &largs->destination_stats_local[remote_index]
+            : NULL;
+    if(dstats) dstats->connection_attempts++;
+
     int sockfd = socket(ss->ss_family, SOCK_STREAM, IPPROTO_TCP);
     if(sockfd == -1) {
         switch(errno) {
@@ -1376,6 +2255,7 @@ static void start_new_connection(TK_P) {
         if(rc == -1) {
             atomic_increment(&remote_stats->connection_failures);
             largs->worker_connection_failures++;
+            if(dstats) dstats->connection_failures++;
             close(sockfd);
             DEBUG(DBG_WARNING, "Connection to %s is not done: %s\n",
                   format_sockaddr(ss, tmpbuf, sizeof(tmpbuf)), strerror(errno));
@@ -1401,6 +2281,7 @@ static void start_new_connection(TK_P) {
         default:
             atomic_increment(&remote_stats->connection_failures);
             largs->worker_connection_failures++;
+            if(dstats) dstats->connection_failures++;
             if(atomic_get(&remote_stats->connection_failures) == 1) {
                 DEBUG(DBG_WARNING, "Connection to %s is not done: %s\n",
                       format_sockaddr(ss, tmpbuf, sizeof(tmpbuf)),
@@ -1421,6 +2302,8 @@ static void start_new_connection(TK_P) {
         conn_state = CSTATE_CONNECTED;
         if(largs->connect_histogram_local)
             hdr_record_value(largs->connect_histogram_local, 0);
+        if(dstats && dstats->latency.connect_histogram)
+            hdr_record_value(dstats->latency.connect_histogram, 0);
     }
 
     /*
@@ -1615,6 +2498,7 @@ common_connection_init(TK_P_ struct connection *conn, enum conn_type conn_type,
 
     conn->latency.connection_initiated = now;
     conn->bytes_leftovers = 0;
+    conn->global_seq = &largs->global_seq;
 
     if(limit_channel_lifetime(largs)) {
         if(TAILQ_FIRST(&largs->open_conns) == NULL) {
@@ -1641,21 +2525,14 @@ common_connection_init(TK_P_ struct connection *conn, enum conn_type conn_type,
 
     if(active_socket) {
 
-        message_collection_replicate(&largs->params.message_collection, &conn->message_collection);
-        enum transport_websocket_side tws_side =
-            (conn_type == CONN_OUTGOING) ? TWS_SIDE_CLIENT : TWS_SIDE_SERVER;
-        explode_data_template(&conn->message_collection,
-                              largs->params.data_templates, tws_side,
-                              &conn->data, largs, conn);
-        enum websocket_side ws_side =
-            (tws_side == TWS_SIDE_CLIENT) ? WS_SIDE_CLIENT : WS_SIDE_SERVER;
-        conn->avg_message_size = message_collection_estimate_size(
-            &conn->message_collection,
-            MSK_PURPOSE_MESSAGE, MSK_PURPOSE_MESSAGE,
-            MCE_AVERAGE_SIZE, ws_side, largs->params.websocket_enable);
-        conn->send_limit = compute_bandwidth_limit_by_message_size(
-            largs->params.channel_send_rate, conn->avg_message_size);
-        pacefier_init(&conn->send_pace, conn->send_limit.bytes_per_second, now);
+        setup_connection_data(largs, conn, now);
+        if(largs->params.corpus) {
+            corpus_connection_init(largs, conn, now);
+        }
+        if(largs->params.stream_size) {
+            conn->stream.enabled = 1;
+            conn->stream.offset = 0;
+        }
         if(largs->params.message_stop_expr) {
             conn->sbmh_stop_ctx = malloc(SBMH_SIZE(largs->params.message_stop_expr->estimate_size));
             assert(conn->sbmh_stop_ctx);
@@ -1663,11 +2540,10 @@ common_connection_init(TK_P_ struct connection *conn, enum conn_type conn_type,
         }
     }
 
-    if(largs->params.latency_marker_expr && (conn->data.single_message_size || largs->params.message_marker)) {
-        if(conn->data.single_message_size) {
-            conn->latency.message_bytes_credit /* See (EXPL:1) below. */
-                = conn->data.single_message_size - 1;
-        }
+    if((largs->params.latency_marker_expr
+        || (largs->params.http_mode && conn_type == CONN_OUTGOING))
+       && (conn->avg_message_size || conn->corpus.corpus
+           || largs->params.message_marker)) {
         /*
          * Figure out how many latency markers to skip
          * before starting to measure latency with them.
@@ -1676,10 +2552,16 @@ common_connection_init(TK_P_ struct connection *conn, enum conn_type conn_type,
             largs->params.latency_marker_skip;
 
         /*
-         * Initialize the Boyer-Moore-Horspool context for substring search.
+         * Initialize the Boyer-Moore-Horspool context for substring search,
+         * or the HTTP response parser which finds the responses instead.
          */
         struct StreamBMH_Occ *init_occ = NULL;
-        if(EXPR_IS_TRIVIAL(largs->params.latency_marker_expr)) {
+        if(largs->params.http_mode) {
+            conn->latency.http_parser =
+                malloc(sizeof(*conn->latency.http_parser));
+            assert(conn->latency.http_parser);
+            http_response_parser_init(conn->latency.http_parser);
+        } else if(EXPR_IS_TRIVIAL(largs->params.latency_marker_expr)) {
             /* Shared search table and expression */
             conn->latency.sbmh_shared = 1;
             conn->latency.sbmh_occ = &largs->params.sbmh_shared_marker_occ;
@@ -1698,11 +2580,13 @@ common_connection_init(TK_P_ struct connection *conn, enum conn_type conn_type,
                 (char **)&conn->latency.sbmh_data, &conn->latency.sbmh_size,
                 largs->params.latency_marker_expr, largs, conn);
         }
-        conn->latency.sbmh_marker_ctx =
-            malloc(SBMH_SIZE(conn->latency.sbmh_size));
-        assert(conn->latency.sbmh_marker_ctx);
-        sbmh_init(conn->latency.sbmh_marker_ctx, init_occ,
-                  conn->latency.sbmh_data, conn->latency.sbmh_size);
+        if(!conn->latency.http_parser) {
+            conn->latency.sbmh_marker_ctx =
+                malloc(SBMH_SIZE(conn->latency.sbmh_size));
+            assert(conn->latency.sbmh_marker_ctx);
+            sbmh_init(conn->latency.sbmh_marker_ctx, init_occ,
+                      conn->latency.sbmh_data, conn->latency.sbmh_size);
+        }
 
         /*
          * Initialize the latency histogram by copying out the template
@@ -1713,6 +2597,13 @@ common_connection_init(TK_P_ struct connection *conn, enum conn_type conn_type,
             hdr_init_similar(largs->marker_histogram_local);
     }
 
+    /*
+     * Outgoing connections replay the captured flows one after another.
+     */
+    if(conn_type == CONN_OUTGOING && largs->params.pcap_replay) {
+        conn->replay.flow = pcap_replay_next_flow(largs->params.pcap_replay);
+    }
+
     /*
      * Catch connection timeout.
      */
@@ -1723,12 +2614,27 @@ common_connection_init(TK_P_ struct connection *conn, enum conn_type conn_type,
         connection_timer_refresh(TK_A_ conn, 0.0);
     }
 
-    conn->conn_wish =
-        CW_READ_INTEREST
-        | ((conn->data.total_size || want_catch_connect) ? CW_WRITE_INTEREST
-                                                         : 0);
+    /*
+     * The outgoing connections render their data once connected.
+     */
+    if(conn_state == CSTATE_CONNECTED) {
+        prepare_connection_data(largs, conn);
+    }
+
+    int want_write = (conn->data.total_size || conn->data_pending
+                      || conn->replay.flow
+                      || conn->corpus.corpus || conn->stream.enabled
+                      || want_catch_connect);
+    conn->conn_wish = CW_READ_INTEREST | (want_write ? CW_WRITE_INTEREST : 0);
 
     if(largs->params.websocket_enable) {
+        conn->ws_decoder = malloc(sizeof(*conn->ws_decoder));
+        assert(conn->ws_decoder);
+        websocket_decoder_init(conn->ws_decoder, conn_type == CONN_OUTGOING
+                                                     ? WS_SIDE_CLIENT
+                                                     : WS_SIDE_SERVER);
+        conn->ws_decoder->deflate_offered =
+            largs->params.websocket_deflate && conn_type == CONN_OUTGOING;
         if(conn_type == CONN_OUTGOING) {
             int want_events = TK_READ | TK_WRITE;
 #ifdef USE_LIBUV
@@ -1748,7 +2654,6 @@ common_connection_init(TK_P_ struct connection *conn, enum conn_type conn_type,
 #endif
         }
     } else { /* Plain socket */
-        int want_write = (conn->data.total_size || want_catch_connect);
         int want_events = TK_READ | (want_write ? TK_WRITE : 0);
 #ifdef USE_LIBUV
         uv_poll_init(TK_A_ & conn->watcher, sockfd);
@@ -1759,7 +2664,15 @@ common_connection_init(TK_P_ struct connection *conn, enum conn_type conn_type,
 #endif
     }
     if(largs->params.ssl_enable != 0) {
-        ssl_setup(conn, sockfd, largs->params.ssl_cert, largs->params.ssl_key);
+        if(ssl_setup(conn, sockfd, &largs->ssl)
+           && conn_state == CSTATE_CONNECTING) {
+            /* The ClientHello went out, so TCP has already connected. */
+            if(!(conn->conn_blocked & CBLOCKED_ON_WRITE))
+                connection_phase_done(TK_A_ conn, CPHASE_TCP);
+            /* Even the whole handshake could be done, e.g. on loopback. */
+            if(!(conn->conn_blocked & CBLOCKED_ON_INIT))
+                connection_phase_done(TK_A_ conn, CPHASE_TLS);
+        }
     }
 }
 
@@ -1836,6 +2749,35 @@ accept_cb(TK_P_ tk_io *w, int UNUSED revents) {
  * Debug data by dumping it in a format escaping all the special
  * characters.
  */
+/*
+ * Hand the sent or received data over to the --capture thread.
+ */
+static void
+capture_connection_data(struct loop_arguments *largs, struct connection *conn,
+                        int outgoing, const void *data, size_t size) {
+    if(!conn->capture_endpoints) {
+        struct sockaddr_storage *remote =
+            conn->conn_type == CONN_OUTGOING
+                ? &largs->params.remote_addresses.addrs[conn->remote_index]
+                : &conn->peer_name;
+        conn->capture_endpoints = malloc(sizeof(*conn->capture_endpoints));
+        assert(conn->capture_endpoints);
+        capture_endpoints_init(conn->capture_endpoints,
+                               tk_fd(&conn->watcher), remote);
+    }
+
+    /* The counters already include the data. */
+    if(outgoing) {
+        capture_data(largs->capture_ring, conn->capture_endpoints, 1,
+                     conn->traffic_ongoing.bytes_sent - size,
+                     conn->traffic_ongoing.bytes_rcvd, data, size);
+    } else {
+        capture_data(largs->capture_ring, conn->capture_endpoints, 0,
+                     conn->traffic_ongoing.bytes_rcvd - size,
+                     conn->traffic_ongoing.bytes_sent, data, size);
+    }
+}
+
 static void
 debug_dump_data(const char *prefix, int fd, const void *data, size_t size,
                 ssize_t limit) {
@@ -1992,7 +2934,7 @@ passive_websocket_cb(TK_P_ tk_io *w, int revents) {
             if(conn->conn_blocked & CBLOCKED_ON_WRITE) {
                 revents &= ~TK_WRITE;
             }
-            if(ssl_setup(conn, 0, largs->params.ssl_cert, largs->params.ssl_key)) {
+            if(ssl_setup(conn, 0, &largs->ssl)) {
                 if(conn->conn_blocked & CBLOCKED_ON_INIT) {
                     conn->conn_wish |= CW_READ_INTEREST;
                     conn->conn_wish |= CW_WRITE_INTEREST;
@@ -2064,6 +3006,10 @@ passive_websocket_cb(TK_P_ tk_io *w, int revents) {
                 debug_dump_data("Rcv", tk_fd(w), largs->scratch_recv_buf, rd,
                                 0);
             }
+            if(largs->capture_ring) {
+                capture_connection_data(largs, conn, 0,
+                                        largs->scratch_recv_buf, rd);
+            }
             latency_record_incoming_ts(TK_A_ conn, largs->scratch_recv_buf, rd);
 
             /*
@@ -2098,7 +3044,7 @@ passive_websocket_cb(TK_P_ tk_io *w, int revents) {
                 return;
             }
         }
-        if(largs->params.ssl_enable) {
+        if(ssl_write_needed(largs, conn)) {
 #ifdef HAVE_OPENSSL
             int wrote = SSL_write(conn->ssl_fd, out_buf, response_size);
             switch(SSL_get_error(conn->ssl_fd, wrote)) {
@@ -2162,12 +3108,12 @@ static void
 latency_record_outgoing_ts(TK_P_ struct connection *conn, size_t wrote) {
     struct loop_arguments *largs = tk_userdata(TK_A);
 
-    if(largs->params.message_marker) {
+    if(largs->params.message_marker || largs->params.websocket_enable) {
             if (conn->avg_message_size > 0) {
                 conn->traffic_ongoing.msgs_sent += (conn->bytes_leftovers + wrote) / conn->avg_message_size;
                 conn->bytes_leftovers = (conn->bytes_leftovers + wrote) % conn->avg_message_size;
             }
-        return;
+        if(largs->params.message_marker) return;
     }
 
     if(!conn->latency.sent_timestamps) return;
@@ -2191,6 +3137,13 @@ latency_record_outgoing_ts(TK_P_ struct connection *conn, size_t wrote) {
     conn->latency.message_bytes_credit =
         pretend_sent % conn->data.single_message_size;
     int ring_grown = 0;
+    conn->latency.messages_in_flight += messages;
+    if(conn->latency.http_parser) {
+        conn->traffic_ongoing.msgs_sent += messages;
+        http_requests_sent(conn->latency.http_parser,
+                           (const char *)conn->data.ptr + conn->data.once_size,
+                           msgsize, messages);
+    }
     for(double now = tk_now(TK_A); messages; messages--) {
         ring_grown |= ring_buffer_add(conn->latency.sent_timestamps, now);
     }
@@ -2222,17 +3175,42 @@ static unsigned nibble(const unsigned char c) {
     }
 }
 
+/*
+ * Account for a complete HTTP response received (--http).
+ */
 static void
+http_response_received(void *key, unsigned status) {
+    struct connection *conn = key;
+    conn->traffic_ongoing.msgs_rcvd++;
+    conn->traffic_ongoing.http_status[status / 100 - 1]++;
+}
+
+/*
+ * Returns -1 if the received data is not what --http expects.
+ */
+static int
 latency_record_incoming_ts(TK_P_ struct connection *conn, char *buf,
                            size_t size) {
     struct loop_arguments *largs = tk_userdata(TK_A);
 
-    if(!conn->latency.sent_timestamps && !largs->params.message_marker) return;
+    if(!conn->latency.sent_timestamps && !largs->params.message_marker)
+        return 0;
 
     const uint8_t *lm = conn->latency.sbmh_data;
     size_t lm_size = conn->latency.sbmh_size;
     unsigned num_markers_found = 0;
 
+    /*
+     * Each complete HTTP response answers the oldest request sent.
+     */
+    if(conn->latency.http_parser) {
+        int responses = http_response_parse(conn->latency.http_parser, buf,
+                                            size, http_response_received, conn);
+        if(responses == -1) return -1;
+        num_markers_found = responses;
+        size = 0;
+    }
+
     for(; size > 0;) {
         switch(conn->latency.marker_parser.state) {
         case MP_DISENGAGED:
@@ -2279,7 +3257,7 @@ latency_record_incoming_ts(TK_P_ struct connection *conn, char *buf,
         }
     }
 
-    if(largs->params.message_marker) return;
+    if(largs->params.message_marker) return 0;
 
     /*
      * Skip the necessary numbers of markers.
@@ -2287,7 +3265,7 @@ latency_record_incoming_ts(TK_P_ struct connection *conn, char *buf,
     if(conn->latency.lm_occurrences_skip) {
         if(num_markers_found <= conn->latency.lm_occurrences_skip) {
             conn->latency.lm_occurrences_skip -= num_markers_found;
-            return;
+            return 0;
         } else {
             num_markers_found -= conn->latency.lm_occurrences_skip;
             conn->latency.lm_occurrences_skip = 0;
@@ -2303,6 +3281,7 @@ latency_record_incoming_ts(TK_P_ struct connection *conn, char *buf,
         double ts;
         int got = ring_buffer_get(conn->latency.sent_timestamps, &ts);
         if(got) {
+            conn->latency.messages_in_flight--;
             int64_t latency = 10000 * (now - ts);
             if(hdr_record_value(conn->latency.marker_histogram, latency)
                == false) {
@@ -2311,6 +3290,11 @@ latency_record_incoming_ts(TK_P_ struct connection *conn, char *buf,
                         "can't record.\n",
                         now - ts);
             }
+        } else if(conn->latency.http_parser) {
+            fprintf(stderr,
+                    "More HTTP responses received than requests sent.\n"
+                    "Use -d option to dump received message data.\n");
+            exit(1);
         } else {
             fprintf(stderr,
                     "More messages received than sent. "
@@ -2319,6 +3303,168 @@ latency_record_incoming_ts(TK_P_ struct connection *conn, char *buf,
             exit(1);
         }
     }
+
+    /*
+     * In the closed-loop mode (--pipeline-depth) a received response
+     * releases the next message to be sent.
+     */
+    if(largs->params.pipeline_depth
+       && conn->latency.messages_in_flight < largs->params.pipeline_depth
+       && !(conn->conn_wish & CW_WRITE_INTEREST)) {
+        conn->conn_wish |= CW_WRITE_INTEREST;
+        update_io_interest(TK_A_ conn);
+    }
+
+    return 0;
+}
+
+/*
+ * Look for the latency markers in the compressed message payload.
+ * Returns -1 if the payload can not be decompressed.
+ */
+static int
+websocket_record_inflated(TK_P_ struct connection *conn, char *buf,
+                          size_t size, int fin) {
+    struct loop_arguments *largs = tk_userdata(TK_A);
+
+    /* Only decompress if there is something to look for. */
+    if(!conn->latency.sent_timestamps && !largs->params.message_marker)
+        return 0;
+
+    if(!conn->ws_inflater) {
+        conn->ws_inflater = websocket_inflater_new();
+        assert(conn->ws_inflater);
+    }
+
+    websocket_inflate_input(conn->ws_inflater, buf, size, fin);
+    for(;;) {
+        char *data;
+        ssize_t inflated = websocket_inflate_output(conn->ws_inflater, &data);
+        if(inflated <= 0) return inflated;
+        latency_record_incoming_ts(TK_A_ conn, data, inflated);
+    }
+}
+
+/*
+ * Decode the received WebSocket frames, counting them by opcode and
+ * counting the complete messages. The latency markers are only looked for
+ * within the data frame payloads. A ping is answered with a pong.
+ * Returns 1 when the close frame is received, -1 on protocol error,
+ * -2 if the server did not accept --ws-deflate.
+ */
+static int
+websocket_record_incoming(TK_P_ struct connection *conn, char *buf,
+                          size_t size) {
+    struct loop_arguments *largs = tk_userdata(TK_A);
+    struct websocket_decoded frame;
+
+    for(;;) {
+        if(size && conn->latency.phase == CPHASE_APPBYTE)
+            connection_phase_done(TK_A_ conn, CPHASE_APPBYTE);
+        switch(websocket_decode(conn->ws_decoder, &buf, &size, &frame)) {
+        case WSD_NEED_MORE:
+            return 0;
+        case WSD_UPGRADED:
+            connection_phase_done(TK_A_ conn, CPHASE_UPGRADE);
+            continue;
+        case WSD_ERROR:
+            return -1;
+        case WSD_NO_DEFLATE:
+            return -2;
+        case WSD_PAYLOAD:
+            if(!frame.compressed) {
+                latency_record_incoming_ts(TK_A_ conn, frame.data, frame.size);
+            } else if(websocket_record_inflated(TK_A_ conn, frame.data,
+                                                frame.size, 0)
+                      == -1) {
+                return -1;
+            }
+            continue;
+        case WSD_FRAME:
+            break;
+        }
+
+        conn->traffic_ongoing.ws_frames_rcvd[websocket_frame_kind(
+            frame.opcode)]++;
+        switch(frame.opcode) {
+        case WS_OP_CONTINUATION:
+        case WS_OP_TEXT_FRAME:
+        case WS_OP_BINARY_FRAME:
+            /* The \{message.marker}s are counted instead. */
+            if(frame.fin && !largs->params.message_marker)
+                conn->traffic_ongoing.msgs_rcvd++;
+            if(frame.fin && frame.compressed
+               && websocket_record_inflated(TK_A_ conn, NULL, 0, 1) == -1)
+                return -1;
+            break;
+        case WS_OP_CLOSE:
+            return 1;
+        case WS_OP_PING:
+            /*
+             * RFC 6455, 5.5.3: it is enough to answer the most recent ping.
+             * The one being sent already is not replaced, though.
+             */
+            if(!conn->ws_pong) {
+                conn->ws_pong = calloc(1, sizeof(*conn->ws_pong));
+                assert(conn->ws_pong);
+            }
+            if(conn->ws_pong->offset == 0) {
+                size_t hdr_size = websocket_frame_header(
+                    conn->ws_pong->buf, sizeof(conn->ws_pong->buf),
+                    conn->conn_type == CONN_OUTGOING ? WS_SIDE_CLIENT
+                                                     : WS_SIDE_SERVER,
+                    WS_OP_PONG, 0, 1, frame.size);
+                memcpy(conn->ws_pong->buf + hdr_size, frame.data, frame.size);
+                websocket_frame_mask(conn->ws_pong->buf, hdr_size, frame.size,
+                                     pcg32_random_r(&largs->rng));
+                conn->ws_pong->size = hdr_size + frame.size;
+            }
+            if(!(conn->conn_wish & CW_WRITE_INTEREST)) {
+                conn->conn_wish |= CW_WRITE_INTEREST;
+                update_io_interest(TK_A_ conn);
+            }
+            break;
+        case WS_OP_PONG:
+            break;
+        }
+    }
+}
+
+/*
+ * Limit the (available_body) to the number of message bytes which can be
+ * sent without exceeding the --pipeline-depth outstanding messages.
+ * Returns the new (available_body).
+ */
+static size_t
+limit_pipeline_depth(struct loop_arguments *largs, struct connection *conn,
+                     size_t available_body) {
+    if(!largs->params.pipeline_depth || !conn->latency.sent_timestamps)
+        return available_body;
+
+    if(conn->corpus.corpus) {
+        /* Finish the record being sent, start another one if permitted. */
+        const struct corpus *corpus = conn->corpus.corpus;
+        if(conn->corpus.offset == 0
+           && conn->latency.messages_in_flight >= largs->params.pipeline_depth)
+            return 0;
+        size_t allowed =
+            corpus->records[conn->corpus.record].size - conn->corpus.offset;
+        return available_body < allowed ? available_body : allowed;
+    }
+
+    /*
+     * A message is considered in flight as soon as its first byte is sent,
+     * see (EXPL:1). Allow to finish the message already being sent plus
+     * as many whole messages as the depth permits.
+     */
+    size_t msgsize = conn->data.single_message_size;
+    size_t allowed = msgsize - 1 - conn->latency.message_bytes_credit;
+    if(conn->latency.messages_in_flight < largs->params.pipeline_depth) {
+        allowed += msgsize * (largs->params.pipeline_depth
+                              - conn->latency.messages_in_flight);
+    }
+
+    return available_body < allowed ? available_body : allowed;
 }
 
 static void
@@ -2405,6 +3551,36 @@ largest_contiguous_chunk(struct loop_arguments *largs, struct connection *conn,
         return;
     }
 
+    if(conn->corpus.corpus
+       && conn->traffic_ongoing.bytes_sent >= conn->data.once_size) {
+        /* The --corpus records are sent straight from the mapping. */
+        const struct corpus *corpus = conn->corpus.corpus;
+        const struct corpus_record *rec =
+            &corpus->records[conn->corpus.record];
+        *position = rec->data + conn->corpus.offset;
+        *available_header = 0;
+        if(corpus->contiguous
+           && largs->params.corpus_order == CORPUS_SEQUENTIAL) {
+            /* Up to the end of the file, spanning many records. */
+            const struct corpus_record *last =
+                &corpus->records[corpus->records_count - 1];
+            *available_body =
+                (last->data + last->size) - (const char *)*position;
+        } else {
+            *available_body = rec->size - conn->corpus.offset;
+        }
+        return;
+    }
+
+    if(conn->stream.enabled
+       && conn->traffic_ongoing.bytes_sent >= conn->data.once_size) {
+        /* The --stream-file data is sent by stream_file_write(). */
+        *position = NULL;
+        *available_header = 0;
+        *available_body = largs->params.stream_size - conn->stream.offset;
+        return;
+    }
+
     if(conn->traffic_ongoing.bytes_sent < conn->data.once_size) {
         /* Send header... once per connection lifetime */
         *available_header =
@@ -2419,14 +3595,17 @@ largest_contiguous_chunk(struct loop_arguments *largs, struct connection *conn,
         *available_body = available - *available_header;
     } else {
         /* If we're at the end of the buffer, re-blow it with new messages */
-        if(conn->message_collection.most_dynamic_expression
-               == DS_PER_MESSAGE
+        enum transport_websocket_side tws_side =
+            (conn->conn_type == CONN_OUTGOING) ? TWS_SIDE_CLIENT
+                                               : TWS_SIDE_SERVER;
+        if(conn->message_collection
+           && (conn->message_collection->most_dynamic_expression
+                   == DS_PER_MESSAGE
+               || (masks_afresh(largs, conn->message_collection, tws_side)
+                   && !(conn->data.flags & TDS_FLAG_PTR_SHARED)))
            && (conn->conn_type == CONN_OUTGOING
                || (largs->params.listen_mode & _LMODE_SND_MASK))) {
-            explode_data_template_override(&conn->message_collection,
-                                           (conn->conn_type == CONN_OUTGOING)
-                                               ? TWS_SIDE_CLIENT
-                                               : TWS_SIDE_SERVER,
+            explode_data_template_override(conn->message_collection, tws_side,
                                            &conn->data, largs, conn);
             accessible_size = conn->data.total_size;
         }
@@ -2437,6 +3616,19 @@ largest_contiguous_chunk(struct loop_arguments *largs, struct connection *conn,
         *current_offset = off;
     }
 
+    /*
+     * Stop at the end of the current message if we're asked
+     * to switch to a different message set.
+     */
+    if(conn->message_set != largs->params.message_set && !*available_header
+       && conn->data.single_message_size
+       && conn->message_collection->most_dynamic_expression != DS_PER_MESSAGE) {
+        size_t msgsize = conn->data.single_message_size;
+        size_t to_boundary =
+            msgsize - (*current_offset - conn->data.once_size) % msgsize;
+        if(*available_body > to_boundary) *available_body = to_boundary;
+    }
+
     if(largs->params.message_marker) {
         if(*position < conn->data.marker_token_ptr) {
             /* Short-circquit search: we know where marker is, directly. */
@@ -2453,6 +3645,46 @@ largest_contiguous_chunk(struct loop_arguments *largs, struct connection *conn,
     }
 }
 
+/*
+ * Mask the shared client frames about to be sent with the fresh keys,
+ * see share_remasked_data(). The (size) is reduced to fit the worker's
+ * scratch buffer. What is left there after a partial write is sent as is,
+ * the keys depend on the position in the stream only. The --corpus
+ * records and the --stream-file data are sent as they are.
+ */
+static const void *
+remasked_chunk(struct loop_arguments *largs, struct connection *conn,
+               const void *position, size_t *size) {
+    if(!conn->message_template || !conn->message_template->remaskable
+       || !(conn->data.flags & TDS_FLAG_PTR_SHARED)
+       || position != (const char *)conn->data.ptr + conn->write_offset)
+        return position;
+
+    size_t offset = conn->write_offset;
+    uint64_t stream_offset = conn->traffic_ongoing.bytes_sent;
+    struct remask_scratch *scratch = &largs->scratch_send;
+
+    if(scratch->seed != conn->mask_seed || scratch->data != conn->data.ptr
+       || offset < scratch->offset
+       || offset >= scratch->offset + scratch->size
+       || stream_offset - offset
+              != scratch->stream_offset - scratch->offset) {
+        scratch->size = *size < sizeof(scratch->buf) ? *size
+                                                     : sizeof(scratch->buf);
+        scratch->data = conn->data.ptr;
+        scratch->seed = conn->mask_seed;
+        scratch->offset = offset;
+        scratch->stream_offset = stream_offset;
+        transport_template_remask(conn->message_template, &conn->data, offset,
+                                  scratch->buf, scratch->size, conn->mask_seed,
+                                  stream_offset);
+    }
+
+    size_t available = scratch->offset + scratch->size - offset;
+    if(*size > available) *size = available;
+    return scratch->buf + (offset - scratch->offset);
+}
+
 static void
 connection_cb(TK_P_ tk_io *w, int revents) {
     struct loop_arguments *largs = tk_userdata(TK_A);
@@ -2472,15 +3704,19 @@ connection_cb(TK_P_ tk_io *w, int revents) {
             if(conn->conn_blocked & CBLOCKED_ON_WRITE) {
                 revents &= ~TK_WRITE;
             }
-            if(ssl_setup(conn, 0, largs->params.ssl_cert, largs->params.ssl_key)) {
+            if(ssl_setup(conn, 0, &largs->ssl)) {
+                /* The first handshake progress means TCP is connected. */
+                connection_phase_done(TK_A_ conn, CPHASE_TCP);
                 if(conn->conn_blocked & CBLOCKED_ON_INIT) {
                     conn->conn_wish |= CW_READ_INTEREST;
                     conn->conn_wish |= CW_WRITE_INTEREST;
                     update_io_interest(TK_A_ conn);
                     return;
                 }
+                connection_phase_done(TK_A_ conn, CPHASE_TLS);
             } else {
                 close_connection(TK_A_ conn, CCR_REMOTE);
+                return;
             }
         } else {
             return;
@@ -2499,11 +3735,8 @@ connection_cb(TK_P_ tk_io *w, int revents) {
         atomic_decrement(&largs->outgoing_connecting);
         atomic_increment(&largs->outgoing_established);
         conn->conn_state = CSTATE_CONNECTED;
-        if(largs->connect_histogram_local) {
-            int64_t latency =
-                10000 * (tk_now(TK_A) - conn->latency.connection_initiated);
-            hdr_record_value(largs->connect_histogram_local, latency);
-        }
+        /* Done already if the TLS handshake was in the way. */
+        connection_phase_done(TK_A_ conn, CPHASE_TCP);
 
         /*
          * We were asked to produce the WRITE event
@@ -2511,7 +3744,10 @@ connection_cb(TK_P_ tk_io *w, int revents) {
          * If there's nothing to write, we remove the write interest.
          */
         tk_timer_stop(TK_A, &conn->timer);
-        if((conn->data.total_size == 0) && !(conn->conn_blocked & CBLOCKED_ON_WRITE)) {
+        prepare_connection_data(largs, conn);
+        if((conn->data.total_size == 0) && !conn->replay.flow
+           && !conn->corpus.corpus && !conn->stream.enabled
+           && !(conn->conn_blocked & CBLOCKED_ON_WRITE)) {
             conn->conn_wish &= ~CW_WRITE_INTEREST; /* Remove write interest */
             update_io_interest(TK_A_ conn);
             revents &= ~TK_WRITE; /* Don't actually write in this loop */
@@ -2620,6 +3856,11 @@ connection_cb(TK_P_ tk_io *w, int revents) {
                         10000
                         * (tk_now(TK_A) - conn->latency.connection_initiated);
                     hdr_record_value(largs->firstbyte_histogram_local, latency);
+                    struct destination_stats *ds =
+                        connection_destination(largs, conn);
+                    if(ds)
+                        hdr_record_value(ds->latency.firstbyte_histogram,
+                                         latency);
                 }
                 conn->traffic_ongoing.num_reads++;
                 conn->traffic_ongoing.bytes_rcvd += rd;
@@ -2629,8 +3870,42 @@ connection_cb(TK_P_ tk_io *w, int revents) {
                     debug_dump_data("Rcv", tk_fd(w), largs->scratch_recv_buf,
                                     rd, 0);
                 }
-                latency_record_incoming_ts(TK_A_ conn, largs->scratch_recv_buf,
-                                           rd);
+                if(largs->capture_ring) {
+                    capture_connection_data(largs, conn, 0,
+                                            largs->scratch_recv_buf, rd);
+                }
+                if(conn->ws_decoder) {
+                    switch(websocket_record_incoming(
+                        TK_A_ conn, largs->scratch_recv_buf, rd)) {
+                    case 0:
+                        break;
+                    case 1: {
+                        char buf[INET6_ADDRSTRLEN + 64];
+                        DEBUG(DBG_DETAIL, "WebSocket closed by %s\n",
+                              format_sockaddr(remote, buf, sizeof(buf)));
+                        close_connection(TK_A_ conn, CCR_REMOTE);
+                        return;
+                    }
+                    case -2:
+                        DEBUG(DBG_ERROR, "Server did not accept "
+                                         "permessage-deflate, closing "
+                                         "connection\n");
+                        close_connection(TK_A_ conn, CCR_DATA);
+                        return;
+                    default:
+                        DEBUG(DBG_ERROR, "Received data is not a valid "
+                                         "WebSocket frame, closing connection\n");
+                        close_connection(TK_A_ conn, CCR_DATA);
+                        return;
+                    }
+                } else if(latency_record_incoming_ts(
+                              TK_A_ conn, largs->scratch_recv_buf, rd)
+                          == -1) {
+                    DEBUG(DBG_ERROR, "Received data is not an HTTP response, "
+                                     "closing connection\n");
+                    close_connection(TK_A_ conn, CCR_DATA);
+                    return;
+                }
                 scan_incoming_bytes(TK_A_ conn, largs->scratch_recv_buf, rd);
 
                 if(record_moved_data) {
@@ -2648,6 +3923,22 @@ process_WRITE:
         int record_moved = 0;
         int lockstep = 0;
 
+        if(conn->replay.flow) {
+            replay_captured_flow(TK_A_ conn, remote);
+            return;
+        }
+
+        /* The pong may not be sent in the middle of another frame. */
+        if(conn->ws_pong && conn->ws_pong->size && at_message_boundary(conn)) {
+            if(send_websocket_pong(TK_A_ conn, remote) == -1) return;
+        }
+
+        if(conn->message_set != largs->params.message_set && conn->data.ptr
+           && !conn->corpus.corpus && !conn->stream.enabled
+           && at_message_boundary(conn)) {
+            switch_message_set(largs, conn, tk_now(TK_A));
+        }
+
         largest_contiguous_chunk(largs, conn, &position, &available_header,
                                  &available_body);
         if(!(available_header + available_body) && !(conn->conn_blocked & CBLOCKED_ON_WRITE)) {
@@ -2659,6 +3950,16 @@ process_WRITE:
             return;
         }
 
+        /* Do not send more messages than --pipeline-depth allows. */
+        available_body = limit_pipeline_depth(largs, conn, available_body);
+        if(!(available_header + available_body)
+           && !(conn->conn_blocked & CBLOCKED_ON_WRITE)) {
+            /* Wait for the responses to release more messages. */
+            conn->conn_wish &= ~CW_WRITE_INTEREST;
+            update_io_interest(TK_A_ conn);
+            return;
+        }
+
         /* Adjust (available_body) to avoid sending too much stuff. */
         switch(limit_channel_bandwidth(TK_A_ conn, &available_body, TK_WRITE)) {
         case LB_UNLIMITED:
@@ -2694,13 +3995,30 @@ process_WRITE:
                              : conn->send_limit.minimal_move_size);
 
             ssize_t wrote = 0;
-            if(largs->params.ssl_enable) {
+            int streaming = conn->stream.enabled && !available_header;
+            const void *sending =
+                streaming ? position
+                          : remasked_chunk(largs, conn, position,
+                                           &available_write);
+            if(streaming) {
+                if(ssl_write_needed(largs, conn)) {
+                    static int warned;
+                    if(__sync_bool_compare_and_swap(&warned, 0, 1))
+                        DEBUG(DBG_ERROR,
+                              "Kernel TLS is not available for --stream-file, "
+                              "closing connections\n");
+                    close_connection(TK_A_ conn, CCR_DATA);
+                    return;
+                }
+                wrote = stream_file_write(largs, conn, tk_fd(w), &sending,
+                                          available_write);
+            } else if(ssl_write_needed(largs, conn)) {
 #ifdef HAVE_OPENSSL
                 if(conn->conn_blocked & CBLOCKED_ON_READ) {
                     return;
                 }
                 conn->conn_blocked &= ~CBLOCKED_ON_WRITE;
-                wrote = SSL_write(conn->ssl_fd, position, available_write);
+                wrote = SSL_write(conn->ssl_fd, sending, available_write);
                 switch(SSL_get_error(conn->ssl_fd, wrote)) {
                 case SSL_ERROR_NONE:
                     break;
@@ -2720,7 +4038,7 @@ process_WRITE:
                 }
 #endif
             } else {
-                wrote = write(tk_fd(w), position, available_write);
+                wrote = write(tk_fd(w), sending, available_write);
             }
             if(wrote == -1) {
                 char buf[INET6_ADDRSTRLEN + 64];
@@ -2743,7 +4061,7 @@ process_WRITE:
                 }
                 break;
             } else {
-                conn->write_offset += wrote;
+                if(!streaming) conn->write_offset += wrote;
                 conn->traffic_ongoing.num_writes++;
                 conn->traffic_ongoing.bytes_sent += wrote;
                 if(record_moved)
@@ -2751,16 +4069,24 @@ process_WRITE:
                 if(largs->params.dump_setting & DS_DUMP_ALL_OUT
                    || ((largs->params.dump_setting & DS_DUMP_ONE_OUT)
                        && largs->dump_connect_fd == tk_fd(w))) {
-                    debug_dump_data("Snd", tk_fd(w), position, wrote, 0);
+                    debug_dump_data("Snd", tk_fd(w), sending, wrote, 0);
+                }
+                if(largs->capture_ring) {
+                    capture_connection_data(largs, conn, 1, sending, wrote);
                 }
-                if((size_t)wrote > available_header) {
+                if(streaming) {
+                    available_body -= wrote;
+                } else if((size_t)wrote > available_header) {
                     position += wrote;
                     wrote -= available_header;
                     available_header = 0;
                     available_body -= wrote;
 
                     /* Record latencies for the body only, not headers */
-                    latency_record_outgoing_ts(TK_A_ conn, wrote);
+                    if(conn->corpus.corpus)
+                        corpus_advance(TK_A_ conn, wrote);
+                    else
+                        latency_record_outgoing_ts(TK_A_ conn, wrote);
                 }
             }
         } while(available_body);
@@ -2779,6 +4105,328 @@ process_WRITE:
     } /* (events & TK_WRITE) */
 }
 
+/*
+ * Whether the outgoing data has to be encrypted with SSL_write(). With
+ * --ssl-ktls the kernel takes over the records after the handshake,
+ * so plain write(2) and sendfile(2) do the job without a copy.
+ */
+static int
+ssl_write_needed(const struct loop_arguments *largs,
+                 const struct connection UNUSED *conn) {
+    if(!largs->params.ssl_enable) return 0;
+#ifdef HAVE_OPENSSL
+    return !conn->ssl_ktls_send;
+#else
+    return 1;
+#endif
+}
+
+/*
+ * Send up to (size) bytes of the --stream-file from the connection's offset,
+ * wrapping around at the end of file. The data bypasses the user space
+ * unless it has to be seen by --dump-* or --capture, in which case the
+ * (position) is set to point to the copy.
+ */
+static ssize_t
+stream_file_write(struct loop_arguments *largs, struct connection *conn,
+                  int sockfd, const void **position, size_t size) {
+    off_t offset = conn->stream.offset;
+    ssize_t wrote;
+
+    int inspect = largs->capture_ring
+                  || (largs->params.dump_setting & DS_DUMP_ALL_OUT)
+                  || ((largs->params.dump_setting & DS_DUMP_ONE_OUT)
+                      && largs->dump_connect_fd == sockfd);
+#ifdef HAVE_SYS_SENDFILE_H
+    if(!inspect) {
+        *position = NULL;
+        wrote = sendfile(sockfd, largs->params.stream_fd, &offset, size);
+    } else
+#endif
+    {
+        if(size > sizeof(largs->scratch_recv_buf))
+            size = sizeof(largs->scratch_recv_buf);
+        ssize_t rd = pread(largs->params.stream_fd, largs->scratch_recv_buf,
+                           size, offset);
+        if(rd <= 0) {
+            if(rd == 0) errno = EIO; /* The file got truncated. */
+            return -1;
+        }
+        *position = largs->scratch_recv_buf;
+        wrote = write(sockfd, largs->scratch_recv_buf, rd);
+        if(wrote > 0) offset += wrote;
+    }
+
+    if(wrote == 0 && size) {
+        /* sendfile(2) hit the end of a truncated file. */
+        errno = EIO;
+        return -1;
+    } else if(wrote > 0) {
+        conn->stream.offset =
+            offset == largs->params.stream_size ? 0 : offset;
+    }
+
+    return wrote;
+}
+
+/*
+ * Pick the record to send after the given one (--corpus-order).
+ */
+static size_t
+corpus_next_record(struct loop_arguments *largs, const struct corpus *corpus,
+                   size_t record) {
+    switch(largs->params.corpus_order) {
+    case CORPUS_RANDOM:
+        if(corpus->records_count <= UINT32_MAX)
+            return pcg32_boundedrand_r(&largs->rng, corpus->records_count);
+        return (((uint64_t)pcg32_random_r(&largs->rng) << 32)
+                | pcg32_random_r(&largs->rng))
+               % corpus->records_count;
+    case CORPUS_SEQUENTIAL:
+        break;
+    }
+    return (record + 1) % corpus->records_count;
+}
+
+/*
+ * Make the connection send the --corpus records instead of the --message.
+ */
+static void
+corpus_connection_init(struct loop_arguments *largs, struct connection *conn,
+                       double now) {
+    const struct corpus *corpus = largs->params.corpus;
+
+    conn->corpus.corpus = corpus;
+    conn->corpus.offset = 0;
+    if(largs->params.corpus_order == CORPUS_RANDOM) {
+        conn->corpus.record = corpus_next_record(largs, corpus, 0);
+    } else {
+        /* Each next connection starts one record further. */
+        if(!conn->connection_unique_id)
+            conn->connection_unique_id =
+                atomic_inc_and_get(largs->connection_unique_id_atomic);
+        conn->corpus.record =
+            (largs->params.corpus_start + conn->connection_unique_id - 1)
+            % corpus->records_count;
+    }
+
+    /* --message-rate is computed over the average record size. */
+    conn->avg_message_size = corpus->total_size / corpus->records_count;
+    if(conn->avg_message_size == 0) conn->avg_message_size = 1;
+    conn->send_limit = compute_bandwidth_limit_by_message_size(
+        largs->params.channel_send_rate, conn->avg_message_size);
+    pacefier_init(&conn->send_pace, conn->send_limit.bytes_per_second, now);
+}
+
+/*
+ * Account for the (wrote) bytes of the --corpus records being sent.
+ */
+static void
+corpus_advance(TK_P_ struct connection *conn, size_t wrote) {
+    struct loop_arguments *largs = tk_userdata(TK_A);
+    const struct corpus *corpus = conn->corpus.corpus;
+
+    while(wrote) {
+        size_t left =
+            corpus->records[conn->corpus.record].size - conn->corpus.offset;
+        if(conn->corpus.offset == 0 && conn->latency.sent_timestamps) {
+            /* In flight since the first byte is sent, see (EXPL:1). */
+            ring_buffer_add(conn->latency.sent_timestamps, tk_now(TK_A));
+            conn->latency.messages_in_flight++;
+            if(conn->latency.http_parser)
+                http_requests_sent(conn->latency.http_parser,
+                                   corpus->records[conn->corpus.record].data,
+                                   corpus->records[conn->corpus.record].size,
+                                   1);
+        }
+        if(wrote < left) {
+            conn->corpus.offset += wrote;
+            return;
+        }
+        wrote -= left;
+        conn->traffic_ongoing.msgs_sent++;
+        conn->corpus.offset = 0;
+        conn->corpus.record =
+            corpus_next_record(largs, corpus, conn->corpus.record);
+    }
+}
+
+/*
+ * Send the pong frame answering the WebSocket ping.
+ * Returns -1 if the connection can't be written to at the moment.
+ */
+static int
+send_websocket_pong(TK_P_ struct connection *conn,
+                    struct sockaddr_storage *remote) {
+    struct loop_arguments *largs = tk_userdata(TK_A);
+
+    while(conn->ws_pong->offset < conn->ws_pong->size) {
+        const uint8_t *position = conn->ws_pong->buf + conn->ws_pong->offset;
+        size_t available = conn->ws_pong->size - conn->ws_pong->offset;
+        ssize_t wrote = 0;
+        if(ssl_write_needed(largs, conn)) {
+#ifdef HAVE_OPENSSL
+            if(conn->conn_blocked & CBLOCKED_ON_READ) {
+                return -1;
+            }
+            conn->conn_blocked &= ~CBLOCKED_ON_WRITE;
+            wrote = SSL_write(conn->ssl_fd, position, available);
+            switch(SSL_get_error(conn->ssl_fd, wrote)) {
+            case SSL_ERROR_NONE:
+                break;
+            case SSL_ERROR_WANT_WRITE:
+                conn->conn_blocked |= CBLOCKED_ON_WRITE;
+                conn->conn_wish |= CW_WRITE_INTEREST;
+                update_io_interest(TK_A_ conn);
+                return -1;
+            case SSL_ERROR_WANT_READ:
+                conn->conn_blocked |= CBLOCKED_ON_READ;
+                conn->conn_wish |= CW_READ_INTEREST;
+                update_io_interest(TK_A_ conn);
+                return -1;
+            case SSL_ERROR_ZERO_RETURN:
+            default:
+                wrote = -1;  // Close it
+            }
+#endif
+        } else {
+            wrote = write(tk_fd(&conn->watcher), position, available);
+        }
+        if(wrote == -1) {
+            char buf[INET6_ADDRSTRLEN + 64];
+            switch(errno) {
+            case EINTR:
+                continue;
+            case EAGAIN:
+                return -1; /* Wait until writable */
+            case EPIPE:
+            default:
+                DEBUG(DBG_WARNING, "Connection reset by %s\n",
+                      format_sockaddr(remote, buf, sizeof(buf)));
+                close_connection(TK_A_ conn, CCR_REMOTE);
+                return -1;
+            }
+        }
+
+        conn->traffic_ongoing.num_writes++;
+        conn->traffic_ongoing.bytes_sent += wrote;
+        if(largs->params.dump_setting & DS_DUMP_ALL_OUT
+           || ((largs->params.dump_setting & DS_DUMP_ONE_OUT)
+               && largs->dump_connect_fd == tk_fd(&conn->watcher))) {
+            debug_dump_data("Snd", tk_fd(&conn->watcher), position, wrote, 0);
+        }
+        if(largs->capture_ring) {
+            capture_connection_data(largs, conn, 1, position, wrote);
+        }
+        conn->ws_pong->offset += wrote;
+    }
+
+    conn->ws_pong->size = 0;
+    conn->ws_pong->offset = 0;
+    return 0;
+}
+
+/*
+ * Send the client side of a captured TCP flow (--pcap), either keeping
+ * the original timing of the packets or as fast as the socket takes it.
+ * With the original timing the connection is closed when the captured
+ * one was.
+ */
+static void
+replay_captured_flow(TK_P_ struct connection *conn,
+                     struct sockaddr_storage *remote) {
+    struct loop_arguments *largs = tk_userdata(TK_A);
+    const struct pcap_flow *flow = conn->replay.flow;
+    int original_timing = (largs->params.pcap_timing == PCAP_TIMING_ORIGINAL);
+    double elapsed = tk_now(TK_A) - conn->latency.connection_initiated;
+
+    while(conn->replay.segment < flow->segments_count) {
+        const struct pcap_segment *seg = &flow->segments[conn->replay.segment];
+        if(original_timing && seg->offset > elapsed) {
+            conn->conn_wish |= CW_WRITE_DELAYED;
+            update_io_interest(TK_A_ conn);
+            connection_timer_refresh(TK_A_ conn, seg->offset - elapsed);
+            return;
+        }
+
+        const char *position = (const char *)seg->data + conn->replay.offset;
+        size_t available = seg->size - conn->replay.offset;
+        ssize_t wrote = 0;
+        if(ssl_write_needed(largs, conn)) {
+#ifdef HAVE_OPENSSL
+            if(conn->conn_blocked & CBLOCKED_ON_READ) {
+                return;
+            }
+            conn->conn_blocked &= ~CBLOCKED_ON_WRITE;
+            wrote = SSL_write(conn->ssl_fd, position, available);
+            switch(SSL_get_error(conn->ssl_fd, wrote)) {
+            case SSL_ERROR_NONE:
+                break;
+            case SSL_ERROR_WANT_WRITE:
+                conn->conn_blocked |= CBLOCKED_ON_WRITE;
+                conn->conn_wish |= CW_WRITE_INTEREST;
+                update_io_interest(TK_A_ conn);
+                return;
+            case SSL_ERROR_WANT_READ:
+                conn->conn_blocked |= CBLOCKED_ON_READ;
+                conn->conn_wish |= CW_READ_INTEREST;
+                update_io_interest(TK_A_ conn);
+                return;
+            case SSL_ERROR_ZERO_RETURN:
+            default:
+                wrote = -1;  // Close it
+            }
+#endif
+        } else {
+            wrote = write(tk_fd(&conn->watcher), position, available);
+        }
+        if(wrote == -1) {
+            char buf[INET6_ADDRSTRLEN + 64];
+            switch(errno) {
+            case EINTR:
+                continue;
+            case EAGAIN:
+                return; /* Wait until writable */
+            case EPIPE:
+            default:
+                DEBUG(DBG_WARNING, "Connection reset by %s\n",
+                      format_sockaddr(remote, buf, sizeof(buf)));
+                close_connection(TK_A_ conn, CCR_REMOTE);
+                return;
+            }
+        }
+
+        conn->traffic_ongoing.num_writes++;
+        conn->traffic_ongoing.bytes_sent += wrote;
+        if(largs->params.dump_setting & DS_DUMP_ALL_OUT
+           || ((largs->params.dump_setting & DS_DUMP_ONE_OUT)
+               && largs->dump_connect_fd == tk_fd(&conn->watcher))) {
+            debug_dump_data("Snd", tk_fd(&conn->watcher), position, wrote, 0);
+        }
+        if(largs->capture_ring) {
+            capture_connection_data(largs, conn, 1, position, wrote);
+        }
+        conn->replay.offset += wrote;
+        if(conn->replay.offset == seg->size) {
+            conn->replay.segment++;
+            conn->replay.offset = 0;
+        }
+    }
+
+    if(!original_timing) {
+        /* Nothing more to send, wait for the remote to close. */
+        conn->conn_wish &= ~CW_WRITE_INTEREST;
+        update_io_interest(TK_A_ conn);
+    } else if(flow->duration > elapsed) {
+        /* Linger for as long as the captured connection did. */
+        conn->conn_wish |= CW_WRITE_DELAYED;
+        update_io_interest(TK_A_ conn);
+        connection_timer_refresh(TK_A_ conn, flow->duration - elapsed);
+    } else {
+        close_connection(TK_A_ conn, CCR_CLEAN);
+    }
+}
+
 /*
  * Ungracefully close all connections and report accumulated stats
  * back to the central loop structure.
@@ -2816,6 +4464,119 @@ connection_flush_stats(TK_P_ struct connection *conn) {
         subtract_traffic_stats(conn->traffic_ongoing, conn->traffic_reported);
     conn->traffic_reported = conn->traffic_ongoing;
     add_traffic_numbers_NtoA(&delta, &largs->worker_traffic_stats);
+    struct destination_stats *ds = connection_destination(largs, conn);
+    if(ds) add_traffic_numbers_NtoN(&delta, &ds->traffic);
+}
+
+/*
+ * Initialize the per-destination counters and histograms (--per-destination).
+ */
+static void
+destination_stats_init(struct destination_stats *ds,
+                       statsd_report_latency_types latency_setting) {
+    const int decims_in_1s = 10 * 1000; /* decimilliseconds, 1/10 ms */
+    struct hdr_histogram **hists[] = {
+        (latency_setting & SLT_CONNECT) ? &ds->latency.connect_histogram : 0,
+        (latency_setting & SLT_FIRSTBYTE) ? &ds->latency.firstbyte_histogram
+                                          : 0,
+        (latency_setting & SLT_MARKER) ? &ds->latency.marker_histogram : 0,
+        (latency_setting & SLT_TLS) ? &ds->latency.tls_histogram : 0,
+        (latency_setting & SLT_UPGRADE) ? &ds->latency.upgrade_histogram : 0,
+        (latency_setting & SLT_APPBYTE) ? &ds->latency.appbyte_histogram : 0};
+    for(size_t i = 0; i < sizeof(hists) / sizeof(hists[0]); i++) {
+        if(!hists[i]) continue;
+        int ret = hdr_init(
+            1, /* 1/10 milliseconds is the lowest storable value. */
+            100 * decims_in_1s, /* 100 seconds is a max storable value */
+            3, hists[i]);
+        assert(ret == 0);
+    }
+}
+
+/*
+ * Get the per-destination stats of an outgoing connection,
+ * if --per-destination is enabled.
+ */
+static struct destination_stats *
+connection_destination(struct loop_arguments *largs, struct connection *conn) {
+    if(largs->destination_stats_local && conn->conn_type == CONN_OUTGOING)
+        return &largs->destination_stats_local[conn->remote_index];
+    else
+        return NULL;
+}
+
+/*
+ * Record how long the (phase) of the outgoing connection establishment
+ * took (--latency-connect, --latency-phases) and move on to the next one.
+ * The phase is ignored if the connection is not in it.
+ */
+static void
+connection_phase_done(TK_P_ struct connection *conn,
+                      enum connection_phase phase) {
+    struct loop_arguments *largs = tk_userdata(TK_A);
+
+    if(conn->conn_type != CONN_OUTGOING || conn->latency.phase != phase)
+        return;
+
+    /*
+     * Phases may complete synchronously (e.g. a TLS handshake finished
+     * right in the first SSL_connect()), long after the loop time
+     * was last updated.
+     */
+    tk_now_update(TK_A);
+    double now = tk_now(TK_A);
+    struct destination_stats *ds = connection_destination(largs, conn);
+    struct hdr_histogram *hist = NULL;
+    struct hdr_histogram *ds_hist = NULL;
+    switch(phase) {
+    case CPHASE_TCP:
+        conn->latency.phase_started = conn->latency.connection_initiated;
+        if(largs->params.ssl_enable
+           && !(largs->params.latency_setting & SLT_TLS)) {
+            /*
+             * Without --latency-phases the --latency-connect
+             * includes the TLS handshake, as it always did.
+             */
+            conn->latency.phase = CPHASE_TLS;
+            return;
+        }
+        hist = largs->connect_histogram_local;
+        if(ds) ds_hist = ds->latency.connect_histogram;
+        phase = largs->params.ssl_enable
+                    ? CPHASE_TLS
+                    : largs->params.websocket_enable ? CPHASE_UPGRADE
+                                                     : CPHASE_DONE;
+        break;
+    case CPHASE_TLS:
+        if(largs->params.latency_setting & SLT_TLS) {
+            hist = largs->tls_histogram_local;
+            if(ds) ds_hist = ds->latency.tls_histogram;
+        } else {
+            hist = largs->connect_histogram_local;
+            if(ds) ds_hist = ds->latency.connect_histogram;
+        }
+        phase = largs->params.websocket_enable ? CPHASE_UPGRADE : CPHASE_DONE;
+        break;
+    case CPHASE_UPGRADE:
+        hist = largs->upgrade_histogram_local;
+        if(ds) ds_hist = ds->latency.upgrade_histogram;
+        phase = CPHASE_APPBYTE;
+        break;
+    case CPHASE_APPBYTE:
+        hist = largs->appbyte_histogram_local;
+        if(ds) ds_hist = ds->latency.appbyte_histogram;
+        phase = CPHASE_DONE;
+        break;
+    case CPHASE_DONE:
+        return;
+    }
+
+    int64_t latency = 10000 * (now - conn->latency.phase_started);
+    if(hist) hdr_record_value(hist, latency);
+    if(ds_hist) hdr_record_value(ds_hist, latency);
+
+    conn->latency.phase = phase;
+    conn->latency.phase_started = now;
 }
 
 static void
@@ -2846,16 +4607,30 @@ connection_free_internals(struct connection *conn) {
         }
     }
 
+    /* Remove the --http response parser. */
+    free(conn->latency.http_parser);
+
+    /* Remove the WebSocket frame decoder. */
+    free(conn->ws_decoder);
+    websocket_inflater_free(conn->ws_inflater);
+    free(conn->ws_pong);
+
     /* Remove --message-stop context. */
     if(conn->sbmh_stop_ctx) {
         free(conn->sbmh_stop_ctx);
     }
 
-    message_collection_free(&conn->message_collection);
+    transport_template_free(conn->message_template);
+    expr_conn_values_free(&conn->expr_values);
+
+    free(conn->capture_endpoints);
 
 #ifdef HAVE_OPENSSL
-    if(conn->ssl_ctx) {
-        SSL_CTX_free(conn->ssl_ctx);
+    if(conn->ssl_fd) {
+        /* Freeing an active session would make it non-resumable. */
+        SSL_set_shutdown(conn->ssl_fd,
+                         SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+        SSL_free(conn->ssl_fd);
     }
 #endif
 }
@@ -2868,11 +4643,32 @@ close_connection(TK_P_ struct connection *conn,
                  enum connection_close_reason reason) {
     char buf[256];
     struct loop_arguments *largs = tk_userdata(TK_A);
+    struct destination_stats *ds = connection_destination(largs, conn);
 
     /* Stop I/O and timer notifications */
     tk_io_stop(TK_A, &conn->watcher);
     tk_timer_stop(TK_A, &conn->timer);
 
+    if(ds) {
+        switch(reason) {
+        case CCR_CLEAN:
+            ds->closed.clean++;
+            break;
+        case CCR_LIFETIME:
+            ds->closed.lifetime++;
+            break;
+        case CCR_TIMEOUT:
+            ds->closed.timeout++;
+            break;
+        case CCR_REMOTE:
+            ds->closed.remote++;
+            break;
+        case CCR_DATA:
+            ds->closed.data++;
+            break;
+        }
+    }
+
     switch(reason) {
     case CCR_LIFETIME:
     case CCR_CLEAN:
@@ -2912,6 +4708,8 @@ close_connection(TK_P_ struct connection *conn,
         int64_t n = hdr_add(largs->marker_histogram_local,
                             conn->latency.marker_histogram);
         assert(n == 0);
+        if(ds) hdr_add(ds->latency.marker_histogram,
+                       conn->latency.marker_histogram);
     }
 
     /* Maintain a count of opened/closed connections */
@@ -2931,9 +4729,7 @@ close_connection(TK_P_ struct connection *conn,
 
     TAILQ_REMOVE(&largs->open_conns, conn, hook);
 
-    if(conn->data.ptr && !(conn->data.flags & TDS_FLAG_PTR_SHARED)) {
-        free(conn->data.ptr);
-    }
+    release_connection_data(largs, conn);
 
     connection_free_internals(conn);
 
@@ -37,6 +37,9 @@
 #include "tcpkali_rate.h"
 #include "tcpkali_expr.h"
 #include "tcpkali_dns.h"
+#include "tcpkali_pcap.h"
+#include "tcpkali_capture.h"
+#include "tcpkali_corpus.h"
 
 long number_of_cpus();
 
@@ -71,12 +74,23 @@ struct engine_params {
     double channel_lifetime;
     double epoch;
     int websocket_enable; /* Enable Websocket responder on (-l) */
+    int websocket_deflate; /* --ws-deflate: offer permessage-deflate */
+    int websocket_premasked; /* --ws-premasked: reuse the masking keys */
     int ssl_enable;       /* Enable SSL/TLS */
     char *ssl_cert;       /* SSL/TLS cert file */
     char *ssl_key;        /* SSL/TLS key file */
+    double ssl_resume_ratio; /* --ssl-resume: share of resumed sessions */
+    int ssl_ktls;            /* --ssl-ktls: kernel TLS offload */
     /* Pre-computed message data template */
     struct message_collection message_collection;  /* A descr. what to send */
     struct transport_data_spec *data_templates[2]; /* client, server tmpls */
+    /* Alternative message collections to switch to at run time */
+    struct message_set {
+        struct message_collection message_collection;
+        struct transport_data_spec *data_templates[2];
+    } * message_sets;
+    size_t message_sets_count;
+    size_t message_set; /* 0 for the above default, N for message_sets[N-1] */
     enum {
         DS_DUMP_ONE_IN = 1,
         DS_DUMP_ONE_OUT = 2,
@@ -86,8 +100,29 @@ struct engine_params {
         DS_DUMP_ALL = 12 /* 8|4 */
     } dump_setting;
     statsd_report_latency_types latency_setting;
+    int per_destination;            /* --per-destination */
+    enum {
+        OUTPUT_FORMAT_TEXT,
+        OUTPUT_FORMAT_JSON
+    } output_format;                /* --output-format */
+    struct pcap_replay *pcap_replay; /* --pcap */
+    enum {
+        PCAP_TIMING_ORIGINAL,
+        PCAP_TIMING_FAST
+    } pcap_timing;                  /* --pcap-timing */
+    struct capture *capture;        /* --capture */
+    struct corpus *corpus;          /* --corpus */
+    enum {
+        CORPUS_SEQUENTIAL,
+        CORPUS_RANDOM
+    } corpus_order;                 /* --corpus-order */
+    size_t corpus_start;            /* --corpus-start <N> */
+    int stream_fd;                  /* --stream-file */
+    off_t stream_size;              /* Non-zero if --stream-file is given */
     int latency_marker_skip;        /* --latency-marker-skip <N> */
+    unsigned pipeline_depth;        /* --pipeline-depth <N> */
     int message_marker;             /* \{message.marker} */
+    int http_mode;                  /* --http */
     double delay_send;              /* --delay-send <Time> */
     tk_expr_t *latency_marker_expr; /* --latency-marker */
     tk_expr_t *message_stop_expr;   /* --message-stop */
@@ -117,7 +152,40 @@ struct latency_snapshot *engine_collect_latency_snapshot(struct engine *);
 struct latency_snapshot *engine_diff_latency_snapshot(struct latency_snapshot *base, struct latency_snapshot *update);
 void engine_free_latency_snapshot(struct latency_snapshot *);
 
+/*
+ * Per-destination breakdown of the outgoing connections (--per-destination).
+ * Collected after engine_prepare_latency_snapshot().
+ */
+struct destination_snapshot {
+    size_t n_destinations;
+    struct destination_stats {
+        struct sockaddr_storage address;
+        non_atomic_narrow_t connection_attempts;
+        non_atomic_narrow_t connection_failures;
+        non_atomic_traffic_stats traffic;
+        struct {
+            non_atomic_narrow_t clean;    /* Closed by us, no failure */
+            non_atomic_narrow_t lifetime; /* --channel-lifetime expired */
+            non_atomic_narrow_t timeout;  /* --connect-timeout expired */
+            non_atomic_narrow_t remote;   /* Closed by the remote side */
+            non_atomic_narrow_t data;     /* Data framing error */
+        } closed;
+        struct latency_snapshot latency;
+    } * destinations;
+};
+struct destination_snapshot *engine_collect_destination_snapshot(
+    struct engine *);
+void engine_free_destination_snapshot(struct destination_snapshot *);
+
 size_t engine_initiate_new_connections(struct engine *, size_t n);
+void engine_terminate_connections(struct engine *, size_t n);
+
+/*
+ * Switch the live and new connections to a different message set:
+ * 0 for the default message collection, N for the params.message_sets[N-1].
+ * The live connections switch at their next message boundary.
+ */
+void engine_set_message_set(struct engine *, size_t message_set);
 
 non_atomic_traffic_stats engine_traffic(struct engine *);
 
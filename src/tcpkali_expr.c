@@ -30,6 +30,7 @@
 #include <sys/types.h>
 #include <assert.h>
 #include <math.h>
+#include <sys/time.h>
 
 #include "tcpkali_transport.h"
 #include "tcpkali_websocket.h"
@@ -73,13 +74,17 @@ free_expression(tk_expr_t *expr, int delete_data) {
         case EXPR_CONNECTION_PTR:
         case EXPR_CONNECTION_UID:
         case EXPR_MESSAGE_MARKER:
+        case EXPR_MESSAGE_SEQ:
+        case EXPR_GLOBAL_SEQ:
+        case EXPR_TIME_MS:
+        case EXPR_TIME_US:
+        case EXPR_RAND:
             break;
         case EXPR_REGEX:{
             if (delete_data) tregex_free(expr->u.regex.re);
             break;
         };
         }
-        if (expr->res_buf) free((void *)expr->res_buf);
         free((void *) expr);
     }
 }
@@ -117,9 +122,100 @@ parse_expression(tk_expr_t **expr_p, const char *buf, size_t size, int debug) {
     }
 }
 
+ssize_t
+expr_print_fixed_width(char *buf, size_t size, size_t width,
+                       unsigned long long value) {
+    char tmp[sizeof("18446744073709551615")];
+
+    if(size < width || width >= sizeof(tmp)) return -1;
+
+    /* Keep the lowest digits should the value ever outgrow the width. */
+    int s = snprintf(tmp, sizeof(tmp), "%0*llu", (int)width, value);
+    memcpy(buf, tmp + (s - width), width);
+    return width;
+}
+
+static unsigned long
+eval_rand(const tk_expr_t *expr, pcg32_random_t *rng) {
+    unsigned long range = expr->u.rand.range;
+    if(range && range <= UINT32_MAX) {
+        return expr->u.rand.from + pcg32_boundedrand_r(rng, range);
+    } else {
+        unsigned long long r = ((unsigned long long)pcg32_random_r(rng) << 32)
+                               | pcg32_random_r(rng);
+        return expr->u.rand.from + (range ? r % range : r);
+    }
+}
+
+void
+expr_conn_values_init(struct expr_conn_values *values, size_t count) {
+    values->count = count;
+    values->values = NULL;
+}
+
+void
+expr_conn_values_free(struct expr_conn_values *values) {
+    if(values->values) {
+        for(size_t i = 0; i < values->count; i++) {
+            free(values->values[i].buf);
+        }
+        free(values->values);
+    }
+    values->values = NULL;
+}
+
+const struct expr_conn_value *
+expr_conn_value(const tk_expr_t *expr, const struct expr_conn_values *values) {
+    if(!expr->conn_slot || !values || !values->values) return NULL;
+    assert(expr->conn_slot <= values->count);
+    const struct expr_conn_value *v = &values->values[expr->conn_slot - 1];
+    return v->buf ? v : NULL;
+}
+
+static void
+expr_conn_value_save(const tk_expr_t *expr, struct expr_conn_values *values,
+                     const char *buf, size_t size) {
+    if(!expr->conn_slot || !values) return;
+    assert(expr->conn_slot <= values->count);
+    if(!values->values) {
+        values->values = calloc(values->count, sizeof(values->values[0]));
+        assert(values->values);
+    }
+    struct expr_conn_value *v = &values->values[expr->conn_slot - 1];
+    v->buf = malloc(size ? size : 1);
+    assert(v->buf);
+    memcpy(v->buf, buf, size);
+    v->size = size;
+}
+
+size_t
+expression_number_conn_slots(tk_expr_t *expr, size_t next_slot) {
+    if(!expr) return next_slot;
+
+    if(expr->dynamic_scope == DS_PER_CONNECTION) {
+        expr->conn_slot = next_slot;
+        return next_slot + 1;
+    }
+
+    switch(expr->type) {
+    case EXPR_RAW:
+        return expression_number_conn_slots(expr->u.raw.expr, next_slot);
+    case EXPR_CONCAT:
+        next_slot = expression_number_conn_slots(expr->u.concat.expr[0],
+                                                 next_slot);
+        return expression_number_conn_slots(expr->u.concat.expr[1],
+                                            next_slot);
+    case EXPR_MODULO:
+        return expression_number_conn_slots(expr->u.modulo.expr, next_slot);
+    default:
+        return next_slot;
+    }
+}
+
 ssize_t
 eval_expression(char **buf_p, size_t size, tk_expr_t *expr, expr_callback_f cb,
-                void *key, long *value, int client_mode, pcg32_random_t *rng) {
+                void *key, struct expr_conn_values *values, long *value,
+                int client_mode, pcg32_random_t *rng) {
     char *buf;
 
     if(!*buf_p) {
@@ -129,10 +225,12 @@ eval_expression(char **buf_p, size_t size, tk_expr_t *expr, expr_callback_f cb,
     } else {
         buf = *buf_p;
     }
-    if (expr->dynamic_scope == DS_PER_CONNECTION && expr->res_buf){
+    const struct expr_conn_value *saved = expr_conn_value(expr, values);
+    if(saved) {
         /* Not first eval of "per connection" expr, just get res from a buffer */
-        memcpy(buf, expr->res_buf, expr->res_size);
-        return expr->res_size;
+        if(size < saved->size) return -1;
+        memcpy(buf, saved->buf, saved->size);
+        return saved->size;
     }
 
     size_t res_size = -1;
@@ -145,8 +243,8 @@ eval_expression(char **buf_p, size_t size, tk_expr_t *expr, expr_callback_f cb,
         break;
     }
     case EXPR_RAW: {
-        res_size = eval_expression(buf_p, size, expr->u.raw.expr, cb, key, value,
-                               client_mode, rng);
+        res_size = eval_expression(buf_p, size, expr->u.raw.expr, cb, key,
+                                   values, value, client_mode, rng);
         break;
     }
     case EXPR_WS_FRAME: {
@@ -160,21 +258,20 @@ eval_expression(char **buf_p, size_t size, tk_expr_t *expr, expr_callback_f cb,
                 expr->u.ws_frame.fin, expr->u.ws_frame.size);
             memcpy(buf + hdr_size, expr->u.ws_frame.data,
                    expr->u.ws_frame.size);
+            websocket_frame_mask((uint8_t *)buf, hdr_size,
+                                 expr->u.ws_frame.size, pcg32_random_r(rng));
             res_size = (hdr_size + expr->u.ws_frame.size);
             break;
         }
     }
     case EXPR_MODULO: {
         long v = 0;
-        (void)eval_expression(&buf, size, expr->u.modulo.expr, cb, key, &v,
-                              client_mode, rng);
+        (void)eval_expression(&buf, size, expr->u.modulo.expr, cb, key, values,
+                              &v, client_mode, rng);
         v %= expr->u.modulo.modulo_value;
         ssize_t s = snprintf(buf, size, "%ld", v);
         if(s < 0 || s > (ssize_t)size) return -1;
         if(value) *value = v;
-        if(expr->u.modulo.expr->dynamic_scope == DS_PER_CONNECTION) {
-            expr->dynamic_scope = DS_PER_CONNECTION;
-        }
         res_size = s;
         break;
     }
@@ -184,12 +281,12 @@ eval_expression(char **buf_p, size_t size, tk_expr_t *expr, expr_callback_f cb,
            > size)
             return -1;
         ssize_t size1 = eval_expression(&buf, size, expr->u.concat.expr[0], cb,
-                                        key, value, client_mode, rng);
+                                        key, values, value, client_mode, rng);
         if(size1 < 0) return -1;
         char *buf2 = buf + size1;
         ssize_t size2 =
             eval_expression(&buf2, size - size1, expr->u.concat.expr[1], cb,
-                            key, value, client_mode, rng);
+                            key, values, value, client_mode, rng);
         if(size1 < 0) return -1;
         res_size = size1 + size2;
         break;
@@ -206,125 +303,43 @@ eval_expression(char **buf_p, size_t size, tk_expr_t *expr, expr_callback_f cb,
         res_size = cb(buf, size, expr, key, value);
         break;
     }
+    case EXPR_MESSAGE_SEQ:
+    case EXPR_GLOBAL_SEQ: {
+        res_size = cb(buf, size, expr, key, value);
+        break;
+    }
+    case EXPR_TIME_MS:
+    case EXPR_TIME_US: {
+        struct timeval tv;
+        unsigned long long t;
+        gettimeofday(&tv, NULL);
+        if(expr->type == EXPR_TIME_MS)
+            t = tv.tv_sec * 1000ULL + tv.tv_usec / 1000;
+        else
+            t = tv.tv_sec * 1000000ULL + tv.tv_usec;
+        if(value) *value = t;
+        res_size = expr_print_fixed_width(buf, size, expr->estimate_size, t);
+        break;
+    }
+    case EXPR_RAND: {
+        unsigned long r = eval_rand(expr, rng);
+        if(value) *value = r;
+        res_size = expr_print_fixed_width(buf, size, expr->estimate_size, r);
+        break;
+    }
     case EXPR_REGEX: {
         res_size = tregex_eval_rng(expr->u.regex.re, buf, size, rng);
     }
     }
 
     /* First eval of "per connection" expr, save results to a buffer */
-    if (expr->dynamic_scope == DS_PER_CONNECTION && res_size > 0){
-        expr->res_buf = malloc(res_size);
-        memcpy(expr->res_buf, buf, res_size);
-        expr->res_size = res_size;
+    if((ssize_t)res_size >= 0) {
+        expr_conn_value_save(expr, values, buf, res_size);
     }
 
     return res_size;
 }
 
-tk_expr_t *
-replicate_expression(tk_expr_t *expr) {
-    if (!expr) return NULL;
-    switch(expr->type) {
-    case EXPR_DATA: {
-        tk_expr_t *new_expr = calloc(1, sizeof(tk_expr_t));
-        new_expr->type = EXPR_DATA;
-        new_expr->u.data.data = expr->u.data.data;
-        new_expr->u.data.size = expr->u.data.size;
-        new_expr->estimate_size = expr->estimate_size;
-        new_expr->dynamic_scope = expr->dynamic_scope;
-        new_expr->res_buf = NULL;
-        new_expr->res_size = 0;
-        return new_expr;
-    };
-    case EXPR_WS_FRAME: {
-        tk_expr_t *new_expr = calloc(1, sizeof(tk_expr_t));
-        new_expr->type = EXPR_WS_FRAME;
-        new_expr->u.ws_frame.data = expr->u.ws_frame.data;
-        new_expr->u.ws_frame.size = expr->u.ws_frame.size;
-        new_expr->u.ws_frame.opcode = expr->u.ws_frame.opcode;
-        new_expr->u.ws_frame.rsvs = expr->u.ws_frame.rsvs;
-        new_expr->u.ws_frame.fin = expr->u.ws_frame.fin;
-        new_expr->estimate_size = expr->estimate_size;
-        new_expr->dynamic_scope = expr->dynamic_scope;
-        new_expr->res_buf = NULL;
-        new_expr->res_size = 0;
-        return new_expr;
-    };
-    case EXPR_MESSAGE_MARKER: {
-        tk_expr_t *new_expr = calloc(1, sizeof(tk_expr_t));
-        new_expr->type = EXPR_MESSAGE_MARKER;
-        new_expr->estimate_size = expr->estimate_size;
-        new_expr->dynamic_scope = expr->dynamic_scope;
-        new_expr->res_buf = NULL;
-        new_expr->res_size = 0;
-        return new_expr;
-    };
-    case EXPR_RAW: {
-        tk_expr_t *new_expr = calloc(1, sizeof(tk_expr_t));
-        new_expr->type = EXPR_RAW;
-        new_expr->u.raw.expr = replicate_expression(expr->u.raw.expr);
-        new_expr->estimate_size = expr->estimate_size;
-        new_expr->dynamic_scope = expr->dynamic_scope;
-        new_expr->res_buf = NULL;
-        new_expr->res_size = 0;
-        return new_expr;
-    };
-    case EXPR_MODULO: {
-        tk_expr_t *new_expr = calloc(1, sizeof(tk_expr_t));
-        new_expr->type = EXPR_MODULO;
-        new_expr->u.modulo.expr = replicate_expression(expr->u.modulo.expr);;
-        new_expr->u.modulo.modulo_value = expr->u.modulo.modulo_value;
-        new_expr->estimate_size = expr->estimate_size;
-        new_expr->dynamic_scope = expr->dynamic_scope;
-        new_expr->res_buf = NULL;
-        new_expr->res_size = 0;
-        return new_expr;
-    };
-    case EXPR_CONCAT: {
-        tk_expr_t *new_expr = calloc(1, sizeof(tk_expr_t));
-        new_expr->type = EXPR_CONCAT;
-        new_expr->u.concat.expr[0] = replicate_expression(expr->u.concat.expr[0]);
-        new_expr->u.concat.expr[1] = replicate_expression(expr->u.concat.expr[1]);
-        new_expr->estimate_size = expr->estimate_size;
-        new_expr->dynamic_scope = expr->dynamic_scope;
-        new_expr->res_buf = NULL;
-        new_expr->res_size = 0;
-        return new_expr;
-    };
-    case EXPR_CONNECTION_PTR: {
-        tk_expr_t *new_expr = calloc(1, sizeof(tk_expr_t));
-        new_expr->type = EXPR_CONNECTION_PTR;
-        new_expr->estimate_size = expr->estimate_size;
-        new_expr->dynamic_scope = expr->dynamic_scope;
-        new_expr->res_buf = NULL;
-        new_expr->res_size = 0;
-        return new_expr;
-    };
-    case EXPR_CONNECTION_UID:{
-        tk_expr_t *new_expr = calloc(1, sizeof(tk_expr_t));
-        new_expr->type = EXPR_CONNECTION_UID;
-        new_expr->estimate_size = expr->estimate_size;
-        new_expr->dynamic_scope = expr->dynamic_scope;
-        new_expr->res_buf = NULL;
-        new_expr->res_size = 0;
-        return new_expr;
-    };
-    case EXPR_REGEX: {
-        tk_expr_t *new_expr = calloc(1, sizeof(tk_expr_t));
-        new_expr->type = EXPR_REGEX;
-        new_expr->u.regex.re = expr->u.regex.re;
-        new_expr->estimate_size = expr->estimate_size;
-        new_expr->dynamic_scope = expr->dynamic_scope;
-        new_expr->res_buf = NULL;
-        new_expr->res_size = 0;
-        return new_expr;
-    };
-
-    }
-
-    return NULL;
-}
-
 tk_expr_t *
 concat_expressions(tk_expr_t *expr1, tk_expr_t *expr2) {
     if(expr1 && expr2) {
@@ -363,6 +378,11 @@ expression_split_by_websocket_frame(tk_expr_t *expr) {
     case EXPR_CONNECTION_UID:
     case EXPR_REGEX:
     case EXPR_MESSAGE_MARKER:
+    case EXPR_MESSAGE_SEQ:
+    case EXPR_GLOBAL_SEQ:
+    case EXPR_TIME_MS:
+    case EXPR_TIME_US:
+    case EXPR_RAND:
         result.esw_prefix = expr;
         return result;
     case EXPR_WS_FRAME:
@@ -443,6 +463,11 @@ unescape_expression(tk_expr_t *expr) {
     case EXPR_CONNECTION_UID:
     case EXPR_REGEX:
     case EXPR_MESSAGE_MARKER:
+    case EXPR_MESSAGE_SEQ:
+    case EXPR_GLOBAL_SEQ:
+    case EXPR_TIME_MS:
+    case EXPR_TIME_US:
+    case EXPR_RAND:
         return;
     case EXPR_WS_FRAME: {
         size_t overhead = expr->estimate_size - expr->u.ws_frame.size;
@@ -472,15 +497,17 @@ float avg_digit_num(long modulo) {
     }
 }
 
-size_t average_size(tk_expr_t *expr) {
-    if (expr->res_buf) {
-        return expr->res_size;
+size_t average_size(const tk_expr_t *expr,
+                    const struct expr_conn_values *values) {
+    const struct expr_conn_value *saved = expr_conn_value(expr, values);
+    if(saved) {
+        return saved->size;
     }
 
     switch(expr->type) {
     case EXPR_CONCAT: {
-        size_t avg_size = average_size(expr->u.concat.expr[0])
-                        + average_size(expr->u.concat.expr[1]);
+        size_t avg_size = average_size(expr->u.concat.expr[0], values)
+                        + average_size(expr->u.concat.expr[1], values);
         return avg_size;
     }
     case EXPR_REGEX: {
@@ -494,6 +521,11 @@ size_t average_size(tk_expr_t *expr) {
     case EXPR_CONNECTION_PTR:
     case EXPR_CONNECTION_UID:
     case EXPR_MESSAGE_MARKER:
+    case EXPR_MESSAGE_SEQ:
+    case EXPR_GLOBAL_SEQ:
+    case EXPR_TIME_MS:
+    case EXPR_TIME_US:
+    case EXPR_RAND:
     case EXPR_WS_FRAME:
         return expr->estimate_size;
     }
@@ -41,6 +41,11 @@ typedef struct tk_expr {
         EXPR_CONNECTION_UID, /* 'connection.uid' */
         EXPR_REGEX,
         EXPR_MESSAGE_MARKER, /* 'messager.marker' */
+        EXPR_MESSAGE_SEQ,    /* 'message.seq' */
+        EXPR_GLOBAL_SEQ,     /* 'global.seq' */
+        EXPR_TIME_MS,        /* 'time.ms' */
+        EXPR_TIME_US,        /* 'time.us' */
+        EXPR_RAND,           /* 'rand N..M' */
     } type;
     union {
         struct {
@@ -68,6 +73,10 @@ typedef struct tk_expr {
         struct {
             tregex *re;
         } regex;
+        struct {
+            unsigned long from;
+            unsigned long range; /* M - N + 1 */
+        } rand;
     } u;
     size_t estimate_size;
     enum tk_expr_dynamic_scope {
@@ -77,13 +86,39 @@ typedef struct tk_expr {
     } dynamic_scope;
 
    /*
-    * if it is "per_connection" expr then we evaluate
-    * it only once and save res in res_buf
+    * The "per connection" expression is evaluated only once, and its value
+    * is saved in the connection's struct expr_conn_values under this slot
+    * (1-based, 0 if none). The expression tree itself is shared.
     */
-    char *res_buf;
-    size_t res_size;
+    size_t conn_slot;
 } tk_expr_t;
 
+/*
+ * The values of the "per connection" expressions of a single connection.
+ */
+struct expr_conn_values {
+    size_t count; /* Number of slots */
+    struct expr_conn_value {
+        char *buf;
+        size_t size;
+    } * values; /* Allocated when the first value is saved */
+};
+
+void expr_conn_values_init(struct expr_conn_values *, size_t count);
+void expr_conn_values_free(struct expr_conn_values *);
+
+/*
+ * Get the value saved for the expression, or NULL if there is none.
+ */
+const struct expr_conn_value *expr_conn_value(const tk_expr_t *,
+                                              const struct expr_conn_values *);
+
+/*
+ * Assign the slots to the outermost "per connection" subexpressions,
+ * starting with (next_slot). Returns the next unused slot.
+ */
+size_t expression_number_conn_slots(tk_expr_t *, size_t next_slot);
+
 /*
  * Trivial expression is expression which does not contain any
  * interesting (dynamically computable) values and is basically
@@ -100,20 +135,32 @@ int parse_expression(tk_expr_t **, const char *expr_string, size_t size,
 
 void free_expression(tk_expr_t *expr, int delete_data);
 
+/*
+ * The sequence numbers and timestamps are zero-padded to a fixed width,
+ * for the messages to keep their layout (see struct transport_template).
+ */
+#define EXPR_SEQ_WIDTH 10     /* 32-bit counters */
+#define EXPR_TIME_MS_WIDTH 13 /* Milliseconds since the Epoch */
+#define EXPR_TIME_US_WIDTH 16 /* Microseconds since the Epoch */
+
+/*
+ * Print the value zero-padded to exactly (width) characters, without
+ * the terminating '\0'. Returns (width) or -1 if (size) is too small.
+ */
+ssize_t expr_print_fixed_width(char *buf, size_t size, size_t width,
+                               unsigned long long value);
+
 typedef ssize_t(expr_callback_f)(char *buf, size_t size, tk_expr_t *, void *key,
                                  long *output_value);
 
 /*
  * Returns -1 if the expression doesn't fit in the (size) fully.
  * Returns the size of the data placed into *buf_p otherwise.
+ * The (values), if given, keep the "per connection" values.
  */
 ssize_t eval_expression(char **buf_p, size_t size, tk_expr_t *, expr_callback_f,
-                        void *key, long *output_value, int client_mode, pcg32_random_t *rng);
-
-/*
- * Replicate expression (copy everything except data)
- */
-tk_expr_t * replicate_expression(tk_expr_t *expr);
+                        void *key, struct expr_conn_values *values,
+                        long *output_value, int client_mode, pcg32_random_t *rng);
 
 /*
  * Concatenate expressions. One or both expressions can be NULL.
@@ -150,6 +197,6 @@ void unescape_expression(tk_expr_t *expr);
  * callculate average msg size.
  */
 
-size_t average_size(tk_expr_t *expr);
+size_t average_size(const tk_expr_t *expr, const struct expr_conn_values *);
 
 #endif /* TCPKALI_EXPR_H */
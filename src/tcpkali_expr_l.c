@@ -363,8 +363,8 @@ static void yy_fatal_error (yyconst char msg[]  );
 	*yy_cp = '\0'; \
 	(yy_c_buf_p) = yy_cp;
 
-#define YY_NUM_RULES 61
-#define YY_END_OF_BUFFER 62
+#define YY_NUM_RULES 66
+#define YY_END_OF_BUFFER 67
 /* This struct is not used in this scanner,
    but its presence is necessary. */
 struct yy_trans_info
@@ -372,27 +372,28 @@ struct yy_trans_info
 	flex_int32_t yy_verify;
 	flex_int32_t yy_nxt;
 	};
-static yyconst flex_int16_t yy_accept[177] =
+static yyconst flex_int16_t yy_accept[187] =
     {   0,
         0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-        0,    0,   62,    2,    2,   36,   12,   12,   12,   37,
-       34,   29,   28,    9,   36,   36,   36,   36,   36,   36,
-       36,   36,   36,   10,   11,    4,    3,    3,    7,    7,
-        8,   39,   38,   38,   44,   45,   50,   49,   48,   42,
-       43,   46,   41,   47,   51,   51,   61,   55,   61,   57,
-       59,   58,   60,    2,    2,    1,   36,   12,   12,    0,
-       35,    0,    0,   28,   36,   36,   36,   36,   36,   36,
-       36,   36,   36,   36,   26,   36,   36,   36,   13,    4,
-        0,    7,    4,    3,    3,    0,    7,    0,    5,    0,
-
-        7,    7,   39,   38,   38,   51,   51,   54,   54,   57,
-       58,   30,   36,   36,   36,   36,   36,   36,   36,   36,
-       24,   14,   36,   36,   25,    6,    6,    5,    0,    5,
-        0,    7,   40,   52,   53,   36,   36,   36,   15,   36,
-       36,   36,   19,   20,   31,   32,   33,   16,    0,    5,
-       36,   18,   36,   36,   36,   36,   36,    5,   17,   36,
-       36,   23,   27,   36,   36,   36,   22,   36,   36,   36,
-       36,   21,   36,   36,   15,    0
+        0,    0,   67,    2,    2,   41,   12,   12,   12,   42,
+       39,   34,   33,    9,   41,   41,   41,   41,   41,   41,
+       41,   41,   41,   41,   10,   11,    4,    3,    3,    7,
+        7,    8,   44,   43,   43,   49,   50,   55,   54,   53,
+       47,   48,   51,   46,   52,   56,   56,   66,   60,   66,
+       62,   64,   63,   65,    2,    2,    1,   41,   12,   12,
+        0,   40,    0,    0,   33,   41,   41,   41,   41,   41,
+       41,   30,   41,   41,   41,   41,   26,   41,   41,   41,
+       41,   41,   31,   13,    4,    0,    7,    4,    3,    3,
+
+        0,    7,    0,    5,    0,    7,    7,   44,   43,   43,
+       56,   56,   59,   59,   62,   63,   35,   41,   41,   41,
+       41,   41,   41,   41,   41,   24,   41,   14,   41,   28,
+       41,   41,   25,    6,    6,    5,    0,    5,    0,    7,
+       45,   57,   58,   41,   41,   41,   15,   41,   41,   41,
+       19,   20,   32,   36,   37,   38,   16,   29,    0,    5,
+       41,   18,   41,   41,   41,   41,   41,    5,   17,   41,
+       41,   23,   27,   41,   41,   41,   22,   41,   41,   41,
+       41,   21,   41,   41,   15,    0
     } ;
 
 static yyconst flex_int32_t yy_ec[256] =
@@ -409,8 +410,8 @@ static yyconst flex_int32_t yy_ec[256] =
        23,   24,   25,    1,    1,    1,   26,   27,   28,   29,
 
        30,    1,   31,    1,   32,    1,   33,   34,   35,   36,
-       37,   38,    1,   39,   40,   41,   42,   43,   44,   45,
-       46,    1,   47,   48,   49,    1,    1,    1,    1,    1,
+       37,   38,   39,   40,   41,   42,   43,   44,   45,   46,
+       47,    1,   48,   49,   50,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
@@ -427,245 +428,251 @@ static yyconst flex_int32_t yy_ec[256] =
         1,    1,    1,    1,    1
     } ;
 
-static yyconst flex_int32_t yy_meta[50] =
+static yyconst flex_int32_t yy_meta[51] =
     {   0,
         1,    1,    2,    2,    3,    3,    3,    1,    4,    4,
         4,    4,    1,    5,    3,    1,    1,    1,    1,    3,
         6,    4,    4,    7,    8,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    1,    1,    1,    1,    1,    9,    4,    9
+        1,    1,    1,    1,    1,    1,    1,    9,    4,    9
     } ;
 
-static yyconst flex_int16_t yy_base[196] =
+static yyconst flex_int16_t yy_base[206] =
     {   0,
-      337,  336,    0,    0,   48,   96,  144,  192,  237,  282,
-      330,  378,  359,    0,   31,    0,   57,   61,   72,   61,
-      735,  343,   63,  735,  325,   49,  322,   58,   55,   63,
-      325,  322,  313,  735,  735,  423,  471,  105,  109,   67,
-      735,    0,  120,  132,  735,  735,  735,  735,  735,  735,
-      735,  735,  735,  735,  156,  338,    0,  735,  735,  136,
-      735,  141,  735,    0,  735,  735,    0,  170,  175,  120,
-      735,  348,  335,  165,  309,  307,  306,  304,  301,  299,
-      302,  301,  297,  285,    0,  285,  281,  296,    0,  183,
-      299,  126,  204,    0,  221,  192,  225,  229,  127,  194,
-
-      242,  214,  243,  519,  256,  262,  308,    0,  735,  268,
-      262,  735,  294,  279,  186,  291,  284,  276,  284,  283,
-        0,    0,  194,  272,    0,  232,  284,  276,  277,  735,
-      288,  300,  735,  735,  735,  260,  265,  255,  252,  249,
-      234,  210,    0,    0,    0,    0,    0,    0,  306,  269,
-      188,    0,  193,  163,  156,  150,  137,  141,    0,  123,
-      110,    0,    0,  112,   96,  101,    0,   83,   77,   75,
-       62,    0,   53,   34,    0,  735,  566,  575,  584,  593,
-      602,  611,  620,  628,  637,  646,  655,  664,  673,  680,
-      689,  698,  707,  716,  725
-
+      347,  346,    0,    0,   49,   98,  147,  196,  242,  288,
+      337,  386,  369,    0,   32,    0,   58,   62,   73,   62,
+      747,  353,   65,  747,  335,   51,  332,   64,   78,   83,
+      335,   41,   55,  323,  747,  747,  432,  481,  123,  139,
+       74,  747,    0,  127,  131,  747,  747,  747,  747,  747,
+      747,  747,  747,  747,  747,  159,  349,    0,  747,  747,
+      135,  747,  159,  747,    0,  747,  747,    0,  178,  182,
+       87,  747,  359,  346,  172,  324,  322,  322,  320,  312,
+      310,    0,  313,  312,  306,  117,    0,  301,  304,  291,
+      301,  306,    0,    0,  208,  310,   90,  220,    0,  212,
+
+      196,  229,  234,  117,  235,  255,  246,  181,  530,  261,
+      266,  319,    0,  747,  280,  271,  747,  306,  290,  119,
+      303,  295,  283,  292,  290,    0,  291,    0,  279,    0,
+      276,  285,    0,  286,  288,  287,  293,  747,  224,  301,
+      747,  747,  747,  269,  271,  248,  245,  249,  244,  243,
+        0,    0,    0,    0,    0,    0,    0,    0,  323,  295,
+      221,    0,  226,  207,  208,  199,  200,  180,    0,  152,
+      128,    0,    0,  138,  135,  128,    0,   80,   74,   76,
+       60,    0,   54,   53,    0,  747,  578,  587,  596,  605,
+      614,  623,  632,  640,  649,  658,  667,  676,  685,  692,
+
+      701,  710,  719,  728,  737
     } ;
 
-static yyconst flex_int16_t yy_def[196] =
+static yyconst flex_int16_t yy_def[206] =
     {   0,
-      177,  177,  176,    3,  178,  178,  179,  179,  180,  180,
-      181,  181,  176,  182,  176,  183,  183,  183,  176,  184,
-      176,  176,  183,  176,  183,  183,  183,  183,  183,  183,
-      183,  183,  183,  176,  176,  185,  185,  186,  187,  188,
-      176,  189,  189,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  190,  191,  192,  176,  176,  176,
-      176,  176,  176,  182,  176,  176,  183,  183,  176,  184,
-      176,  184,  176,  183,  183,  183,  183,  183,  183,  183,
-      183,  183,  183,  183,  183,  183,  183,  183,  183,   37,
-      186,  188,   37,   37,  186,  186,  187,  193,  188,  194,
-
-      187,  188,  189,  189,  176,  190,  191,  195,  176,  176,
-      176,  176,  183,  183,  183,  183,  183,  183,  183,  183,
-      183,  183,  183,  183,  183,  188,  186,  186,  193,  176,
-      194,  187,  176,  176,  176,  183,  183,  183,  183,  183,
-      183,  183,  183,  183,  183,  183,  183,  183,  193,  188,
-      183,  183,  183,  183,  183,  183,  183,  186,  183,  183,
-      183,  183,  183,  183,  183,  183,  183,  183,  183,  183,
-      183,  183,  183,  183,  183,    0,  176,  176,  176,  176,
-      176,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  176
-
+      187,  187,  186,    3,  188,  188,  189,  189,  190,  190,
+      191,  191,  186,  192,  186,  193,  193,  193,  186,  194,
+      186,  186,  193,  186,  193,  193,  193,  193,  193,  193,
+      193,  193,  193,  193,  186,  186,  195,  195,  196,  197,
+      198,  186,  199,  199,  186,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  200,  201,  202,  186,  186,
+      186,  186,  186,  186,  192,  186,  186,  193,  193,  186,
+      194,  186,  194,  186,  193,  193,  193,  193,  193,  193,
+      193,  193,  193,  193,  193,  193,  193,  193,  193,  193,
+      193,  193,  193,  193,   38,  196,  198,   38,   38,  196,
+
+      196,  197,  203,  198,  204,  197,  198,  199,  199,  186,
+      200,  201,  205,  186,  186,  186,  186,  193,  193,  193,
+      193,  193,  193,  193,  193,  193,  193,  193,  193,  193,
+      193,  193,  193,  198,  196,  196,  203,  186,  204,  197,
+      186,  186,  186,  193,  193,  193,  193,  193,  193,  193,
+      193,  193,  193,  193,  193,  193,  193,  193,  203,  198,
+      193,  193,  193,  193,  193,  193,  193,  196,  193,  193,
+      193,  193,  193,  193,  193,  193,  193,  193,  193,  193,
+      193,  193,  193,  193,  193,    0,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  186,  186,  186,
+
+      186,  186,  186,  186,  186
     } ;
 
-static yyconst flex_int16_t yy_nxt[785] =
+static yyconst flex_int16_t yy_nxt[798] =
     {   0,
        16,   17,   18,   17,   19,   20,   21,   16,   16,   16,
        16,   16,   16,   16,   22,   23,   23,   23,   23,   24,
        16,   16,   16,   16,   16,   16,   25,   26,   16,   16,
-       27,   16,   16,   16,   28,   16,   16,   29,   30,   16,
-       31,   32,   16,   33,   16,   16,   34,   16,   35,   37,
-       37,   37,   38,   39,   65,   40,   40,   40,   68,   68,
-       68,   69,   68,   68,   68,   69,   71,   40,   41,  175,
-       40,   91,   40,   69,   69,   69,   69,   66,   74,   74,
-       74,   74,   76,   79,   72,   77,   81,   80,   84,  174,
-      102,   82,   85,  173,   40,   83,   40,   37,   37,   37,
-
-       38,   39,   86,   40,   40,   40,   95,   95,   95,   95,
-      172,   92,   92,   98,   99,   40,   41,  171,   40,  170,
-       40,  104,  104,  104,  104,   71,  169,  168,   96,  100,
-       91,   91,  101,  105,  105,  105,  105,  110,  110,  110,
-      110,  167,   40,   72,   40,   43,   43,   43,   44,  102,
-      102,  166,   45,   46,   47,   48,  111,  111,  111,  111,
-      107,  107,  107,  165,   96,   49,   50,  164,   51,  108,
-      107,   68,   68,   68,   69,  107,   69,   69,   69,   69,
-       74,   74,   74,   74,   90,   90,   90,   91,  163,  162,
-       52,   53,   54,   43,   43,   43,   44,  127,  161,  130,
-
-       45,   46,   47,   48,  107,   90,   90,   90,   91,  126,
-      145,  146,  147,   49,   50,   96,   51,  131,   91,  126,
-      160,  138,   95,   95,   95,   95,  139,   92,   92,   98,
-       99,   91,   91,  159,  128,  157,   91,  102,   52,   53,
-       54,   56,   56,   56,   96,  100,   98,  126,  101,  100,
-       57,   56,  129,  133,  133,  102,   56,  105,  105,  105,
-      105,   58,  100,  156,  133,  132,  107,  107,  107,  110,
-      110,  110,  110,   91,  155,  134,  107,  111,  111,  111,
-      111,  107,  127,  154,  153,   56,   56,   56,   56,  133,
-      100,  100,  102,  176,  152,   57,   56,  100,  151,   96,
-
-      149,   56,   92,   92,   98,  150,   58,   96,   91,   91,
-      107,  158,  148,  144,  143,  142,  141,  140,  137,  136,
-      100,  134,   96,  101,  125,  124,  100,  123,  122,  129,
-       56,   60,   60,   60,   60,  121,  120,  119,  118,  117,
-      116,  115,   61,  114,  113,   62,   62,   62,   62,  112,
-      176,  108,   89,   88,   87,   78,   75,   73,  176,   15,
-       15,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  176,  176,  176,  176,   63,   60,
-       60,   60,   60,  176,  176,  176,  176,  176,  176,  176,
-       61,  176,  176,   62,   62,   62,   62,  176,  176,  176,
-
-      176,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  176,  176,   63,   91,   92,  176,
-       92,   92,   92,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,   92,  176,  176,   92,   93,   92,  176,  176,
-      176,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  176,  176,  176,  176,  176,   92,
-      176,   92,   94,   94,   94,   95,   92,  176,   92,   92,
-       92,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-       92,  176,  176,   92,   93,   92,  176,  176,  176,  176,
-
-      176,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  176,  176,  176,   92,  176,   92,
-      104,  104,  104,  104,  176,  176,  176,  176,  176,  133,
-      133,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      133,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  176,  133,   14,   14,   14,   14,
-       14,   14,   14,   14,   14,   36,   36,   36,   36,   36,
-       36,   36,   36,   36,   42,   42,   42,   42,   42,   42,
-       42,   42,   42,   55,   55,   55,   55,   55,   55,   55,
-
-       55,   55,   59,   59,   59,   59,   59,   59,   59,   59,
-       59,   64,   64,   64,   64,   64,   64,  176,   64,   64,
-       67,   67,  176,   67,   67,   67,   67,   67,   70,   70,
-       70,   70,   70,   70,   70,   70,   70,   90,   90,   90,
-       90,   90,  176,   90,   90,   90,   91,   91,   91,   91,
-       91,  176,   91,   91,   91,   97,   97,   97,   97,   97,
-       97,   97,   97,   97,   92,   92,   92,   92,   92,  176,
-       92,   92,   92,  103,  103,  103,  176,  103,  103,  103,
-      106,  106,  106,  106,  106,  106,  106,  176,  106,  107,
-      107,  107,  107,  107,  107,  107,  176,  107,  109,  109,
-
-      109,  109,  176,  109,  109,  176,  109,   98,   98,   98,
-       98,   98,   98,   98,   98,   98,  100,  176,  100,  100,
-      100,  100,  100,  100,  100,  135,  135,  135,  135,  176,
-      135,  135,  176,  135,   13,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176
+       27,   16,   16,   16,   28,   16,   16,   29,   16,   30,
+       31,   32,   33,   16,   34,   16,   16,   35,   16,   36,
+       38,   38,   38,   39,   40,   66,   41,   41,   41,   69,
+       69,   69,   70,   69,   69,   69,   70,   72,   41,   42,
+       90,   41,   91,   41,   70,   70,   70,   70,   96,   67,
+       75,   75,   75,   75,   77,   73,   92,   78,  185,   80,
+      184,  183,   72,   81,   96,   93,   41,  107,   41,   38,
+
+       38,   38,   39,   40,   82,   41,   41,   41,   86,   83,
+       73,  182,   87,  107,   84,  181,  180,   41,   42,   85,
+       41,   96,   41,   88,  100,  100,  100,  100,  109,  109,
+      109,  109,  110,  110,  110,  110,  115,  115,  115,  115,
+      107,   97,   97,  103,  104,   41,  101,   41,   44,   44,
+       44,   45,  127,  179,  146,   46,   47,   48,   49,  105,
+      147,  128,  106,  112,  112,  112,  178,  177,   50,   51,
+      176,   52,  113,  112,  116,  116,  116,  116,  112,   69,
+       69,   69,   70,   70,   70,   70,   70,   75,   75,   75,
+       75,  141,  141,  175,   53,   54,   55,   44,   44,   44,
+
+       45,  135,  141,  101,   46,   47,   48,   49,  112,   95,
+       95,   95,   96,  100,  100,  100,  100,   50,   51,  101,
+       52,   95,   95,   95,   96,  134,  105,  105,  141,  186,
+      174,   97,   97,  103,  104,  101,   96,   96,  173,  136,
+      138,  172,  171,   53,   54,   55,   57,   57,   57,  105,
+       96,  134,  106,  170,  105,   58,   57,  137,  139,  103,
+      134,   57,  110,  110,  110,  110,   59,  169,  167,  107,
+      112,  112,  112,  166,  165,  105,  164,  163,  140,  142,
+      112,  115,  115,  115,  115,  112,  116,  116,  116,  116,
+       96,   57,   57,   57,   57,  154,  155,  156,  135,   96,
+
+      162,   58,   57,   97,   97,  103,  160,   57,  161,  107,
+      101,  101,   59,  105,  158,  112,  159,  157,  107,  153,
+      152,  105,  151,  150,  106,   96,   96,  149,  168,  148,
+      145,  144,  142,  101,  133,  132,  131,   57,   61,   61,
+       61,   61,  130,  105,  129,  126,  137,  125,  124,   62,
+      123,  122,   63,   63,   63,   63,  121,  120,  119,  118,
+      117,  186,  113,   94,   89,   79,   76,   74,  186,   15,
+       15,  186,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,   64,   61,   61,   61,
+       61,  186,  186,  186,  186,  186,  186,  186,   62,  186,
+
+      186,   63,   63,   63,   63,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,   64,   96,   97,  186,   97,
+       97,   97,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,   97,  186,  186,   97,   98,   97,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  186,  186,   97,
+      186,   97,   99,   99,   99,  100,   97,  186,   97,   97,
+       97,  186,  186,  186,  186,  186,  186,  186,  186,  186,
+
+       97,  186,  186,   97,   98,   97,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  186,   97,  186,
+       97,  109,  109,  109,  109,  186,  186,  186,  186,  186,
+      141,  141,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,  141,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  141,   14,   14,
+       14,   14,   14,   14,   14,   14,   14,   37,   37,   37,
+       37,   37,   37,   37,   37,   37,   43,   43,   43,   43,
+
+       43,   43,   43,   43,   43,   56,   56,   56,   56,   56,
+       56,   56,   56,   56,   60,   60,   60,   60,   60,   60,
+       60,   60,   60,   65,   65,   65,   65,   65,   65,  186,
+       65,   65,   68,   68,  186,   68,   68,   68,   68,   68,
+       71,   71,   71,   71,   71,   71,   71,   71,   71,   95,
+       95,   95,   95,   95,  186,   95,   95,   95,   96,   96,
+       96,   96,   96,  186,   96,   96,   96,  102,  102,  102,
+      102,  102,  102,  102,  102,  102,   97,   97,   97,   97,
+       97,  186,   97,   97,   97,  108,  108,  108,  186,  108,
+      108,  108,  111,  111,  111,  111,  111,  111,  111,  186,
+
+      111,  112,  112,  112,  112,  112,  112,  112,  186,  112,
+      114,  114,  114,  114,  186,  114,  114,  186,  114,  103,
+      103,  103,  103,  103,  103,  103,  103,  103,  105,  186,
+      105,  105,  105,  105,  105,  105,  105,  143,  143,  143,
+      143,  186,  143,  143,  186,  143,   13,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186
+
     } ;
 
-static yyconst flex_int16_t yy_chk[785] =
+static yyconst flex_int16_t yy_chk[798] =
     {   0,
         3,    3,    3,    3,    3,    3,    3,    3,    3,    3,
         3,    3,    3,    3,    3,    3,    3,    3,    3,    3,
         3,    3,    3,    3,    3,    3,    3,    3,    3,    3,
         3,    3,    3,    3,    3,    3,    3,    3,    3,    3,
-        3,    3,    3,    3,    3,    3,    3,    3,    3,    5,
-        5,    5,    5,    5,   15,    5,    5,    5,   17,   17,
-       17,   17,   18,   18,   18,   18,   20,    5,    5,  174,
-        5,   40,    5,   19,   19,   19,   19,   15,   23,   23,
-       23,   23,   26,   28,   20,   26,   29,   28,   30,  173,
-       40,   29,   30,  171,    5,   29,    5,    6,    6,    6,
-
-        6,    6,   30,    6,    6,    6,   38,   38,   38,   38,
-      170,   39,   39,   39,   39,    6,    6,  169,    6,  168,
-        6,   43,   43,   43,   43,   70,  166,  165,   38,   39,
-       92,   99,   39,   44,   44,   44,   44,   60,   60,   60,
-       60,  164,    6,   70,    6,    7,    7,    7,    7,   92,
-       99,  161,    7,    7,    7,    7,   62,   62,   62,   62,
-       55,   55,   55,  160,  158,    7,    7,  157,    7,   55,
-       55,   68,   68,   68,   68,   55,   69,   69,   69,   69,
-       74,   74,   74,   74,   90,   90,   90,   90,  156,  155,
-        7,    7,    7,    8,    8,    8,    8,   96,  154,  100,
-
-        8,    8,    8,    8,   55,   93,   93,   93,   93,   93,
-      123,  123,  123,    8,    8,   96,    8,  100,  102,  102,
-      153,  115,   95,   95,   95,   95,  115,   97,   97,   97,
-       97,   98,   98,  151,   98,  142,  126,  102,    8,    8,
-        8,    9,    9,    9,   95,   97,  101,  101,   97,   98,
-        9,    9,   98,  103,  103,  126,    9,  105,  105,  105,
-      105,    9,  101,  141,  103,  101,  106,  106,  106,  110,
-      110,  110,  110,  150,  140,  106,  106,  111,  111,  111,
-      111,  106,  129,  139,  138,    9,   10,   10,   10,  103,
-      131,  131,  150,  131,  137,   10,   10,  129,  136,  128,
-
-      129,   10,  132,  132,  132,  132,   10,  127,  149,  149,
-      106,  149,  124,  120,  119,  118,  117,  116,  114,  113,
-      132,  107,   91,  132,   88,   87,  149,   86,   84,  149,
-       10,   11,   11,   11,   11,   83,   82,   81,   80,   79,
-       78,   77,   11,   76,   75,   11,   11,   11,   11,   73,
-       72,   56,   33,   32,   31,   27,   25,   22,   13,    2,
+        3,    3,    3,    3,    3,    3,    3,    3,    3,    3,
+        5,    5,    5,    5,    5,   15,    5,    5,    5,   17,
+       17,   17,   17,   18,   18,   18,   18,   20,    5,    5,
+       32,    5,   32,    5,   19,   19,   19,   19,   41,   15,
+       23,   23,   23,   23,   26,   20,   33,   26,  184,   28,
+      183,  181,   71,   28,   97,   33,    5,   41,    5,    6,
+
+        6,    6,    6,    6,   28,    6,    6,    6,   30,   29,
+       71,  180,   30,   97,   29,  179,  178,    6,    6,   29,
+        6,  104,    6,   30,   39,   39,   39,   39,   44,   44,
+       44,   44,   45,   45,   45,   45,   61,   61,   61,   61,
+      104,   40,   40,   40,   40,    6,   39,    6,    7,    7,
+        7,    7,   86,  176,  120,    7,    7,    7,    7,   40,
+      120,   86,   40,   56,   56,   56,  175,  174,    7,    7,
+      171,    7,   56,   56,   63,   63,   63,   63,   56,   69,
+       69,   69,   69,   70,   70,   70,   70,   75,   75,   75,
+       75,  108,  108,  170,    7,    7,    7,    8,    8,    8,
+
+        8,  101,  108,  168,    8,    8,    8,    8,   56,   95,
+       95,   95,   95,  100,  100,  100,  100,    8,    8,  101,
+        8,   98,   98,   98,   98,   98,  139,  139,  108,  139,
+      167,  102,  102,  102,  102,  100,  103,  103,  166,  103,
+      105,  165,  164,    8,    8,    8,    9,    9,    9,  102,
+      107,  107,  102,  163,  103,    9,    9,  103,  105,  106,
+      106,    9,  110,  110,  110,  110,    9,  161,  150,  107,
+      111,  111,  111,  149,  148,  106,  147,  146,  106,  111,
+      111,  115,  115,  115,  115,  111,  116,  116,  116,  116,
+      134,    9,   10,   10,   10,  129,  129,  129,  137,  160,
+
+      145,   10,   10,  140,  140,  140,  140,   10,  144,  134,
+      136,  135,   10,  137,  132,  111,  137,  131,  160,  127,
+      125,  140,  124,  123,  140,  159,  159,  122,  159,  121,
+      119,  118,  112,   96,   92,   91,   90,   10,   11,   11,
+       11,   11,   89,  159,   88,   85,  159,   84,   83,   11,
+       81,   80,   11,   11,   11,   11,   79,   78,   77,   76,
+       74,   73,   57,   34,   31,   27,   25,   22,   13,    2,
         1,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-        0,    0,    0,    0,    0,    0,    0,    0,   11,   12,
-       12,   12,   12,    0,    0,    0,    0,    0,    0,    0,
-       12,    0,    0,   12,   12,   12,   12,    0,    0,    0,
+        0,    0,    0,    0,    0,    0,   11,   12,   12,   12,
+       12,    0,    0,    0,    0,    0,    0,    0,   12,    0,
 
+        0,   12,   12,   12,   12,    0,    0,    0,    0,    0,
         0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
         0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-        0,    0,    0,    0,    0,    0,   12,   36,   36,    0,
-       36,   36,   36,    0,    0,    0,    0,    0,    0,    0,
-        0,    0,   36,    0,    0,   36,   36,   36,    0,    0,
+        0,    0,    0,    0,    0,   12,   37,   37,    0,   37,
+       37,   37,    0,    0,    0,    0,    0,    0,    0,    0,
+        0,   37,    0,    0,   37,   37,   37,    0,    0,    0,
         0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-        0,    0,    0,    0,    0,    0,    0,    0,    0,   36,
-        0,   36,   37,   37,   37,   37,   37,    0,   37,   37,
-       37,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-       37,    0,    0,   37,   37,   37,    0,    0,    0,    0,
+        0,    0,    0,    0,    0,    0,    0,    0,    0,   37,
+        0,   37,   38,   38,   38,   38,   38,    0,   38,   38,
+       38,    0,    0,    0,    0,    0,    0,    0,    0,    0,
 
+       38,    0,    0,   38,   38,   38,    0,    0,    0,    0,
         0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-        0,    0,    0,    0,    0,    0,    0,   37,    0,   37,
-      104,  104,  104,  104,    0,    0,    0,    0,    0,  104,
-      104,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-      104,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+        0,    0,    0,    0,    0,    0,    0,    0,   38,    0,
+       38,  109,  109,  109,  109,    0,    0,    0,    0,    0,
+      109,  109,    0,    0,    0,    0,    0,    0,    0,    0,
+        0,  109,    0,    0,    0,    0,    0,    0,    0,    0,
         0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-        0,    0,    0,    0,    0,  104,  177,  177,  177,  177,
-      177,  177,  177,  177,  177,  178,  178,  178,  178,  178,
-      178,  178,  178,  178,  179,  179,  179,  179,  179,  179,
-      179,  179,  179,  180,  180,  180,  180,  180,  180,  180,
-
-      180,  180,  181,  181,  181,  181,  181,  181,  181,  181,
-      181,  182,  182,  182,  182,  182,  182,    0,  182,  182,
-      183,  183,    0,  183,  183,  183,  183,  183,  184,  184,
-      184,  184,  184,  184,  184,  184,  184,  185,  185,  185,
-      185,  185,    0,  185,  185,  185,  186,  186,  186,  186,
-      186,    0,  186,  186,  186,  187,  187,  187,  187,  187,
-      187,  187,  187,  187,  188,  188,  188,  188,  188,    0,
-      188,  188,  188,  189,  189,  189,    0,  189,  189,  189,
-      190,  190,  190,  190,  190,  190,  190,    0,  190,  191,
-      191,  191,  191,  191,  191,  191,    0,  191,  192,  192,
-
-      192,  192,    0,  192,  192,    0,  192,  193,  193,  193,
-      193,  193,  193,  193,  193,  193,  194,    0,  194,  194,
-      194,  194,  194,  194,  194,  195,  195,  195,  195,    0,
-      195,  195,    0,  195,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176,  176,  176,  176,  176,  176,  176,
-      176,  176,  176,  176
+        0,    0,    0,    0,    0,    0,    0,  109,  187,  187,
+      187,  187,  187,  187,  187,  187,  187,  188,  188,  188,
+      188,  188,  188,  188,  188,  188,  189,  189,  189,  189,
+
+      189,  189,  189,  189,  189,  190,  190,  190,  190,  190,
+      190,  190,  190,  190,  191,  191,  191,  191,  191,  191,
+      191,  191,  191,  192,  192,  192,  192,  192,  192,    0,
+      192,  192,  193,  193,    0,  193,  193,  193,  193,  193,
+      194,  194,  194,  194,  194,  194,  194,  194,  194,  195,
+      195,  195,  195,  195,    0,  195,  195,  195,  196,  196,
+      196,  196,  196,    0,  196,  196,  196,  197,  197,  197,
+      197,  197,  197,  197,  197,  197,  198,  198,  198,  198,
+      198,    0,  198,  198,  198,  199,  199,  199,    0,  199,
+      199,  199,  200,  200,  200,  200,  200,  200,  200,    0,
+
+      200,  201,  201,  201,  201,  201,  201,  201,    0,  201,
+      202,  202,  202,  202,    0,  202,  202,    0,  202,  203,
+      203,  203,  203,  203,  203,  203,  203,  203,  204,    0,
+      204,  204,  204,  204,  204,  204,  204,  205,  205,  205,
+      205,    0,  205,  205,    0,  205,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186,  186,  186,  186,
+      186,  186,  186,  186,  186,  186,  186
+
     } ;
 
 static yy_state_type yy_last_accepting_state;
@@ -701,7 +708,7 @@ int transport_expr_lex(void);
 
 
 
-#line 705 "tcpkali_expr_l.c"
+#line 712 "tcpkali_expr_l.c"
 
 #define INITIAL 0
 #define in_expression 1
@@ -901,7 +908,7 @@ YY_DECL
 #line 27 "tcpkali_expr_l.l"
 
 
-#line 905 "tcpkali_expr_l.c"
+#line 912 "tcpkali_expr_l.c"
 
 	if ( !(yy_init) )
 		{
@@ -954,13 +961,13 @@ yy_match:
 			while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 				{
 				yy_current_state = (int) yy_def[yy_current_state];
-				if ( yy_current_state >= 177 )
+				if ( yy_current_state >= 187 )
 					yy_c = yy_meta[(unsigned int) yy_c];
 				}
 			yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
 			++yy_cp;
 			}
-		while ( yy_current_state != 176 );
+		while ( yy_current_state != 186 );
 		yy_cp = (yy_last_accepting_cpos);
 		yy_current_state = (yy_last_accepting_state);
 
@@ -1170,45 +1177,70 @@ return TOK_marker;
 case 28:
 YY_RULE_SETUP
 #line 109 "tcpkali_expr_l.l"
+return TOK_seq;
+	YY_BREAK
+case 29:
+YY_RULE_SETUP
+#line 110 "tcpkali_expr_l.l"
+return TOK_time;
+	YY_BREAK
+case 30:
+YY_RULE_SETUP
+#line 111 "tcpkali_expr_l.l"
+return TOK_ms;
+	YY_BREAK
+case 31:
+YY_RULE_SETUP
+#line 112 "tcpkali_expr_l.l"
+return TOK_us;
+	YY_BREAK
+case 32:
+YY_RULE_SETUP
+#line 113 "tcpkali_expr_l.l"
+return TOK_rand;
+	YY_BREAK
+case 33:
+YY_RULE_SETUP
+#line 114 "tcpkali_expr_l.l"
 {
             yylval.tv_long = atol(yytext);
             return integer;
         }
 	YY_BREAK
-case 29:
+case 34:
 YY_RULE_SETUP
-#line 113 "tcpkali_expr_l.l"
+#line 118 "tcpkali_expr_l.l"
 return '.';
 	YY_BREAK
-case 30:
+case 35:
 YY_RULE_SETUP
-#line 114 "tcpkali_expr_l.l"
+#line 119 "tcpkali_expr_l.l"
 return TOK_ellipsis;
 	YY_BREAK
-case 31:
+case 36:
 YY_RULE_SETUP
-#line 115 "tcpkali_expr_l.l"
+#line 120 "tcpkali_expr_l.l"
 { yylval.tv_long = 0x4; return TOK_ws_reserved_flag; }
 	YY_BREAK
-case 32:
+case 37:
 YY_RULE_SETUP
-#line 116 "tcpkali_expr_l.l"
+#line 121 "tcpkali_expr_l.l"
 { yylval.tv_long = 0x2; return TOK_ws_reserved_flag; }
 	YY_BREAK
-case 33:
+case 38:
 YY_RULE_SETUP
-#line 117 "tcpkali_expr_l.l"
+#line 122 "tcpkali_expr_l.l"
 { yylval.tv_long = 0x1; return TOK_ws_reserved_flag; }
 	YY_BREAK
-case 34:
+case 39:
 YY_RULE_SETUP
-#line 118 "tcpkali_expr_l.l"
+#line 123 "tcpkali_expr_l.l"
 return '%';
 	YY_BREAK
-case 35:
-/* rule 35 can match eol */
+case 40:
+/* rule 40 can match eol */
 YY_RULE_SETUP
-#line 121 "tcpkali_expr_l.l"
+#line 126 "tcpkali_expr_l.l"
 {
                     size_t new_size = yyleng - 2;
                     char *new_str = malloc(new_size + 1);
@@ -1220,10 +1252,10 @@ YY_RULE_SETUP
                     return quoted_string;
                 }
 	YY_BREAK
-case 36:
-/* rule 36 can match eol */
+case 41:
+/* rule 41 can match eol */
 YY_RULE_SETUP
-#line 132 "tcpkali_expr_l.l"
+#line 137 "tcpkali_expr_l.l"
 {
                     fprintf(stderr,
                         "Unexpected token in message expression: %s\n",
@@ -1232,9 +1264,9 @@ YY_RULE_SETUP
                     return -1;
                 }
 	YY_BREAK
-case 37:
+case 42:
 YY_RULE_SETUP
-#line 140 "tcpkali_expr_l.l"
+#line 145 "tcpkali_expr_l.l"
 {
                     fprintf(stderr,
                         "Unexpected token in message expression: %s\n",
@@ -1245,16 +1277,16 @@ YY_RULE_SETUP
 	YY_BREAK
 
 
-case 38:
-/* rule 38 can match eol */
+case 43:
+/* rule 43 can match eol */
 YY_RULE_SETUP
-#line 151 "tcpkali_expr_l.l"
+#line 156 "tcpkali_expr_l.l"
 /* Ignore whitespace */
 	YY_BREAK
-case 39:
-/* rule 39 can match eol */
+case 44:
+/* rule 44 can match eol */
 YY_RULE_SETUP
-#line 152 "tcpkali_expr_l.l"
+#line 157 "tcpkali_expr_l.l"
 {
                 yylval.tv_string.buf = malloc(yyleng + 1);
                 yylval.tv_string.len = yyleng;
@@ -1263,13 +1295,13 @@ YY_RULE_SETUP
                 return string_token;
             }
 	YY_BREAK
-case 40:
-/* rule 40 can match eol */
+case 45:
+/* rule 45 can match eol */
 *yy_cp = (yy_hold_char); /* undo effects of setting up yytext */
 (yy_c_buf_p) = yy_cp -= 2;
 YY_DO_BEFORE_ACTION; /* set up yytext again */
 YY_RULE_SETUP
-#line 159 "tcpkali_expr_l.l"
+#line 164 "tcpkali_expr_l.l"
 {
                 yylval.tv_string.buf = malloc(yyleng + 1);
                 yylval.tv_string.len = yyleng;
@@ -1278,91 +1310,89 @@ YY_RULE_SETUP
                 return string_token;
             }
 	YY_BREAK
-case 41:
+case 46:
 YY_RULE_SETUP
-#line 166 "tcpkali_expr_l.l"
+#line 171 "tcpkali_expr_l.l"
 { return '|'; }
 	YY_BREAK
-case 42:
+case 47:
 YY_RULE_SETUP
-#line 167 "tcpkali_expr_l.l"
+#line 172 "tcpkali_expr_l.l"
 { yy_push_state(in_regex_class); return '['; }
 	YY_BREAK
-case 43:
+case 48:
 YY_RULE_SETUP
-#line 168 "tcpkali_expr_l.l"
+#line 173 "tcpkali_expr_l.l"
 { return ']'; }
 	YY_BREAK
-case 44:
+case 49:
 YY_RULE_SETUP
-#line 169 "tcpkali_expr_l.l"
+#line 174 "tcpkali_expr_l.l"
 { return '('; }
 	YY_BREAK
-case 45:
+case 50:
 YY_RULE_SETUP
-#line 170 "tcpkali_expr_l.l"
+#line 175 "tcpkali_expr_l.l"
 { return ')'; }
 	YY_BREAK
-case 46:
+case 51:
 YY_RULE_SETUP
-#line 171 "tcpkali_expr_l.l"
+#line 176 "tcpkali_expr_l.l"
 { yy_push_state(in_regex_range); return '{'; }
 	YY_BREAK
-case 47:
+case 52:
 YY_RULE_SETUP
-#line 172 "tcpkali_expr_l.l"
+#line 177 "tcpkali_expr_l.l"
 { yy_pop_state(); unput('}'); }
 	YY_BREAK
-case 48:
+case 53:
 YY_RULE_SETUP
-#line 173 "tcpkali_expr_l.l"
+#line 178 "tcpkali_expr_l.l"
 { return '?'; }
 	YY_BREAK
-case 49:
+case 54:
 YY_RULE_SETUP
-#line 174 "tcpkali_expr_l.l"
+#line 179 "tcpkali_expr_l.l"
 { return '+'; }
 	YY_BREAK
-case 50:
+case 55:
 YY_RULE_SETUP
-#line 175 "tcpkali_expr_l.l"
+#line 180 "tcpkali_expr_l.l"
 { return '*'; }
 	YY_BREAK
 
 
-case 51:
-/* rule 51 can match eol */
+case 56:
+/* rule 56 can match eol */
 YY_RULE_SETUP
-#line 180 "tcpkali_expr_l.l"
+#line 185 "tcpkali_expr_l.l"
 {
                 yylval.tv_string.buf = malloc(yyleng + 1);
                 yylval.tv_string.len = yyleng;
                 memcpy(yylval.tv_string.buf, yytext, yyleng);
                 yylval.tv_string.buf[yyleng] = '\0';
-                printf("accept string [%s]\n", yylval.tv_string.buf);
                 return string_token;
             }
 	YY_BREAK
-case 52:
-/* rule 52 can match eol */
+case 57:
+/* rule 57 can match eol */
 *yy_cp = (yy_hold_char); /* undo effects of setting up yytext */
 (yy_c_buf_p) = yy_cp -= 2;
 YY_DO_BEFORE_ACTION; /* set up yytext again */
 YY_RULE_SETUP
-#line 189 "tcpkali_expr_l.l"
+#line 193 "tcpkali_expr_l.l"
 {
                 yylval.tv_string.buf = malloc(yyleng + 1);
                 yylval.tv_string.len = yyleng;
                 memcpy(yylval.tv_string.buf, yytext, yyleng);
                 yylval.tv_string.buf[yyleng] = '\0';
-                printf("accept string [%s]\n", yylval.tv_string.buf);
                 return string_token;
             }
 	YY_BREAK
-case 53:
-/* rule 53 can match eol */
+case 58:
+/* rule 58 can match eol */
 YY_RULE_SETUP
-#line 198 "tcpkali_expr_l.l"
+#line 201 "tcpkali_expr_l.l"
 {
                 assert(yyleng == 3);
                 yylval.tv_class_range.from = yytext[0];
@@ -1370,10 +1400,10 @@ YY_RULE_SETUP
                 return class_range_token;
             }
 	YY_BREAK
-case 54:
-/* rule 54 can match eol */
+case 59:
+/* rule 59 can match eol */
 YY_RULE_SETUP
-#line 205 "tcpkali_expr_l.l"
+#line 208 "tcpkali_expr_l.l"
 {
                 assert(yyleng == 2);
                 yylval.tv_string.buf = malloc(yyleng + 1);
@@ -1383,15 +1413,15 @@ YY_RULE_SETUP
                 return string_token;
             }
 	YY_BREAK
-case 55:
+case 60:
 YY_RULE_SETUP
-#line 214 "tcpkali_expr_l.l"
+#line 217 "tcpkali_expr_l.l"
 { yy_pop_state(); unput(']'); }
 	YY_BREAK
-case 56:
-/* rule 56 can match eol */
+case 61:
+/* rule 61 can match eol */
 YY_RULE_SETUP
-#line 216 "tcpkali_expr_l.l"
+#line 219 "tcpkali_expr_l.l"
 {
                     fprintf(stderr,
                         "Unexpected token in regular expression: %s\n",
@@ -1402,37 +1432,37 @@ YY_RULE_SETUP
 	YY_BREAK
 
 
-case 57:
-/* rule 57 can match eol */
+case 62:
+/* rule 62 can match eol */
 YY_RULE_SETUP
-#line 226 "tcpkali_expr_l.l"
+#line 229 "tcpkali_expr_l.l"
 /* Ignore whitespace */
 	YY_BREAK
-case 58:
+case 63:
 YY_RULE_SETUP
-#line 227 "tcpkali_expr_l.l"
+#line 230 "tcpkali_expr_l.l"
 {
             yylval.tv_long = atol(yytext);
             return integer;
         }
 	YY_BREAK
-case 59:
+case 64:
 YY_RULE_SETUP
-#line 232 "tcpkali_expr_l.l"
+#line 235 "tcpkali_expr_l.l"
 { return ','; }
 	YY_BREAK
-case 60:
+case 65:
 YY_RULE_SETUP
-#line 234 "tcpkali_expr_l.l"
+#line 237 "tcpkali_expr_l.l"
 { yy_pop_state(); return '}'; }
 	YY_BREAK
 
-case 61:
+case 66:
 YY_RULE_SETUP
-#line 237 "tcpkali_expr_l.l"
+#line 240 "tcpkali_expr_l.l"
 YY_FATAL_ERROR( "flex scanner jammed" );
 	YY_BREAK
-#line 1436 "tcpkali_expr_l.c"
+#line 1466 "tcpkali_expr_l.c"
 case YY_STATE_EOF(in_expression):
 case YY_STATE_EOF(in_filename):
 case YY_STATE_EOF(in_regex):
@@ -1729,7 +1759,7 @@ static int yy_get_next_buffer (void)
 		while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 			{
 			yy_current_state = (int) yy_def[yy_current_state];
-			if ( yy_current_state >= 177 )
+			if ( yy_current_state >= 187 )
 				yy_c = yy_meta[(unsigned int) yy_c];
 			}
 		yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
@@ -1757,11 +1787,11 @@ static int yy_get_next_buffer (void)
 	while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 		{
 		yy_current_state = (int) yy_def[yy_current_state];
-		if ( yy_current_state >= 177 )
+		if ( yy_current_state >= 187 )
 			yy_c = yy_meta[(unsigned int) yy_c];
 		}
 	yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
-	yy_is_jam = (yy_current_state == 176);
+	yy_is_jam = (yy_current_state == 186);
 
 	return yy_is_jam ? 0 : yy_current_state;
 }
@@ -2475,7 +2505,7 @@ void yyfree (void * ptr )
 
 #define YYTABLES_NAME "yytables"
 
-#line 237 "tcpkali_expr_l.l"
+#line 240 "tcpkali_expr_l.l"
 
 
 
@@ -127,13 +127,18 @@ extern int yydebug;
     TOK_uid = 266,
     TOK_regex = 267,
     TOK_marker = 268,
-    TOK_ellipsis = 269,
-    string_token = 270,
-    class_range_token = 271,
-    repeat_range_token = 272,
-    quoted_string = 273,
-    filename = 274,
-    integer = 275
+    TOK_seq = 269,
+    TOK_time = 270,
+    TOK_ms = 271,
+    TOK_us = 272,
+    TOK_rand = 273,
+    TOK_ellipsis = 274,
+    string_token = 275,
+    class_range_token = 276,
+    repeat_range_token = 277,
+    quoted_string = 278,
+    filename = 279,
+    integer = 280
   };
 #endif
 /* Tokens.  */
@@ -149,13 +154,18 @@ extern int yydebug;
 #define TOK_uid 266
 #define TOK_regex 267
 #define TOK_marker 268
-#define TOK_ellipsis 269
-#define string_token 270
-#define class_range_token 271
-#define repeat_range_token 272
-#define quoted_string 273
-#define filename 274
-#define integer 275
+#define TOK_seq 269
+#define TOK_time 270
+#define TOK_ms 271
+#define TOK_us 272
+#define TOK_rand 273
+#define TOK_ellipsis 274
+#define string_token 275
+#define class_range_token 276
+#define repeat_range_token 277
+#define quoted_string 278
+#define filename 279
+#define integer 280
 
 /* Value type.  */
 #if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
@@ -182,7 +192,7 @@ union YYSTYPE
     enum ws_frame_opcode tv_opcode;
     char  tv_char;
 
-#line 186 "tcpkali_expr_y.c" /* yacc.c:355  */
+#line 196 "tcpkali_expr_y.c" /* yacc.c:355  */
 };
 
 typedef union YYSTYPE YYSTYPE;
@@ -199,7 +209,7 @@ int yyparse (tk_expr_t **param);
 
 /* Copy the second part of user declarations.  */
 
-#line 203 "tcpkali_expr_y.c" /* yacc.c:358  */
+#line 213 "tcpkali_expr_y.c" /* yacc.c:358  */
 
 #ifdef short
 # undef short
@@ -439,23 +449,23 @@ union yyalloc
 #endif /* !YYCOPY_NEEDED */
 
 /* YYFINAL -- State number of the termination state.  */
-#define YYFINAL  22
+#define YYFINAL  24
 /* YYLAST -- Last index in YYTABLE.  */
-#define YYLAST   78
+#define YYLAST   91
 
 /* YYNTOKENS -- Number of terminals.  */
-#define YYNTOKENS  39
+#define YYNTOKENS  44
 /* YYNNTS -- Number of nonterminals.  */
 #define YYNNTS  20
 /* YYNRULES -- Number of rules.  */
-#define YYNRULES  49
+#define YYNRULES  54
 /* YYNSTATES -- Number of states.  */
-#define YYNSTATES  81
+#define YYNSTATES  92
 
 /* YYTRANSLATE[YYX] -- Symbol number corresponding to YYX as returned
    by yylex, with out-of-bounds checking.  */
 #define YYUNDEFTOK  2
-#define YYMAXUTOK   278
+#define YYMAXUTOK   283
 
 #define YYTRANSLATE(YYX)                                                \
   ((unsigned int) (YYX) <= YYMAXUTOK ? yytranslate[YYX] : YYUNDEFTOK)
@@ -467,16 +477,16 @@ static const yytype_uint8 yytranslate[] =
        0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,    28,     2,     2,
-      37,    38,    33,    32,    34,     2,    27,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,    33,     2,     2,
+      42,    43,    38,    37,    39,     2,    32,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-      29,     2,    30,    31,     2,     2,     2,     2,     2,     2,
+      34,     2,    35,    36,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,    35,     2,    36,     2,     2,     2,     2,     2,     2,
+       2,    40,     2,    41,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,    25,    21,    26,     2,     2,     2,     2,
+       2,     2,     2,    30,    26,    31,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
@@ -491,18 +501,20 @@ static const yytype_uint8 yytranslate[] =
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
        5,     6,     7,     8,     9,    10,    11,    12,    13,    14,
-      15,    16,    17,    18,    19,    20,    22,    23,    24
+      15,    16,    17,    18,    19,    20,    21,    22,    23,    24,
+      25,    27,    28,    29
 };
 
 #if YYDEBUG
   /* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
 static const yytype_uint16 yyrline[] =
 {
-       0,    75,    75,    81,    87,    90,    95,    96,   107,   116,
-     119,   123,   126,   134,   137,   148,   155,   166,   174,   184,
-     192,   198,   204,   212,   214,   219,   225,   227,   243,   251,
-     251,   254,   274,   277,   280,   285,   286,   291,   292,   293,
-     294,   295,   296,   299,   302,   305,   310,   311,   316,   319
+       0,    80,    80,    86,    92,    95,   100,   101,   112,   121,
+     124,   128,   131,   139,   142,   153,   160,   171,   179,   189,
+     197,   203,   209,   215,   221,   227,   233,   239,   253,   255,
+     260,   266,   268,   284,   292,   292,   295,   315,   318,   321,
+     326,   327,   332,   333,   334,   335,   336,   337,   340,   343,
+     346,   351,   352,   357,   360
 };
 #endif
 
@@ -514,17 +526,19 @@ static const char *const yytname[] =
   "\"end of expression\"", "error", "$undefined", "\"ws\"", "\"raw\"",
   "\"text, binary, close, ping, pong, continuation\"",
   "\"rsv1, rsv2, rsv3\"", "\"global\"", "\"connection\"", "\"message\"",
-  "\" ptr\"", "\"uid\"", "\"re\"", "\"marker\"", "\"...\"",
-  "\"arbitrary string\"", "\"regex character class range\"",
-  "\"regex repeat spec\"", "\"quoted string\"", "\"file name\"", "integer",
-  "'|'", "\"some string or \\\\{expression}\"", "\"data and expressions\"",
-  "\"connection, global, re, or <filename.ext>\"", "'{'", "'}'", "'.'",
-  "'%'", "'<'", "'>'", "'?'", "'+'", "'*'", "','", "'['", "']'", "'('",
-  "')'", "$accept", "Grammar", "ByteSequencesAndExpressions", "String",
-  "ByteSequenceOrExpr", "WSExpression", "NonWSExpression", "NumericExpr",
-  "WSFrameFinalized", "WSFrameWithData", "WSBasicFrame", "FileOrQuoted",
-  "File", "CompleteRegex", "RegexAlternatives", "RegexSequence",
-  "RepeatedRegex", "RegexPiece", "RegexClasses", "RegexClass", YY_NULLPTR
+  "\" ptr\"", "\"uid\"", "\"re\"", "\"marker\"", "\"seq\"", "\"time\"",
+  "\"ms\"", "\"us\"", "\"rand\"", "\"...\"", "\"arbitrary string\"",
+  "\"regex character class range\"", "\"regex repeat spec\"",
+  "\"quoted string\"", "\"file name\"", "integer", "'|'",
+  "\"some string or \\\\{expression}\"", "\"data and expressions\"",
+  "\"connection, message, global, time, rand, re, or <filename.ext>\"",
+  "'{'", "'}'", "'.'", "'%'", "'<'", "'>'", "'?'", "'+'", "'*'", "','",
+  "'['", "']'", "'('", "')'", "$accept", "Grammar",
+  "ByteSequencesAndExpressions", "String", "ByteSequenceOrExpr",
+  "WSExpression", "NonWSExpression", "NumericExpr", "WSFrameFinalized",
+  "WSFrameWithData", "WSBasicFrame", "FileOrQuoted", "File",
+  "CompleteRegex", "RegexAlternatives", "RegexSequence", "RepeatedRegex",
+  "RegexPiece", "RegexClasses", "RegexClass", YY_NULLPTR
 };
 #endif
 
@@ -535,15 +549,16 @@ static const yytype_uint16 yytoknum[] =
 {
        0,   256,   257,   258,   259,   260,   261,   262,   263,   264,
      265,   266,   267,   268,   269,   270,   271,   272,   273,   274,
-     275,   124,   276,   277,   278,   123,   125,    46,    37,    60,
-      62,    63,    43,    42,    44,    91,    93,    40,    41
+     275,   276,   277,   278,   279,   280,   124,   281,   282,   283,
+     123,   125,    46,    37,    60,    62,    63,    43,    42,    44,
+      91,    93,    40,    41
 };
 # endif
 
-#define YYPACT_NINF -40
+#define YYPACT_NINF -42
 
 #define yypact_value_is_default(Yystate) \
-  (!!((Yystate) == (-40)))
+  (!!((Yystate) == (-42)))
 
 #define YYTABLE_NINF -1
 
@@ -554,15 +569,16 @@ static const yytype_uint16 yytoknum[] =
      STATE-NUM.  */
 static const yytype_int8 yypact[] =
 {
-       3,   -40,   -40,    -2,    23,    41,    28,     5,    27,    13,
-      29,    31,    32,   -11,    38,    34,    35,    37,    39,    11,
-     -40,   -40,   -40,   -40,   -40,   -40,    50,   -40,     4,   -40,
-     -40,    51,    36,    49,   -40,     6,   -11,   -40,    43,   -11,
-     -40,    19,    40,   -40,   -40,    46,   -40,   -40,   -40,   -40,
-      42,   -11,   -40,   -40,   -11,   -40,   -40,    28,    -1,   -40,
-      33,   -11,   -40,    47,   -40,   -40,   -40,   -40,   -40,   -40,
-     -40,   -40,   -40,   -40,   -40,   -11,    -9,   -40,    52,    48,
-     -40
+       3,   -42,   -42,    -2,    12,    26,    36,     0,    32,    11,
+      33,    34,    35,    -5,    37,    47,    44,    42,    48,    38,
+       5,    13,   -42,   -42,   -42,   -42,   -42,   -42,    65,   -42,
+      10,   -42,   -42,    43,    39,    45,   -42,    40,    -5,   -42,
+      49,    -5,   -42,    16,    46,    50,    41,   -42,   -42,    52,
+     -42,   -42,   -42,   -42,    53,    -5,   -42,   -42,   -42,    -5,
+     -42,   -42,   -42,    36,   -12,   -42,    31,    -5,   -42,    55,
+     -42,   -42,   -42,   -42,   -42,    51,   -42,   -42,   -42,   -42,
+     -42,   -42,   -42,   -42,    -5,     9,    56,   -42,    60,   -42,
+      57,   -42
 };
 
   /* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
@@ -571,28 +587,29 @@ static const yytype_int8 yypact[] =
 static const yytype_uint8 yydefact[] =
 {
        0,     2,     6,     0,     0,     0,     8,     4,     0,     0,
-       0,     0,     0,     0,     0,     0,     0,    13,    11,    23,
-      26,    12,     1,     3,     7,     5,     0,    29,     0,    14,
-      30,     0,     0,     0,    43,     0,     0,    18,    32,    33,
-      35,    37,     0,     9,    10,     0,    25,    24,    27,    28,
-       0,     0,    20,    21,     0,    22,    49,    48,     0,    46,
-       0,     0,    36,     0,    38,    39,    40,    31,    19,    15,
-      16,    17,    44,    47,    45,    34,     0,    41,     0,     0,
-      42
+       0,     0,     0,     0,     0,     0,     0,     0,     0,    13,
+      11,    28,    31,    12,     1,     3,     7,     5,     0,    34,
+       0,    14,    35,     0,     0,     0,    48,     0,     0,    18,
+      37,    38,    40,    42,     0,     0,     0,     9,    10,     0,
+      30,    29,    32,    33,     0,     0,    24,    20,    21,     0,
+      22,    23,    54,    53,     0,    51,     0,     0,    41,     0,
+      43,    44,    45,    25,    26,     0,    36,    19,    15,    16,
+      17,    49,    52,    50,    39,     0,     0,    46,     0,    27,
+       0,    47
 };
 
   /* YYPGOTO[NTERM-NUM].  */
 static const yytype_int8 yypgoto[] =
 {
-     -40,   -40,    62,   -26,   -40,   -40,    45,   -40,   -40,   -40,
-     -40,    56,    30,   -17,   -40,    15,   -39,   -40,   -40,    20
+     -42,   -42,    71,   -33,   -42,   -42,    59,   -42,   -42,   -42,
+     -42,    66,    18,   -17,   -42,    19,   -41,   -42,   -42,    27
 };
 
   /* YYDEFGOTO[NTERM-NUM].  */
 static const yytype_int8 yydefgoto[] =
 {
-      -1,     4,     5,     6,     7,    15,    16,    17,    18,    19,
-      20,    29,    21,    37,    38,    39,    40,    41,    58,    59
+      -1,     4,     5,     6,     7,    17,    18,    19,    20,    21,
+      22,    31,    23,    39,    40,    41,    42,    43,    64,    65
 };
 
   /* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
@@ -600,51 +617,57 @@ static const yytype_int8 yydefgoto[] =
      number is the opposite.  If YYTABLE_NINF, syntax error.  */
 static const yytype_uint8 yytable[] =
 {
-      62,     8,     9,     1,    34,    10,    11,    12,     9,    57,
-      13,    10,    11,    12,     2,    56,    13,    77,     2,    60,
-       2,     2,    56,    22,    35,    78,    36,    14,     3,    27,
-       3,    27,    57,    14,    70,    72,    62,    71,    28,    30,
-      14,    23,    14,    24,    63,    46,    52,    53,    54,    30,
-      64,    65,    66,    47,    26,    49,    31,    42,    32,    33,
-      43,    44,    55,    51,    61,    45,    68,    76,    69,    25,
-      67,    74,    79,    50,    80,    48,    75,     0,    73
+      68,     8,     9,     1,    63,    10,    11,    12,     2,    62,
+      13,    50,    24,    14,     9,    36,    15,    10,    11,    12,
+       2,    66,    13,     2,    51,    14,    25,    32,    15,    81,
+       3,    63,    16,     3,    29,    37,    29,    38,    79,    32,
+      87,    30,    80,    68,    16,    16,    69,    16,    88,    57,
+      58,    59,    70,    71,    72,    55,    26,    56,    60,    61,
+       2,    62,    73,    74,    28,    33,    34,    35,    46,    44,
+      53,    49,    45,    47,    83,    67,    76,    77,    27,    48,
+      85,    89,    75,    86,    78,    90,    84,    52,    91,    54,
+       0,    82
 };
 
 static const yytype_int8 yycheck[] =
 {
-      39,     3,     4,     0,    15,     7,     8,     9,     4,    35,
-      12,     7,     8,     9,    15,    16,    12,    26,    15,    36,
-      15,    15,    16,     0,    35,    34,    37,    29,    25,    18,
-      25,    18,    58,    29,    51,    36,    75,    54,    25,     9,
-      29,     0,    29,    15,    25,     6,    10,    11,    12,    19,
-      31,    32,    33,    14,    27,     5,    27,    19,    27,    27,
-      26,    26,    13,    12,    21,    28,    20,    20,    26,     7,
-      30,    38,    20,    28,    26,    19,    61,    -1,    58
+      41,     3,     4,     0,    37,     7,     8,     9,    20,    21,
+      12,     6,     0,    15,     4,    20,    18,     7,     8,     9,
+      20,    38,    12,    20,    19,    15,     0,     9,    18,    41,
+      30,    64,    34,    30,    23,    40,    23,    42,    55,    21,
+      31,    30,    59,    84,    34,    34,    30,    34,    39,    10,
+      11,    12,    36,    37,    38,    12,    20,    14,    13,    14,
+      20,    21,    16,    17,    32,    32,    32,    32,    24,    32,
+       5,    33,    25,    31,    43,    26,    35,    25,     7,    31,
+      25,    25,    32,    32,    31,    25,    67,    21,    31,    30,
+      -1,    64
 };
 
   /* YYSTOS[STATE-NUM] -- The (internal number of the) accessing
      symbol of state STATE-NUM.  */
 static const yytype_uint8 yystos[] =
 {
-       0,     0,    15,    25,    40,    41,    42,    43,     3,     4,
-       7,     8,     9,    12,    29,    44,    45,    46,    47,    48,
-      49,    51,     0,     0,    15,    41,    27,    18,    25,    50,
-      51,    27,    27,    27,    15,    35,    37,    52,    53,    54,
-      55,    56,    19,    26,    26,    28,     6,    14,    50,     5,
-      45,    12,    10,    11,    12,    13,    16,    42,    57,    58,
-      52,    21,    55,    25,    31,    32,    33,    30,    20,    26,
-      52,    52,    36,    58,    38,    54,    20,    26,    34,    20,
-      26
+       0,     0,    20,    30,    45,    46,    47,    48,     3,     4,
+       7,     8,     9,    12,    15,    18,    34,    49,    50,    51,
+      52,    53,    54,    56,     0,     0,    20,    46,    32,    23,
+      30,    55,    56,    32,    32,    32,    20,    40,    42,    57,
+      58,    59,    60,    61,    32,    25,    24,    31,    31,    33,
+       6,    19,    55,     5,    50,    12,    14,    10,    11,    12,
+      13,    14,    21,    47,    62,    63,    57,    26,    60,    30,
+      36,    37,    38,    16,    17,    32,    35,    25,    31,    57,
+      57,    41,    63,    43,    59,    25,    32,    31,    39,    25,
+      25,    31
 };
 
   /* YYR1[YYN] -- Symbol number of symbol that rule YYN derives.  */
 static const yytype_uint8 yyr1[] =
 {
-       0,    39,    40,    40,    41,    41,    42,    42,    43,    43,
-      43,    44,    45,    45,    45,    45,    45,    45,    45,    46,
-      46,    46,    46,    47,    47,    47,    48,    48,    49,    50,
-      50,    51,    52,    53,    53,    54,    54,    55,    55,    55,
-      55,    55,    55,    56,    56,    56,    57,    57,    58,    58
+       0,    44,    45,    45,    46,    46,    47,    47,    48,    48,
+      48,    49,    50,    50,    50,    50,    50,    50,    50,    51,
+      51,    51,    51,    51,    51,    51,    51,    51,    52,    52,
+      52,    53,    53,    54,    55,    55,    56,    57,    58,    58,
+      59,    59,    60,    60,    60,    60,    60,    60,    61,    61,
+      61,    62,    62,    63,    63
 };
 
   /* YYR2[YYN] -- Number of symbols on the right hand side of rule YYN.  */
@@ -652,9 +675,10 @@ static const yytype_uint8 yyr2[] =
 {
        0,     2,     1,     2,     1,     2,     1,     2,     1,     3,
        3,     1,     1,     1,     2,     4,     4,     4,     2,     3,
-       3,     3,     3,     1,     2,     2,     1,     2,     3,     1,
-       1,     3,     1,     1,     3,     1,     2,     1,     2,     2,
-       2,     4,     6,     1,     3,     3,     1,     2,     1,     1
+       3,     3,     3,     3,     3,     3,     3,     5,     1,     2,
+       2,     1,     2,     3,     1,     1,     3,     1,     1,     3,
+       1,     2,     1,     2,     2,     2,     4,     6,     1,     3,
+       3,     1,     2,     1,     1
 };
 
 
@@ -1333,43 +1357,43 @@ yyreduce:
   switch (yyn)
     {
         case 2:
-#line 75 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 80 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         tk_expr_t *expr = calloc(1, sizeof(tk_expr_t));
         expr->type = EXPR_DATA;
         *(tk_expr_t **)param = expr;
         return 0;
     }
-#line 1344 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1368 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 3:
-#line 81 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 86 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         *(tk_expr_t **)param = (yyvsp[-1].tv_expr);
         return 0;
     }
-#line 1353 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1377 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 4:
-#line 87 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 92 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_expr) = (yyvsp[0].tv_expr);
     }
-#line 1361 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1385 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 5:
-#line 90 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 95 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_expr) = concat_expressions((yyvsp[-1].tv_expr), (yyvsp[0].tv_expr));
     }
-#line 1369 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1393 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 7:
-#line 96 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 101 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         size_t len = (((yyvsp[-1].tv_string)).len + ((yyvsp[0].tv_string)).len);
         char *p = malloc(len + 1);
@@ -1379,11 +1403,11 @@ yyreduce:
         (yyval.tv_string).buf = p;
         (yyval.tv_string).len = len;
     }
-#line 1383 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1407 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 8:
-#line 107 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 112 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         /* If there's nothing to parse, don't return anything */
         tk_expr_t *expr = calloc(1, sizeof(tk_expr_t));
@@ -1393,27 +1417,27 @@ yyreduce:
         expr->estimate_size = ((yyvsp[0].tv_string)).len;
         (yyval.tv_expr) = expr;
     }
-#line 1397 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1421 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 9:
-#line 116 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 121 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_expr) = (yyvsp[-1].tv_expr);
     }
-#line 1405 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1429 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 10:
-#line 119 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 124 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_expr) = (yyvsp[-1].tv_expr);
     }
-#line 1413 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1437 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 12:
-#line 126 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 131 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {    /* \{<filename.txt>} */
         tk_expr_t *expr = calloc(1, sizeof(tk_expr_t));
         expr->type = EXPR_DATA;
@@ -1422,19 +1446,19 @@ yyreduce:
         expr->estimate_size = ((yyvsp[0].tv_string)).len;
         (yyval.tv_expr) = expr;
     }
-#line 1426 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1450 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 13:
-#line 134 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 139 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_expr) = (yyvsp[0].tv_expr);
     }
-#line 1434 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1458 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 14:
-#line 137 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 142 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         tk_expr_t *expr = calloc(1, sizeof(tk_expr_t));
         expr->type = EXPR_DATA;
@@ -1446,11 +1470,11 @@ yyreduce:
         (yyval.tv_expr)->u.raw.expr = expr;
         (yyval.tv_expr)->estimate_size = expr->estimate_size;
     }
-#line 1450 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1474 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 15:
-#line 148 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 153 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_expr) = calloc(1, sizeof(tk_expr_t));
         (yyval.tv_expr)->type = EXPR_RAW;
@@ -1458,11 +1482,11 @@ yyreduce:
         (yyval.tv_expr)->estimate_size = (yyvsp[-1].tv_expr)->estimate_size;
         (yyval.tv_expr)->dynamic_scope = (yyvsp[-1].tv_expr)->dynamic_scope;
     }
-#line 1462 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1486 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 16:
-#line 155 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 160 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         tk_expr_t *expr = calloc(1, sizeof(tk_expr_t));
         expr->type = EXPR_DATA;
@@ -1474,11 +1498,11 @@ yyreduce:
         tregex_free((yyvsp[0].tv_regex));
         (yyval.tv_expr) = expr;
     }
-#line 1478 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1502 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 17:
-#line 166 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 171 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         tk_expr_t *expr = calloc(1, sizeof(tk_expr_t));
         expr->type = EXPR_REGEX;
@@ -1487,11 +1511,11 @@ yyreduce:
         expr->dynamic_scope = DS_PER_CONNECTION;
         (yyval.tv_expr) = expr;
     }
-#line 1491 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1515 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 18:
-#line 174 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 179 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         tk_expr_t *expr = calloc(1, sizeof(tk_expr_t));
         expr->type = EXPR_REGEX;
@@ -1500,11 +1524,11 @@ yyreduce:
         expr->dynamic_scope = DS_PER_MESSAGE;
         (yyval.tv_expr) = expr;
     }
-#line 1504 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1528 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 19:
-#line 184 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 189 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_expr) = calloc(1, sizeof(*((yyval.tv_expr))));
         (yyval.tv_expr)->type = EXPR_MODULO;
@@ -1513,62 +1537,123 @@ yyreduce:
         (yyval.tv_expr)->estimate_size = (yyvsp[-2].tv_expr)->estimate_size;
         (yyval.tv_expr)->dynamic_scope = (yyvsp[-2].tv_expr)->dynamic_scope;
     }
-#line 1517 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1541 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 20:
-#line 192 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 197 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_expr) = calloc(1, sizeof(*((yyval.tv_expr))));
         (yyval.tv_expr)->type = EXPR_CONNECTION_PTR;
         (yyval.tv_expr)->estimate_size = sizeof("100000000000000");
         (yyval.tv_expr)->dynamic_scope = DS_PER_CONNECTION;
     }
-#line 1528 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1552 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 21:
-#line 198 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 203 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_expr) = calloc(1, sizeof(*((yyval.tv_expr))));
         (yyval.tv_expr)->type = EXPR_CONNECTION_UID;
         (yyval.tv_expr)->estimate_size = sizeof("100000000000000");
         (yyval.tv_expr)->dynamic_scope = DS_PER_CONNECTION;
     }
-#line 1539 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1563 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 22:
-#line 204 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 209 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_expr) = calloc(1, sizeof(*((yyval.tv_expr))));
         (yyval.tv_expr)->type = EXPR_MESSAGE_MARKER;
         (yyval.tv_expr)->estimate_size = sizeof("1000000000000" "1000000000000000" "!") - 1;
         (yyval.tv_expr)->dynamic_scope = DS_PER_MESSAGE;
     }
-#line 1550 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1574 "tcpkali_expr_y.c" /* yacc.c:1661  */
+    break;
+
+  case 23:
+#line 215 "tcpkali_expr_y.y" /* yacc.c:1661  */
+    {
+        (yyval.tv_expr) = calloc(1, sizeof(*((yyval.tv_expr))));
+        (yyval.tv_expr)->type = EXPR_MESSAGE_SEQ;
+        (yyval.tv_expr)->estimate_size = EXPR_SEQ_WIDTH;
+        (yyval.tv_expr)->dynamic_scope = DS_PER_MESSAGE;
+    }
+#line 1585 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
   case 24:
-#line 214 "tcpkali_expr_y.y" /* yacc.c:1661  */
+#line 221 "tcpkali_expr_y.y" /* yacc.c:1661  */
+    {
+        (yyval.tv_expr) = calloc(1, sizeof(*((yyval.tv_expr))));
+        (yyval.tv_expr)->type = EXPR_GLOBAL_SEQ;
+        (yyval.tv_expr)->estimate_size = EXPR_SEQ_WIDTH;
+        (yyval.tv_expr)->dynamic_scope = DS_PER_MESSAGE;
+    }
+#line 1596 "tcpkali_expr_y.c" /* yacc.c:1661  */
+    break;
+
+  case 25:
+#line 227 "tcpkali_expr_y.y" /* yacc.c:1661  */
+    {
+        (yyval.tv_expr) = calloc(1, sizeof(*((yyval.tv_expr))));
+        (yyval.tv_expr)->type = EXPR_TIME_MS;
+        (yyval.tv_expr)->estimate_size = EXPR_TIME_MS_WIDTH;
+        (yyval.tv_expr)->dynamic_scope = DS_PER_MESSAGE;
+    }
+#line 1607 "tcpkali_expr_y.c" /* yacc.c:1661  */
+    break;
+
+  case 26:
+#line 233 "tcpkali_expr_y.y" /* yacc.c:1661  */
+    {
+        (yyval.tv_expr) = calloc(1, sizeof(*((yyval.tv_expr))));
+        (yyval.tv_expr)->type = EXPR_TIME_US;
+        (yyval.tv_expr)->estimate_size = EXPR_TIME_US_WIDTH;
+        (yyval.tv_expr)->dynamic_scope = DS_PER_MESSAGE;
+    }
+#line 1618 "tcpkali_expr_y.c" /* yacc.c:1661  */
+    break;
+
+  case 27:
+#line 239 "tcpkali_expr_y.y" /* yacc.c:1661  */
+    {
+        long from = (yyvsp[-3].tv_long) < (yyvsp[0].tv_long) ? (yyvsp[-3].tv_long) : (yyvsp[0].tv_long);
+        long to = (yyvsp[-3].tv_long) < (yyvsp[0].tv_long) ? (yyvsp[0].tv_long) : (yyvsp[-3].tv_long);
+        (yyval.tv_expr) = calloc(1, sizeof(*((yyval.tv_expr))));
+        (yyval.tv_expr)->type = EXPR_RAND;
+        (yyval.tv_expr)->u.rand.from = from;
+        (yyval.tv_expr)->u.rand.range = (to - from) + 1;
+        /* Zero-padded to the width of the upper bound. */
+        (yyval.tv_expr)->estimate_size = 1;
+        for(; to >= 10; to /= 10) (yyval.tv_expr)->estimate_size++;
+        (yyval.tv_expr)->dynamic_scope = DS_PER_MESSAGE;
+    }
+#line 1635 "tcpkali_expr_y.c" /* yacc.c:1661  */
+    break;
+
+  case 29:
+#line 255 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_expr) = (yyvsp[-1].tv_expr);
         (yyval.tv_expr)->u.ws_frame.fin = 0; /* Expect continuation. */
     }
-#line 1559 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1644 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 25:
-#line 219 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 30:
+#line 260 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_expr) = (yyvsp[-1].tv_expr);
         (yyval.tv_expr)->u.ws_frame.rsvs |= (yyvsp[0].tv_long);
     }
-#line 1568 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1653 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 27:
-#line 227 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 32:
+#line 268 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_expr) = (yyvsp[-1].tv_expr);
         /* Combine old data with new data. */
@@ -1583,11 +1668,11 @@ yyreduce:
         (yyval.tv_expr)->u.ws_frame.size = total_size;
         (yyval.tv_expr)->estimate_size += ((yyvsp[0].tv_string)).len;
     }
-#line 1587 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1672 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 28:
-#line 243 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 33:
+#line 284 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_expr) = calloc(1, sizeof(*((yyval.tv_expr))));
         (yyval.tv_expr)->type = EXPR_WS_FRAME;
@@ -1595,11 +1680,11 @@ yyreduce:
         (yyval.tv_expr)->u.ws_frame.fin = 1; /* Complete frame */
         (yyval.tv_expr)->estimate_size = WEBSOCKET_MAX_FRAME_HDR_SIZE;
     }
-#line 1599 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1684 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 31:
-#line 254 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 36:
+#line 295 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         const char *name = (yyvsp[-1].tv_string).buf;
         FILE *fp = fopen(name, "r");
@@ -1618,113 +1703,113 @@ yyreduce:
         fclose(fp);
         (yyval.tv_string).buf[(yyval.tv_string).len] = '\0';
     }
-#line 1622 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1707 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 33:
-#line 277 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 38:
+#line 318 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_regex) = tregex_alternative((yyvsp[0].tv_regex));
     }
-#line 1630 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1715 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 34:
-#line 280 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 39:
+#line 321 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_regex) = tregex_alternative_add((yyvsp[-2].tv_regex), (yyvsp[0].tv_regex));
     }
-#line 1638 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1723 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 36:
-#line 286 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 41:
+#line 327 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_regex) = tregex_join((yyvsp[-1].tv_regex), (yyvsp[0].tv_regex));
     }
-#line 1646 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1731 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 38:
-#line 292 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 43:
+#line 333 "tcpkali_expr_y.y" /* yacc.c:1661  */
     { (yyval.tv_regex) = tregex_repeat((yyvsp[-1].tv_regex), 0, 1); }
-#line 1652 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1737 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 39:
-#line 293 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 44:
+#line 334 "tcpkali_expr_y.y" /* yacc.c:1661  */
     { (yyval.tv_regex) = tregex_repeat((yyvsp[-1].tv_regex), 1, 16); }
-#line 1658 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1743 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 40:
-#line 294 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 45:
+#line 335 "tcpkali_expr_y.y" /* yacc.c:1661  */
     { (yyval.tv_regex) = tregex_repeat((yyvsp[-1].tv_regex), 0, 16); }
-#line 1664 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1749 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 41:
-#line 295 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 46:
+#line 336 "tcpkali_expr_y.y" /* yacc.c:1661  */
     { (yyval.tv_regex) = tregex_repeat((yyvsp[-3].tv_regex), (yyvsp[-1].tv_long), (yyvsp[-1].tv_long)); }
-#line 1670 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1755 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 42:
-#line 296 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 47:
+#line 337 "tcpkali_expr_y.y" /* yacc.c:1661  */
     { (yyval.tv_regex) = tregex_repeat((yyvsp[-5].tv_regex), (yyvsp[-3].tv_long), (yyvsp[-1].tv_long)); }
-#line 1676 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1761 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 43:
-#line 299 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 48:
+#line 340 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_regex) = tregex_string((yyvsp[0].tv_string).buf, (yyvsp[0].tv_string).len);
     }
-#line 1684 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1769 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 44:
-#line 302 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 49:
+#line 343 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_regex) = (yyvsp[-1].tv_regex);
     }
-#line 1692 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1777 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 45:
-#line 305 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 50:
+#line 346 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_regex) = (yyvsp[-1].tv_regex);
     }
-#line 1700 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1785 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 47:
-#line 311 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 52:
+#line 352 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_regex) = tregex_union_ranges((yyvsp[-1].tv_regex), (yyvsp[0].tv_regex));
     }
-#line 1708 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1793 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 48:
-#line 316 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 53:
+#line 357 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_regex) = tregex_range_from_string((yyvsp[0].tv_string).buf, (yyvsp[0].tv_string).len);
     }
-#line 1716 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1801 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
-  case 49:
-#line 319 "tcpkali_expr_y.y" /* yacc.c:1661  */
+  case 54:
+#line 360 "tcpkali_expr_y.y" /* yacc.c:1661  */
     {
         (yyval.tv_regex) = tregex_range((yyvsp[0].tv_class_range).from, (yyvsp[0].tv_class_range).to);
     }
-#line 1724 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1809 "tcpkali_expr_y.c" /* yacc.c:1661  */
     break;
 
 
-#line 1728 "tcpkali_expr_y.c" /* yacc.c:1661  */
+#line 1813 "tcpkali_expr_y.c" /* yacc.c:1661  */
       default: break;
     }
   /* User semantic actions sometimes alter yychar, and that requires
@@ -1952,7 +2037,7 @@ yyreturn:
 #endif
   return yyresult;
 }
-#line 323 "tcpkali_expr_y.y" /* yacc.c:1906  */
+#line 364 "tcpkali_expr_y.y" /* yacc.c:1906  */
 
 
 int
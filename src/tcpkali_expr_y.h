@@ -57,13 +57,18 @@ extern int yydebug;
     TOK_uid = 266,
     TOK_regex = 267,
     TOK_marker = 268,
-    TOK_ellipsis = 269,
-    string_token = 270,
-    class_range_token = 271,
-    repeat_range_token = 272,
-    quoted_string = 273,
-    filename = 274,
-    integer = 275
+    TOK_seq = 269,
+    TOK_time = 270,
+    TOK_ms = 271,
+    TOK_us = 272,
+    TOK_rand = 273,
+    TOK_ellipsis = 274,
+    string_token = 275,
+    class_range_token = 276,
+    repeat_range_token = 277,
+    quoted_string = 278,
+    filename = 279,
+    integer = 280
   };
 #endif
 /* Tokens.  */
@@ -79,13 +84,18 @@ extern int yydebug;
 #define TOK_uid 266
 #define TOK_regex 267
 #define TOK_marker 268
-#define TOK_ellipsis 269
-#define string_token 270
-#define class_range_token 271
-#define repeat_range_token 272
-#define quoted_string 273
-#define filename 274
-#define integer 275
+#define TOK_seq 269
+#define TOK_time 270
+#define TOK_ms 271
+#define TOK_us 272
+#define TOK_rand 273
+#define TOK_ellipsis 274
+#define string_token 275
+#define class_range_token 276
+#define repeat_range_token 277
+#define quoted_string 278
+#define filename 279
+#define integer 280
 
 /* Value type.  */
 #if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
@@ -112,7 +122,7 @@ union YYSTYPE
     enum ws_frame_opcode tv_opcode;
     char  tv_char;
 
-#line 116 "tcpkali_expr_y.h" /* yacc.c:1915  */
+#line 126 "tcpkali_expr_y.h" /* yacc.c:1915  */
 };
 
 typedef union YYSTYPE YYSTYPE;
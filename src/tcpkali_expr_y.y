@@ -49,6 +49,11 @@ int yyerror(tk_expr_t **, const char *);
 %token              TOK_uid          "uid"
 %token              TOK_regex        "re"
 %token              TOK_marker       "marker"
+%token              TOK_seq          "seq"
+%token              TOK_time         "time"
+%token              TOK_ms           "ms"
+%token              TOK_us           "us"
+%token              TOK_rand         "rand"
 %token              TOK_ellipsis     "..."
 %token              END 0            "end of expression"
 %token  <tv_string> string_token     "arbitrary string"
@@ -66,7 +71,7 @@ int yyerror(tk_expr_t **, const char *);
 %type   <tv_expr>   WSBasicFrame WSFrameWithData WSFrameFinalized
 %type   <tv_expr>   ByteSequenceOrExpr          "some string or \\{expression}"
 %type   <tv_expr>   ByteSequencesAndExpressions "data and expressions"
-%type   <tv_expr>   NonWSExpression      "connection, global, re, or <filename.ext>"
+%type   <tv_expr>   NonWSExpression      "connection, message, global, time, rand, re, or <filename.ext>"
 %type   <tv_expr>   WSExpression      "ws"
 
 %%
@@ -207,6 +212,42 @@ NumericExpr:
         $$->estimate_size = sizeof("1000000000000" "1000000000000000" "!") - 1;
         $$->dynamic_scope = DS_PER_MESSAGE;
     }
+    | TOK_message '.' TOK_seq {
+        $$ = calloc(1, sizeof(*($$)));
+        $$->type = EXPR_MESSAGE_SEQ;
+        $$->estimate_size = EXPR_SEQ_WIDTH;
+        $$->dynamic_scope = DS_PER_MESSAGE;
+    }
+    | TOK_global '.' TOK_seq {
+        $$ = calloc(1, sizeof(*($$)));
+        $$->type = EXPR_GLOBAL_SEQ;
+        $$->estimate_size = EXPR_SEQ_WIDTH;
+        $$->dynamic_scope = DS_PER_MESSAGE;
+    }
+    | TOK_time '.' TOK_ms {
+        $$ = calloc(1, sizeof(*($$)));
+        $$->type = EXPR_TIME_MS;
+        $$->estimate_size = EXPR_TIME_MS_WIDTH;
+        $$->dynamic_scope = DS_PER_MESSAGE;
+    }
+    | TOK_time '.' TOK_us {
+        $$ = calloc(1, sizeof(*($$)));
+        $$->type = EXPR_TIME_US;
+        $$->estimate_size = EXPR_TIME_US_WIDTH;
+        $$->dynamic_scope = DS_PER_MESSAGE;
+    }
+    | TOK_rand integer '.' '.' integer {
+        long from = $2 < $5 ? $2 : $5;
+        long to = $2 < $5 ? $5 : $2;
+        $$ = calloc(1, sizeof(*($$)));
+        $$->type = EXPR_RAND;
+        $$->u.rand.from = from;
+        $$->u.rand.range = (to - from) + 1;
+        /* Zero-padded to the width of the upper bound. */
+        $$->estimate_size = 1;
+        for(; to >= 10; to /= 10) $$->estimate_size++;
+        $$->dynamic_scope = DS_PER_MESSAGE;
+    }
 
 WSFrameFinalized:
     WSFrameWithData
@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <config.h>
+
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#include <zlib.h>
+#define HDR_LOG_COMPRESSION
+#endif
+
+#include "tcpkali_hdr_log.h"
+
+/*
+ * The V2 encoding and its compressed wrapper, as understood by
+ * the Java and C HdrHistogram implementations. The 0x10 bit in the
+ * cookie denotes the ZigZag LEB128 (variable word size) counts encoding.
+ */
+#define V2_ENCODING_COOKIE (0x1c849303 | 0x10)
+#define V2_COMPRESSION_COOKIE (0x1c849304 | 0x10)
+#define V2_ENCODING_HEADER_SIZE 40
+#define V2_COMPRESSION_HEADER_SIZE 8
+
+struct hdr_log {
+    FILE *fp;
+    double time_base; /* Log timestamps are relative to this time */
+};
+
+static void
+put_be32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void
+put_be64(uint8_t *p, uint64_t v) {
+    put_be32(p, v >> 32);
+    put_be32(p + 4, v);
+}
+
+/*
+ * ZigZag LEB128 encoding of a 64-bit value, 9 bytes max.
+ */
+static size_t
+put_zigzag(uint8_t *p, int64_t value) {
+    uint64_t v = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    size_t n = 0;
+    /* The ninth byte carries full 8 bits. */
+    while(v >= 0x80 && n < 8) {
+        p[n++] = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    p[n++] = v;
+    return n;
+}
+
+/*
+ * Encode the counts array, run-length encoding the stretches of zeros
+ * as negative numbers. Returns the encoded size.
+ */
+static size_t
+encode_counts(uint8_t *p, const struct hdr_histogram *h) {
+    int32_t limit = h->counts_len;
+    while(limit > 0 && h->counts[limit - 1] == 0) limit--;
+
+    size_t size = 0;
+    for(int32_t i = 0; i < limit;) {
+        int64_t count = h->counts[i++];
+        if(count < 0) count = 0;
+        int64_t zeros = 0;
+        if(count == 0) {
+            for(zeros = 1; i < limit && h->counts[i] <= 0; i++) zeros++;
+        }
+        size += put_zigzag(p + size, zeros > 1 ? -zeros : count);
+    }
+    return size;
+}
+
+static char *
+base64_encode(const uint8_t *data, size_t size) {
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char *out = malloc(4 * ((size + 2) / 3) + 1);
+    char *o = out;
+    if(!out) return NULL;
+
+    for(size_t i = 0; i < size; i += 3) {
+        uint32_t v = data[i] << 16;
+        if(i + 1 < size) v |= data[i + 1] << 8;
+        if(i + 2 < size) v |= data[i + 2];
+        *o++ = alphabet[(v >> 18) & 0x3f];
+        *o++ = alphabet[(v >> 12) & 0x3f];
+        *o++ = (i + 1 < size) ? alphabet[(v >> 6) & 0x3f] : '=';
+        *o++ = (i + 2 < size) ? alphabet[v & 0x3f] : '=';
+    }
+    *o = '\0';
+    return out;
+}
+
+char *
+hdr_log_encode(const struct hdr_histogram *h) {
+#ifdef HDR_LOG_COMPRESSION
+    size_t max_encoded = V2_ENCODING_HEADER_SIZE + 9 * (size_t)h->counts_len;
+    uint8_t *encoded = malloc(max_encoded);
+    if(!encoded) return NULL;
+
+    union {
+        double d;
+        uint64_t u;
+    } ratio = {.d = 1.0};
+    size_t payload_size =
+        encode_counts(encoded + V2_ENCODING_HEADER_SIZE, h);
+    put_be32(encoded, V2_ENCODING_COOKIE);
+    put_be32(encoded + 4, payload_size);
+    put_be32(encoded + 8, h->normalizing_index_offset);
+    put_be32(encoded + 12, h->significant_figures);
+    put_be64(encoded + 16, h->lowest_trackable_value);
+    put_be64(encoded + 24, h->highest_trackable_value);
+    put_be64(encoded + 32, ratio.u);
+
+    uLongf compressed_size =
+        compressBound(V2_ENCODING_HEADER_SIZE + payload_size);
+    uint8_t *compressed = malloc(V2_COMPRESSION_HEADER_SIZE + compressed_size);
+    if(!compressed) {
+        free(encoded);
+        return NULL;
+    }
+    int rc = compress(compressed + V2_COMPRESSION_HEADER_SIZE,
+                      &compressed_size, encoded,
+                      V2_ENCODING_HEADER_SIZE + payload_size);
+    free(encoded);
+    if(rc != Z_OK) {
+        free(compressed);
+        return NULL;
+    }
+    put_be32(compressed, V2_COMPRESSION_COOKIE);
+    put_be32(compressed + 4, compressed_size);
+
+    char *b64 = base64_encode(compressed,
+                              V2_COMPRESSION_HEADER_SIZE + compressed_size);
+    free(compressed);
+    return b64;
+#else
+    (void)h;
+    return NULL;
+#endif
+}
+
+struct hdr_log *
+hdr_log_open(const char *filename, double now) {
+#ifndef HDR_LOG_COMPRESSION
+    fprintf(stderr, "%s: HdrHistogram log requires zlib support\n", filename);
+    return NULL;
+#endif
+
+    FILE *fp = fopen(filename, "w");
+    if(!fp) {
+        fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+        return NULL;
+    }
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    char date[64];
+    time_t t = tv.tv_sec;
+    strftime(date, sizeof(date), "%a %b %d %H:%M:%S %Z %Y", localtime(&t));
+
+    fprintf(fp, "#[Logged with " PACKAGE_NAME " " VERSION "]\n");
+    fprintf(fp, "#[Histogram log format version 1.3]\n");
+    fprintf(fp, "#[StartTime: %.3f (seconds since epoch), %s]\n",
+            tv.tv_sec + tv.tv_usec / 1000000.0, date);
+    fprintf(fp, "#[Values are in 1/10 of a millisecond]\n");
+    fprintf(fp, "\"StartTimestamp\",\"Interval_Length\",\"Interval_Max\","
+                "\"Interval_Compressed_Histogram\"\n");
+    fflush(fp);
+
+    struct hdr_log *log = calloc(1, sizeof(*log));
+    assert(log);
+    log->fp = fp;
+    log->time_base = now;
+    return log;
+}
+
+int
+hdr_log_write(struct hdr_log *log, const char *tag, double start, double end,
+              const struct hdr_histogram *h) {
+    char *b64 = hdr_log_encode(h);
+    if(!b64) return -1;
+    /* Interval_Max is conventionally reported in milliseconds. */
+    fprintf(log->fp, "Tag=%s,%.3f,%.3f,%.3f,%s\n", tag,
+            start - log->time_base, end - start,
+            hdr_max((struct hdr_histogram *)h) / 10.0, b64);
+    free(b64);
+    return 0;
+}
+
+void
+hdr_log_close(struct hdr_log *log) {
+    if(log) {
+        fclose(log->fp);
+        free(log);
+    }
+}
+
+#ifdef TCPKALI_HDR_LOG_UNIT_TEST
+
+static size_t
+base64_decode(const char *in, uint8_t *out) {
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t n = 0;
+    uint32_t acc = 0;
+    int bits = 0;
+    for(; *in && *in != '='; in++) {
+        acc = (acc << 6) | (strchr(alphabet, *in) - alphabet);
+        bits += 6;
+        if(bits >= 8) {
+            bits -= 8;
+            out[n++] = acc >> bits;
+        }
+    }
+    return n;
+}
+
+static uint32_t
+get_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static int64_t
+get_zigzag(const uint8_t **p) {
+    uint64_t v = 0;
+    int shift;
+    for(shift = 0; shift < 56; shift += 7) {
+        uint8_t b = *(*p)++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if(!(b & 0x80)) break;
+    }
+    if(shift == 56) v |= (uint64_t) * (*p)++ << 56;
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+int
+main() {
+#ifdef HDR_LOG_COMPRESSION
+    struct hdr_histogram *h;
+    int ret = hdr_init(1, 100 * 10000, 3, &h);
+    assert(ret == 0);
+
+    /* Zigzag sanity */
+    uint8_t buf[16];
+    const uint8_t *p = buf;
+    int64_t samples[] = {0, 1, -1, 63, -64, 64, 1000000, -123456789,
+                         INT64_MAX, INT64_MIN};
+    for(size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+        size_t n = put_zigzag(buf, samples[i]);
+        assert(n <= 9);
+        p = buf;
+        assert(get_zigzag(&p) == samples[i]);
+        assert(p == buf + n);
+    }
+
+    hdr_record_value(h, 1);
+    hdr_record_value(h, 15);
+    hdr_record_values(h, 1234, 10);
+    hdr_record_value(h, 50000);
+
+    char *b64 = hdr_log_encode(h);
+    assert(b64);
+    /* Compressed V2 histograms are recognized by this prefix. */
+    assert(strncmp(b64, "HISTFAAA", 8) == 0);
+
+    uint8_t *compressed = malloc(strlen(b64));
+    size_t compressed_size = base64_decode(b64, compressed);
+    assert(get_be32(compressed) == V2_COMPRESSION_COOKIE);
+    assert(get_be32(compressed + 4) + 8 == compressed_size);
+
+    uLongf size = V2_ENCODING_HEADER_SIZE + 9 * h->counts_len;
+    uint8_t *encoded = malloc(size);
+    ret = uncompress(encoded, &size, compressed + 8, compressed_size - 8);
+    assert(ret == Z_OK);
+    assert(get_be32(encoded) == V2_ENCODING_COOKIE);
+    size_t payload_size = get_be32(encoded + 4);
+    assert(V2_ENCODING_HEADER_SIZE + payload_size == size);
+    assert(get_be32(encoded + 12) == 3);
+
+    /* Decode the counts back and compare with the original. */
+    int64_t total = 0;
+    int32_t index = 0;
+    for(p = encoded + V2_ENCODING_HEADER_SIZE; p < encoded + size;) {
+        int64_t v = get_zigzag(&p);
+        if(v < 0) {
+            for(; v < 0; v++) assert(h->counts[index++] == 0);
+        } else {
+            assert(h->counts[index++] == v);
+            total += v;
+        }
+    }
+    assert(total == h->total_count);
+    assert(total == 13);
+
+    free(encoded);
+    free(compressed);
+    free(b64);
+    printf("OK\n");
+#endif
+    return 0;
+}
+
+#endif /* TCPKALI_HDR_LOG_UNIT_TEST */
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef TCPKALI_HDR_LOG_H
+#define TCPKALI_HDR_LOG_H
+
+#include <hdr_histogram.h>
+
+/*
+ * Write latency histograms in the HdrHistogram interval log format
+ * (version 1.3), to be analyzed or merged offline by the HdrHistogram
+ * tools, such as HistogramLogProcessor.
+ */
+struct hdr_log;
+
+/*
+ * Open the log file and write the log header.
+ * The (now) argument establishes the time base for the log entries.
+ * Returns NULL and prints the reason if the log can not be created.
+ */
+struct hdr_log *hdr_log_open(const char *filename, double now);
+
+/*
+ * Append an interval [start, end) histogram with the given tag,
+ * such as "connect" or "message".
+ */
+int hdr_log_write(struct hdr_log *, const char *tag, double start,
+                  double end, const struct hdr_histogram *);
+
+void hdr_log_close(struct hdr_log *);
+
+/*
+ * Encode the histogram in the compressed V2 format and wrap it into base64.
+ * Returns a newly allocated string or NULL.
+ */
+char *hdr_log_encode(const struct hdr_histogram *);
+
+#endif /* TCPKALI_HDR_LOG_H */
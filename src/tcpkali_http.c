@@ -0,0 +1,389 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include "tcpkali_http.h"
+
+void
+http_response_parser_init(struct http_response_parser *p) {
+    memset(p, 0, sizeof(*p));
+    p->state = HRP_STATUS_LINE;
+}
+
+void
+http_requests_sent(struct http_response_parser *p, const char *request,
+                   size_t size, unsigned long long count) {
+    int head = (size >= 5 && memcmp(request, "HEAD ", 5) == 0);
+
+    if(count == 0) return;
+
+    if(p->request_runs && p->requests[p->request_runs - 1].head == head) {
+        p->requests[p->request_runs - 1].count += count;
+    } else if(p->request_runs < HTTP_PARSER_REQUEST_RUNS) {
+        p->requests[p->request_runs].count = count;
+        p->requests[p->request_runs].head = head;
+        p->request_runs++;
+    } else {
+        /* Methods alternate too often; lump these with the last run. */
+        p->requests[p->request_runs - 1].count += count;
+    }
+}
+
+/*
+ * Take the oldest unanswered request off the list.
+ * Returns 1 if it is a HEAD request.
+ */
+static int
+http_answer_request(struct http_response_parser *p) {
+    if(p->request_runs == 0) return 0;
+
+    int head = p->requests[0].head;
+    if(--p->requests[0].count == 0) {
+        p->request_runs--;
+        memmove(&p->requests[0], &p->requests[1],
+                p->request_runs * sizeof(p->requests[0]));
+    }
+    return head;
+}
+
+/*
+ * Get ready to parse the next response on the same connection.
+ */
+static void
+http_next_response(struct http_response_parser *p) {
+    p->state = HRP_STATUS_LINE;
+    p->status = 0;
+    p->chunked = 0;
+    p->content_length_given = 0;
+    p->remaining = 0;
+}
+
+/*
+ * Return the value of the header (name) found in the (line), or NULL.
+ */
+static const char *
+header_value(const char *line, const char *name) {
+    size_t name_size = strlen(name);
+    if(strncasecmp(line, name, name_size) != 0 || line[name_size] != ':')
+        return NULL;
+    for(line += name_size + 1; *line == ' ' || *line == '\t'; line++)
+        ;
+    return line;
+}
+
+/*
+ * Figure out how the response body is delimited once the headers are over.
+ * Returns 1 if the response is complete, 0 otherwise.
+ */
+static int
+http_headers_complete(struct http_response_parser *p) {
+    if(p->status < 200 && p->status != 101) {
+        /* 100 Continue and the like precede the actual response. */
+        http_next_response(p);
+        return 0;
+    }
+
+    int head = http_answer_request(p);
+
+    if(p->status == 101) {
+        /* Whatever follows is not HTTP anymore. */
+        p->state = HRP_BODY_UNTIL_CLOSE;
+        return 1;
+    } else if(head || p->status == 204 || p->status == 304) {
+        /* RFC 7230, 3.3.3: no body, whatever the headers say. */
+        return 1;
+    } else if(p->chunked) {
+        p->state = HRP_CHUNK_SIZE;
+        return 0;
+    } else if(p->content_length_given) {
+        if(p->remaining == 0) return 1;
+        p->state = HRP_BODY;
+        return 0;
+    } else {
+        /* RFC 7230, 3.3.3: the body lasts until the connection close. */
+        p->state = HRP_BODY_UNTIL_CLOSE;
+        return 1;
+    }
+}
+
+/*
+ * Process the complete line collected in p->line.
+ * Returns 1 if the response is complete, 0 if it is not, -1 on error.
+ */
+static int
+http_process_line(struct http_response_parser *p) {
+    char *line = p->line;
+    size_t size = p->line_size;
+    const char *value;
+    char *end;
+
+    if(size < sizeof(p->line)) {
+        if(size && line[size - 1] == '\r') size--;
+    } else {
+        size = sizeof(p->line) - 1; /* Truncated */
+    }
+    line[size] = '\0';
+
+    switch(p->state) {
+    case HRP_STATUS_LINE:
+        if(size == 0) return 0; /* Tolerate empty lines between responses */
+        if(size < 12 || strncmp(line, "HTTP/1.", 7) != 0
+           || !isdigit((unsigned char)line[7]) || line[8] != ' '
+           || !isdigit((unsigned char)line[9])
+           || !isdigit((unsigned char)line[10])
+           || !isdigit((unsigned char)line[11])
+           || (line[12] != ' ' && line[12] != '\0'))
+            return -1;
+        p->status = 100 * (line[9] - '0') + 10 * (line[10] - '0')
+                    + (line[11] - '0');
+        if(p->status < 100 || p->status > 599) return -1;
+        p->state = HRP_HEADERS;
+        return 0;
+    case HRP_HEADERS:
+        if(size == 0) return http_headers_complete(p);
+        if((value = header_value(line, "Content-Length"))) {
+            if(!isdigit((unsigned char)*value)) return -1;
+            p->remaining = strtoull(value, &end, 10);
+            for(; *end == ' ' || *end == '\t'; end++)
+                ;
+            if(*end) return -1;
+            p->content_length_given = 1;
+        } else if((value = header_value(line, "Transfer-Encoding"))) {
+            /* The chunked coding, if any, is always the final one. */
+            size_t vsize = strlen(value);
+            for(; vsize && (value[vsize - 1] == ' ' || value[vsize - 1] == '\t');
+                vsize--)
+                ;
+            p->chunked = (vsize >= 7
+                          && strncasecmp(value + vsize - 7, "chunked", 7) == 0);
+        }
+        return 0;
+    case HRP_CHUNK_SIZE:
+        /* 16 hex digits, the chunk extensions are ignored. */
+        if(!isxdigit((unsigned char)line[0])) return -1;
+        if(strspn(line, "0123456789abcdefABCDEF") > 16) return -1;
+        p->remaining = strtoull(line, NULL, 16);
+        p->state = p->remaining ? HRP_CHUNK_DATA : HRP_TRAILERS;
+        return 0;
+    case HRP_CHUNK_DATA_END:
+        if(size != 0) return -1;
+        p->state = HRP_CHUNK_SIZE;
+        return 0;
+    case HRP_TRAILERS:
+        return (size == 0);
+    case HRP_BODY:
+    case HRP_CHUNK_DATA:
+    case HRP_BODY_UNTIL_CLOSE:
+        break;
+    }
+
+    assert(!"Unreachable");
+    return -1;
+}
+
+int
+http_response_parse(struct http_response_parser *p, const char *buf,
+                    size_t size,
+                    void (*on_response)(void *key, unsigned status),
+                    void *key) {
+    const char *bend = buf + size;
+    int responses = 0;
+    int complete;
+
+    while(buf < bend) {
+        switch(p->state) {
+        case HRP_BODY_UNTIL_CLOSE:
+            return responses;
+        case HRP_BODY:
+        case HRP_CHUNK_DATA:
+            if((size_t)(bend - buf) < p->remaining) {
+                p->remaining -= bend - buf;
+                return responses;
+            }
+            buf += p->remaining;
+            p->remaining = 0;
+            if(p->state == HRP_CHUNK_DATA) {
+                p->state = HRP_CHUNK_DATA_END;
+                continue;
+            }
+            complete = 1;
+            break;
+        default: {
+            const char *eol = memchr(buf, '\n', bend - buf);
+            size_t line_size = (eol ? eol : bend) - buf;
+            if(p->line_size < sizeof(p->line)) {
+                size_t room = sizeof(p->line) - p->line_size;
+                memcpy(&p->line[p->line_size], buf,
+                       line_size < room ? line_size : room);
+            }
+            p->line_size += line_size;
+            if(!eol) return responses;
+            buf = eol + 1;
+            complete = http_process_line(p);
+            p->line_size = 0;
+            if(complete == -1) return -1;
+        }
+        }
+
+        if(complete) {
+            responses++;
+            if(on_response) on_response(key, p->status);
+            if(p->state != HRP_BODY_UNTIL_CLOSE) http_next_response(p);
+        }
+    }
+
+    return responses;
+}
+
+#ifdef TCPKALI_HTTP_UNIT_TEST
+
+static unsigned statuses[16];
+static size_t statuses_count;
+
+static void
+record_status(void *key, unsigned status) {
+    assert(key == statuses);
+    assert(statuses_count < sizeof(statuses) / sizeof(statuses[0]));
+    statuses[statuses_count++] = status;
+}
+
+/*
+ * Parse the (input) at once and then byte by byte, expecting
+ * the given number of responses to the (methods) sent,
+ * one letter per request: G for GET, H for HEAD.
+ */
+static void
+check_methods(const char *methods, const char *input, int expected_responses,
+              unsigned expected_status) {
+    for(int bytewise = 0; bytewise <= 1; bytewise++) {
+        struct http_response_parser p;
+        http_response_parser_init(&p);
+        for(const char *m = methods; *m; m++) {
+            const char *request = (*m == 'H') ? "HEAD / HTTP/1.1\r\n\r\n"
+                                              : "GET / HTTP/1.1\r\n\r\n";
+            http_requests_sent(&p, request, strlen(request), 1);
+        }
+        size_t size = strlen(input);
+        int responses = 0;
+        statuses_count = 0;
+        if(bytewise) {
+            for(size_t i = 0; i < size && responses != -1; i++) {
+                int n = http_response_parse(&p, &input[i], 1, record_status,
+                                            statuses);
+                responses = (n == -1) ? -1 : responses + n;
+            }
+        } else {
+            responses =
+                http_response_parse(&p, input, size, record_status, statuses);
+        }
+        if(responses != expected_responses) {
+            fprintf(stderr, "Expected %d responses, got %d in \"%s\"\n",
+                    expected_responses, responses, input);
+            assert(responses == expected_responses);
+        }
+        if(responses > 0) {
+            assert(statuses_count == (size_t)responses);
+            assert(statuses[responses - 1] == expected_status);
+        }
+    }
+}
+
+static void
+check(const char *input, int expected_responses, unsigned expected_status) {
+    check_methods("", input, expected_responses, expected_status);
+}
+
+int
+main() {
+    check("", 0, 0);
+    check("HTTP/1.1 200 OK\r\n", 0, 0);
+    check("HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n", 1, 200);
+    check("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nabcd", 0, 0);
+    check("HTTP/1.1 200 OK\r\ncontent-length:5\r\n\r\nabcde", 1, 200);
+    check("HTTP/1.1 404 Not Found\r\nContent-Length: 2\r\n\r\n\r\n"
+          "HTTP/1.1 503 Busy\r\nContent-Length: 3\r\n\r\nabc"
+          "HTTP/1.1 200 OK\r\n",
+          2, 503);
+    /* Chunked, including the chunk extensions and trailers. */
+    check("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+          "5\r\nhello\r\n1a;ext=1\r\nabcdefghijklmnopqrstuvwxyz\r\n0\r\n\r\n",
+          1, 200);
+    check("HTTP/1.1 201 Created\r\nTransfer-Encoding: gzip, Chunked\r\n"
+          "Content-Length: 100\r\n\r\n"
+          "3\r\nabc\r\n0\r\nX-Trailer: yes\r\n\r\n"
+          "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+          "0\r\n\r\n",
+          2, 200);
+    check("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+          "5\r\nhello\r\n0\r\n",
+          0, 0);
+    /* No body */
+    check("HTTP/1.1 204 No Content\r\n\r\nHTTP/1.1 304 Not Modified\r\n"
+          "Content-Length: 10\r\n\r\n",
+          2, 304);
+    /* The responses to HEAD requests have no body. */
+    check_methods("HH", "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\n"
+                        "HTTP/1.1 404 Not Found\r\nContent-Length: 9\r\n\r\n",
+                  2, 404);
+    check_methods("GHG",
+                  "HTTP/1.1 200 OK\r\nContent-Length: 3\r\n\r\nabc"
+                  "HTTP/1.1 100 Continue\r\n\r\n"
+                  "HTTP/1.1 200 OK\r\nContent-Length: 3\r\n\r\n"
+                  "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                  "1\r\nx\r\n0\r\n\r\n",
+                  3, 200);
+    check_methods("GH", "HTTP/1.1 200 OK\r\nContent-Length: 3\r\n\r\nab", 0,
+                  0);
+    /* Interim responses are not counted. */
+    check("HTTP/1.1 100 Continue\r\n\r\n"
+          "HTTP/1.1 200 OK\r\nContent-Length: 1\r\n\r\nx",
+          1, 200);
+    /* The rest of the stream belongs to the response or another protocol. */
+    check("HTTP/1.0 200 OK\r\n\r\nHTTP/1.1 200 OK\r\n\r\n", 1, 200);
+    check("HTTP/1.1 101 Switching Protocols\r\n\r\n\x81\x05hello", 1, 101);
+    /* Long header lines are fine. */
+    check("HTTP/1.1 200 OK\r\nX-Long: "
+          "0123456789012345678901234567890123456789012345678901234567890123456"
+          "0123456789012345678901234567890123456789012345678901234567890123456"
+          "\r\nContent-Length: 1\r\n\r\nx",
+          1, 200);
+    /* Garbage */
+    check("GET / HTTP/1.1\r\n", -1, 0);
+    check("HTTP/1.1 20 OK\r\n", -1, 0);
+    check("HTTP/1.1 200 OK\r\nContent-Length: five\r\n", -1, 0);
+    check("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nxyz\r\n", -1,
+          0);
+
+    return 0;
+}
+
+#endif /* TCPKALI_HTTP_UNIT_TEST */
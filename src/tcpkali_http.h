@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef TCPKALI_HTTP_H
+#define TCPKALI_HTTP_H
+
+#include <stddef.h>
+
+/*
+ * Incremental HTTP/1.x response parser (--http).
+ * Finds the response boundaries in the received byte stream: the status
+ * line, the headers, and the body delimited by Content-Length, by the
+ * chunked transfer coding, or by the connection close.
+ * The responses to HEAD requests have no body whatever their headers say,
+ * so the parser is told about the requests sent, see http_requests_sent().
+ */
+#define HTTP_PARSER_LINE_SIZE 128
+#define HTTP_PARSER_REQUEST_RUNS 8
+
+struct http_response_parser {
+    enum {
+        HRP_STATUS_LINE,
+        HRP_HEADERS,
+        HRP_BODY,             /* Content-Length bytes */
+        HRP_CHUNK_SIZE,
+        HRP_CHUNK_DATA,
+        HRP_CHUNK_DATA_END,   /* CRLF after the chunk data */
+        HRP_TRAILERS,
+        HRP_BODY_UNTIL_CLOSE, /* Also after 101 Switching Protocols */
+    } state;
+    unsigned status;               /* Status code of the current response */
+    int chunked;                   /* Transfer-Encoding: chunked */
+    int content_length_given;      /* Content-Length header seen */
+    unsigned long long remaining;  /* Body or chunk bytes yet to skip */
+    size_t line_size;              /* Bytes of the current line seen */
+    char line[HTTP_PARSER_LINE_SIZE]; /* Its (possibly truncated) prefix */
+    /* Requests yet to be answered, in runs of the same method kind. */
+    struct http_request_run {
+        unsigned long long count;
+        int head; /* HEAD requests */
+    } requests[HTTP_PARSER_REQUEST_RUNS];
+    unsigned request_runs;
+};
+
+void http_response_parser_init(struct http_response_parser *);
+
+/*
+ * Account for the (count) identical requests sent, which start
+ * with the given (request) data. The responses are matched to the requests
+ * in order. If the requests are not reported, none are HEAD requests.
+ */
+void http_requests_sent(struct http_response_parser *, const char *request,
+                        size_t size, unsigned long long count);
+
+/*
+ * Feed the next portion of the received data into the parser.
+ * The (on_response) callback is invoked with the status code of every
+ * complete final (non-1xx) response. The 101 Switching Protocols response
+ * is reported once its headers are received, and so is the response
+ * whose body lasts until the connection close.
+ * RETURN VALUES:
+ *   Number of complete responses found, or
+ *   -1 if the data does not look like HTTP responses.
+ */
+int http_response_parse(struct http_response_parser *, const char *buf,
+                        size_t size,
+                        void (*on_response)(void *key, unsigned status),
+                        void *key);
+
+#endif /* TCPKALI_HTTP_H */
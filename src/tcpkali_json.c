@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "tcpkali_json.h"
+
+void
+json_print_string(FILE *fp, const char *str) {
+    fputc('"', fp);
+    for(const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        switch(*p) {
+        case '"':
+        case '\\':
+            fprintf(fp, "\\%c", *p);
+            break;
+        default:
+            if(*p < 0x20)
+                fprintf(fp, "\\u%04x", *p);
+            else
+                fputc(*p, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+void
+json_print_traffic(FILE *fp, const char *key,
+                   const non_atomic_traffic_stats *traffic) {
+    fprintf(fp,
+            "\"%s\":{\"bytes_sent\":%" PRIu64 ",\"bytes_rcvd\":%" PRIu64
+            ",\"num_writes\":%" PRIu64 ",\"num_reads\":%" PRIu64
+            ",\"msgs_sent\":%" PRIu64 ",\"msgs_rcvd\":%" PRIu64 "}",
+            key, (uint64_t)traffic->bytes_sent, (uint64_t)traffic->bytes_rcvd,
+            (uint64_t)traffic->num_writes, (uint64_t)traffic->num_reads,
+            (uint64_t)traffic->msgs_sent, (uint64_t)traffic->msgs_rcvd);
+}
+
+void
+json_print_histogram(FILE *fp, const char *key, struct hdr_histogram *hist,
+                     const struct percentile_values *percentiles) {
+    fprintf(fp, "\"%s\":{\"count\":%" PRId64, key, hist->total_count);
+    if(hist->total_count) {
+        /* The histogram values are in 1/10 ms. */
+        fprintf(fp, ",\"min\":%.1f,\"mean\":%.1f,\"max\":%.1f",
+                hdr_min(hist) / 10.0, hdr_mean(hist) / 10.0,
+                hdr_max(hist) / 10.0);
+        fprintf(fp, ",\"percentiles\":{");
+        for(size_t i = 0; i < percentiles->size; i++) {
+            fprintf(fp, "%s\"%s\":%.1f", i ? "," : "",
+                    percentiles->values[i].value_s,
+                    hdr_value_at_percentile(hist,
+                                            percentiles->values[i].value_d)
+                        / 10.0);
+        }
+        fprintf(fp, "}");
+    }
+    fprintf(fp, "}");
+}
+
+void
+json_print_latency(FILE *fp, const char *key,
+                   const struct latency_snapshot *latency,
+                   const struct percentile_values *percentiles) {
+    struct {
+        const char *kind;
+        struct hdr_histogram *hist;
+    } kinds[] = {{"connect", latency->connect_histogram},
+                 {"firstbyte", latency->firstbyte_histogram},
+                 {"message", latency->marker_histogram},
+                 {"tls", latency->tls_histogram},
+                 {"upgrade", latency->upgrade_histogram},
+                 {"appbyte", latency->appbyte_histogram}};
+    int printed = 0;
+
+    fprintf(fp, "\"%s\":{", key);
+    for(size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++) {
+        if(!kinds[i].hist) continue;
+        if(printed++) fprintf(fp, ",");
+        json_print_histogram(fp, kinds[i].kind, kinds[i].hist, percentiles);
+    }
+    fprintf(fp, "}");
+}
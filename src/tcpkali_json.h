@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef TCPKALI_JSON_H
+#define TCPKALI_JSON_H
+
+#include <stdio.h>
+#include <hdr_histogram.h>
+
+#include "tcpkali_common.h"
+#include "tcpkali_traffic_stats.h"
+
+/*
+ * Helpers for the machine-readable output (--output-format=json and
+ * --json-stream). Each of them prints a single "key":value pair,
+ * without the separating comma, and never a newline, so every record
+ * stays on its own line.
+ */
+
+/*
+ * Print a double-quoted string, escaping it as necessary.
+ */
+void json_print_string(FILE *, const char *);
+
+/*
+ * "key":{"bytes_sent":N,"bytes_rcvd":N,...}
+ */
+void json_print_traffic(FILE *, const char *key,
+                        const non_atomic_traffic_stats *);
+
+/*
+ * "key":{"count":N,"min":ms,"mean":ms,"max":ms,"percentiles":{"95":ms,...}}
+ * An empty histogram only has the "count" field.
+ */
+void json_print_histogram(FILE *, const char *key, struct hdr_histogram *,
+                          const struct percentile_values *);
+
+/*
+ * "key":{"connect":{...},"firstbyte":{...},"message":{...}}
+ * with only the measured latency kinds present.
+ */
+void json_print_latency(FILE *, const char *key,
+                        const struct latency_snapshot *,
+                        const struct percentile_values *);
+
+#endif /* TCPKALI_JSON_H */
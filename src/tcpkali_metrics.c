@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <hdr_histogram.h>
+
+#include "tcpkali_metrics.h"
+#include "tcpkali_traffic_stats.h"
+
+struct metrics_server {
+    struct engine *eng;
+    int listen_fd;
+    pthread_t thread;
+    volatile int stop_flag;
+    /*
+     * The latest latency snapshot, replaced by the main thread.
+     * The lock is held only while swapping the pointer
+     * and while rendering the response.
+     */
+    pthread_mutex_t latency_lock;
+    struct latency_snapshot *latency;
+    /*
+     * The message rate change resets the marker histograms,
+     * but the Prometheus counters must not go down. The main thread
+     * accumulates the latencies recorded since the (previous) snapshot
+     * into the (totals) it publishes.
+     */
+    struct latency_snapshot *previous;
+    struct latency_snapshot *totals;
+};
+
+/*
+ * Growable output buffer for the exposition text.
+ */
+struct metrics_buf {
+    char *data;
+    size_t size;
+    size_t allocated;
+};
+
+static void __attribute__((format(printf, 2, 3)))
+mbuf_printf(struct metrics_buf *mb, const char *fmt, ...) {
+    for(;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(mb->data + mb->size, mb->allocated - mb->size, fmt,
+                          ap);
+        va_end(ap);
+        assert(n >= 0);
+        if((size_t)n < mb->allocated - mb->size) {
+            mb->size += n;
+            return;
+        }
+        size_t new_size = 2 * mb->allocated + n + 1;
+        char *p = realloc(mb->data, new_size);
+        assert(p);
+        mb->data = p;
+        mb->allocated = new_size;
+    }
+}
+
+static struct hdr_histogram *
+histogram_copy(struct hdr_histogram *src) {
+    struct hdr_histogram *dst = NULL;
+    if(src) {
+        int ret = hdr_init(src->lowest_trackable_value,
+                           src->highest_trackable_value,
+                           src->significant_figures, &dst);
+        assert(ret == 0);
+        hdr_add(dst, src);
+    }
+    return dst;
+}
+
+static struct latency_snapshot *
+latency_snapshot_copy(const struct latency_snapshot *latency) {
+    struct latency_snapshot *copy = calloc(1, sizeof(*copy));
+    assert(copy);
+    copy->connect_histogram = histogram_copy(latency->connect_histogram);
+    copy->firstbyte_histogram = histogram_copy(latency->firstbyte_histogram);
+    copy->marker_histogram = histogram_copy(latency->marker_histogram);
+    copy->tls_histogram = histogram_copy(latency->tls_histogram);
+    copy->upgrade_histogram = histogram_copy(latency->upgrade_histogram);
+    copy->appbyte_histogram = histogram_copy(latency->appbyte_histogram);
+    return copy;
+}
+
+static void
+histogram_accumulate(struct hdr_histogram *dst, struct hdr_histogram *src) {
+    if(dst && src) hdr_add(dst, src);
+}
+
+void
+metrics_publish_latency(struct metrics_server *ms,
+                        struct latency_snapshot *latency) {
+    if(!ms || !latency) return;
+
+    if(ms->previous) {
+        struct latency_snapshot *delta =
+            engine_diff_latency_snapshot(ms->previous, latency);
+        struct latency_snapshot *t = ms->totals;
+        histogram_accumulate(t->connect_histogram, delta->connect_histogram);
+        histogram_accumulate(t->firstbyte_histogram,
+                             delta->firstbyte_histogram);
+        histogram_accumulate(t->marker_histogram, delta->marker_histogram);
+        histogram_accumulate(t->tls_histogram, delta->tls_histogram);
+        histogram_accumulate(t->upgrade_histogram, delta->upgrade_histogram);
+        histogram_accumulate(t->appbyte_histogram, delta->appbyte_histogram);
+        engine_free_latency_snapshot(delta);
+        engine_free_latency_snapshot(ms->previous);
+    } else {
+        ms->totals = latency_snapshot_copy(latency);
+    }
+    ms->previous = latency_snapshot_copy(latency);
+
+    struct latency_snapshot *copy = latency_snapshot_copy(ms->totals);
+
+    pthread_mutex_lock(&ms->latency_lock);
+    struct latency_snapshot *old = ms->latency;
+    ms->latency = copy;
+    pthread_mutex_unlock(&ms->latency_lock);
+
+    engine_free_latency_snapshot(old);
+}
+
+/*
+ * Render the latency histogram as the cumulative Prometheus buckets.
+ * The values are stored in 1/10 ms units and reported in seconds.
+ */
+static void
+format_latency_histogram(struct metrics_buf *mb, const char *kind,
+                         struct hdr_histogram *hist) {
+    static const int64_t bounds[] = {
+        1,     2,     5,     10,     20,     50,     100,
+        200,   500,   1000,  2000,   5000,   10000,  20000,
+        50000, 100000, 200000, 500000, 1000000};
+    const size_t n_bounds = sizeof(bounds) / sizeof(bounds[0]);
+    int64_t counts[sizeof(bounds) / sizeof(bounds[0])] = {0};
+
+    if(!hist) return;
+
+    struct hdr_iter iter;
+    hdr_iter_recorded_init(&iter, hist);
+    while(hdr_iter_next(&iter)) {
+        for(size_t i = 0; i < n_bounds; i++) {
+            if(iter.value_from_index <= bounds[i]) {
+                counts[i] += iter.count_at_index;
+                break;
+            }
+        }
+    }
+
+    int64_t cumulative = 0;
+    for(size_t i = 0; i < n_bounds; i++) {
+        cumulative += counts[i];
+        mbuf_printf(mb,
+                    "tcpkali_latency_seconds_bucket{kind=\"%s\",le=\"%g\"}"
+                    " %lld\n",
+                    kind, bounds[i] / 10000.0, (long long)cumulative);
+    }
+    mbuf_printf(mb,
+                "tcpkali_latency_seconds_bucket{kind=\"%s\",le=\"+Inf\"} %lld\n",
+                kind, (long long)hist->total_count);
+    mbuf_printf(mb, "tcpkali_latency_seconds_sum{kind=\"%s\"} %.6f\n", kind,
+                hist->total_count ? hdr_mean(hist) * hist->total_count / 10000.0
+                                  : 0.0);
+    mbuf_printf(mb, "tcpkali_latency_seconds_count{kind=\"%s\"} %lld\n", kind,
+                (long long)hist->total_count);
+}
+
+static void
+format_metrics(struct metrics_server *ms, struct metrics_buf *mb) {
+    non_atomic_traffic_stats traffic = engine_traffic(ms->eng);
+    size_t connecting, conns_in, conns_out, conns_counter;
+    engine_get_connection_stats(ms->eng, &connecting, &conns_in, &conns_out,
+                                &conns_counter);
+
+    struct {
+        const char *name;
+        const char *help;
+        non_atomic_wide_t value;
+    } counters[] = {
+        {"tcpkali_sent_bytes_total", "Data sent", traffic.bytes_sent},
+        {"tcpkali_received_bytes_total", "Data received", traffic.bytes_rcvd},
+        {"tcpkali_writes_total", "Number of write(2) calls",
+         traffic.num_writes},
+        {"tcpkali_reads_total", "Number of read(2) calls", traffic.num_reads},
+        {"tcpkali_sent_messages_total", "Messages sent", traffic.msgs_sent},
+        {"tcpkali_received_messages_total", "Messages received",
+         traffic.msgs_rcvd},
+        {"tcpkali_connections_seen_total", "Connections opened",
+         conns_counter}};
+    for(size_t i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+        mbuf_printf(mb,
+                    "# HELP %s %s.\n"
+                    "# TYPE %s counter\n"
+                    "%s %llu\n",
+                    counters[i].name, counters[i].help, counters[i].name,
+                    counters[i].name, (unsigned long long)counters[i].value);
+    }
+
+    mbuf_printf(mb,
+                "# HELP tcpkali_connections Connections currently open.\n"
+                "# TYPE tcpkali_connections gauge\n"
+                "tcpkali_connections{state=\"connecting\"} %zu\n"
+                "tcpkali_connections{state=\"outgoing\"} %zu\n"
+                "tcpkali_connections{state=\"incoming\"} %zu\n",
+                connecting, conns_out, conns_in);
+
+    pthread_mutex_lock(&ms->latency_lock);
+    struct latency_snapshot *latency = ms->latency;
+    if(latency
+       && (latency->connect_histogram || latency->firstbyte_histogram
+           || latency->marker_histogram || latency->tls_histogram
+           || latency->upgrade_histogram || latency->appbyte_histogram)) {
+        mbuf_printf(mb,
+                    "# HELP tcpkali_latency_seconds Latency, see"
+                    " --latency-connect, --latency-first-byte,"
+                    " --latency-marker, --latency-phases.\n"
+                    "# TYPE tcpkali_latency_seconds histogram\n");
+        format_latency_histogram(mb, "connect", latency->connect_histogram);
+        format_latency_histogram(mb, "firstbyte",
+                                 latency->firstbyte_histogram);
+        format_latency_histogram(mb, "message", latency->marker_histogram);
+        format_latency_histogram(mb, "tls", latency->tls_histogram);
+        format_latency_histogram(mb, "upgrade", latency->upgrade_histogram);
+        format_latency_histogram(mb, "appbyte", latency->appbyte_histogram);
+    }
+    pthread_mutex_unlock(&ms->latency_lock);
+}
+
+static void
+write_fully(int fd, const char *data, size_t size) {
+    while(size) {
+        ssize_t wrote = write(fd, data, size);
+        if(wrote <= 0) {
+            if(wrote == -1 && errno == EINTR) continue;
+            return;
+        }
+        data += wrote;
+        size -= wrote;
+    }
+}
+
+static void
+serve_request(struct metrics_server *ms, int fd) {
+    char req[2048];
+    size_t req_size = 0;
+
+    /* Do not let a stuck client hold up the scrapes. */
+    struct timeval tv = {.tv_sec = 1, .tv_usec = 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    /* Read the request headers, ignore the body, if any. */
+    while(req_size < sizeof(req) - 1) {
+        ssize_t rd = read(fd, req + req_size, sizeof(req) - 1 - req_size);
+        if(rd <= 0) {
+            if(rd == -1 && errno == EINTR) continue;
+            break;
+        }
+        req_size += rd;
+        req[req_size] = '\0';
+        if(strstr(req, "\r\n\r\n") || strstr(req, "\n\n")) break;
+    }
+    req[req_size] = '\0';
+
+    struct metrics_buf body = {0, 0, 0};
+    const char *status;
+    if(strncmp(req, "GET /metrics ", 13) == 0
+       || strncmp(req, "GET /metrics?", 13) == 0) {
+        status = "200 OK";
+        format_metrics(ms, &body);
+    } else {
+        status = "404 Not Found";
+        mbuf_printf(&body, "Try /metrics\n");
+    }
+
+    struct metrics_buf head = {0, 0, 0};
+    mbuf_printf(&head,
+                "HTTP/1.1 %s\r\n"
+                "Content-Type: text/plain; version=0.0.4\r\n"
+                "Content-Length: %zu\r\n"
+                "Connection: close\r\n"
+                "\r\n",
+                status, body.size);
+    write_fully(fd, head.data, head.size);
+    write_fully(fd, body.data, body.size);
+    free(head.data);
+    free(body.data);
+}
+
+static void *
+metrics_server_thread(void *arg) {
+    struct metrics_server *ms = arg;
+    struct pollfd pfd = {.fd = ms->listen_fd, .events = POLLIN};
+
+    while(!ms->stop_flag) {
+        if(poll(&pfd, 1, 250) <= 0) continue;
+        int fd = accept(ms->listen_fd, NULL, NULL);
+        if(fd == -1) continue;
+        serve_request(ms, fd);
+        close(fd);
+    }
+
+    return NULL;
+}
+
+struct metrics_server *
+metrics_server_start(struct addrinfo *listen_addrs,
+                     const char *listen_addr_str, struct engine *eng) {
+    int lsock = -1;
+
+    for(struct addrinfo *p = listen_addrs; p; p = p->ai_next) {
+        lsock = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+        if(lsock == -1) continue;
+        int on = 1;
+        (void)setsockopt(lsock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if(bind(lsock, p->ai_addr, p->ai_addrlen) == 0
+           && listen(lsock, 16) == 0) {
+            break;
+        }
+        close(lsock);
+        lsock = -1;
+    }
+    if(lsock == -1) {
+        fprintf(stderr, "Can not listen on --metrics-listen=%s: %s\n",
+                listen_addr_str, strerror(errno));
+        return NULL;
+    }
+
+    struct metrics_server *ms = calloc(1, sizeof(*ms));
+    assert(ms);
+    ms->eng = eng;
+    ms->listen_fd = lsock;
+    pthread_mutex_init(&ms->latency_lock, 0);
+
+    int rc = pthread_create(&ms->thread, 0, metrics_server_thread, ms);
+    if(rc != 0) {
+        fprintf(stderr, "Can not start --metrics-listen thread: %s\n",
+                strerror(rc));
+        close(lsock);
+        free(ms);
+        return NULL;
+    }
+
+    return ms;
+}
+
+void
+metrics_server_stop(struct metrics_server *ms) {
+    if(!ms) return;
+    ms->stop_flag = 1;
+    pthread_join(ms->thread, NULL);
+    close(ms->listen_fd);
+    engine_free_latency_snapshot(ms->latency);
+    engine_free_latency_snapshot(ms->previous);
+    engine_free_latency_snapshot(ms->totals);
+    pthread_mutex_destroy(&ms->latency_lock);
+    free(ms);
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef TCPKALI_METRICS_H
+#define TCPKALI_METRICS_H
+
+#include <netdb.h> /* addrinfo */
+
+#include "tcpkali_common.h"
+#include "tcpkali_engine.h"
+
+/*
+ * Prometheus exposition endpoint (--metrics-listen).
+ * The HTTP requests are served from a dedicated thread which only reads
+ * the engine's atomic counters and the latency snapshot most recently
+ * published by the main thread, never interrupting the worker loops.
+ */
+struct metrics_server;
+
+/*
+ * Listen on the first of the given addresses which can be bound to,
+ * and start serving GET /metrics.
+ * Returns NULL and prints the reason if the address can not be bound to.
+ */
+struct metrics_server *metrics_server_start(struct addrinfo *listen_addrs,
+                                            const char *listen_addr_str,
+                                            struct engine *);
+
+/*
+ * Add the latencies recorded since the previous snapshot to the totals
+ * served on the next request.
+ */
+void metrics_publish_latency(struct metrics_server *,
+                             struct latency_snapshot *);
+
+/*
+ * Stop serving and free the server. Must be called before the
+ * engine is terminated.
+ */
+void metrics_server_stop(struct metrics_server *);
+
+#endif /* TCPKALI_METRICS_H */
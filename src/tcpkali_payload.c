@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "tcpkali_payload.h"
+
+struct payload {
+    struct payload *next; /* Within the hash bucket */
+    uint64_t hash;
+    size_t rendered_size; /* Data size before it was prepared */
+    size_t refcount;
+    struct transport_data_spec data;
+};
+
+struct payload_cache {
+    struct payload **buckets;
+    size_t buckets_count; /* Power of 2 */
+    size_t payloads_count;
+};
+
+#define PAYLOAD_CACHE_INITIAL_BUCKETS 64
+
+struct payload_cache *
+payload_cache_new() {
+    struct payload_cache *cache = calloc(1, sizeof(*cache));
+    assert(cache);
+    cache->buckets_count = PAYLOAD_CACHE_INITIAL_BUCKETS;
+    cache->buckets = calloc(cache->buckets_count, sizeof(cache->buckets[0]));
+    assert(cache->buckets);
+    return cache;
+}
+
+void
+payload_cache_free(struct payload_cache *cache) {
+    if(!cache) return;
+    for(size_t b = 0; b < cache->buckets_count; b++) {
+        struct payload *pl = cache->buckets[b];
+        while(pl) {
+            struct payload *next = pl->next;
+            free(pl->data.ptr);
+            free(pl);
+            pl = next;
+        }
+    }
+    free(cache->buckets);
+    free(cache);
+}
+
+/*
+ * FNV-1a over the rendered data and its layout.
+ */
+static uint64_t
+payload_hash(const struct transport_data_spec *data) {
+    const uint64_t prime = 1099511628211ULL;
+    uint64_t h = 14695981039346656037ULL;
+    const unsigned char *p = data->ptr;
+    for(size_t i = 0; i < data->total_size; i++) {
+        h = (h ^ p[i]) * prime;
+    }
+    h = (h ^ data->once_size) * prime;
+    h = (h ^ data->single_message_size) * prime;
+    return h;
+}
+
+static int
+payload_matches(const struct payload *pl, uint64_t hash,
+                const struct transport_data_spec *data) {
+    /* The prepared data starts with the data as it was rendered. */
+    return pl->hash == hash && pl->rendered_size == data->total_size
+           && pl->data.once_size == data->once_size
+           && pl->data.ws_hdr_size == data->ws_hdr_size
+           && pl->data.single_message_size == data->single_message_size
+           && memcmp(pl->data.ptr, data->ptr, data->total_size) == 0;
+}
+
+static void
+payload_cache_grow(struct payload_cache *cache) {
+    size_t new_count = 2 * cache->buckets_count;
+    struct payload **new_buckets = calloc(new_count, sizeof(new_buckets[0]));
+    assert(new_buckets);
+    for(size_t b = 0; b < cache->buckets_count; b++) {
+        struct payload *pl = cache->buckets[b];
+        while(pl) {
+            struct payload *next = pl->next;
+            size_t nb = pl->hash & (new_count - 1);
+            pl->next = new_buckets[nb];
+            new_buckets[nb] = pl;
+            pl = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = new_buckets;
+    cache->buckets_count = new_count;
+}
+
+struct payload *
+payload_cache_share(struct payload_cache *cache,
+                    struct transport_data_spec *data,
+                    void (*prepare)(struct transport_data_spec *)) {
+    uint64_t hash = payload_hash(data);
+    struct payload **bucket = &cache->buckets[hash & (cache->buckets_count - 1)];
+
+    for(struct payload *pl = *bucket; pl; pl = pl->next) {
+        if(payload_matches(pl, hash, data)) {
+            free(data->ptr);
+            *data = pl->data;
+            pl->refcount++;
+            return pl;
+        }
+    }
+
+    struct payload *pl = calloc(1, sizeof(*pl));
+    assert(pl);
+    pl->hash = hash;
+    pl->rendered_size = data->total_size;
+    pl->refcount = 1;
+    if(prepare) prepare(data);
+    data->flags |= TDS_FLAG_PTR_SHARED;
+    pl->data = *data;
+    pl->next = *bucket;
+    *bucket = pl;
+
+    if(++cache->payloads_count > cache->buckets_count) {
+        payload_cache_grow(cache);
+    }
+
+    return pl;
+}
+
+void
+payload_release(struct payload_cache *cache, struct payload *pl) {
+    assert(pl->refcount > 0);
+    if(--pl->refcount) return;
+
+    struct payload **p = &cache->buckets[pl->hash & (cache->buckets_count - 1)];
+    while(*p != pl) {
+        assert(*p);
+        p = &(*p)->next;
+    }
+    *p = pl->next;
+    cache->payloads_count--;
+
+    free(pl->data.ptr);
+    free(pl);
+}
+
+#ifdef TCPKALI_PAYLOAD_UNIT_TEST
+
+static struct transport_data_spec
+rendered(const char *once, const char *message) {
+    struct transport_data_spec data;
+    memset(&data, 0, sizeof(data));
+    data.once_size = strlen(once);
+    data.single_message_size = strlen(message);
+    data.total_size = data.once_size + data.single_message_size;
+    data.allocated_size = data.total_size;
+    data.ptr = malloc(data.total_size + 1);
+    assert(data.ptr);
+    memcpy(data.ptr, once, data.once_size);
+    memcpy((char *)data.ptr + data.once_size, message, data.single_message_size);
+    return data;
+}
+
+static int prepared;
+
+/* Append another copy of the message, as replicate_payload() would. */
+static void
+double_message(struct transport_data_spec *data) {
+    size_t msize = data->single_message_size;
+    data->ptr = realloc(data->ptr, data->total_size + msize + 1);
+    assert(data->ptr);
+    memcpy((char *)data->ptr + data->total_size,
+           (char *)data->ptr + data->once_size, msize);
+    data->total_size += msize;
+    data->allocated_size = data->total_size;
+    prepared++;
+}
+
+int
+main() {
+    struct payload_cache *cache = payload_cache_new();
+
+    struct transport_data_spec a = rendered("", "id=1;");
+    struct transport_data_spec b = rendered("", "id=2;");
+    struct transport_data_spec c = rendered("", "id=1;");
+    struct transport_data_spec d = rendered("id=1;", "");
+
+    struct payload *pa = payload_cache_share(cache, &a, double_message);
+    struct payload *pb = payload_cache_share(cache, &b, double_message);
+    struct payload *pc = payload_cache_share(cache, &c, double_message);
+    struct payload *pd = payload_cache_share(cache, &d, double_message);
+
+    assert(prepared == 3);
+    assert(pa == pc);
+    assert(pa != pb);
+    assert(pa != pd); /* Same bytes, different layout */
+    assert(a.ptr == c.ptr);
+    assert(a.total_size == 10 && c.total_size == 10);
+    assert(memcmp(c.ptr, "id=1;id=1;", 10) == 0);
+    assert(a.flags & TDS_FLAG_PTR_SHARED);
+    assert(c.flags & TDS_FLAG_PTR_SHARED);
+
+    payload_release(cache, pa);
+    /* Still in use by (c). */
+    struct transport_data_spec e = rendered("", "id=1;");
+    struct payload *pe = payload_cache_share(cache, &e, double_message);
+    assert(pe == pc);
+    assert(e.ptr == c.ptr);
+    payload_release(cache, pc);
+    payload_release(cache, pc);
+
+    /* Gone from the cache, is prepared anew. */
+    struct transport_data_spec f = rendered("", "id=1;");
+    payload_cache_share(cache, &f, double_message);
+    assert(prepared == 4);
+
+    /* Many distinct payloads make the table grow. */
+    for(int i = 0; i < 1000; i++) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "id=%d;", 1000 + i);
+        struct transport_data_spec g = rendered("", buf);
+        struct transport_data_spec h = rendered("", buf);
+        struct payload *pg = payload_cache_share(cache, &g, NULL);
+        struct payload *ph = payload_cache_share(cache, &h, NULL);
+        assert(pg == ph);
+    }
+
+    payload_cache_free(cache);
+
+    return 0;
+}
+
+#endif /* TCPKALI_PAYLOAD_UNIT_TEST */
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef TCPKALI_PAYLOAD_H
+#define TCPKALI_PAYLOAD_H
+
+#include "tcpkali_transport.h"
+
+/*
+ * Per-worker cache of the rendered per-connection data (DS_PER_CONNECTION),
+ * indexed by content. The connections whose expressions happen to produce
+ * the same data, such as \{connection.uid % 16}, share a single buffer.
+ */
+struct payload_cache;
+struct payload;
+
+struct payload_cache *payload_cache_new(void);
+void payload_cache_free(struct payload_cache *);
+
+/*
+ * Replace the freshly rendered (data) with the equal one from the cache.
+ * If there is none, (prepare) the data (e.g. replicate it) and add it to
+ * the cache. Either way the (data) becomes TDS_FLAG_PTR_SHARED and must be
+ * released with payload_release() using the returned handle.
+ */
+struct payload *payload_cache_share(struct payload_cache *,
+                                    struct transport_data_spec *data,
+                                    void (*prepare)(struct transport_data_spec *));
+
+void payload_release(struct payload_cache *, struct payload *);
+
+#endif /* TCPKALI_PAYLOAD_H */
@@ -0,0 +1,962 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "tcpkali_pcap.h"
+
+/*
+ * Link-layer header types (http://www.tcpdump.org/linktypes.html).
+ */
+enum {
+    LINKTYPE_NULL = 0,
+    LINKTYPE_ETHERNET = 1,
+    LINKTYPE_RAW_OLD = 12,
+    LINKTYPE_RAW_OPENBSD = 14,
+    LINKTYPE_RAW = 101,
+    LINKTYPE_LOOP = 108,
+    LINKTYPE_LINUX_SLL = 113,
+    LINKTYPE_IPV4 = 228,
+    LINKTYPE_IPV6 = 229,
+    LINKTYPE_LINUX_SLL2 = 276,
+};
+
+#define PCAPNG_MAX_INTERFACES 64
+
+struct endpoint {
+    uint8_t family; /* 4 or 6 */
+    uint8_t addr[16];
+    uint16_t port;
+};
+
+/*
+ * A client data packet as it was found in the capture.
+ */
+struct raw_segment {
+    uint32_t seq;
+    int64_t position; /* Relative to the initial sequence number */
+    const uint8_t *data;
+    size_t size;
+    double ts;
+};
+
+struct flow_builder {
+    struct endpoint client;
+    struct endpoint server;
+    int isn_known;
+    uint32_t isn;
+    double first_ts;
+    double last_ts;
+    struct raw_segment *segments;
+    size_t segments_count;
+    size_t segments_size;
+    struct flow_builder *bucket_next;
+};
+
+#define FLOW_BUCKETS 65536
+
+struct pcap_parser {
+    const char *filename;
+    struct flow_builder *buckets[FLOW_BUCKETS];
+    struct flow_builder **flows; /* In the order of appearance */
+    size_t flows_count;
+    size_t flows_size;
+    size_t tcp_packets;
+};
+
+static uint32_t
+get16(const uint8_t *p, int big_endian) {
+    return big_endian ? ((p[0] << 8) | p[1]) : ((p[1] << 8) | p[0]);
+}
+
+static uint32_t
+get32(const uint8_t *p, int big_endian) {
+    return big_endian
+               ? (((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3])
+               : (((uint32_t)p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0]);
+}
+
+/* Network byte order */
+#define get_n16(p) get16(p, 1)
+#define get_n32(p) get32(p, 1)
+
+static int
+endpoint_equal(const struct endpoint *a, const struct endpoint *b) {
+    return a->family == b->family && a->port == b->port
+           && memcmp(a->addr, b->addr, a->family == 4 ? 4 : 16) == 0;
+}
+
+static unsigned
+endpoint_hash(const struct endpoint *ep) {
+    unsigned h = 2166136261u; /* FNV-1a */
+    for(int i = 0; i < (ep->family == 4 ? 4 : 16); i++) {
+        h = (h ^ ep->addr[i]) * 16777619;
+    }
+    h = (h ^ (ep->port & 0xff)) * 16777619;
+    h = (h ^ (ep->port >> 8)) * 16777619;
+    return h;
+}
+
+/*
+ * Direction-agnostic hash of a connection.
+ */
+static unsigned
+flow_bucket(const struct endpoint *a, const struct endpoint *b) {
+    return (endpoint_hash(a) ^ endpoint_hash(b)) % FLOW_BUCKETS;
+}
+
+/*
+ * Find the most recent flow between the two endpoints.
+ * The (*from_client) is set if (src) is the client side of the flow.
+ */
+static struct flow_builder *
+find_flow(struct pcap_parser *parser, const struct endpoint *src,
+          const struct endpoint *dst, int *from_client) {
+    struct flow_builder *fb;
+    for(fb = parser->buckets[flow_bucket(src, dst)]; fb; fb = fb->bucket_next) {
+        if(endpoint_equal(&fb->client, src)
+           && endpoint_equal(&fb->server, dst)) {
+            *from_client = 1;
+            return fb;
+        } else if(endpoint_equal(&fb->client, dst)
+                  && endpoint_equal(&fb->server, src)) {
+            *from_client = 0;
+            return fb;
+        }
+    }
+    return NULL;
+}
+
+static struct flow_builder *
+add_flow(struct pcap_parser *parser, const struct endpoint *client,
+         const struct endpoint *server, double ts) {
+    struct flow_builder *fb = calloc(1, sizeof(*fb));
+    assert(fb);
+    fb->client = *client;
+    fb->server = *server;
+    fb->first_ts = ts;
+    fb->last_ts = ts;
+
+    /* Newer flows shadow the older ones with the same addresses. */
+    unsigned bucket = flow_bucket(client, server);
+    fb->bucket_next = parser->buckets[bucket];
+    parser->buckets[bucket] = fb;
+
+    if(parser->flows_count == parser->flows_size) {
+        parser->flows_size = parser->flows_size ? 2 * parser->flows_size : 64;
+        parser->flows = realloc(parser->flows,
+                                parser->flows_size * sizeof(parser->flows[0]));
+        assert(parser->flows);
+    }
+    parser->flows[parser->flows_count++] = fb;
+
+    return fb;
+}
+
+static void
+add_segment(struct flow_builder *fb, uint32_t seq, const uint8_t *data,
+            size_t size, double ts) {
+    if(fb->segments_count == fb->segments_size) {
+        fb->segments_size = fb->segments_size ? 2 * fb->segments_size : 8;
+        fb->segments = realloc(fb->segments,
+                               fb->segments_size * sizeof(fb->segments[0]));
+        assert(fb->segments);
+    }
+    struct raw_segment *rs = &fb->segments[fb->segments_count++];
+    rs->seq = seq;
+    rs->position = 0;
+    rs->data = data;
+    rs->size = size;
+    rs->ts = ts;
+}
+
+enum {
+    TCP_FIN = 0x01,
+    TCP_SYN = 0x02,
+    TCP_RST = 0x04,
+    TCP_ACK = 0x10,
+};
+
+static void
+process_tcp(struct pcap_parser *parser, struct endpoint *src,
+            struct endpoint *dst, const uint8_t *tcp, size_t tcp_len,
+            size_t captured, double ts) {
+    if(captured < 20 || tcp_len < 20) return;
+    size_t hdr_len = 4 * (tcp[12] >> 4);
+    if(hdr_len < 20 || hdr_len > captured || hdr_len > tcp_len) return;
+
+    src->port = get_n16(tcp);
+    dst->port = get_n16(tcp + 2);
+    uint32_t seq = get_n32(tcp + 4);
+    uint32_t ack = get_n32(tcp + 8);
+    int flags = tcp[13];
+    const uint8_t *payload = tcp + hdr_len;
+    /* Snapped packets contribute what was captured. */
+    size_t payload_size =
+        (captured < tcp_len ? captured : tcp_len) - hdr_len;
+
+    parser->tcp_packets++;
+
+    int from_client = 0;
+    struct flow_builder *fb = find_flow(parser, src, dst, &from_client);
+
+    if((flags & (TCP_SYN | TCP_ACK)) == TCP_SYN) {
+        /* Connection attempt. A reused port pair starts a new flow. */
+        if(fb == NULL || fb->segments_count || !from_client
+           || (fb->isn_known && fb->isn != seq)) {
+            fb = add_flow(parser, src, dst, ts);
+        }
+        fb->isn_known = 1;
+        fb->isn = seq;
+        from_client = 1;
+    } else if(fb == NULL) {
+        if((flags & (TCP_SYN | TCP_ACK)) == (TCP_SYN | TCP_ACK)) {
+            /* Missed the initial SYN, but the server acknowledges it. */
+            fb = add_flow(parser, dst, src, ts);
+            fb->isn_known = 1;
+            fb->isn = ack - 1;
+            from_client = 0;
+        } else {
+            /* Started capturing mid-connection: guess the sides. */
+            fb = add_flow(parser, src, dst, ts);
+            from_client = 1;
+        }
+    }
+
+    if(fb->last_ts < ts) fb->last_ts = ts;
+
+    if(from_client && payload_size) {
+        add_segment(fb, (flags & TCP_SYN) ? seq + 1 : seq, payload,
+                    payload_size, ts);
+    }
+}
+
+static void
+process_ip(struct pcap_parser *parser, const uint8_t *p, size_t captured,
+           double ts) {
+    struct endpoint src;
+    struct endpoint dst;
+
+    if(captured < 1) return;
+
+    memset(&src, 0, sizeof(src));
+    memset(&dst, 0, sizeof(dst));
+
+    switch(p[0] >> 4) {
+    case 4: {
+        if(captured < 20) return;
+        size_t hdr_len = 4 * (p[0] & 0x0f);
+        size_t total_len = get_n16(p + 2);
+        if(hdr_len < 20 || total_len < hdr_len || captured < hdr_len) return;
+        if(get_n16(p + 6) & 0x3fff) return; /* Fragment */
+        if(p[9] != 6) return;               /* Not TCP */
+        src.family = dst.family = 4;
+        memcpy(src.addr, p + 12, 4);
+        memcpy(dst.addr, p + 16, 4);
+        /* Trim the link layer padding */
+        if(captured > total_len) captured = total_len;
+        process_tcp(parser, &src, &dst, p + hdr_len, total_len - hdr_len,
+                    captured - hdr_len, ts);
+    } break;
+    case 6: {
+        if(captured < 40) return;
+        size_t total_len = 40 + get_n16(p + 4);
+        int next_header = p[6];
+        size_t off = 40;
+        src.family = dst.family = 6;
+        memcpy(src.addr, p + 8, 16);
+        memcpy(dst.addr, p + 24, 16);
+        if(captured > total_len) captured = total_len;
+        /* Skip the extension headers */
+        while(next_header != 6) {
+            switch(next_header) {
+            case 0:  /* Hop-by-Hop */
+            case 43: /* Routing */
+            case 60: /* Destination Options */
+                if(captured < off + 8) return;
+                next_header = p[off];
+                off += 8 * (p[off + 1] + 1);
+                break;
+            default: /* Fragments and non-TCP */
+                return;
+            }
+        }
+        if(off > captured) return;
+        process_tcp(parser, &src, &dst, p + off, total_len - off,
+                    captured - off, ts);
+    } break;
+    default:
+        break;
+    }
+}
+
+static int
+linktype_supported(unsigned linktype) {
+    switch(linktype) {
+    case LINKTYPE_NULL:
+    case LINKTYPE_ETHERNET:
+    case LINKTYPE_RAW_OLD:
+    case LINKTYPE_RAW_OPENBSD:
+    case LINKTYPE_RAW:
+    case LINKTYPE_LOOP:
+    case LINKTYPE_LINUX_SLL:
+    case LINKTYPE_IPV4:
+    case LINKTYPE_IPV6:
+    case LINKTYPE_LINUX_SLL2:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Strip the link layer header and pass the IP packet further.
+ */
+static void
+process_packet(struct pcap_parser *parser, unsigned linktype,
+               const uint8_t *p, size_t captured, double ts) {
+    size_t off;
+    uint32_t ethertype;
+
+    switch(linktype) {
+    case LINKTYPE_NULL:
+    case LINKTYPE_LOOP:
+        /* The address family is checked by looking at the IP version. */
+        off = 4;
+        break;
+    case LINKTYPE_ETHERNET:
+        if(captured < 14) return;
+        off = 14;
+        ethertype = get_n16(p + 12);
+        /* 802.1Q and 802.1ad VLAN tags */
+        while(ethertype == 0x8100 || ethertype == 0x88a8) {
+            if(captured < off + 4) return;
+            ethertype = get_n16(p + off + 2);
+            off += 4;
+        }
+        if(ethertype != 0x0800 && ethertype != 0x86dd) return;
+        break;
+    case LINKTYPE_LINUX_SLL:
+        if(captured < 16) return;
+        off = 16;
+        ethertype = get_n16(p + 14);
+        if(ethertype != 0x0800 && ethertype != 0x86dd) return;
+        break;
+    case LINKTYPE_LINUX_SLL2:
+        if(captured < 20) return;
+        off = 20;
+        ethertype = get_n16(p);
+        if(ethertype != 0x0800 && ethertype != 0x86dd) return;
+        break;
+    default:
+        off = 0;
+        break;
+    }
+
+    if(captured <= off) return;
+    process_ip(parser, p + off, captured - off, ts);
+}
+
+/*
+ * Classic libpcap format.
+ */
+static int
+parse_pcap(struct pcap_parser *parser, const uint8_t *base, size_t size) {
+    uint32_t magic = get32(base, 0);
+    int big_endian;
+    double ts_unit;
+
+    switch(magic) {
+    case 0xa1b2c3d4: big_endian = 0; ts_unit = 1e-6; break;
+    case 0xd4c3b2a1: big_endian = 1; ts_unit = 1e-6; break;
+    case 0xa1b23c4d: big_endian = 0; ts_unit = 1e-9; break;
+    case 0x4d3cb2a1: big_endian = 1; ts_unit = 1e-9; break;
+    default:
+        assert(!"Unreachable");
+        return -1;
+    }
+
+    if(size < 24) {
+        fprintf(stderr, "%s: Truncated pcap header\n", parser->filename);
+        return -1;
+    }
+
+    unsigned linktype = get32(base + 20, big_endian) & 0xffff;
+    if(!linktype_supported(linktype)) {
+        fprintf(stderr, "%s: Unsupported link type %u\n", parser->filename,
+                linktype);
+        return -1;
+    }
+
+    size_t off;
+    for(off = 24; off + 16 <= size;) {
+        const uint8_t *rec = base + off;
+        double ts = get32(rec, big_endian) + ts_unit * get32(rec + 4, big_endian);
+        size_t captured = get32(rec + 8, big_endian);
+        if(captured > size - off - 16) break;
+        process_packet(parser, linktype, rec + 16, captured, ts);
+        off += 16 + captured;
+    }
+    if(off != size) {
+        fprintf(stderr, "%s: Warning: capture is truncated at offset %zu\n",
+                parser->filename, off);
+    }
+
+    return 0;
+}
+
+/*
+ * The pcapng format: only the blocks carrying packets
+ * and the interface descriptions are of interest.
+ */
+static int
+parse_pcapng(struct pcap_parser *parser, const uint8_t *base, size_t size) {
+    struct {
+        unsigned linktype;
+        double ts_unit;
+    } ifaces[PCAPNG_MAX_INTERFACES];
+    size_t ifaces_count = 0;
+    size_t unsupported = 0;
+    double last_ts = 0;
+    int big_endian = 0;
+    size_t off;
+
+    for(off = 0; off + 12 <= size;) {
+        const uint8_t *blk = base + off;
+        uint32_t type = get32(blk, big_endian);
+
+        if(type == 0x0a0d0d0a) { /* Section Header Block */
+            uint32_t bom = get32(blk + 8, 0);
+            if(bom == 0x1a2b3c4d) {
+                big_endian = 0;
+            } else if(bom == 0x4d3c2b1a) {
+                big_endian = 1;
+            } else {
+                fprintf(stderr, "%s: Invalid pcapng section at offset %zu\n",
+                        parser->filename, off);
+                return -1;
+            }
+            ifaces_count = 0;
+        }
+
+        size_t blk_len = get32(blk + 4, big_endian);
+        if(blk_len < 12 || (blk_len & 3) || blk_len > size - off) break;
+        const uint8_t *body = blk + 8;
+        size_t body_len = blk_len - 12;
+
+        switch(type) {
+        case 1: /* Interface Description Block */
+            if(body_len < 8) break;
+            if(ifaces_count == PCAPNG_MAX_INTERFACES) {
+                fprintf(stderr, "%s: Too many interfaces\n", parser->filename);
+                return -1;
+            }
+            ifaces[ifaces_count].linktype = get16(body, big_endian);
+            ifaces[ifaces_count].ts_unit = 1e-6;
+            /* Look for the if_tsresol option */
+            for(size_t opt = 8; opt + 4 <= body_len;) {
+                unsigned code = get16(body + opt, big_endian);
+                unsigned len = get16(body + opt + 2, big_endian);
+                if(code == 0 || opt + 4 + len > body_len) break;
+                if(code == 9 && len >= 1) {
+                    unsigned resol = body[opt + 4];
+                    double unit = 1.0;
+                    for(unsigned i = 0; i < (resol & 0x7f); i++)
+                        unit /= (resol & 0x80) ? 2 : 10;
+                    ifaces[ifaces_count].ts_unit = unit;
+                }
+                opt += 4 + ((len + 3) & ~3u);
+            }
+            if(!linktype_supported(ifaces[ifaces_count].linktype))
+                unsupported++;
+            ifaces_count++;
+            break;
+        case 2: /* Packet Block (obsolete) */
+        case 6: /* Enhanced Packet Block */
+        {
+            if(body_len < 20) break;
+            size_t iface = (type == 6) ? get32(body, big_endian) : get16(body, big_endian);
+            uint64_t ts_raw = ((uint64_t)get32(body + 4, big_endian) << 32)
+                              | get32(body + 8, big_endian);
+            size_t captured = get32(body + 12, big_endian);
+            if(iface >= ifaces_count || captured > body_len - 20) break;
+            last_ts = ts_raw * ifaces[iface].ts_unit;
+            if(!linktype_supported(ifaces[iface].linktype)) break;
+            process_packet(parser, ifaces[iface].linktype, body + 20, captured,
+                           last_ts);
+        } break;
+        case 3: /* Simple Packet Block */
+        {
+            if(body_len < 4 || ifaces_count == 0) break;
+            size_t captured = get32(body, big_endian);
+            if(captured > body_len - 4) captured = body_len - 4;
+            if(!linktype_supported(ifaces[0].linktype)) break;
+            /* No timestamp, pretend it came right after the previous one. */
+            process_packet(parser, ifaces[0].linktype, body + 4, captured,
+                           last_ts);
+        } break;
+        default:
+            break;
+        }
+
+        off += blk_len;
+    }
+    if(off != size) {
+        fprintf(stderr, "%s: Warning: capture is truncated at offset %zu\n",
+                parser->filename, off);
+    }
+    if(unsupported) {
+        fprintf(stderr,
+                "%s: Warning: skipped %zu interface%s of unsupported "
+                "link type\n",
+                parser->filename, unsupported, unsupported == 1 ? "" : "s");
+    }
+
+    return 0;
+}
+
+static int
+compare_segments(const void *ap, const void *bp) {
+    const struct raw_segment *a = ap;
+    const struct raw_segment *b = bp;
+    if(a->position != b->position) return a->position < b->position ? -1 : 1;
+    /* The earliest transmission wins. */
+    if(a->ts != b->ts) return a->ts < b->ts ? -1 : 1;
+    return (a->data > b->data) - (a->data < b->data);
+}
+
+/*
+ * Order the client packets by their sequence numbers, dropping the
+ * retransmitted and overlapping bytes. Returns the number of holes
+ * left in the stream by the packets missing from the capture.
+ */
+static size_t
+reassemble_flow(struct flow_builder *fb, struct pcap_flow *flow) {
+    size_t holes = 0;
+
+    memset(flow, 0, sizeof(*flow));
+    flow->duration = fb->last_ts - fb->first_ts;
+    if(fb->segments_count == 0) return 0;
+
+    uint32_t base = fb->isn_known ? fb->isn + 1 : fb->segments[0].seq;
+    for(size_t i = 0; i < fb->segments_count; i++) {
+        /* Sequence numbers wrap around */
+        fb->segments[i].position = (int32_t)(fb->segments[i].seq - base);
+    }
+    qsort(fb->segments, fb->segments_count, sizeof(fb->segments[0]),
+          compare_segments);
+
+    flow->segments = calloc(fb->segments_count, sizeof(flow->segments[0]));
+    assert(flow->segments);
+
+    int64_t next = fb->segments[0].position;
+    if(fb->isn_known && next > 0) holes++;
+    double offset = 0;
+    for(size_t i = 0; i < fb->segments_count; i++) {
+        const struct raw_segment *rs = &fb->segments[i];
+        int64_t end = rs->position + (int64_t)rs->size;
+        if(end <= next) continue; /* Retransmission */
+        size_t skip = 0;
+        if(rs->position < next) {
+            skip = next - rs->position;
+        } else if(rs->position > next) {
+            holes++;
+        }
+        /* Reordered segments are sent no earlier than the preceding ones. */
+        if(offset < rs->ts - fb->first_ts) offset = rs->ts - fb->first_ts;
+        struct pcap_segment *seg = &flow->segments[flow->segments_count++];
+        seg->data = rs->data + skip;
+        seg->size = rs->size - skip;
+        seg->offset = offset;
+        flow->total_size += seg->size;
+        next = end;
+    }
+
+    return holes;
+}
+
+struct pcap_replay *
+pcap_replay_open(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if(fd == -1) {
+        fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) == -1) {
+        fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    if(st.st_size < 4) {
+        fprintf(stderr, "%s: Not a pcap or pcapng file\n", filename);
+        close(fd);
+        return NULL;
+    }
+
+    /*
+     * The packet data is referred to directly from the mapping,
+     * so the capture is paged in on demand rather than read whole.
+     */
+    size_t size = st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) {
+        fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+        return NULL;
+    }
+
+    struct pcap_parser *parser = calloc(1, sizeof(*parser));
+    assert(parser);
+    parser->filename = filename;
+
+    int ret;
+    switch(get32(map, 0)) {
+    case 0xa1b2c3d4:
+    case 0xd4c3b2a1:
+    case 0xa1b23c4d:
+    case 0x4d3cb2a1:
+        ret = parse_pcap(parser, map, size);
+        break;
+    case 0x0a0d0d0a:
+        ret = parse_pcapng(parser, map, size);
+        break;
+    default:
+        fprintf(stderr, "%s: Not a pcap or pcapng file\n", filename);
+        ret = -1;
+    }
+
+    struct pcap_replay *pr = calloc(1, sizeof(*pr));
+    assert(pr);
+    pr->map = map;
+    pr->map_size = size;
+    pr->flows = calloc(parser->flows_count + 1, sizeof(pr->flows[0]));
+    assert(pr->flows);
+
+    size_t holes = 0;
+    for(size_t i = 0; i < parser->flows_count; i++) {
+        struct flow_builder *fb = parser->flows[i];
+        if(ret == 0) {
+            struct pcap_flow *flow = &pr->flows[pr->flows_count];
+            holes += reassemble_flow(fb, flow);
+            /* Flows where the client did not say anything are of no use. */
+            if(flow->total_size)
+                pr->flows_count++;
+            else
+                free(flow->segments);
+        }
+        free(fb->segments);
+        free(fb);
+    }
+    size_t tcp_packets = parser->tcp_packets;
+    free(parser->flows);
+    free(parser);
+
+    if(ret == 0 && pr->flows_count == 0) {
+        fprintf(stderr,
+                "%s: No TCP connections with client data found "
+                "among %zu TCP packets\n",
+                filename, tcp_packets);
+        ret = -1;
+    }
+    if(ret != 0) {
+        pcap_replay_close(pr);
+        return NULL;
+    }
+
+    if(holes) {
+        fprintf(stderr,
+                "%s: Warning: %zu hole%s in the client data due to "
+                "packets missing from the capture\n",
+                filename, holes, holes == 1 ? "" : "s");
+    }
+
+    return pr;
+}
+
+const struct pcap_flow *
+pcap_replay_next_flow(struct pcap_replay *pr) {
+    size_t n = atomic_inc_and_get(&pr->flows_taken) - 1;
+    return &pr->flows[n % pr->flows_count];
+}
+
+void
+pcap_replay_close(struct pcap_replay *pr) {
+    if(!pr) return;
+    for(size_t i = 0; i < pr->flows_count; i++) {
+        free(pr->flows[i].segments);
+    }
+    free(pr->flows);
+    munmap(pr->map, pr->map_size);
+    free(pr);
+}
+
+#ifdef TCPKALI_PCAP_UNIT_TEST
+
+struct capture {
+    uint8_t buf[4096];
+    size_t len;
+};
+
+static void
+put(struct capture *c, const void *data, size_t size) {
+    assert(c->len + size <= sizeof(c->buf));
+    memcpy(c->buf + c->len, data, size);
+    c->len += size;
+}
+
+static void
+put_le32(struct capture *c, uint32_t v) {
+    uint8_t b[4] = {v, v >> 8, v >> 16, v >> 24};
+    put(c, b, 4);
+}
+
+static void
+put_le16(struct capture *c, uint16_t v) {
+    uint8_t b[2] = {v, v >> 8};
+    put(c, b, 2);
+}
+
+/*
+ * Compose an IPv4 or IPv6 TCP packet between 10.0.0.1:40000 (client)
+ * and 10.0.0.2:80 (server), or their IPv6 counterparts.
+ */
+static size_t
+make_packet(uint8_t *pkt, int ipv6, int from_client, uint32_t seq,
+            uint32_t ack, int flags, const char *payload) {
+    size_t plen = strlen(payload);
+    size_t ip_len = ipv6 ? 40 : 20;
+    uint8_t *tcp = pkt + ip_len;
+    uint8_t client[16] = {10, 0, 0, 1};
+    uint8_t server[16] = {10, 0, 0, 2};
+    uint16_t cport = 40000;
+    uint16_t sport = 80;
+
+    memset(pkt, 0, ip_len + 20);
+    if(ipv6) {
+        pkt[0] = 0x60;
+        pkt[4] = (20 + plen) >> 8;
+        pkt[5] = (20 + plen);
+        pkt[6] = 6;
+        memcpy(pkt + 8, from_client ? client : server, 16);
+        memcpy(pkt + 24, from_client ? server : client, 16);
+    } else {
+        pkt[0] = 0x45;
+        pkt[2] = (20 + 20 + plen) >> 8;
+        pkt[3] = (20 + 20 + plen);
+        pkt[6] = 0x40; /* Don't fragment */
+        pkt[9] = 6;
+        memcpy(pkt + 12, from_client ? client : server, 4);
+        memcpy(pkt + 16, from_client ? server : client, 4);
+    }
+    tcp[0] = (from_client ? cport : sport) >> 8;
+    tcp[1] = (from_client ? cport : sport);
+    tcp[2] = (from_client ? sport : cport) >> 8;
+    tcp[3] = (from_client ? sport : cport);
+    for(int i = 0; i < 4; i++) {
+        tcp[4 + i] = seq >> (24 - 8 * i);
+        tcp[8 + i] = ack >> (24 - 8 * i);
+    }
+    tcp[12] = 5 << 4;
+    tcp[13] = flags;
+    memcpy(tcp + 20, payload, plen);
+    return ip_len + 20 + plen;
+}
+
+/*
+ * A client sends "Hello, world!" in three pieces: one piece is
+ * retransmitted, another arrives out of order.
+ */
+static const struct {
+    int from_client;
+    uint32_t seq;
+    int flags;
+    const char *payload;
+} conversation[] = {{1, 0xfffffffa, TCP_SYN, ""},
+                    {0, 1000, TCP_SYN | TCP_ACK, ""},
+                    {1, 0xfffffffb, TCP_ACK, "Hello"},
+                    {1, 0xfffffffb, TCP_ACK, "Hello"},
+                    {1, 0xfffffffb + 12, TCP_ACK, "!"},
+                    {1, 0xfffffffb + 3, TCP_ACK, "lo, world"},
+                    {0, 1001, TCP_ACK, "HTTP/1.0 200 OK"},
+                    {1, 0xfffffffb + 13, TCP_ACK | TCP_FIN, ""}};
+#define CONVERSATION_SIZE (sizeof(conversation) / sizeof(conversation[0]))
+
+static void
+make_pcap(struct capture *c) {
+    uint8_t pkt[256];
+    uint8_t eth[14] = {0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 6, 0x08, 0x00};
+
+    put_le32(c, 0xa1b2c3d4);
+    put_le16(c, 2);
+    put_le16(c, 4);
+    put_le32(c, 0);
+    put_le32(c, 0);
+    put_le32(c, 65535);
+    put_le32(c, LINKTYPE_ETHERNET);
+    for(size_t i = 0; i < CONVERSATION_SIZE; i++) {
+        size_t len = make_packet(pkt, 0, conversation[i].from_client,
+                                 conversation[i].seq, 0,
+                                 conversation[i].flags,
+                                 conversation[i].payload);
+        put_le32(c, 1500000000);
+        put_le32(c, 100000 * i); /* 0.1s apart */
+        put_le32(c, 14 + len);
+        put_le32(c, 14 + len);
+        put(c, eth, 14);
+        put(c, pkt, len);
+    }
+}
+
+static void
+make_pcapng(struct capture *c) {
+    uint8_t pkt[256];
+    static const uint8_t zeros[4];
+
+    /* Section Header Block */
+    put_le32(c, 0x0a0d0d0a);
+    put_le32(c, 28);
+    put_le32(c, 0x1a2b3c4d);
+    put_le16(c, 1);
+    put_le16(c, 0);
+    put_le32(c, 0xffffffff);
+    put_le32(c, 0xffffffff);
+    put_le32(c, 28);
+
+    /* Interface Description Block with nanosecond resolution */
+    put_le32(c, 1);
+    put_le32(c, 32);
+    put_le16(c, LINKTYPE_RAW);
+    put_le16(c, 0);
+    put_le32(c, 65535);
+    put_le16(c, 9); /* if_tsresol */
+    put_le16(c, 1);
+    put(c, "\x09\0\0", 4);
+    put_le32(c, 0); /* opt_endofopt */
+    put_le32(c, 32);
+
+    for(size_t i = 0; i < CONVERSATION_SIZE; i++) {
+        size_t len = make_packet(pkt, 1, conversation[i].from_client,
+                                 conversation[i].seq, 0,
+                                 conversation[i].flags,
+                                 conversation[i].payload);
+        size_t padded = (len + 3) & ~3u;
+        uint64_t ts = 1500000000000000000ull + 100000000ull * i;
+        put_le32(c, 6);
+        put_le32(c, 32 + padded);
+        put_le32(c, 0);
+        put_le32(c, ts >> 32);
+        put_le32(c, ts);
+        put_le32(c, len);
+        put_le32(c, len);
+        put(c, pkt, len);
+        put(c, zeros, padded - len);
+        put_le32(c, 32 + padded);
+    }
+}
+
+static void
+check_capture(const struct capture *c) {
+    char filename[] = "/tmp/check_tcpkali_pcap.XXXXXX";
+    int fd = mkstemp(filename);
+    assert(fd != -1);
+    if(write(fd, c->buf, c->len) != (ssize_t)c->len) {
+        fprintf(stderr, "%s: Can not write the test capture\n", filename);
+        exit(1);
+    }
+    close(fd);
+
+    struct pcap_replay *pr = pcap_replay_open(filename);
+    unlink(filename);
+    assert(pr);
+    assert(pr->flows_count == 1);
+
+    const struct pcap_flow *flow = pcap_replay_next_flow(pr);
+    assert(flow == pcap_replay_next_flow(pr));
+    assert(flow->total_size == strlen("Hello, world!"));
+    assert(flow->segments_count == 3);
+    assert(flow->duration > 0.69 && flow->duration < 0.71);
+
+    char stream[32] = {0};
+    size_t off = 0;
+    double prev_offset = 0;
+    for(size_t i = 0; i < flow->segments_count; i++) {
+        memcpy(stream + off, flow->segments[i].data, flow->segments[i].size);
+        off += flow->segments[i].size;
+        assert(flow->segments[i].offset >= prev_offset);
+        prev_offset = flow->segments[i].offset;
+    }
+    assert(strcmp(stream, "Hello, world!") == 0);
+    /* "Hello" is sent at 0.2s, not at its 0.3s retransmission */
+    assert(flow->segments[0].offset > 0.19 && flow->segments[0].offset < 0.21);
+    /* "!" came before "lo, world", so it waits for it */
+    assert(flow->segments[2].offset > 0.49 && flow->segments[2].offset < 0.51);
+
+    pcap_replay_close(pr);
+}
+
+int
+main() {
+    struct capture c;
+
+    memset(&c, 0, sizeof(c));
+    make_pcap(&c);
+    check_capture(&c);
+
+    memset(&c, 0, sizeof(c));
+    make_pcapng(&c);
+    check_capture(&c);
+
+    /* Not a capture */
+    memset(&c, 0, sizeof(c));
+    put(&c, "GET / HTTP/1.0\r\n\r\n", 18);
+    char filename[] = "/tmp/check_tcpkali_pcap.XXXXXX";
+    int fd = mkstemp(filename);
+    assert(fd != -1);
+    if(write(fd, c.buf, c.len) != (ssize_t)c.len) {
+        fprintf(stderr, "%s: Can not write the test capture\n", filename);
+        exit(1);
+    }
+    close(fd);
+    assert(pcap_replay_open(filename) == NULL);
+    unlink(filename);
+
+    printf("OK\n");
+    return 0;
+}
+
+#endif /* TCPKALI_PCAP_UNIT_TEST */
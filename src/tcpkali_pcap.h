@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef TCPKALI_PCAP_H
+#define TCPKALI_PCAP_H
+
+#include "tcpkali_atomic.h"
+
+/*
+ * Replay the client side of the TCP connections recorded
+ * in a pcap or pcapng capture file (--pcap).
+ */
+
+/*
+ * A chunk of the client byte stream. The data points into the
+ * memory-mapped capture file.
+ */
+struct pcap_segment {
+    const void *data;
+    size_t size;
+    double offset; /* Seconds since the first packet of the flow */
+};
+
+/*
+ * The client byte stream of a single TCP connection, with retransmissions
+ * and reordering already sorted out.
+ */
+struct pcap_flow {
+    struct pcap_segment *segments;
+    size_t segments_count;
+    size_t total_size;
+    double duration; /* Until the last packet in either direction */
+};
+
+struct pcap_replay {
+    void *map;
+    size_t map_size;
+    struct pcap_flow *flows;
+    size_t flows_count;
+    atomic_narrow_t flows_taken;
+};
+
+/*
+ * Map the capture file and reassemble the client streams.
+ * Returns NULL and prints the reason if the file can not be used.
+ */
+struct pcap_replay *pcap_replay_open(const char *filename);
+
+/*
+ * Pick the flow for the next connection, in a round-robin fashion.
+ * Safe to call from multiple threads.
+ */
+const struct pcap_flow *pcap_replay_next_flow(struct pcap_replay *);
+
+void pcap_replay_close(struct pcap_replay *);
+
+#endif /* TCPKALI_PCAP_H */
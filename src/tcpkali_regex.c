@@ -24,8 +24,11 @@ struct tregex {
             size_t size;
         } chars;
         struct {
-            unsigned char size;
+            unsigned size;
             unsigned char table[256];
+            /* Random byte to character map, see tregex_class_prepare(). */
+            unsigned char lut[256];
+            unsigned accept_below;
         } oneof;
         struct {
             tregex *piece[TREGEX_ELEMENTS];
@@ -136,6 +139,53 @@ tregex_join(tregex *re, tregex *rhs) {
     assert(!"Unreachable");
 }
 
+/*
+ * Map each random byte value into a class character. The byte values
+ * at and above (accept_below) are rejected to keep the characters
+ * distributed uniformly.
+ */
+static void
+tregex_class_prepare(tregex *re) {
+    unsigned size = re->oneof.size;
+    assert(size >= 1 && size <= 256);
+    re->oneof.accept_below = 256 - (256 % size);
+    for(unsigned b = 0; b < 256; b++) {
+        re->oneof.lut[b] = re->oneof.table[b % size];
+    }
+}
+
+/*
+ * Fill the buffer with (n) random characters of the class, taking
+ * up to four characters out of each random number.
+ */
+static void
+tregex_class_fill(tregex *re, char *buf, size_t n, pcg32_random_t *rng) {
+    const unsigned char *lut = re->oneof.lut;
+    const unsigned accept_below = re->oneof.accept_below;
+
+    if(accept_below == 256) {
+        /* Every byte is usable, e.g. a class of all 256 byte values. */
+        for(; n >= 4; n -= 4) {
+            uint32_t r = pcg32_random_r(rng);
+            *buf++ = lut[r & 0xff];
+            *buf++ = lut[(r >> 8) & 0xff];
+            *buf++ = lut[(r >> 16) & 0xff];
+            *buf++ = lut[r >> 24];
+        }
+    }
+
+    while(n) {
+        uint32_t r = pcg32_random_r(rng);
+        for(int i = 0; i < 4 && n; i++, r >>= 8) {
+            unsigned b = r & 0xff;
+            if(b < accept_below) {
+                *buf++ = lut[b];
+                n--;
+            }
+        }
+    }
+}
+
 tregex *
 tregex_range(unsigned char from, unsigned char to) {
     tregex *re = calloc(1, sizeof(*re));
@@ -146,6 +196,7 @@ tregex_range(unsigned char from, unsigned char to) {
     for(unsigned i = from; i <= to; i++) {
         re->oneof.table[re->oneof.size++] = i;
     }
+    tregex_class_prepare(re);
     return re;
 }
 
@@ -167,6 +218,7 @@ tregex_range_from_string(const char *str, ssize_t len) {
             re->oneof.table[re->oneof.size++] = c;
         }
     }
+    tregex_class_prepare(re);
     return re;
 }
 
@@ -182,9 +234,11 @@ tregex_union_ranges(tregex *re, tregex *rhs) {
     for(size_t i = 0; i < rhs->oneof.size; i++) {
         unsigned char c = rhs->oneof.table[i];
         if(!used[c]) {
+            used[c] = 1;
             re->oneof.table[re->oneof.size++] = c;
         }
     }
+    tregex_class_prepare(re);
     return re;
 }
 
@@ -292,6 +346,12 @@ tregex_eval_rng(tregex *re, char *buf, size_t size, pcg32_random_t *rng) {
     case TRegexRepeat: {
         size_t cycles = re->repeat.minimum
                         + (re->repeat.range ? pcg32_boundedrand_r(rng, re->repeat.range) : 0);
+        if(re->repeat.what->kind == TRegexClass) {
+            /* [a-z]{1000}: fill in bulk rather than one by one. */
+            tregex_class_fill(re->repeat.what, buf, cycles, rng);
+            buf += cycles;
+            break;
+        }
         for(unsigned i = 0; i < cycles; i++) {
             buf += tregex_eval_rng(re->repeat.what, buf, bend - buf, rng);
         }
@@ -368,6 +428,35 @@ main() {
     assert(buf[0] == 'a' || buf[0] == 'b');
     tregex_free(re);
 
+    /* [a-z]{100}, uniformly */
+    re = tregex_repeat(tregex_range('a', 'z'), 100, 100);
+    unsigned seen[26] = {0};
+    for(int i = 0; i < 1000; i++) {
+        n = tregex_eval(re, buf, sizeof(buf));
+        assert(n == 100);
+        for(int j = 0; j < n; j++) {
+            assert(buf[j] >= 'a' && buf[j] <= 'z');
+            seen[buf[j] - 'a']++;
+        }
+    }
+    for(int i = 0; i < 26; i++) {
+        /* Expecting 3846 of each */
+        assert(seen[i] > 3400 && seen[i] < 4300);
+    }
+    tregex_free(re);
+
+    /* All byte values */
+    re = tregex_repeat(tregex_range(0, 255), 7, 7);
+    n = tregex_eval(re, buf, sizeof(buf));
+    assert(n == 7);
+    tregex_free(re);
+
+    /* [ab][bc] */
+    re = tregex_union_ranges(tregex_range_from_string("ab", -1),
+                             tregex_range_from_string("bc", -1));
+    assert(re->oneof.size == 3);
+    tregex_free(re);
+
     /* a|b */
     re = tregex_alternative(tregex_string("a", -1));
     re = tregex_alternative_add(re, tregex_string("b", -1));
@@ -41,6 +41,9 @@
 #include "tcpkali_engine.h"
 #include "tcpkali_pacefier.h"
 #include "tcpkali_terminfo.h"
+#include "tcpkali_hdr_log.h"
+#include "tcpkali_metrics.h"
+#include "tcpkali_json.h"
 
 #include "TcpkaliMessage.h"
 
@@ -98,11 +101,11 @@ print_connections_line(int conns, int max_conns, int conns_counter) {
 
 static int
 format_latency(char *buf, size_t size, const char *prefix,
-               struct hdr_histogram *hist) {
+               struct hdr_histogram *hist, double percentile) {
     if(hist) {
         if(hist->total_count) {
             return snprintf(buf, size, "%s%.1f ", prefix,
-                            hdr_value_at_percentile(hist, 95.0) / 10.0);
+                            hdr_value_at_percentile(hist, percentile) / 10.0);
         } else {
             return snprintf(buf, size, "%s? ", prefix);
         }
@@ -111,19 +114,49 @@ format_latency(char *buf, size_t size, const char *prefix,
     }
 }
 
+/*
+ * Print the percentile as a superscript, e.g. "⁹⁹·⁹ᵖ" for 99.9.
+ */
+static int
+format_percentile_superscript(char *buf, size_t size, double percentile) {
+    static const char *const superscript_digits[] = {
+        "⁰", "¹", "²", "³", "⁴", "⁵", "⁶", "⁷", "⁸", "⁹"};
+    char digits[32];
+    char *p = buf;
+
+    snprintf(digits, sizeof(digits), "%g", percentile);
+    for(const char *d = digits; *d; d++) {
+        const char *sup = (*d >= '0' && *d <= '9') ? superscript_digits[*d - '0']
+                                                   : "·";
+        p += snprintf(p, size - (p - buf), "%s", sup);
+    }
+    p += snprintf(p, size - (p - buf), "ᵖ");
+    return p - buf;
+}
+
 static void
-format_latencies(char *buf, size_t size, struct latency_snapshot *latency) {
+format_latencies(char *buf, size_t size, struct latency_snapshot *latency,
+                 double percentile) {
     if(latency->connect_histogram || latency->firstbyte_histogram
-       || latency->marker_histogram) {
+       || latency->marker_histogram || latency->tls_histogram
+       || latency->upgrade_histogram || latency->appbyte_histogram) {
         char *p = buf;
         p += snprintf(p, size, " (");
         p += format_latency(p, size-(p-buf),
-                            "c=", latency->connect_histogram);
+                            "c=", latency->connect_histogram, percentile);
         p += format_latency(p, size-(p-buf),
-                            "fb=", latency->firstbyte_histogram);
+                            "tls=", latency->tls_histogram, percentile);
         p += format_latency(p, size-(p-buf),
-                            "m=", latency->marker_histogram);
-        snprintf(p, size - (p - buf), "ms⁹⁵ᵖ)");
+                            "up=", latency->upgrade_histogram, percentile);
+        p += format_latency(p, size-(p-buf),
+                            "ab=", latency->appbyte_histogram, percentile);
+        p += format_latency(p, size-(p-buf),
+                            "fb=", latency->firstbyte_histogram, percentile);
+        p += format_latency(p, size-(p-buf),
+                            "m=", latency->marker_histogram, percentile);
+        p += snprintf(p, size - (p - buf), "ms");
+        p += format_percentile_superscript(p, size - (p - buf), percentile);
+        snprintf(p, size - (p - buf), ")");
     } else {
         buf[0] = '\0';
     }
@@ -156,101 +189,270 @@ every(double delta_time, double now, double *checkpoint_time) {
     }
 }
 
+/*
+ * Estimate the latency at the given percentile (in seconds) along with
+ * its 95% confidence interval. The interval is derived from the order
+ * statistics: the rank of the percentile's sample in (n) observations
+ * is approximately normally distributed with the standard deviation
+ * of sqrt(n*q*(1-q)).
+ * Returns the number of observations used for the estimate.
+ */
+static int64_t
+estimate_latency_at_percentile(struct hdr_histogram *hist, double percentile,
+                               double *latency, double *ci_low,
+                               double *ci_high) {
+    int64_t n = hist->total_count;
+    if(n <= 0) return 0;
+
+    double q = percentile / 100.0;
+    double halfwidth = 1.96 * sqrt(q * (1 - q) / n);
+    double q_low = q - halfwidth < 0.0 ? 0.0 : q - halfwidth;
+    double q_high = q + halfwidth > 1.0 ? 1.0 : q + halfwidth;
+
+    /* Histogram values are in 1/10 ms units. */
+    *latency = hdr_value_at_percentile(hist, 100 * q) / 10000.0;
+    *ci_low = hdr_value_at_percentile(hist, 100 * q_low) / 10000.0;
+    *ci_high = hdr_value_at_percentile(hist, 100 * q_high) / 10000.0;
+
+    return n;
+}
+
+static struct hdr_histogram *
+copy_histogram(struct hdr_histogram *hist) {
+    struct hdr_histogram *copy;
+    int ret = hdr_init(hist->lowest_trackable_value,
+                       hist->highest_trackable_value,
+                       hist->significant_figures, &copy);
+    assert(ret == 0);
+    hdr_add(copy, hist);
+    return copy;
+}
+
+/*
+ * Pick the next rate within the (rate_min_bound, rate_max_bound) bracket.
+ * The latency tends to grow exponentially as the load approaches capacity,
+ * so we linearly interpolate the logarithm of latency between the bounds
+ * (regula falsi). The guard band guarantees that the bracket shrinks
+ * at least by 10% on every step even if the model is off.
+ */
+static double
+interpolate_rate(const struct rate_modulator *rm) {
+    double span = rm->rate_max_bound - rm->rate_min_bound;
+    double guard = span / 10;
+    double rate;
+
+    if(rm->latency_at_min_bound > 0
+       && rm->latency_at_max_bound > rm->latency_at_min_bound) {
+        double lmin = log(rm->latency_at_min_bound);
+        double lmax = log(rm->latency_at_max_bound);
+        double ltarget = log(rm->latency_target);
+        rate = rm->rate_min_bound + span * (ltarget - lmin) / (lmax - lmin);
+    } else {
+        rate = rm->rate_min_bound + span / 2;
+    }
+
+    if(rate < rm->rate_min_bound + guard) rate = rm->rate_min_bound + guard;
+    if(rate > rm->rate_max_bound - guard) rate = rm->rate_max_bound - guard;
+    return rate;
+}
+
 static enum {
     MRR_ONGOING,
     MRR_RATE_SEARCH_SUCCEEDED,
     MRR_RATE_SEARCH_FAILED
-} modulate_request_rate(struct engine *eng, double now,
-                        struct rate_modulator *rm,
+} modulate_request_rate(struct oc_args *args, double now, size_t conns_out,
                         struct latency_snapshot *latency) {
+    struct rate_modulator *rm = args->rate_modulator;
     if(rm->mode == RM_UNMODULATED || !latency->marker_histogram)
         return MRR_ONGOING;
     /*
      * Do not measure and modulate latency estimates more frequently than
      * necessary.
      */
-    const double short_time = 1.0; /* Every second */
-    const double long_time = 10.0;
+    const double short_time = 1.0;    /* Every second */
+    const double settle_time = 1.0;   /* Let queues adapt to a new rate */
+    const double max_step_time = 10.0; /* Give up on narrowing the CI */
+    const double max_settle_time = 30.0; /* Give up on waiting for drain */
     if(rm->state == RMS_STATE_INITIAL) {
-        const struct engine_params *params = engine_params(eng);
-        if(params->channel_send_rate.value_base == RS_MESSAGES_PER_SECOND)
+        const struct engine_params *params = engine_params(args->eng);
+        if(rm->mode == RM_MAX_CONNECTIONS_AT_TARGET_LATENCY)
+            rm->suggested_rate_value = args->max_connections;
+        else if(params->channel_send_rate.value_base == RS_MESSAGES_PER_SECOND)
             rm->suggested_rate_value = params->channel_send_rate.value;
         else
             rm->suggested_rate_value = 100;
-        rm->binary_search_steps = 15;
+        if(rm->latency_percentile <= 0) rm->latency_percentile = 95.0;
+        rm->search_steps = 25;
+        rm->rate_min_bound = 0;
+        rm->rate_max_bound = INFINITY;
         rm->last_update_short = now;
-        rm->last_update_long = now;
+        rm->step_started = now;
+        rm->conns_changed = now;
         rm->state = RMS_RATE_RAMP_UP;
     }
 
+    /*
+     * New connections are opened at --connect-rate, so the step
+     * effectively starts when all of them are established.
+     * Give up if the connection count stops moving towards the goal,
+     * for example when the target refuses new connections.
+     */
+    if(rm->mode == RM_MAX_CONNECTIONS_AT_TARGET_LATENCY
+       && conns_out < (size_t)args->max_connections) {
+        if(conns_out != rm->conns_seen) {
+            rm->conns_seen = conns_out;
+            rm->conns_changed = now;
+        } else if(now - rm->conns_changed >= max_settle_time) {
+            fprintf(stderr,
+                    "Could not open %d connections, stuck at %zu "
+                    "for %g seconds%s\n",
+                    args->max_connections, conns_out, max_settle_time,
+                    tcpkali_clear_eol());
+            return MRR_RATE_SEARCH_FAILED;
+        }
+        rm->step_started = now;
+        return MRR_ONGOING;
+    }
+
+    /*
+     * Discard the latencies of messages which were queued at the
+     * previous rate: start measuring after the settle time passes.
+     */
+    if(now - rm->step_started < settle_time) return MRR_ONGOING;
+    if(!rm->window_base
+       || rm->window_base->total_count > latency->marker_histogram->total_count) {
+        free(rm->window_base);
+        free(rm->window_last);
+        rm->window_base = copy_histogram(latency->marker_histogram);
+        rm->window_last = copy_histogram(latency->marker_histogram);
+        rm->latency_last = 0;
+        rm->last_update_short = now;
+        rm->window_started = now;
+        return MRR_ONGOING;
+    }
+
     if(!every(short_time, now, &rm->last_update_short)) return MRR_ONGOING;
 
-    double lat = hdr_value_at_percentile(latency->marker_histogram, 95.0) / 10.0
-                 / 1000.0;
-    if(every(long_time, now, &rm->last_update_long)) {
-        /*
-         * Every long time (to make moving averages stabilize a bit)
-         * we do assessment and ramp up furtheri or adjust lower and
-         * upper bounds if we're doing a binary search for the best rate.
-         */
-        rm->prev_latency = lat;
-        rm->prev_max_latency_exceeded = 0;
-
-        if(rm->state == RMS_RATE_RAMP_UP) {
-            if(lat < 1.5 * rm->latency_target) {
-                if(lat < 0.95 * rm->latency_target) {
-                    rm->rate_min_bound = rm->suggested_rate_value;
-                    rm->rate_max_bound = INFINITY;
-                }
-                rm->suggested_rate_value *= 4;
-            } else {
-                rm->state = RMS_RATE_BINARY_SEARCH;
-                rm->rate_max_bound = rm->suggested_rate_value;
-            }
-        }
-        if(rm->state == RMS_RATE_BINARY_SEARCH) {
-            if(rm->binary_search_steps-- <= 0) return MRR_RATE_SEARCH_FAILED;
+    int step_over = (now - rm->window_started >= max_step_time);
+    double lat, ci_low, ci_high;
 
-            if(lat < 0.98 * rm->latency_target) {
-                rm->rate_min_bound = rm->suggested_rate_value;
-            } else if(lat > 1.01 * rm->latency_target) {
-                rm->rate_max_bound = rm->suggested_rate_value;
-            } else {
-                return MRR_RATE_SEARCH_SUCCEEDED;
-            }
-            /* If bounds are within 1% of each other, means we've failed */
-            if(rm->rate_max_bound > 0
-               && 0.001 > ((rm->rate_max_bound - rm->rate_min_bound) / 2)
-                              / rm->rate_min_bound) {
-                if(lat <= rm->latency_target) return MRR_RATE_SEARCH_SUCCEEDED;
-                return MRR_RATE_SEARCH_FAILED;
-            }
-            rm->suggested_rate_value =
-                (rm->rate_max_bound + rm->rate_min_bound) / 2.0;
+    /*
+     * If the previous rate overloaded the system, the backlog takes time
+     * to drain. While the latency observed over the last short interval
+     * keeps going down, the system has not settled yet: restart the window.
+     */
+    struct hdr_histogram *recent =
+        hdr_diff(rm->window_last, latency->marker_histogram);
+    assert(recent);
+    int64_t recent_samples = estimate_latency_at_percentile(
+        recent, rm->latency_percentile, &lat, &ci_low, &ci_high);
+    free(recent);
+    free(rm->window_last);
+    rm->window_last = copy_histogram(latency->marker_histogram);
+    if(recent_samples) {
+        int draining = (ci_high < rm->latency_last);
+        rm->latency_last = lat;
+        if(draining && now - rm->step_started < max_settle_time) {
+            free(rm->window_base);
+            rm->window_base = copy_histogram(latency->marker_histogram);
+            rm->window_started = now;
+            return MRR_ONGOING;
         }
-        engine_set_message_send_rate(eng, rm->suggested_rate_value);
-        fprintf(stderr, "Attempting --message-rate %g (in range %g..%g)%s\n",
-                rm->suggested_rate_value, rm->rate_min_bound,
-                rm->rate_max_bound, tcpkali_clear_eol());
-    } else if(rm->state == RMS_RATE_RAMP_UP) {
-        if(lat > 2 * rm->latency_target) {
-            if(lat > rm->prev_latency) {
-                rm->prev_max_latency_exceeded++;
-            } else {
-                /* If we're fluctuating, disable fast exit from RAMP_UP */
-                rm->prev_max_latency_exceeded = -1000;
-            }
+    }
+
+    struct hdr_histogram *window =
+        hdr_diff(rm->window_base, latency->marker_histogram);
+    assert(window);
+    int64_t samples = estimate_latency_at_percentile(
+        window, rm->latency_percentile, &lat, &ci_low, &ci_high);
+    free(window);
+
+    /*
+     * Wait until there are enough observations in the tail to make
+     * the percentile meaningful, or until we run out of patience.
+     */
+    double tail_samples = samples * (1 - rm->latency_percentile / 100.0);
+    if(samples == 0 || (tail_samples < 10 && !step_over)) return MRR_ONGOING;
+
+    enum { LAT_BELOW, LAT_ABOVE, LAT_AT_TARGET } verdict;
+    if(ci_high < rm->latency_target) {
+        verdict = LAT_BELOW;
+    } else if(ci_low > rm->latency_target) {
+        verdict = LAT_ABOVE;
+    } else if(ci_high - ci_low <= 0.05 * rm->latency_target) {
+        /* Target is within a narrow confidence interval. */
+        verdict = LAT_AT_TARGET;
+    } else if(!step_over) {
+        return MRR_ONGOING; /* Collect more observations */
+    } else if(lat >= 0.98 * rm->latency_target
+              && lat <= 1.01 * rm->latency_target) {
+        verdict = LAT_AT_TARGET;
+    } else {
+        verdict = lat < rm->latency_target ? LAT_BELOW : LAT_ABOVE;
+    }
+
+    switch(verdict) {
+    case LAT_AT_TARGET:
+    case LAT_BELOW:
+        rm->rate_min_bound = rm->suggested_rate_value;
+        rm->latency_at_min_bound = lat;
+        rm->latency_at_min_bound_ci[0] = ci_low;
+        rm->latency_at_min_bound_ci[1] = ci_high;
+        if(verdict == LAT_AT_TARGET) return MRR_RATE_SEARCH_SUCCEEDED;
+        break;
+    case LAT_ABOVE:
+        rm->rate_max_bound = rm->suggested_rate_value;
+        rm->latency_at_max_bound = lat;
+        rm->state = RMS_RATE_SEARCH;
+        break;
+    }
+
+    if(rm->state == RMS_RATE_RAMP_UP) {
+        rm->suggested_rate_value *= (lat < rm->latency_target / 2) ? 4 : 2;
+    } else {
+        if(rm->search_steps-- <= 0) return MRR_RATE_SEARCH_FAILED;
+        /* If bounds are within 1% of each other, we're done. */
+        if(rm->rate_min_bound > 0
+           && ((rm->rate_max_bound - rm->rate_min_bound) / rm->rate_min_bound
+                   < 0.01
+               || (rm->mode == RM_MAX_CONNECTIONS_AT_TARGET_LATENCY
+                   && rm->rate_max_bound - rm->rate_min_bound <= 1))) {
+            rm->suggested_rate_value = rm->rate_min_bound;
+            return MRR_RATE_SEARCH_SUCCEEDED;
         }
-        rm->prev_latency = lat;
-        /*
-         * If for the last few seconds we've been consistently increasing
-         * latency, quickly exit the ramp-up state.
-         */
-        if(rm->prev_max_latency_exceeded > 3) {
-            rm->state = RMS_RATE_BINARY_SEARCH;
-            rm->rate_max_bound = rm->suggested_rate_value;
+        rm->suggested_rate_value = interpolate_rate(rm);
+    }
+
+    const char *option;
+    if(rm->mode == RM_MAX_CONNECTIONS_AT_TARGET_LATENCY) {
+        int conns = round(rm->suggested_rate_value);
+        if(rm->state == RMS_RATE_SEARCH) {
+            /* Make sure we try a new count strictly within bounds. */
+            if(conns <= rm->rate_min_bound) conns = rm->rate_min_bound + 1;
+            if(conns >= rm->rate_max_bound) conns = rm->rate_max_bound - 1;
         }
+        if(conns < 1) conns = 1;
+        rm->suggested_rate_value = conns;
+        if(conns < args->max_connections)
+            engine_terminate_connections(args->eng,
+                                         args->max_connections - conns);
+        args->max_connections = conns;
+        option = "--connections";
+    } else {
+        engine_set_message_send_rate(args->eng, rm->suggested_rate_value);
+        option = "--message-rate";
     }
+    rm->step_started = now;
+    rm->conns_changed = now;
+    free(rm->window_base);
+    rm->window_base = NULL;
+    free(rm->window_last);
+    rm->window_last = NULL;
+    fprintf(stderr,
+            "Attempting %s %g (in range %g..%g), "
+            "last latency %.1f ms (%.1f..%.1f)%s\n",
+            option, rm->suggested_rate_value, rm->rate_min_bound, rm->rate_max_bound,
+            1000 * lat, 1000 * ci_low, 1000 * ci_high, tcpkali_clear_eol());
 
     return MRR_ONGOING;
 }
@@ -263,6 +465,9 @@ reinit_latency_snapshot(struct oc_args *args) {
         engine_prepare_latency_snapshot(args->eng);
         args->previous_window_latency =
             engine_collect_latency_snapshot(args->eng);
+        engine_free_destination_snapshot(args->previous_window_destinations);
+        args->previous_window_destinations =
+            engine_collect_destination_snapshot(args->eng);
     }
 }
 
@@ -331,6 +536,66 @@ process_orch_events(struct oc_args *args,
     return 1;
 }
 
+void
+flush_hdr_log(struct oc_args *args) {
+    if(!args->hdr_log) return;
+
+    tk_now_update(TK_DEFAULT);
+    double now = tk_now(TK_DEFAULT);
+    engine_prepare_latency_snapshot(args->eng);
+    struct latency_snapshot *latency =
+        engine_collect_latency_snapshot(args->eng);
+
+    if(args->previous_hdr_log_latency) {
+        struct latency_snapshot *diff = engine_diff_latency_snapshot(
+            args->previous_hdr_log_latency, latency);
+        double start = args->checkpoint.last_hdr_log_flush;
+        if(diff->connect_histogram)
+            hdr_log_write(args->hdr_log, "connect", start, now,
+                          diff->connect_histogram);
+        if(diff->firstbyte_histogram)
+            hdr_log_write(args->hdr_log, "firstbyte", start, now,
+                          diff->firstbyte_histogram);
+        if(diff->marker_histogram)
+            hdr_log_write(args->hdr_log, "message", start, now,
+                          diff->marker_histogram);
+        if(diff->tls_histogram)
+            hdr_log_write(args->hdr_log, "tls", start, now,
+                          diff->tls_histogram);
+        if(diff->upgrade_histogram)
+            hdr_log_write(args->hdr_log, "upgrade", start, now,
+                          diff->upgrade_histogram);
+        if(diff->appbyte_histogram)
+            hdr_log_write(args->hdr_log, "appbyte", start, now,
+                          diff->appbyte_histogram);
+        engine_free_latency_snapshot(diff);
+        engine_free_latency_snapshot(args->previous_hdr_log_latency);
+    }
+
+    args->previous_hdr_log_latency = latency;
+    args->checkpoint.last_hdr_log_flush = now;
+}
+
+/*
+ * Write the checkpoint stats as a JSON line (--json-stream).
+ */
+static void
+write_json_checkpoint(struct oc_args *args, const statsd_feedback *sf,
+                      const struct latency_snapshot *latency, double now) {
+    FILE *fp = args->json_stream;
+    fprintf(fp,
+            "{\"type\":\"checkpoint\",\"time\":%.3f,\"opened\":%zu"
+            ",\"conns_in\":%zu,\"conns_out\":%zu,\"bps_in\":%zu"
+            ",\"bps_out\":%zu,",
+            now - args->json_stream_start, sf->opened, sf->conns_in,
+            sf->conns_out, sf->bps_in, sf->bps_out);
+    json_print_traffic(fp, "traffic_delta", &sf->traffic_delta);
+    fprintf(fp, ",");
+    json_print_latency(fp, "latency", latency, args->latency_percentiles);
+    fprintf(fp, "}\n");
+    fflush(fp);
+}
+
 enum oc_return_value
 open_connections_until_maxed_out(enum work_phase phase, struct oc_args *args,
                                  struct orchestration_data *orch_state) {
@@ -358,6 +623,11 @@ open_connections_until_maxed_out(enum work_phase phase, struct oc_args *args,
         engine_prepare_latency_snapshot(args->eng);
         args->previous_window_latency =
             engine_collect_latency_snapshot(args->eng);
+        args->previous_window_destinations =
+            engine_collect_destination_snapshot(args->eng);
+    }
+    if(args->hdr_log && !args->previous_hdr_log_latency) {
+        flush_hdr_log(args); /* Start the first interval */
     }
 
 #define STDIN_IDX 0
@@ -442,6 +712,7 @@ open_connections_until_maxed_out(enum work_phase phase, struct oc_args *args,
 
         engine_prepare_latency_snapshot(args->eng);
         struct latency_snapshot *latency = engine_collect_latency_snapshot(args->eng);
+        metrics_publish_latency(args->metrics, latency);
 
         statsd_feedback feedback = {.opened = args->connections_opened_tally,
                                     .conns_in = conns_in,
@@ -451,6 +722,11 @@ open_connections_until_maxed_out(enum work_phase phase, struct oc_args *args,
                                     .traffic_delta = traffic_delta,
                                     .latency = NULL};
         args->connections_opened_tally = 0;
+        int latency_window_flushed = 0;
+
+        if(args->json_stream) {
+            write_json_checkpoint(args, &feedback, latency, now);
+        }
 
         if(requested_latency_types && args->latency_window) {
             /*
@@ -461,6 +737,7 @@ open_connections_until_maxed_out(enum work_phase phase, struct oc_args *args,
 
             if(every(args->latency_window, now,
                      &args->checkpoint.last_latency_window_flush)) {
+                latency_window_flushed = 1;
                 struct latency_snapshot *diff =
                     engine_diff_latency_snapshot(args->previous_window_latency, latency);
                 engine_free_latency_snapshot(args->previous_window_latency);
@@ -478,13 +755,37 @@ open_connections_until_maxed_out(enum work_phase phase, struct oc_args *args,
                              args->latency_percentiles);
         }
 
+        if(args->statsd && engine_params(args->eng)->per_destination) {
+            struct destination_snapshot *destinations =
+                engine_collect_destination_snapshot(args->eng);
+            report_destinations_to_statsd(
+                args->statsd, destinations, args->previous_destinations,
+                args->latency_window ? 0 : requested_latency_types,
+                args->latency_percentiles);
+            engine_free_destination_snapshot(args->previous_destinations);
+            args->previous_destinations = destinations;
+
+            /* Same as the latencies above, once per window. */
+            if(latency_window_flushed) {
+                struct destination_snapshot *window =
+                    engine_collect_destination_snapshot(args->eng);
+                report_destination_latencies_to_statsd(
+                    args->statsd, window, args->previous_window_destinations,
+                    requested_latency_types, args->latency_percentiles);
+                engine_free_destination_snapshot(
+                    args->previous_window_destinations);
+                args->previous_window_destinations = window;
+            }
+        }
+
         if(args->print_stats) {
             if(phase == PHASE_ESTABLISHING_CONNECTIONS) {
                 print_connections_line(conns_out, args->max_connections,
                                        conns_counter);
             } else {
                 char latency_buf[256];
-                format_latencies(latency_buf, sizeof(latency_buf), latency);
+                format_latencies(latency_buf, sizeof(latency_buf), latency,
+                                 args->rate_modulator->latency_percentile);
                 char mps_buf[256];
                 format_message_rate(mps_buf, sizeof(mps_buf), args, now);
 
@@ -504,7 +805,7 @@ open_connections_until_maxed_out(enum work_phase phase, struct oc_args *args,
 
         /* Change the request rate according to the modulation rules. */
         if(phase == PHASE_STEADY_STATE) {
-            switch(modulate_request_rate(args->eng, now, args->rate_modulator, latency)) {
+            switch(modulate_request_rate(args, now, conns_out, latency)) {
             case MRR_ONGOING:
                 break;
             case MRR_RATE_SEARCH_SUCCEEDED:
@@ -516,6 +817,12 @@ open_connections_until_maxed_out(enum work_phase phase, struct oc_args *args,
 
         if(latency != args->previous_window_latency)
             engine_free_latency_snapshot(latency);
+
+        if(args->hdr_log
+           && now - args->checkpoint.last_hdr_log_flush
+                  >= args->hdr_log_interval) {
+            flush_hdr_log(args);
+        }
     }
 
     if(now >= args->epoch_end) return OC_TIMEOUT;
@@ -523,6 +830,28 @@ open_connections_until_maxed_out(enum work_phase phase, struct oc_args *args,
     return OC_CONNECTED;
 }
 
+/*
+ * Run the main loop for the specified amount of time.
+ * Returns 0 if interrupted.
+ */
+int
+run_for_duration(double duration, enum work_phase phase, struct oc_args *args,
+                 struct orchestration_data *orch_state) {
+    tk_now_update(TK_DEFAULT);
+    args->checkpoint.epoch_start = tk_now(TK_DEFAULT);
+    args->epoch_end = args->checkpoint.epoch_start + duration;
+    switch(open_connections_until_maxed_out(phase, args, orch_state)) {
+    case OC_CONNECTED:
+    case OC_TIMEOUT:
+    case OC_RATE_GOAL_MET:
+        return 1;
+    case OC_INTERRUPT:
+    case OC_RATE_GOAL_FAILED:
+        break;
+    }
+    return 0;
+}
+
 struct orchestration_data
 tcpkali_connect_to_orch_server(struct orchestration_args args) {
     struct orchestration_data res = {.connected = 0};
@@ -42,25 +42,37 @@ enum work_phase { PHASE_ESTABLISHING_CONNECTIONS, PHASE_STEADY_STATE };
 struct rate_modulator {
     enum {
         RM_UNMODULATED, /* Do not modulate request rate */
-        RM_MAX_RATE_AT_TARGET_LATENCY
+        RM_MAX_RATE_AT_TARGET_LATENCY,
+        RM_MAX_CONNECTIONS_AT_TARGET_LATENCY /* Rates are connection counts */
     } mode;
-    enum { RMS_STATE_INITIAL, RMS_RATE_RAMP_UP, RMS_RATE_BINARY_SEARCH } state;
-    double last_update_long;
+    enum { RMS_STATE_INITIAL, RMS_RATE_RAMP_UP, RMS_RATE_SEARCH } state;
     double last_update_short;
+    double step_started;   /* When the current rate has been set */
+    double window_started; /* When the measurement window has started */
+    double conns_changed;  /* When -c @<Latency> open count last changed */
+    size_t conns_seen;     /* Open connections at that time */
     double latency_target; /* In seconds. */
     char *latency_target_s;
-    int binary_search_steps;
+    double latency_percentile; /* --latency-target-percentile, 95.0 */
+    int search_steps;
     /*
      * Runtime parameters.
      */
-    /* Previous latency value */
-    double prev_latency;
-    int prev_max_latency_exceeded;
+    /* Latency histogram at the start of the measurement window */
+    struct hdr_histogram *window_base;
+    /* Latency histogram and latency at the last evaluation */
+    struct hdr_histogram *window_last;
+    double latency_last;
     /*
-     * Rate bounds for binary search.
+     * Rate bounds for the search and latencies observed at these bounds.
+     * Latencies are in seconds; the one observed at (rate_min_bound)
+     * is accompanied by its 95% confidence interval.
      */
     double rate_min_bound;
     double rate_max_bound;
+    double latency_at_min_bound;
+    double latency_at_min_bound_ci[2];
+    double latency_at_max_bound;
     double suggested_rate_value;
 };
 
@@ -83,10 +95,19 @@ struct oc_args {
         double epoch_start; /* Start of current checkpoint epoch */
         double last_update; /* Last we updated the checkpoint structure */
         double last_latency_window_flush;   /* Last time we flushed statsd latencies */
+        double last_hdr_log_flush;          /* Start of the --hdr-log interval */
         non_atomic_traffic_stats initial_traffic_stats; /* Ramp-up phase traffic */
         non_atomic_traffic_stats last_traffic_stats;
     } checkpoint;
     struct latency_snapshot *previous_window_latency;
+    struct hdr_log *hdr_log;    /* --hdr-log */
+    double hdr_log_interval;    /* --hdr-log-interval */
+    struct latency_snapshot *previous_hdr_log_latency;
+    struct destination_snapshot *previous_destinations; /* --per-destination */
+    struct destination_snapshot *previous_window_destinations;
+    struct metrics_server *metrics; /* --metrics-listen */
+    FILE *json_stream;              /* --json-stream */
+    double json_stream_start;       /* Time base for the --json-stream */
     mavg traffic_mavgs[2];
     mavg count_mavgs[2];    /* --message-marker */
     size_t connections_opened_tally;
@@ -101,6 +122,18 @@ open_connections_until_maxed_out(enum work_phase phase,
                                  struct oc_args *,
                                  struct orchestration_data *orch_state);
 
+/*
+ * Write the latencies collected since the last --hdr-log interval.
+ */
+void flush_hdr_log(struct oc_args *);
+
+/*
+ * Run the main loop for the specified amount of time, starting
+ * a new checkpoint epoch. Returns 0 if interrupted.
+ */
+int run_for_duration(double duration, enum work_phase phase, struct oc_args *,
+                     struct orchestration_data *orch_state);
+
 struct orchestration_args {
     int enabled;
     char *server_addr_str;
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <hdr_histogram.h>
+
+#include "tcpkali_scenario.h"
+#include "tcpkali_events.h"
+#include "tcpkali_terminfo.h"
+#include "tcpkali_json.h"
+
+/*
+ * Reconfigure the engine for the next phase without disturbing
+ * the connections which are already open.
+ */
+static void
+scenario_apply_phase(struct scenario_phase *phase, struct oc_args *args) {
+    fprintf(stderr, "%sPhase %s:", tcpkali_clear_eol(), phase->name);
+    if(phase->connections >= 0) {
+        if(phase->connections < args->max_connections)
+            engine_terminate_connections(
+                args->eng, args->max_connections - phase->connections);
+        args->max_connections = phase->connections;
+        fprintf(stderr, " --connections %d", phase->connections);
+    }
+    if(phase->message_rate >= 0) {
+        engine_set_message_send_rate(args->eng, phase->message_rate);
+        fprintf(stderr, " --message-rate %g", phase->message_rate);
+    }
+    if(phase->message_set != engine_params(args->eng)->message_set) {
+        engine_set_message_set(args->eng, phase->message_set);
+    }
+    if(phase->latency_window >= 0) {
+        args->latency_window = phase->latency_window;
+    }
+    fprintf(stderr, " for %gs\n", phase->duration);
+}
+
+size_t
+scenario_run(struct scenario *scenario, struct oc_args *args,
+             struct orchestration_data *orch_state,
+             struct scenario_phase_result *results) {
+    size_t phases = 0;
+
+    for(size_t i = 0; i < scenario->phases_count; i++) {
+        struct scenario_phase *phase = &scenario->phases[i];
+        struct scenario_phase_result *r = &results[i];
+
+        scenario_apply_phase(phase, args);
+
+        engine_prepare_latency_snapshot(args->eng);
+        struct latency_snapshot *base_latency =
+            engine_collect_latency_snapshot(args->eng);
+        non_atomic_traffic_stats base_traffic = engine_traffic(args->eng);
+        double started = tk_now(TK_DEFAULT);
+
+        int completed = run_for_duration(phase->duration, PHASE_STEADY_STATE,
+                                         args, orch_state);
+
+        engine_prepare_latency_snapshot(args->eng);
+        struct latency_snapshot *latency =
+            engine_collect_latency_snapshot(args->eng);
+        size_t connecting, conns_in, conns_out, conns_counter;
+        engine_get_connection_stats(args->eng, &connecting, &conns_in,
+                                    &conns_out, &conns_counter);
+
+        r->connections = conns_out;
+        r->duration = tk_now(TK_DEFAULT) - started;
+        r->traffic_delta =
+            subtract_traffic_stats(engine_traffic(args->eng), base_traffic);
+        r->latency = engine_diff_latency_snapshot(base_latency, latency);
+        engine_free_latency_snapshot(base_latency);
+        engine_free_latency_snapshot(latency);
+        phases++;
+
+        if(!completed) break;
+    }
+
+    fprintf(stderr, "%s", tcpkali_clear_eol());
+    return phases;
+}
+
+void
+scenario_print_results(struct scenario *scenario,
+                       struct scenario_phase_result *results, size_t phases,
+                       struct percentile_values *percentiles) {
+    printf("Scenario results by phase:\n");
+
+    /* Arrows take 3 bytes but a single terminal column, hence %12s */
+    printf("%-12s %8s %8s %12s %12s %10s", "Phase", "Time, s", "Conns",
+           "Mbps↓", "Mbps↑", "Replies/s");
+    for(size_t p = 0; p < percentiles->size; p++) {
+        char title[32];
+        snprintf(title, sizeof(title), "p%s ms", percentiles->values[p].value_s);
+        printf(" %10s", title);
+    }
+    printf("\n");
+
+    for(size_t i = 0; i < phases; i++) {
+        struct scenario_phase_result *r = &results[i];
+        struct hdr_histogram *hist = r->latency->marker_histogram;
+        double duration = r->duration > 0 ? r->duration : 1;
+
+        printf("%-12s %8.1f %8zu %10.3f %10.3f", scenario->phases[i].name,
+               r->duration, r->connections,
+               8 * r->traffic_delta.bytes_rcvd / duration / 1000000.0,
+               8 * r->traffic_delta.bytes_sent / duration / 1000000.0);
+        if(hist) {
+            printf(" %10.1f", hist->total_count / duration);
+        } else if(r->traffic_delta.msgs_rcvd) {
+            printf(" %10.1f", r->traffic_delta.msgs_rcvd / duration);
+        } else {
+            printf(" %10s", "-");
+        }
+        for(size_t p = 0; p < percentiles->size; p++) {
+            if(hist && hist->total_count) {
+                printf(" %10.1f",
+                       hdr_value_at_percentile(
+                           hist, percentiles->values[p].value_d) / 10.0);
+            } else {
+                printf(" %10s", "-");
+            }
+        }
+        printf("\n");
+    }
+}
+
+void
+scenario_print_results_json(struct scenario *scenario,
+                            struct scenario_phase_result *results,
+                            size_t phases,
+                            struct percentile_values *percentiles) {
+    for(size_t i = 0; i < phases; i++) {
+        struct scenario_phase_result *r = &results[i];
+        printf("{\"type\":\"scenario_phase\",\"phase\":");
+        json_print_string(stdout, scenario->phases[i].name);
+        printf(",\"connections\":%zu,\"duration\":%g,", r->connections,
+               r->duration);
+        json_print_traffic(stdout, "traffic", &r->traffic_delta);
+        printf(",");
+        json_print_latency(stdout, "latency", r->latency, percentiles);
+        printf("}\n");
+    }
+}
+
+void
+scenario_free_results(struct scenario_phase_result *results, size_t phases) {
+    for(size_t i = 0; i < phases; i++) {
+        engine_free_latency_snapshot(results[i].latency);
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef TCPKALI_SCENARIO_H
+#define TCPKALI_SCENARIO_H
+
+#include "tcpkali_run.h"
+#include "tcpkali_transport.h"
+
+/*
+ * A scenario is a sequence of phases executed back to back in a single run,
+ * keeping the connections open between the phases (--scenario <file>).
+ */
+struct scenario_phase {
+    char *name;
+    double duration;       /* Seconds */
+    int connections;       /* Number of connections, or -1 to keep */
+    double message_rate;   /* Messages per second, or -1 to keep */
+    double latency_window; /* --statsd-latency-window, or -1 to keep */
+    /*
+     * Messages to send during the phase, if any.
+     * Moved into the engine_params.message_sets before the run.
+     */
+    struct message_collection message_collection;
+    size_t message_set; /* See engine_set_message_set() */
+};
+
+struct scenario {
+    struct scenario_phase *phases;
+    size_t phases_count;
+};
+
+/*
+ * Measurements taken during a single phase.
+ */
+struct scenario_phase_result {
+    size_t connections; /* At the end of the phase */
+    double duration;    /* Seconds */
+    non_atomic_traffic_stats traffic_delta;
+    struct latency_snapshot *latency; /* Latencies within the phase */
+};
+
+/*
+ * Run all phases of the scenario. Fills out the (results) array which should
+ * have at least scenario->phases_count elements.
+ * Returns the number of phases completed.
+ */
+size_t scenario_run(struct scenario *, struct oc_args *,
+                    struct orchestration_data *,
+                    struct scenario_phase_result *results);
+
+/*
+ * Print the per-phase results in a tabular form, reporting message
+ * latencies at the given percentiles.
+ */
+void scenario_print_results(struct scenario *, struct scenario_phase_result *,
+                            size_t phases, struct percentile_values *);
+
+/*
+ * Print the per-phase results as JSON lines (--output-format=json).
+ */
+void scenario_print_results_json(struct scenario *,
+                                 struct scenario_phase_result *,
+                                 size_t phases, struct percentile_values *);
+
+void scenario_free_results(struct scenario_phase_result *, size_t phases);
+
+#endif /* TCPKALI_SCENARIO_H */
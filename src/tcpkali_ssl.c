@@ -1,6 +1,8 @@
 #include "tcpkali_ssl.h"
 #include "tcpkali_common.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
 #include <assert.h>
 
@@ -83,3 +85,123 @@ int tcpkali_ssl_thread_cleanup(void) {
 #endif /* HAVE_OPENSSL */
     return 1;
 }
+
+void
+tcpkali_ssl_worker_init(struct tcpkali_ssl_worker *w, const char *cert,
+                        const char *key, double resume_ratio, int ktls) {
+    memset(w, 0, sizeof(*w));
+    w->cert = cert;
+    w->key = key;
+    w->resume_ratio = resume_ratio;
+    w->ktls = ktls;
+}
+
+void
+tcpkali_ssl_worker_free(struct tcpkali_ssl_worker UNUSED *w) {
+#ifdef HAVE_OPENSSL
+    if(w->session) SSL_SESSION_free(w->session);
+    if(w->client_ctx) SSL_CTX_free(w->client_ctx);
+    if(w->server_ctx) SSL_CTX_free(w->server_ctx);
+    w->session = NULL;
+    w->client_ctx = NULL;
+    w->server_ctx = NULL;
+#endif /* HAVE_OPENSSL */
+}
+
+#ifdef HAVE_OPENSSL
+
+/*
+ * Keep the most recent session the server gave us. With TLS 1.3
+ * it arrives after the handshake, in a NewSessionTicket message.
+ * The session is copied: the connection's own one is made non-resumable
+ * once the connection is freed without a shutdown.
+ */
+static int
+new_session_cb(SSL *ssl, SSL_SESSION *session) {
+    struct tcpkali_ssl_worker *w = SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+    if(w->session) SSL_SESSION_free(w->session);
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+    w->session = SSL_SESSION_dup(session);
+    return 0; /* The reference stays with the caller. */
+#else
+    w->session = session;
+    return 1; /* The reference is taken over. */
+#endif
+}
+
+SSL_CTX *
+tcpkali_ssl_context(struct tcpkali_ssl_worker *w, int server_side) {
+    SSL_CTX **ctxp = server_side ? &w->server_ctx : &w->client_ctx;
+    if(*ctxp) return *ctxp;
+
+    const SSL_METHOD *method = server_side
+#if (OPENSSL_VERSION_NUMBER < 0x10100000L)
+                                   ? TLSv1_2_server_method()
+                                   : TLSv1_2_client_method();
+#else
+                                   ? TLS_server_method()
+                                   : TLS_client_method();
+#endif
+    if(method == NULL) {
+        fprintf(stderr, "Can not create SSL method %lu\n", ERR_get_error());
+        ERR_print_errors_fp(stderr);
+        exit(1);
+    }
+    SSL_CTX *ctx = SSL_CTX_new(method);
+    if(ctx == NULL) {
+        fprintf(stderr, "Can not create SSL context %lu\n", ERR_get_error());
+        ERR_print_errors_fp(stderr);
+        exit(1);
+    }
+
+    /*
+     * The re-keyed WebSocket frames are sent from a scratch buffer,
+     * which may be refilled at a different place before a retry.
+     */
+    SSL_CTX_set_mode(ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+#ifdef TCPKALI_SSL_KTLS
+    /*
+     * OpenSSL silently stays in user space if the kernel lacks
+     * the "tls" ULP or the negotiated cipher is not supported.
+     */
+    if(w->ktls) SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
+
+    if(server_side) {
+#ifdef HAVE_SSL_CTX_SET_ECDH_AUTO
+        SSL_CTX_set_ecdh_auto(ctx, 1);
+#endif
+        if(SSL_CTX_use_certificate_file(ctx, w->cert, SSL_FILETYPE_PEM) <= 0) {
+            fprintf(stderr, "%s: %s\n", w->cert,
+                    ERR_error_string(ERR_get_error(), NULL));
+            exit(1);
+        }
+        if(SSL_CTX_use_PrivateKey_file(ctx, w->key, SSL_FILETYPE_PEM) <= 0) {
+            fprintf(stderr, "%s: %s\n", w->key,
+                    ERR_error_string(ERR_get_error(), NULL));
+            exit(1);
+        }
+    } else if(w->resume_ratio > 0) {
+        SSL_CTX_set_app_data(ctx, w);
+        SSL_CTX_set_session_cache_mode(
+            ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx, new_session_cb);
+    }
+
+    *ctxp = ctx;
+    return ctx;
+}
+
+void
+tcpkali_ssl_resume(struct tcpkali_ssl_worker *w, SSL *ssl) {
+    if(w->resume_ratio <= 0) return;
+
+    w->resume_credit += w->resume_ratio;
+    if(w->resume_credit >= 1) {
+        w->resume_credit -= 1;
+        if(w->session) SSL_set_session(ssl, w->session);
+    }
+}
+
+#endif /* HAVE_OPENSSL */
@@ -6,6 +6,45 @@
 #ifdef HAVE_OPENSSL
 #include <openssl/err.h>
 #include <openssl/ssl.h>
+/* OpenSSL 3.0+ can hand the record encryption over to the kernel. */
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+#define TCPKALI_SSL_KTLS
+#endif
+#endif /* HAVE_OPENSSL */
+
+/*
+ * The TLS contexts shared by the connections of a worker thread.
+ * The client side keeps the most recent session to resume the
+ * connections with (--ssl-resume).
+ */
+struct tcpkali_ssl_worker {
+#ifdef HAVE_OPENSSL
+    SSL_CTX *client_ctx;
+    SSL_CTX *server_ctx;
+    SSL_SESSION *session;
+#endif
+    const char *cert;
+    const char *key;
+    double resume_ratio;  /* Share of client connections to resume */
+    double resume_credit; /* Spreads the resumed connections evenly */
+    int ktls;             /* Ask for the kernel TLS offload (--ssl-ktls) */
+};
+void tcpkali_ssl_worker_init(struct tcpkali_ssl_worker *, const char *cert,
+                             const char *key, double resume_ratio, int ktls);
+void tcpkali_ssl_worker_free(struct tcpkali_ssl_worker *);
+
+#ifdef HAVE_OPENSSL
+/*
+ * Get the worker's context for the client or server side connections,
+ * creating it on first use. Exits if the certificate can not be loaded.
+ */
+SSL_CTX *tcpkali_ssl_context(struct tcpkali_ssl_worker *, int server_side);
+
+/*
+ * Make the new client connection resume the kept session, if it is its
+ * turn according to the resumption ratio.
+ */
+void tcpkali_ssl_resume(struct tcpkali_ssl_worker *, SSL *);
 #endif /* HAVE_OPENSSL */
 
 void tcpkali_init_ssl();
@@ -29,8 +29,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <ctype.h>
 
 #include "tcpkali_statsd.h"
+#include "tcpkali_iface.h"
 
 #define SBATCH_INT(t, str, value)                               \
     do {                                                        \
@@ -53,46 +55,36 @@
     } while(0)
 
 
-static void report_latency(Statsd *statsd, statsd_report_latency_types ltype, struct hdr_histogram *hist, const struct percentile_values *latency_percentiles) {
+static void report_latency(Statsd *statsd, const char *prefix, statsd_report_latency_types ltype, struct hdr_histogram *hist, const struct percentile_values *latency_percentiles) {
 
     if(!hist || hist->total_count == 0)
         return;
 
-#define LENGTH_PREFIXED_STR(s)  {sizeof(s)-1,(s)}
-    static struct prefixes {
-        const char *min;
-        const char *mean;
-        const char *max;
-        struct {
-            size_t size;
-            const char *str;
-        } latency_kind;
-    } prefixes[] =
-        {[SLT_CONNECT] = {"latency.connect.min", "latency.connect.mean",
-                          "latency.connect.max",
-                          LENGTH_PREFIXED_STR("latency.connect.")},
-         [SLT_FIRSTBYTE] = {"latency.firstbyte.min", "latency.firstbyte.mean",
-                            "latency.firstbyte.max",
-                            LENGTH_PREFIXED_STR("latency.firstbyte.")},
-         [SLT_MARKER] = {"latency.message.min", "latency.message.mean",
-                         "latency.message.max",
-                         LENGTH_PREFIXED_STR("latency.message.")}};
-    assert(ltype < sizeof(prefixes)/sizeof(prefixes[0]));
-    const struct prefixes *pfx = &prefixes[ltype];
-    assert(pfx->mean);
+    static const char *latency_kinds[] = {[SLT_CONNECT] = "connect",
+                                          [SLT_FIRSTBYTE] = "firstbyte",
+                                          [SLT_MARKER] = "message",
+                                          [SLT_TLS] = "tls",
+                                          [SLT_UPGRADE] = "upgrade",
+                                          [SLT_APPBYTE] = "appbyte"};
+    assert(ltype < sizeof(latency_kinds)/sizeof(latency_kinds[0]));
+    const char *kind = latency_kinds[ltype];
+    assert(kind);
 
+    char name[128];
     for(size_t i = 0; i < latency_percentiles->size; i++) {
         const struct percentile_value *pv = &latency_percentiles->values[i];
-        char name[64];
-        memcpy(name, pfx->latency_kind.str, pfx->latency_kind.size);
-        strcpy(name+pfx->latency_kind.size, pv->value_s);
+        snprintf(name, sizeof(name), "%slatency.%s.%s", prefix, kind,
+                 pv->value_s);
         double latency_ms = hdr_value_at_percentile(hist, pv->value_d) / 10.0;
         SBATCH_DBL(STATSD_GAUGE, name, latency_ms);
     }
 
-    SBATCH_DBL(STATSD_GAUGE, pfx->min, hdr_min(hist) / 10.0);
-    SBATCH_DBL(STATSD_GAUGE, pfx->mean, hdr_mean(hist) / 10.0);
-    SBATCH_DBL(STATSD_GAUGE, pfx->max, hdr_max(hist) / 10.0);
+    snprintf(name, sizeof(name), "%slatency.%s.min", prefix, kind);
+    SBATCH_DBL(STATSD_GAUGE, name, hdr_min(hist) / 10.0);
+    snprintf(name, sizeof(name), "%slatency.%s.mean", prefix, kind);
+    SBATCH_DBL(STATSD_GAUGE, name, hdr_mean(hist) / 10.0);
+    snprintf(name, sizeof(name), "%slatency.%s.max", prefix, kind);
+    SBATCH_DBL(STATSD_GAUGE, name, hdr_max(hist) / 10.0);
 }
 
 
@@ -124,17 +116,29 @@ report_to_statsd(Statsd *statsd, statsd_feedback *sf, statsd_report_latency_type
 
     if(latency_types) {
         if(latency_types & SLT_CONNECT)
-            report_latency(statsd, SLT_CONNECT,
+            report_latency(statsd, "", SLT_CONNECT,
                            sf->latency ? sf->latency->connect_histogram : 0,
                            latency_percentiles);
         if(latency_types & SLT_FIRSTBYTE)
-            report_latency(statsd, SLT_FIRSTBYTE,
+            report_latency(statsd, "", SLT_FIRSTBYTE,
                            sf->latency ? sf->latency->firstbyte_histogram : 0,
                            latency_percentiles);
         if(latency_types & SLT_MARKER)
-            report_latency(statsd, SLT_MARKER,
+            report_latency(statsd, "", SLT_MARKER,
                            sf->latency ? sf->latency->marker_histogram : 0,
                            latency_percentiles);
+        if(latency_types & SLT_TLS)
+            report_latency(statsd, "", SLT_TLS,
+                           sf->latency ? sf->latency->tls_histogram : 0,
+                           latency_percentiles);
+        if(latency_types & SLT_UPGRADE)
+            report_latency(statsd, "", SLT_UPGRADE,
+                           sf->latency ? sf->latency->upgrade_histogram : 0,
+                           latency_percentiles);
+        if(latency_types & SLT_APPBYTE)
+            report_latency(statsd, "", SLT_APPBYTE,
+                           sf->latency ? sf->latency->appbyte_histogram : 0,
+                           latency_percentiles);
     }
 
     statsd_sendBatch(statsd);
@@ -147,18 +151,150 @@ report_latency_to_statsd(Statsd *statsd, struct latency_snapshot *latency, stats
     statsd_resetBatch(statsd);
 
     if(latency_types & SLT_CONNECT)
-        report_latency(statsd, SLT_CONNECT,
+        report_latency(statsd, "", SLT_CONNECT,
                        latency->connect_histogram,
                        latency_percentiles);
     if(latency_types & SLT_FIRSTBYTE)
-        report_latency(statsd, SLT_FIRSTBYTE,
+        report_latency(statsd, "", SLT_FIRSTBYTE,
                        latency->firstbyte_histogram,
                        latency_percentiles);
     if(latency_types & SLT_MARKER)
-        report_latency(statsd, SLT_MARKER,
+        report_latency(statsd, "", SLT_MARKER,
                        latency->marker_histogram,
                        latency_percentiles);
+    if(latency_types & SLT_TLS)
+        report_latency(statsd, "", SLT_TLS,
+                       latency->tls_histogram,
+                       latency_percentiles);
+    if(latency_types & SLT_UPGRADE)
+        report_latency(statsd, "", SLT_UPGRADE,
+                       latency->upgrade_histogram,
+                       latency_percentiles);
+    if(latency_types & SLT_APPBYTE)
+        report_latency(statsd, "", SLT_APPBYTE,
+                       latency->appbyte_histogram,
+                       latency_percentiles);
 
     statsd_sendBatch(statsd);
 }
 
+
+/*
+ * StatsD has no tags, so the destination address becomes a part of
+ * the metric name: "dest.127_0_0_1_80.latency.message.95".
+ */
+static void
+destination_metric_prefix(struct sockaddr_storage *ss, char *buf,
+                          size_t size) {
+    char addr_buf[INET6_ADDRSTRLEN + 64];
+    char *dst = addr_buf;
+    format_sockaddr(ss, addr_buf, sizeof(addr_buf));
+    for(const char *p = addr_buf; *p; p++) {
+        if(*p == '[' || *p == ']') continue;
+        *dst++ = isalnum((unsigned char)*p) ? *p : '_';
+    }
+    *dst = '\0';
+    snprintf(buf, size, "dest.%s.", addr_buf);
+}
+
+static void
+report_destination_latency(Statsd *statsd, const char *prefix,
+                           struct latency_snapshot *latency,
+                           statsd_report_latency_types latency_types,
+                           const struct percentile_values *latency_percentiles) {
+    if(latency_types & SLT_CONNECT)
+        report_latency(statsd, prefix, SLT_CONNECT,
+                       latency->connect_histogram, latency_percentiles);
+    if(latency_types & SLT_FIRSTBYTE)
+        report_latency(statsd, prefix, SLT_FIRSTBYTE,
+                       latency->firstbyte_histogram, latency_percentiles);
+    if(latency_types & SLT_MARKER)
+        report_latency(statsd, prefix, SLT_MARKER,
+                       latency->marker_histogram, latency_percentiles);
+    if(latency_types & SLT_TLS)
+        report_latency(statsd, prefix, SLT_TLS,
+                       latency->tls_histogram, latency_percentiles);
+    if(latency_types & SLT_UPGRADE)
+        report_latency(statsd, prefix, SLT_UPGRADE,
+                       latency->upgrade_histogram, latency_percentiles);
+    if(latency_types & SLT_APPBYTE)
+        report_latency(statsd, prefix, SLT_APPBYTE,
+                       latency->appbyte_histogram, latency_percentiles);
+}
+
+void
+report_destinations_to_statsd(Statsd *statsd,
+                              struct destination_snapshot *update,
+                              struct destination_snapshot *previous_optional,
+                              statsd_report_latency_types latency_types,
+                              const struct percentile_values *latency_percentiles) {
+    if(!statsd || !update) return;
+
+    statsd_resetBatch(statsd);
+
+    for(size_t i = 0; i < update->n_destinations; i++) {
+        struct destination_stats *ds = &update->destinations[i];
+        static const struct destination_stats empty;
+        const struct destination_stats *prev = &empty;
+        if(previous_optional && i < previous_optional->n_destinations)
+            prev = &previous_optional->destinations[i];
+
+        char prefix[128];
+        char name[192];
+        destination_metric_prefix(&ds->address, prefix, sizeof(prefix));
+
+#define SBATCH_DEST_DELTA(suffix, field)                               \
+    do {                                                               \
+        snprintf(name, sizeof(name), "%s%s", prefix, suffix);          \
+        SBATCH_INT(STATSD_COUNT, name, ds->field - prev->field);       \
+    } while(0)
+        SBATCH_DEST_DELTA("connections.attempted", connection_attempts);
+        SBATCH_DEST_DELTA("connections.failed", connection_failures);
+        SBATCH_DEST_DELTA("connections.closed.clean", closed.clean);
+        SBATCH_DEST_DELTA("connections.closed.lifetime", closed.lifetime);
+        SBATCH_DEST_DELTA("connections.closed.timeout", closed.timeout);
+        SBATCH_DEST_DELTA("connections.closed.remote", closed.remote);
+        SBATCH_DEST_DELTA("connections.closed.data", closed.data);
+        SBATCH_DEST_DELTA("traffic.data.rcvd", traffic.bytes_rcvd);
+        SBATCH_DEST_DELTA("traffic.data.sent", traffic.bytes_sent);
+        SBATCH_DEST_DELTA("traffic.msgs.rcvd", traffic.msgs_rcvd);
+        SBATCH_DEST_DELTA("traffic.msgs.sent", traffic.msgs_sent);
+#undef SBATCH_DEST_DELTA
+
+        report_destination_latency(statsd, prefix, &ds->latency,
+                                   latency_types, latency_percentiles);
+    }
+
+    statsd_sendBatch(statsd);
+}
+
+void
+report_destination_latencies_to_statsd(
+    Statsd *statsd, struct destination_snapshot *update,
+    struct destination_snapshot *base_optional,
+    statsd_report_latency_types latency_types,
+    const struct percentile_values *latency_percentiles) {
+    if(!statsd || !update) return;
+
+    statsd_resetBatch(statsd);
+
+    for(size_t i = 0; i < update->n_destinations; i++) {
+        struct destination_stats *ds = &update->destinations[i];
+        char prefix[128];
+        destination_metric_prefix(&ds->address, prefix, sizeof(prefix));
+
+        if(base_optional && i < base_optional->n_destinations) {
+            struct latency_snapshot *diff = engine_diff_latency_snapshot(
+                &base_optional->destinations[i].latency, &ds->latency);
+            report_destination_latency(statsd, prefix, diff, latency_types,
+                                       latency_percentiles);
+            engine_free_latency_snapshot(diff);
+        } else {
+            /* Everything was observed since the base snapshot. */
+            report_destination_latency(statsd, prefix, &ds->latency,
+                                       latency_types, latency_percentiles);
+        }
+    }
+
+    statsd_sendBatch(statsd);
+}
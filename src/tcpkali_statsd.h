@@ -54,5 +54,24 @@ void report_latency_to_statsd(Statsd *statsd, struct latency_snapshot *,
                       statsd_report_latency_types types,
                       const struct percentile_values *latency_percentiles);
 
+/*
+ * Report the per-destination counters (as deltas since the previous
+ * snapshot, if given) and latencies (--per-destination).
+ */
+void report_destinations_to_statsd(Statsd *statsd,
+                      struct destination_snapshot *update,
+                      struct destination_snapshot *previous_optional,
+                      statsd_report_latency_types types,
+                      const struct percentile_values *latency_percentiles);
+
+/*
+ * Report the per-destination latencies observed since the (base) snapshot,
+ * if given (--per-destination with --statsd-latency-window).
+ */
+void report_destination_latencies_to_statsd(Statsd *statsd,
+                      struct destination_snapshot *update,
+                      struct destination_snapshot *base_optional,
+                      statsd_report_latency_types types,
+                      const struct percentile_values *latency_percentiles);
 
 #endif /* TCPKALI_STATSD_H */
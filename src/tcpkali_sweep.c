@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <hdr_histogram.h>
+
+#include "tcpkali_sweep.h"
+#include "tcpkali_events.h"
+#include "tcpkali_terminfo.h"
+#include "tcpkali_json.h"
+
+static void
+sweep_apply_value(struct sweep_spec *sweep, struct oc_args *args,
+                  double value) {
+    switch(sweep->kind) {
+    case SWEEP_NONE:
+        assert(sweep->kind != SWEEP_NONE);
+        break;
+    case SWEEP_MESSAGE_RATE:
+        engine_set_message_send_rate(args->eng, value);
+        fprintf(stderr, "%sSweeping --message-rate %g\n", tcpkali_clear_eol(),
+                value);
+        break;
+    case SWEEP_CONNECTIONS:
+        if(value < args->max_connections)
+            engine_terminate_connections(args->eng,
+                                         args->max_connections - value);
+        args->max_connections = value;
+        fprintf(stderr, "%sSweeping --connections %g\n", tcpkali_clear_eol(),
+                value);
+        break;
+    }
+}
+
+size_t
+sweep_run(struct sweep_spec *sweep, struct oc_args *args,
+          struct orchestration_data *orch_state,
+          struct sweep_step_result *results) {
+    size_t steps = 0;
+
+    for(size_t i = 0; i < sweep->values_count; i++) {
+        struct sweep_step_result *r = &results[i];
+        sweep_apply_value(sweep, args, sweep->values[i]);
+
+        /* Open the new connections, if any, then let the system settle. */
+        if(sweep->kind == SWEEP_CONNECTIONS
+           && !run_for_duration(INFINITY, PHASE_ESTABLISHING_CONNECTIONS,
+                                args, orch_state))
+            break;
+        if(!run_for_duration(sweep->warmup_time, PHASE_STEADY_STATE, args,
+                             orch_state))
+            break;
+
+        engine_prepare_latency_snapshot(args->eng);
+        struct latency_snapshot *base_latency =
+            engine_collect_latency_snapshot(args->eng);
+        non_atomic_traffic_stats base_traffic = engine_traffic(args->eng);
+        double started = tk_now(TK_DEFAULT);
+
+        int completed = run_for_duration(sweep->step_time,
+                                         PHASE_STEADY_STATE, args, orch_state);
+
+        engine_prepare_latency_snapshot(args->eng);
+        struct latency_snapshot *latency =
+            engine_collect_latency_snapshot(args->eng);
+        size_t connecting, conns_in, conns_out, conns_counter;
+        engine_get_connection_stats(args->eng, &connecting, &conns_in,
+                                    &conns_out, &conns_counter);
+
+        r->value = sweep->values[i];
+        r->connections = conns_out;
+        r->duration = tk_now(TK_DEFAULT) - started;
+        r->traffic_delta =
+            subtract_traffic_stats(engine_traffic(args->eng), base_traffic);
+        r->latency = engine_diff_latency_snapshot(base_latency, latency);
+        engine_free_latency_snapshot(base_latency);
+        engine_free_latency_snapshot(latency);
+        steps++;
+
+        if(!completed) break;
+    }
+
+    fprintf(stderr, "%s", tcpkali_clear_eol());
+    return steps;
+}
+
+void
+sweep_print_results(struct sweep_spec *sweep,
+                    struct sweep_step_result *results, size_t steps,
+                    struct percentile_values *percentiles) {
+    printf("Sweep over %s, measured for %gs after %gs warm-up:\n",
+           sweep->kind == SWEEP_CONNECTIONS ? "--connections"
+                                            : "--message-rate",
+           sweep->step_time, sweep->warmup_time);
+
+    /* Arrows take 3 bytes but a single terminal column, hence %12s */
+    printf("%10s %8s %12s %12s %10s",
+           sweep->kind == SWEEP_CONNECTIONS ? "Target" : "Rate", "Conns",
+           "Mbps↓", "Mbps↑", "Replies/s");
+    for(size_t p = 0; p < percentiles->size; p++) {
+        char title[32];
+        snprintf(title, sizeof(title), "p%s ms", percentiles->values[p].value_s);
+        printf(" %10s", title);
+    }
+    printf("\n");
+
+    for(size_t i = 0; i < steps; i++) {
+        struct sweep_step_result *r = &results[i];
+        struct hdr_histogram *hist = r->latency->marker_histogram;
+        double duration = r->duration > 0 ? r->duration : 1;
+
+        printf("%10g %8zu %10.3f %10.3f", r->value, r->connections,
+               8 * r->traffic_delta.bytes_rcvd / duration / 1000000.0,
+               8 * r->traffic_delta.bytes_sent / duration / 1000000.0);
+        if(hist) {
+            printf(" %10.1f", hist->total_count / duration);
+        } else if(r->traffic_delta.msgs_rcvd) {
+            printf(" %10.1f", r->traffic_delta.msgs_rcvd / duration);
+        } else {
+            printf(" %10s", "-");
+        }
+        for(size_t p = 0; p < percentiles->size; p++) {
+            if(hist && hist->total_count) {
+                printf(" %10.1f",
+                       hdr_value_at_percentile(
+                           hist, percentiles->values[p].value_d) / 10.0);
+            } else {
+                printf(" %10s", "-");
+            }
+        }
+        printf("\n");
+    }
+}
+
+void
+sweep_print_results_json(struct sweep_spec *sweep,
+                         struct sweep_step_result *results, size_t steps,
+                         struct percentile_values *percentiles) {
+    for(size_t i = 0; i < steps; i++) {
+        struct sweep_step_result *r = &results[i];
+        printf("{\"type\":\"sweep_step\",\"sweep\":\"%s\",\"value\":%g"
+               ",\"connections\":%zu,\"duration\":%g,",
+               sweep->kind == SWEEP_CONNECTIONS ? "connections"
+                                                : "message-rate",
+               r->value, r->connections, r->duration);
+        json_print_traffic(stdout, "traffic", &r->traffic_delta);
+        printf(",");
+        json_print_latency(stdout, "latency", r->latency, percentiles);
+        printf("}\n");
+    }
+}
+
+void
+sweep_free_results(struct sweep_step_result *results, size_t steps) {
+    for(size_t i = 0; i < steps; i++) {
+        engine_free_latency_snapshot(results[i].latency);
+    }
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2017  Machine Zone, Inc.
+ *
+ * Original author: Lev Walkin <lwalkin@machinezone.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef TCPKALI_SWEEP_H
+#define TCPKALI_SWEEP_H
+
+#include "tcpkali_run.h"
+
+/*
+ * Step through a list of message rates or connection counts in a single
+ * run, keeping the connections open between the steps (--sweep-*).
+ */
+struct sweep_spec {
+    enum sweep_kind {
+        SWEEP_NONE,
+        SWEEP_MESSAGE_RATE, /* --sweep-rate <list> */
+        SWEEP_CONNECTIONS   /* --sweep-connections <list> */
+    } kind;
+    double *values;
+    size_t values_count;
+    double warmup_time; /* --sweep-warmup <Time> */
+    double step_time;   /* --sweep-step <Time> */
+};
+
+/*
+ * Measurements taken during a single step, after the warm-up.
+ */
+struct sweep_step_result {
+    double value;    /* Message rate or number of connections */
+    size_t connections;
+    double duration; /* Measurement window, seconds */
+    non_atomic_traffic_stats traffic_delta;
+    struct latency_snapshot *latency; /* Latencies within the window */
+};
+
+/*
+ * Run all steps of the sweep. Fills out the (results) array which should
+ * have at least sweep->values_count elements.
+ * Returns the number of steps completed.
+ */
+size_t sweep_run(struct sweep_spec *, struct oc_args *,
+                 struct orchestration_data *,
+                 struct sweep_step_result *results);
+
+/*
+ * Print the results in a tabular form, reporting message latencies
+ * at the given percentiles.
+ */
+void sweep_print_results(struct sweep_spec *, struct sweep_step_result *,
+                         size_t steps, struct percentile_values *);
+
+/*
+ * Print the results as JSON lines, one record per step
+ * (--output-format=json).
+ */
+void sweep_print_results_json(struct sweep_spec *, struct sweep_step_result *,
+                              size_t steps, struct percentile_values *);
+
+void sweep_free_results(struct sweep_step_result *, size_t steps);
+
+#endif /* TCPKALI_SWEEP_H */
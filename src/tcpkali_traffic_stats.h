@@ -39,6 +39,10 @@ typedef struct {
     non_atomic_wide_t num_reads; /* Number of read(2) calls */
     non_atomic_wide_t msgs_sent;
     non_atomic_wide_t msgs_rcvd;
+    non_atomic_wide_t http_status[5]; /* 1xx..5xx responses, see --http */
+    non_atomic_wide_t ws_frames_rcvd[6]; /* See websocket_frame_kind() */
+    non_atomic_wide_t ssl_handshakes[2]; /* Full and resumed, see --ssl */
+    non_atomic_wide_t ssl_ktls; /* Handshakes with kTLS offload, --ssl-ktls */
 } non_atomic_traffic_stats;
 
 /*
@@ -51,6 +55,10 @@ typedef struct {
     atomic_wide_t num_reads; /* Number of read(2) calls */
     atomic_wide_t msgs_sent;
     atomic_wide_t msgs_rcvd;
+    atomic_wide_t http_status[5]; /* 1xx..5xx responses, see --http */
+    atomic_wide_t ws_frames_rcvd[6]; /* See websocket_frame_kind() */
+    atomic_wide_t ssl_handshakes[2]; /* Full and resumed, see --ssl */
+    atomic_wide_t ssl_ktls; /* Handshakes with kTLS offload, --ssl-ktls */
 } atomic_traffic_stats;
 
 /*
@@ -65,6 +73,13 @@ add_traffic_numbers_AtoN(const atomic_traffic_stats *src,
     dst->num_reads += atomic_wide_get(&src->num_reads);
     dst->msgs_sent += atomic_wide_get(&src->msgs_sent);
     dst->msgs_rcvd += atomic_wide_get(&src->msgs_rcvd);
+    for(int i = 0; i < 5; i++)
+        dst->http_status[i] += atomic_wide_get(&src->http_status[i]);
+    for(int i = 0; i < 6; i++)
+        dst->ws_frames_rcvd[i] += atomic_wide_get(&src->ws_frames_rcvd[i]);
+    for(int i = 0; i < 2; i++)
+        dst->ssl_handshakes[i] += atomic_wide_get(&src->ssl_handshakes[i]);
+    dst->ssl_ktls += atomic_wide_get(&src->ssl_ktls);
 }
 
 static UNUSED void
@@ -76,6 +91,33 @@ add_traffic_numbers_NtoA(const non_atomic_traffic_stats *src,
     atomic_add(&dst->num_reads, src->num_reads);
     atomic_add(&dst->msgs_sent, src->msgs_sent);
     atomic_add(&dst->msgs_rcvd, src->msgs_rcvd);
+    for(int i = 0; i < 5; i++)
+        atomic_add(&dst->http_status[i], src->http_status[i]);
+    for(int i = 0; i < 6; i++)
+        atomic_add(&dst->ws_frames_rcvd[i], src->ws_frames_rcvd[i]);
+    for(int i = 0; i < 2; i++)
+        atomic_add(&dst->ssl_handshakes[i], src->ssl_handshakes[i]);
+    atomic_add(&dst->ssl_ktls, src->ssl_ktls);
+}
+
+/*
+ * Add non-atomic traffic numbers to non-atomic. Mutates the (dst).
+ */
+static UNUSED void
+add_traffic_numbers_NtoN(const non_atomic_traffic_stats *src,
+                         non_atomic_traffic_stats *dst) {
+    dst->bytes_sent += src->bytes_sent;
+    dst->num_writes += src->num_writes;
+    dst->bytes_rcvd += src->bytes_rcvd;
+    dst->num_reads += src->num_reads;
+    dst->msgs_sent += src->msgs_sent;
+    dst->msgs_rcvd += src->msgs_rcvd;
+    for(int i = 0; i < 5; i++) dst->http_status[i] += src->http_status[i];
+    for(int i = 0; i < 6; i++)
+        dst->ws_frames_rcvd[i] += src->ws_frames_rcvd[i];
+    for(int i = 0; i < 2; i++)
+        dst->ssl_handshakes[i] += src->ssl_handshakes[i];
+    dst->ssl_ktls += src->ssl_ktls;
 }
 
 /*
@@ -91,6 +133,13 @@ subtract_traffic_stats(const non_atomic_traffic_stats a,
     result.num_reads = a.num_reads - b.num_reads;
     result.msgs_sent = a.msgs_sent - b.msgs_sent;
     result.msgs_rcvd = a.msgs_rcvd - b.msgs_rcvd;
+    for(int i = 0; i < 5; i++)
+        result.http_status[i] = a.http_status[i] - b.http_status[i];
+    for(int i = 0; i < 6; i++)
+        result.ws_frames_rcvd[i] = a.ws_frames_rcvd[i] - b.ws_frames_rcvd[i];
+    for(int i = 0; i < 2; i++)
+        result.ssl_handshakes[i] = a.ssl_handshakes[i] - b.ssl_handshakes[i];
+    result.ssl_ktls = a.ssl_ktls - b.ssl_ktls;
     return result;
 }
 
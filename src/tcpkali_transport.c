@@ -57,7 +57,8 @@ snippet_compare_cb(const void *ap, const void *bp) {
 
 void
 message_collection_finalize(struct message_collection *mc, int as_websocket,
-                            const char *hostport, const char *path, const char *headers) {
+                            int ws_deflate, const char *hostport,
+                            const char *path, const char *headers) {
     const char ws_http_headers_fmt[] =
         "GET /%s HTTP/1.1\r\n"
         "Host: %s\r\n"
@@ -65,7 +66,9 @@ message_collection_finalize(struct message_collection *mc, int as_websocket,
         "Connection: Upgrade\r\n"
         "Sec-WebSocket-Key: x3JJHMbDL1EzLkh9GBhXDw==\r\n"
         "Sec-WebSocket-Version: 13\r\n"
-        "%s\r\n";
+        "%s%s\r\n";
+    const char ws_deflate_header[] =
+        "Sec-WebSocket-Extensions: " WEBSOCKET_DEFLATE_EXTENSION "\r\n";
 
     assert(mc->state == MC_EMBRYONIC);
 
@@ -75,10 +78,12 @@ message_collection_finalize(struct message_collection *mc, int as_websocket,
         if(!headers) headers = "";
 
         ssize_t estimated_size = sizeof(ws_http_headers_fmt) + strlen(hostport)
-                                 + strlen(path) + strlen(headers);
+                                 + strlen(path) + sizeof(ws_deflate_header)
+                                 + strlen(headers);
         char http_headers[estimated_size];
         ssize_t h_size = snprintf(http_headers, estimated_size,
-                                  ws_http_headers_fmt, path, hostport, headers);
+                                  ws_http_headers_fmt, path, hostport,
+                                  ws_deflate ? ws_deflate_header : "", headers);
         assert(h_size < estimated_size);
 
         const int NO_UNESCAPE = 0;
@@ -87,6 +92,7 @@ message_collection_finalize(struct message_collection *mc, int as_websocket,
                                h_size, NO_UNESCAPE, PERFORM_EXPR_PARSING);
 
         mc->state = MC_FINALIZED_WEBSOCKET;
+        mc->ws_deflate = ws_deflate;
     } else {
         mc->state = MC_FINALIZED_PLAIN_TCP;
     }
@@ -94,6 +100,16 @@ message_collection_finalize(struct message_collection *mc, int as_websocket,
     /* Order hdr > first_msg > msg. */
     qsort(mc->snippets, mc->snippets_count, sizeof(mc->snippets[0]),
           snippet_compare_cb);
+
+    /*
+     * The collection is shared by the connections from now on,
+     * which keep the "per connection" values on their own.
+     */
+    size_t next_slot = 1;
+    for(size_t i = 0; i < mc->snippets_count; i++) {
+        next_slot = expression_number_conn_slots(mc->snippets[i].expr, next_slot);
+    }
+    mc->conn_values_count = next_slot - 1;
 }
 
 /*
@@ -136,34 +152,6 @@ replicate_payload(struct transport_data_spec *data, size_t target_size) {
     data->flags |= TDS_FLAG_REPLICATED;
 }
 
-void
-message_collection_replicate(struct message_collection *mc_from, struct message_collection *mc_to) {
-    mc_to->snippets = malloc(sizeof(mc_from->snippets[0])*mc_from->snippets_size);
-    for(size_t i = 0; i < mc_from->snippets_count; i++) {
-        struct message_collection_snippet *snip = &mc_from->snippets[i];
-        mc_to->snippets[i].data = snip->data;
-        mc_to->snippets[i].size = snip->size;
-        mc_to->snippets[i].expr = replicate_expression(snip->expr);
-        mc_to->snippets[i].flags = snip->flags;
-        mc_to->snippets[i].sort_index =  snip->sort_index;
-    }
-    mc_to->snippets_size = mc_from->snippets_size;
-    mc_to->snippets_count = mc_from->snippets_count;
-    mc_to->most_dynamic_expression = mc_from->most_dynamic_expression;
-    mc_to->state = mc_from->state;
-}
-
-void
-message_collection_free(struct message_collection *mc) {
-    for(size_t i = 0; i < mc->snippets_count; i++) {
-        struct message_collection_snippet *snip = &mc->snippets[i];
-        if(snip->flags & MSK_EXPRESSION_FOUND) {
-            free_expression(snip->expr, 0);
-        }
-    }
-    free((void *)mc->snippets);
-}
-
 static void
 message_collection_ensure_space(struct message_collection *mc, size_t need) {
     /* Reallocate snippets array, if needed. */
@@ -342,7 +330,8 @@ message_collection_estimate_size(struct message_collection *mc,
                                  enum mc_snippet_kind kind_equal,
                                  enum mc_snippet_estimate mce,
                                  enum websocket_side ws_side,
-                                 int ws_enable) {
+                                 int ws_enable,
+                                 const struct expr_conn_values *values) {
     size_t total_size = 0;
     size_t i;
 
@@ -357,7 +346,7 @@ message_collection_estimate_size(struct message_collection *mc,
 
         if(snip->flags & MSK_EXPRESSION_FOUND) {
             if(mce == MCE_AVERAGE_SIZE) {
-                snippet_size += average_size(snip->expr);
+                snippet_size += average_size(snip->expr, values);
             } else if(snip->expr->type == EXPR_REGEX && mce == MCE_MINIMUM_SIZE) {
                 snippet_size += tregex_min_size(snip->expr->u.regex.re);
             } else {
@@ -417,9 +406,11 @@ transport_spec_from_message_collection(struct transport_data_spec *out_spec,
                                        struct message_collection *mc,
                                        expr_callback_f optional_cb,
                                        void *expr_cb_key,
+                                       struct expr_conn_values *values,
                                        enum transport_websocket_side tws_side,
                                        enum transport_conversion tconv,
-                                       pcg32_random_t *rng) {
+                                       pcg32_random_t *rng,
+                                       struct websocket_deflater *deflater) {
     /*
      * If expressions found we can not create a transport data specification
      * from this collection directly. Need to go through expression evaluator.
@@ -436,9 +427,13 @@ transport_spec_from_message_collection(struct transport_data_spec *out_spec,
     enum websocket_side ws_side =
         (tws_side == TWS_SIDE_CLIENT) ? WS_SIDE_CLIENT : WS_SIDE_SERVER;
 
+    /* Only the client offers compression, see message_collection_finalize() */
+    if(!mc->ws_deflate || ws_side != WS_SIDE_CLIENT) deflater = NULL;
+
     if(tconv == TS_CONVERSION_INITIAL) {
         size_t estimate_size =
-            message_collection_estimate_size(mc, 0, 0, MCE_MAXIMUM_SIZE, ws_side, 1);
+            message_collection_estimate_size(mc, 0, 0, MCE_MAXIMUM_SIZE,
+                                             ws_side, 1, NULL);
         if(estimate_size < REPLICATE_MAX_SIZE)
             estimate_size = REPLICATE_MAX_SIZE;
         data_spec->ptr = malloc(estimate_size + 1);
@@ -454,11 +449,15 @@ transport_spec_from_message_collection(struct transport_data_spec *out_spec,
                                            .original_key = expr_cb_key};
 
     int place_multiple_messages = 0;
+    size_t complete_message_size = data_spec->single_message_size;
 
     do { /* while(place_multiple_messages) */
 
         if(tconv == TS_CONVERSION_OVERRIDE_MESSAGES) {
             /* We'll rebuild the message anew */
+            complete_message_size = data_spec->single_message_size
+                                        ? data_spec->single_message_size
+                                        : complete_message_size;
             data_spec->single_message_size = 0;
         }
 
@@ -486,6 +485,8 @@ transport_spec_from_message_collection(struct transport_data_spec *out_spec,
                        + snip->expr->estimate_size
                    > data_spec->allocated_size) {
                     assert(tconv == TS_CONVERSION_OVERRIDE_MESSAGES);
+                    /* The last message did not fit, it doesn't count. */
+                    data_spec->single_message_size = complete_message_size;
                     place_multiple_messages = 0;
                     break;
                 }
@@ -502,7 +503,7 @@ transport_spec_from_message_collection(struct transport_data_spec *out_spec,
                     (char **)&tptr,
                     data_spec->allocated_size
                         - (data_spec->total_size + estimate_ws_frame_size),
-                    snip->expr, callback_wrapper, &callback_key, 0,
+                    snip->expr, callback_wrapper, &callback_key, values, 0,
                     (tws_side == TWS_SIDE_CLIENT), rng);
                 if(callback_key.multiple_message_markers) {
                     data_spec->marker_token_ptr = 0;
@@ -520,9 +521,16 @@ transport_spec_from_message_collection(struct transport_data_spec *out_spec,
                 data = 0;
                 size = reified_size;
             } else {
-                if(data_spec->total_size + snip->size
+                size_t max_frame_size =
+                    (mc->state == MC_FINALIZED_WEBSOCKET
+                     && snip->flags & MSK_FRAMING_REQUESTED)
+                        ? WEBSOCKET_MAX_FRAME_HDR_SIZE
+                        : 0;
+                if(data_spec->total_size + max_frame_size + snip->size
                    > data_spec->allocated_size) {
                     assert(tconv == TS_CONVERSION_OVERRIDE_MESSAGES);
+                    /* The last message did not fit, it doesn't count. */
+                    data_spec->single_message_size = complete_message_size;
                     place_multiple_messages = 0;
                     break;
                 }
@@ -576,12 +584,39 @@ transport_spec_from_message_collection(struct transport_data_spec *out_spec,
             /*
              * We only add data if it has not already been added.
              */
-            size_t framed_snippet_size = ws_frame_size + size;
             if(data) { /* Data is not there if expression is used. */
                 memcpy((char *)data_spec->ptr + data_spec->total_size
                            + ws_frame_size,
                        data, size);
             }
+            /*
+             * The message marker is looked up and updated in plaintext,
+             * so its frame is neither compressed nor masked.
+             */
+            if(ws_frame_size
+               && !((snip->flags & MSK_EXPRESSION_FOUND)
+                    && has_subexpression(snip->expr, EXPR_MESSAGE_MARKER))) {
+                uint8_t *frame = (uint8_t *)data_spec->ptr
+                                 + data_spec->total_size;
+                const void *compressed;
+                ssize_t compressed_size =
+                    deflater ? websocket_deflate(deflater, frame + ws_frame_size,
+                                                 size, &compressed)
+                             : -1;
+                if(compressed_size >= 0) {
+                    /* Smaller payload never needs a larger header. */
+                    ws_frame_size = websocket_frame_header(
+                        frame,
+                        data_spec->allocated_size - data_spec->total_size,
+                        ws_side, WS_OP_TEXT_FRAME, WS_RSV1, 1,
+                        compressed_size);
+                    memcpy(frame + ws_frame_size, compressed, compressed_size);
+                    size = compressed_size;
+                }
+                websocket_frame_mask(frame, ws_frame_size, size,
+                                     pcg32_random_r(rng));
+            }
+            size_t framed_snippet_size = ws_frame_size + size;
             data_spec->total_size += framed_snippet_size;
 
             switch(MSK_PURPOSE(snip)) {
@@ -608,3 +643,324 @@ transport_spec_from_message_collection(struct transport_data_spec *out_spec,
 
     return data_spec;
 }
+
+static ssize_t
+template_hole(struct transport_template *tpl, tk_expr_t *expr, size_t offset,
+              size_t size) {
+    struct transport_template_hole *holes =
+        realloc(tpl->holes, (tpl->holes_count + 1) * sizeof(*holes));
+    assert(holes);
+    holes[tpl->holes_count].offset = offset;
+    holes[tpl->holes_count].size = size;
+    holes[tpl->holes_count].expr = expr;
+    holes[tpl->holes_count].masked_payload = 0;
+    tpl->holes = holes;
+    tpl->holes_count++;
+    return size;
+}
+
+static void
+template_frame(struct transport_template *tpl, size_t offset, size_t size) {
+    struct transport_template_frame *frames =
+        realloc(tpl->frames, (tpl->frames_count + 1) * sizeof(*frames));
+    assert(frames);
+    frames[tpl->frames_count].offset = offset;
+    frames[tpl->frames_count].size = size;
+    tpl->frames = frames;
+    tpl->frames_count++;
+}
+
+/*
+ * Figure out the width of the expression value and record the holes in it.
+ * Returns -1 if the expression value may vary in width.
+ */
+static ssize_t
+template_walk(struct transport_template *tpl, tk_expr_t *expr,
+              const struct expr_conn_values *values, size_t offset,
+              enum websocket_side ws_side) {
+    /* The per-connection values are known after the first evaluation. */
+    if(expr->dynamic_scope == DS_PER_CONNECTION) {
+        const struct expr_conn_value *saved = expr_conn_value(expr, values);
+        return saved ? (ssize_t)saved->size : -1;
+    }
+
+    switch(expr->type) {
+    case EXPR_DATA:
+        return expr->u.data.size;
+    case EXPR_RAW:
+        return template_walk(tpl, expr->u.raw.expr, values, offset, ws_side);
+    case EXPR_WS_FRAME: {
+        size_t hdr_size = websocket_frame_header(NULL, 0, ws_side,
+                                                 expr->u.ws_frame.opcode,
+                                                 expr->u.ws_frame.rsvs,
+                                                 expr->u.ws_frame.fin,
+                                                 expr->u.ws_frame.size);
+        if(ws_side == WS_SIDE_CLIENT)
+            template_frame(tpl, offset + hdr_size, expr->u.ws_frame.size);
+        return hdr_size + expr->u.ws_frame.size;
+    }
+    case EXPR_CONCAT: {
+        ssize_t size0 =
+            template_walk(tpl, expr->u.concat.expr[0], values, offset, ws_side);
+        if(size0 < 0) return -1;
+        ssize_t size1 = template_walk(tpl, expr->u.concat.expr[1], values,
+                                      offset + size0, ws_side);
+        if(size1 < 0) return -1;
+        return size0 + size1;
+    }
+    case EXPR_REGEX: {
+        size_t size = tregex_max_size(expr->u.regex.re);
+        if(tregex_min_size(expr->u.regex.re) != size) return -1;
+        return template_hole(tpl, expr, offset, size);
+    }
+    case EXPR_MESSAGE_SEQ:
+    case EXPR_GLOBAL_SEQ:
+    case EXPR_TIME_MS:
+    case EXPR_TIME_US:
+    case EXPR_RAND:
+        /* Zero-padded to a fixed width. */
+        return template_hole(tpl, expr, offset, expr->estimate_size);
+    case EXPR_MODULO:
+    case EXPR_CONNECTION_PTR:
+    case EXPR_CONNECTION_UID:
+    case EXPR_MESSAGE_MARKER:
+        /* Either varies in width, or is patched by the engine itself. */
+        return -1;
+    }
+
+    return -1;
+}
+
+/*
+ * Record the holes and the masked frames of the snippet placed at (offset).
+ * Returns the size of the framed snippet, or -1 if it may vary.
+ */
+static ssize_t
+template_snippet(struct transport_template *tpl,
+                 struct message_collection *mc,
+                 struct message_collection_snippet *snip,
+                 const struct expr_conn_values *values, size_t offset,
+                 enum websocket_side ws_side) {
+    size_t hdr_size = 0;
+    ssize_t size;
+
+    /* The compressed messages vary in size. */
+    if(mc->ws_deflate && ws_side == WS_SIDE_CLIENT
+       && snip->flags & MSK_FRAMING_REQUESTED)
+        return -1;
+    if(snip->flags & MSK_EXPRESSION_FOUND) {
+        if(has_subexpression(snip->expr, EXPR_MESSAGE_MARKER)) return -1;
+        size_t holes_before = tpl->holes_count;
+        size = template_walk(tpl, snip->expr, values, offset, ws_side);
+        if(size < 0) return -1;
+        if(mc->state == MC_FINALIZED_WEBSOCKET
+           && snip->flags & MSK_FRAMING_REQUESTED) {
+            /* Holes are behind the frame header. */
+            hdr_size = websocket_frame_header(NULL, 0, ws_side,
+                                              WS_OP_TEXT_FRAME, 0, 1, size);
+            for(size_t h = holes_before; h < tpl->holes_count; h++) {
+                tpl->holes[h].offset += hdr_size;
+                if(ws_side == WS_SIDE_CLIENT)
+                    tpl->holes[h].masked_payload = offset + hdr_size;
+            }
+        }
+    } else {
+        size = snip->size;
+        if(mc->state == MC_FINALIZED_WEBSOCKET
+           && snip->flags & MSK_FRAMING_REQUESTED) {
+            hdr_size = websocket_frame_header(NULL, 0, ws_side,
+                                              WS_OP_TEXT_FRAME, 0, 1, size);
+        }
+    }
+    if(hdr_size && ws_side == WS_SIDE_CLIENT)
+        template_frame(tpl, offset + hdr_size, size);
+
+    return hdr_size + size;
+}
+
+struct transport_template *
+transport_template_compile(struct message_collection *mc,
+                           const struct transport_data_spec *data,
+                           const struct expr_conn_values *values,
+                           enum transport_websocket_side tws_side) {
+    struct transport_template *tpl = calloc(1, sizeof(*tpl));
+    assert(tpl);
+
+    enum websocket_side ws_side =
+        (tws_side == TWS_SIDE_CLIENT) ? WS_SIDE_CLIENT : WS_SIDE_SERVER;
+
+    /*
+     * The --first-message frames are sent once, behind the HTTP upgrade
+     * headers, but they are to be re-keyed as well if the data is shared.
+     */
+    int once_known = 1;
+    size_t offset = data->ws_hdr_size;
+    for(size_t i = 0; i < mc->snippets_count; i++) {
+        struct message_collection_snippet *snip = &mc->snippets[i];
+        if(MSK_PURPOSE(snip) != MSK_PURPOSE_FIRST_MSG) continue;
+        ssize_t size =
+            template_snippet(tpl, mc, snip, values, offset, ws_side);
+        if(size < 0) {
+            once_known = 0;
+            break;
+        }
+        offset += size;
+    }
+    if(offset != data->once_size) once_known = 0;
+    tpl->once_frames = tpl->frames;
+    tpl->once_frames_count = tpl->frames_count;
+    tpl->frames = NULL;
+    tpl->frames_count = 0;
+    tpl->holes_count = 0; /* Only the messages are patched. */
+
+    offset = 0;
+    for(size_t i = 0; i < mc->snippets_count; i++) {
+        struct message_collection_snippet *snip = &mc->snippets[i];
+        if(MSK_PURPOSE(snip) != MSK_PURPOSE_MESSAGE) continue;
+        ssize_t size =
+            template_snippet(tpl, mc, snip, values, offset, ws_side);
+        if(size < 0) return tpl;
+        offset += size;
+    }
+
+    /*
+     * Double-check against the data which was actually built: a message
+     * which did not fit in full would leave a remainder.
+     */
+    size_t payload_size = data->total_size - data->once_size;
+    if(offset ? payload_size % offset != 0 : payload_size != 0) return tpl;
+
+    tpl->message_size = offset;
+    tpl->patchable = (tpl->holes_count || tpl->frames_count) && offset;
+    tpl->remaskable = once_known;
+
+    return tpl;
+}
+
+int
+transport_template_patch(const struct transport_template *tpl,
+                         struct transport_data_spec *data,
+                         expr_callback_f optional_cb, void *expr_cb_key,
+                         enum transport_websocket_side tws_side,
+                         pcg32_random_t *rng) {
+    if(!tpl->patchable) return -1;
+
+    for(size_t off = data->once_size; off < data->total_size;
+        off += tpl->message_size) {
+        char *message = (char *)data->ptr + off;
+        for(size_t h = 0; h < tpl->holes_count; h++) {
+            const struct transport_template_hole *hole = &tpl->holes[h];
+            char *buf = message + hole->offset;
+            /* The evaluation NUL-terminates the value, save the byte. */
+            char following = buf[hole->size];
+            ssize_t size = eval_expression(&buf, hole->size, hole->expr,
+                                           optional_cb, expr_cb_key, NULL, 0,
+                                           (tws_side == TWS_SIDE_CLIENT), rng);
+            assert(size == (ssize_t)hole->size);
+            buf[hole->size] = following;
+            if(hole->masked_payload) {
+                /* Mask with the current key, the frame is re-keyed below. */
+                const uint8_t *mask =
+                    (uint8_t *)message + hole->masked_payload - 4;
+                websocket_mask((uint8_t *)buf, hole->size, mask,
+                               hole->offset - hole->masked_payload);
+            }
+        }
+        /* RFC 6455, 5.3: the masking key is not to be reused. */
+        for(size_t f = 0; f < tpl->frames_count; f++) {
+            const struct transport_template_frame *frame = &tpl->frames[f];
+            websocket_payload_remask((uint8_t *)message + frame->offset,
+                                     frame->size, pcg32_random_r(rng));
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * A fresh masking key of the frame found at the (position) in the stream.
+ * This is the SplitMix64 finalizer, the (seed) keeps the keys unpredictable.
+ */
+static uint32_t
+remask_key(uint64_t seed, uint64_t position) {
+    uint64_t z = seed + position * 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return (uint32_t)(z ^ (z >> 31));
+}
+
+/*
+ * Re-key the part of the frame, the masking key included, which got
+ * copied into the (buf) holding the data from (offset) to (offset + size).
+ */
+static inline void
+remask_frame(const struct transport_template_frame *frame, size_t frame_base,
+             size_t offset, uint8_t *buf, size_t size, uint64_t seed,
+             uint64_t stream_offset) {
+    size_t payload = frame_base + frame->offset;
+    size_t begin = payload - 4;
+    size_t end = payload + frame->size;
+    if(end <= offset || begin >= offset + size) return;
+
+    /* Masking with the delta replaces the old key with the new one. */
+    uint32_t key = remask_key(seed, stream_offset - offset + payload);
+    uint8_t delta[4];
+    memcpy(delta, &key, 4);
+
+    if(begin >= offset && end <= offset + size) {
+        /* The whole frame is there, most of the time. */
+        uint8_t *p = buf + (begin - offset);
+        uint32_t old_key;
+        memcpy(&old_key, p, 4);
+        old_key ^= key;
+        memcpy(p, &old_key, 4);
+        if(frame->size < 16) {
+            for(size_t i = 0; i < frame->size; i++) p[4 + i] ^= delta[i & 3];
+        } else {
+            websocket_mask(p + 4, frame->size, delta, 0);
+        }
+        return;
+    }
+
+    if(begin < offset) begin = offset;
+    if(end > offset + size) end = offset + size;
+    websocket_mask(buf + (begin - offset), end - begin, delta,
+                   (begin - payload) & 3);
+}
+
+void
+transport_template_remask(const struct transport_template *tpl,
+                          const struct transport_data_spec *data,
+                          size_t offset, void *buf, size_t size, uint64_t seed,
+                          uint64_t stream_offset) {
+    assert(tpl->remaskable);
+    assert(offset + size <= data->total_size);
+
+    memcpy(buf, (const char *)data->ptr + offset, size);
+
+    for(size_t f = 0; f < tpl->once_frames_count; f++) {
+        remask_frame(&tpl->once_frames[f], 0, offset, buf, size, seed,
+                     stream_offset);
+    }
+
+    if(!tpl->frames_count || offset + size <= data->once_size) return;
+
+    size_t first = offset > data->once_size ? offset - data->once_size : 0;
+    size_t base = data->once_size + first - first % tpl->message_size;
+    for(; base < offset + size; base += tpl->message_size) {
+        for(size_t f = 0; f < tpl->frames_count; f++) {
+            remask_frame(&tpl->frames[f], base, offset, buf, size, seed,
+                         stream_offset);
+        }
+    }
+}
+
+void
+transport_template_free(struct transport_template *tpl) {
+    if(tpl) {
+        free(tpl->holes);
+        free(tpl->frames);
+        free(tpl->once_frames);
+        free(tpl);
+    }
+}
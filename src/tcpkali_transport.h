@@ -28,6 +28,7 @@
 #define TCPKALI_TRANSPORT_H
 
 #include "tcpkali_expr.h"
+#include "tcpkali_websocket.h"
 
 /* Forward declarations */
 struct tk_expr;
@@ -68,6 +69,11 @@ struct message_collection {
      * Scopes are: global, connection and per message.
      */
     enum tk_expr_dynamic_scope most_dynamic_expression;
+    /*
+     * Number of the "per connection" values to keep for each connection
+     * (see struct expr_conn_values). Known after finalization.
+     */
+    size_t conn_values_count;
     /*
      * A collection must be finalized before use.
      */
@@ -76,6 +82,7 @@ struct message_collection {
         MC_FINALIZED_PLAIN_TCP, /* Data is for plain TCP connection */
         MC_FINALIZED_WEBSOCKET  /* Data is for WebSocket connection */
     } state;
+    int ws_deflate; /* The client offers permessage-deflate (--ws-deflate) */
 };
 
 /*
@@ -98,8 +105,8 @@ void message_collection_add_expr(struct message_collection *mc,
  * and adding websocket related messages details.
  */
 void message_collection_finalize(struct message_collection *, int as_websocket,
-                                 const char *hostport, const char *path,
-                                 const char *headers);
+                                 int ws_deflate, const char *hostport,
+                                 const char *path, const char *headers);
 
 /*
  * Recursively figure out if message collection contains the
@@ -118,7 +125,8 @@ size_t message_collection_estimate_size(struct message_collection *mc,
                                         enum mc_snippet_kind kind_equal,
                                         enum mc_snippet_estimate,
                                         enum websocket_side ws_side,
-                                        int ws_enable);
+                                        int ws_enable,
+                                        const struct expr_conn_values *);
 
 /*
  * Our send buffer is pre-computed in advance and may be shared
@@ -147,6 +155,8 @@ struct transport_data_spec {
 /*
  * Convert message collection into transport data specification, which is
  * friendlier for the high speed sending routine.
+ * The client messages of the ws_deflate collection are compressed
+ * with the (deflater), if given.
  */
 enum transport_websocket_side {
     TWS_SIDE_CLIENT,
@@ -159,8 +169,73 @@ enum transport_conversion {
 struct transport_data_spec *transport_spec_from_message_collection(
     struct transport_data_spec *out_spec, struct message_collection *,
     expr_callback_f optional_cb, void *expr_cb_key,
-    enum transport_websocket_side, enum transport_conversion,
-    pcg32_random_t *rng);
+    struct expr_conn_values *, enum transport_websocket_side,
+    enum transport_conversion, pcg32_random_t *rng,
+    struct websocket_deflater *deflater);
+
+/*
+ * The layout of the messages built by transport_spec_from_message_collection()
+ * with the DS_PER_MESSAGE expressions. When all such expressions produce
+ * the data of a fixed width, every next batch of messages differs from
+ * the previous one only in these "holes" and in the masking keys of
+ * the client WebSocket frames, and the rest of the buffer can be kept intact.
+ */
+struct transport_template {
+    int patchable;       /* Whether the holes can be patched in place */
+    size_t message_size; /* Size of a single (framed) message */
+    size_t holes_count;
+    struct transport_template_hole {
+        size_t offset; /* Offset of the hole within a message */
+        size_t size;   /* Fixed width of the expression value */
+        size_t masked_payload; /* Offset of the masked frame payload, or 0 */
+        struct tk_expr *expr;
+    } *holes;
+    size_t frames_count;
+    struct transport_template_frame {
+        size_t offset; /* Offset of the masked payload within a message */
+        size_t size;   /* Size of the masked payload */
+    } *frames;
+    int remaskable; /* Whether all client frames are known, see below */
+    size_t once_frames_count;
+    struct transport_template_frame *once_frames; /* Offsets within data */
+};
+
+/*
+ * Compile the layout of the messages found in the (data) buffer, which was
+ * just built out of the message collection. The template refers to the
+ * collection's expressions, so it must not outlive the collection.
+ */
+struct transport_template *transport_template_compile(
+    struct message_collection *, const struct transport_data_spec *data,
+    const struct expr_conn_values *, enum transport_websocket_side);
+
+/*
+ * Re-evaluate the holes of all messages in the (data) buffer in place,
+ * and mask the client WebSocket frames with the new keys.
+ * This has the same effect as a TS_CONVERSION_OVERRIDE_MESSAGES conversion.
+ * Returns -1 if the template is not patchable, and the data must be rebuilt.
+ */
+int transport_template_patch(const struct transport_template *,
+                             struct transport_data_spec *data,
+                             expr_callback_f optional_cb, void *expr_cb_key,
+                             enum transport_websocket_side,
+                             pcg32_random_t *rng);
+
+/*
+ * Copy (size) bytes of the shared (data) starting at (offset) into (buf),
+ * masking the client WebSocket frames with the new keys. The keys are
+ * derived from the (seed) and the position of the frame in the stream,
+ * (stream_offset) being the position of the (offset) byte. The frames
+ * are never sent with the same key twice, yet the bytes not yet sent
+ * after a partial write come out the same when they are copied again.
+ * The template must be remaskable.
+ */
+void transport_template_remask(const struct transport_template *,
+                               const struct transport_data_spec *data,
+                               size_t offset, void *buf, size_t size,
+                               uint64_t seed, uint64_t stream_offset);
+
+void transport_template_free(struct transport_template *);
 
 /*
  * To be able to efficiently transfer small payloads, we replicate
@@ -170,13 +245,4 @@ struct transport_data_spec *transport_spec_from_message_collection(
 void replicate_payload(struct transport_data_spec *data,
                        size_t target_payload_size);
 
-/*
- * Replicate snippets (need to replicate expressions)
- * it does not copy data
- */
-void message_collection_replicate(struct message_collection *mc_from,
-                                  struct message_collection *mc_to);
-
-void message_collection_free(struct message_collection *mc);
-
 #endif /* TCPKALI_TRANSPORT_H */
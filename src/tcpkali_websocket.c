@@ -25,12 +25,21 @@
  * SUCH DAMAGE.
  */
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <ctype.h>
 #include <arpa/inet.h>
 #include <assert.h>
 #include <unistd.h>
 
+#include <config.h>
+
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#include <zlib.h>
+#define WEBSOCKET_DEFLATE
+#endif
+
 #include "tcpkali_websocket.h"
 #include "libcows_base64.h"
 #include "sha-1.c"
@@ -99,7 +108,7 @@ websocket_frame_header(uint8_t *buf, size_t size, enum websocket_side side,
         buf += 4;
     }
 
-    /* Add 4-byte 0-valued XOR mask (for debugging) */
+    /* Add 4-byte 0-valued XOR mask, see websocket_frame_mask() */
     if(mask_flag) {
         memset(buf, 0, 4);
         buf += 4;
@@ -108,6 +117,467 @@ websocket_frame_header(uint8_t *buf, size_t size, enum websocket_side side,
     return buf - orig_buf_ptr;
 }
 
+/*
+ * Sixteen bytes at a time: the compiler turns it into SIMD XOR
+ * where the target has it, and into a couple of word XORs otherwise.
+ */
+typedef uint8_t ws_mask_vector __attribute__((vector_size(16)));
+
+void
+websocket_mask(uint8_t *data, size_t size, const uint8_t mask[4],
+               unsigned phase) {
+    size_t i = 0;
+
+    if(size >= sizeof(ws_mask_vector)) {
+        ws_mask_vector vmask;
+        for(size_t j = 0; j < sizeof(vmask); j++)
+            vmask[j] = mask[(phase + j) & 3];
+        for(; i + sizeof(vmask) <= size; i += sizeof(vmask)) {
+            ws_mask_vector v;
+            memcpy(&v, data + i, sizeof(v));
+            v ^= vmask;
+            memcpy(data + i, &v, sizeof(v));
+        }
+    }
+
+    for(; i < size; i++) data[i] ^= mask[(phase + i) & 3];
+}
+
+void
+websocket_frame_mask(uint8_t *frame, size_t hdr_size, size_t payload_size,
+                     uint32_t key) {
+    if(hdr_size < 6 || !(frame[1] & 0x80)) return;
+
+    uint8_t *mask = frame + hdr_size - 4;
+    memcpy(mask, &key, 4);
+    websocket_mask(frame + hdr_size, payload_size, mask, 0);
+}
+
+void
+websocket_payload_remask(uint8_t *payload, size_t payload_size,
+                         uint32_t key) {
+    uint8_t *mask = payload - 4;
+    uint8_t delta[4];
+
+    /* Unmasking with the old key and masking with the new one at once. */
+    memcpy(delta, &key, 4);
+    for(int i = 0; i < 4; i++) delta[i] ^= mask[i];
+    memcpy(mask, &key, 4);
+    websocket_mask(payload, payload_size, delta, 0);
+}
+
+#ifdef WEBSOCKET_DEFLATE
+
+/*
+ * RFC 7692, 7.2.1: the compressed message ends with an empty deflate
+ * block, the last 4 octets of which are removed by the sender.
+ */
+static const uint8_t deflate_tail[4] = {0x00, 0x00, 0xff, 0xff};
+
+struct websocket_deflater {
+    z_stream zs;
+    uint8_t *buf;
+    size_t buf_size;
+};
+
+struct websocket_deflater *
+websocket_deflater_new() {
+    struct websocket_deflater *wd = calloc(1, sizeof(*wd));
+    assert(wd);
+    /* Raw deflate with the default 32k window, as RFC 7692 mandates. */
+    if(deflateInit2(&wd->zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                    Z_DEFAULT_STRATEGY)
+       != Z_OK) {
+        free(wd);
+        return NULL;
+    }
+    return wd;
+}
+
+void
+websocket_deflater_free(struct websocket_deflater *wd) {
+    if(wd) {
+        deflateEnd(&wd->zs);
+        free(wd->buf);
+        free(wd);
+    }
+}
+
+ssize_t
+websocket_deflate(struct websocket_deflater *wd, const void *data, size_t size,
+                  const void **out) {
+    /* Not worth it, and would not fit into the same space anyway. */
+    if(size < sizeof(deflate_tail)) return -1;
+
+    /* The no context takeover: every message starts afresh. */
+    deflateReset(&wd->zs);
+
+    size_t need = deflateBound(&wd->zs, size) + 16;
+    if(need > wd->buf_size) {
+        free(wd->buf);
+        wd->buf = malloc(need);
+        assert(wd->buf);
+        wd->buf_size = need;
+    }
+
+    wd->zs.next_in = (Bytef *)data;
+    wd->zs.avail_in = size;
+    wd->zs.next_out = wd->buf;
+    wd->zs.avail_out = wd->buf_size;
+    int rc = deflate(&wd->zs, Z_SYNC_FLUSH);
+    assert(rc == Z_OK && wd->zs.avail_in == 0 && wd->zs.avail_out != 0);
+
+    size_t compressed_size = wd->buf_size - wd->zs.avail_out;
+    assert(compressed_size >= sizeof(deflate_tail));
+    compressed_size -= sizeof(deflate_tail);
+    if(compressed_size >= size) return -1;
+
+    *out = wd->buf;
+    return compressed_size;
+}
+
+struct websocket_inflater {
+    z_stream zs;
+    int tail_pending; /* Feed the deflate_tail after the message ends */
+    int out_full;     /* More output may be buffered by zlib */
+    char out[4096];
+};
+
+struct websocket_inflater *
+websocket_inflater_new() {
+    struct websocket_inflater *wi = calloc(1, sizeof(*wi));
+    assert(wi);
+    if(inflateInit2(&wi->zs, -MAX_WBITS) != Z_OK) {
+        free(wi);
+        return NULL;
+    }
+    return wi;
+}
+
+void
+websocket_inflater_free(struct websocket_inflater *wi) {
+    if(wi) {
+        inflateEnd(&wi->zs);
+        free(wi);
+    }
+}
+
+void
+websocket_inflate_input(struct websocket_inflater *wi, const void *data,
+                        size_t size, int fin) {
+    assert(wi->zs.avail_in == 0 && !wi->tail_pending);
+    wi->zs.next_in = (Bytef *)data;
+    wi->zs.avail_in = size;
+    wi->tail_pending = fin;
+}
+
+ssize_t
+websocket_inflate_output(struct websocket_inflater *wi, char **out) {
+    for(;;) {
+        if(wi->zs.avail_in == 0 && !wi->out_full) {
+            if(!wi->tail_pending) return 0;
+            wi->tail_pending = 0;
+            wi->zs.next_in = (Bytef *)deflate_tail;
+            wi->zs.avail_in = sizeof(deflate_tail);
+        }
+
+        size_t avail_in = wi->zs.avail_in;
+        wi->zs.next_out = (Bytef *)wi->out;
+        wi->zs.avail_out = sizeof(wi->out);
+        int rc = inflate(&wi->zs, Z_SYNC_FLUSH);
+        switch(rc) {
+        case Z_OK:
+            break;
+        case Z_STREAM_END:
+            /* The sender may end the deflate stream with every message. */
+            inflateReset(&wi->zs);
+            break;
+        case Z_BUF_ERROR: /* No progress was possible. */
+            if(wi->zs.avail_in) return -1;
+            break;
+        default:
+            return -1;
+        }
+
+        size_t size = sizeof(wi->out) - wi->zs.avail_out;
+        wi->out_full = (wi->zs.avail_out == 0);
+        if(size) {
+            *out = wi->out;
+            return size;
+        } else if(wi->zs.avail_in == avail_in && avail_in) {
+            return -1;
+        }
+    }
+}
+
+#else /* !WEBSOCKET_DEFLATE */
+
+struct websocket_deflater *
+websocket_deflater_new() {
+    return NULL;
+}
+
+void
+websocket_deflater_free(struct websocket_deflater *wd) {
+    assert(!wd);
+}
+
+ssize_t
+websocket_deflate(struct websocket_deflater *wd, const void *data, size_t size,
+                  const void **out) {
+    (void)wd;
+    (void)data;
+    (void)size;
+    (void)out;
+    return -1;
+}
+
+struct websocket_inflater *
+websocket_inflater_new() {
+    return NULL;
+}
+
+void
+websocket_inflater_free(struct websocket_inflater *wi) {
+    assert(!wi);
+}
+
+void
+websocket_inflate_input(struct websocket_inflater *wi, const void *data,
+                        size_t size, int fin) {
+    (void)wi;
+    (void)data;
+    (void)size;
+    (void)fin;
+}
+
+ssize_t
+websocket_inflate_output(struct websocket_inflater *wi, char **out) {
+    (void)wi;
+    (void)out;
+    return -1;
+}
+
+#endif /* WEBSOCKET_DEFLATE */
+
+const char *const websocket_frame_kind_names[WS_FRAME_KINDS] = {
+    "continuation", "text", "binary", "close", "ping", "pong"};
+
+void
+websocket_decoder_init(struct websocket_decoder *d, enum websocket_side side) {
+    memset(d, 0, sizeof(*d));
+    d->state = (side == WS_SIDE_CLIENT) ? WSD_HTTP_RESPONSE : WSD_FRAME_HEADER;
+}
+
+/*
+ * The header size is known once its first two bytes are seen.
+ */
+static size_t
+websocket_frame_header_size(const struct websocket_decoder *d) {
+    if(d->hdr_size < 2) return 2;
+    size_t size = 2 + ((d->hdr[1] & 0x80) ? 4 : 0);
+    switch(d->hdr[1] & 0x7f) {
+    case 126:
+        return size + 2;
+    case 127:
+        return size + 8;
+    default:
+        return size;
+    }
+}
+
+/*
+ * Validate the complete frame header and get ready to receive the payload.
+ */
+static int
+websocket_frame_header_parse(struct websocket_decoder *d) {
+    const uint8_t *p = d->hdr;
+    d->fin = p[0] >> 7;
+    d->rsv = (p[0] >> 4) & 0x7;
+    d->opcode = p[0] & 0x0f;
+    d->masked = p[1] >> 7;
+    uint64_t payload_size = p[1] & 0x7f;
+    p += 2;
+    if(payload_size == 126) {
+        payload_size = ((uint64_t)p[0] << 8) | p[1];
+        p += 2;
+    } else if(payload_size == 127) {
+        if(p[0] & 0x80) return -1;
+        payload_size = 0;
+        for(int i = 0; i < 8; i++) payload_size = (payload_size << 8) | p[i];
+        p += 8;
+    }
+    if(d->masked) {
+        memcpy(d->mask, p, 4);
+        /* The zero mask makes no difference, skip unmasking. */
+        d->masked = (d->mask[0] | d->mask[1] | d->mask[2] | d->mask[3]) != 0;
+    }
+
+    switch(d->opcode) {
+    case WS_OP_CONTINUATION:
+        if(!d->in_message) return -1;
+        d->in_message = !d->fin;
+        break;
+    case WS_OP_TEXT_FRAME:
+    case WS_OP_BINARY_FRAME:
+        if(d->in_message) return -1;
+        d->in_message = !d->fin;
+        d->compressed = (d->rsv & WS_RSV1) != 0;
+        break;
+    case WS_OP_CLOSE:
+    case WS_OP_PING:
+    case WS_OP_PONG:
+        /* RFC 6455, 5.5: control frames are short and not fragmented. */
+        if(!d->fin || payload_size > sizeof(d->control)) return -1;
+        break;
+    default:
+        return -1;
+    }
+
+    d->hdr_size = 0;
+    d->mask_offset = 0;
+    d->control_size = 0;
+    d->payload_remaining = payload_size;
+    d->state = payload_size ? WSD_FRAME_PAYLOAD : WSD_FRAME_END;
+    return 0;
+}
+
+/*
+ * Look for the permessage-deflate extension token in the comma-separated
+ * Sec-WebSocket-Extensions list of the handshake response, one byte
+ * at a time (RFC 6455, 9.1). The extension parameters are skipped.
+ */
+static void
+websocket_scan_extensions(struct websocket_decoder *d, char c) {
+    static const char name[] = "sec-websocket-extensions:";
+    static const char pmd[] = "permessage-deflate";
+
+    if(d->ext_state == WSX_EXTENSION
+       && (c == ',' || c == ';' || c == ' ' || c == '\t' || c == '\r'
+           || c == '\n')) {
+        if(d->ext_token_size == sizeof(pmd) - 1 && !d->ext_token_differs)
+            d->deflate_accepted = 1;
+        if(d->ext_token_size) d->ext_state = WSX_PARAMETERS;
+        d->ext_token_size = 0;
+        d->ext_token_differs = 0;
+        d->ext_quoted = 0;
+    }
+
+    if(c == '\n') {
+        d->ext_state = WSX_HEADER_NAME;
+        d->ext_name_seen = 0;
+        return;
+    }
+
+    switch(d->ext_state) {
+    case WSX_HEADER_NAME:
+        if(tolower((unsigned char)c) == name[d->ext_name_seen]) {
+            if(++d->ext_name_seen == sizeof(name) - 1)
+                d->ext_state = WSX_EXTENSION;
+        } else {
+            d->ext_state = WSX_OTHER_LINE;
+        }
+        break;
+    case WSX_OTHER_LINE:
+        break;
+    case WSX_EXTENSION:
+        if(c == ',' || c == ';' || c == ' ' || c == '\t' || c == '\r') break;
+        if(d->ext_token_size >= sizeof(pmd) - 1
+           || tolower((unsigned char)c) != pmd[d->ext_token_size])
+            d->ext_token_differs = 1;
+        d->ext_token_size++;
+        break;
+    case WSX_PARAMETERS:
+        if(c == '"')
+            d->ext_quoted = !d->ext_quoted;
+        else if(c == ',' && !d->ext_quoted)
+            d->ext_state = WSX_EXTENSION;
+        break;
+    }
+}
+
+enum websocket_decode_result
+websocket_decode(struct websocket_decoder *d, char **buf, size_t *size,
+                 struct websocket_decoded *frame) {
+    static const char eoh[] = "\r\n\r\n";
+
+    for(;;) {
+        switch(d->state) {
+        case WSD_HTTP_RESPONSE:
+            if(*size == 0) return WSD_NEED_MORE;
+            if(**buf == eoh[d->http_eoh_seen])
+                d->http_eoh_seen++;
+            else
+                d->http_eoh_seen = (**buf == '\r');
+            if(d->deflate_offered) websocket_scan_extensions(d, **buf);
+            (*buf)++;
+            (*size)--;
+            if(d->http_eoh_seen == sizeof(eoh) - 1) {
+                d->state = WSD_FRAME_HEADER;
+                if(d->deflate_offered && !d->deflate_accepted)
+                    return WSD_NO_DEFLATE;
+                return WSD_UPGRADED;
+            }
+            continue;
+        case WSD_FRAME_HEADER: {
+            if(*size == 0) return WSD_NEED_MORE;
+            size_t want = websocket_frame_header_size(d) - d->hdr_size;
+            if(want > *size) want = *size;
+            memcpy(&d->hdr[d->hdr_size], *buf, want);
+            d->hdr_size += want;
+            *buf += want;
+            *size -= want;
+            if(d->hdr_size == websocket_frame_header_size(d)
+               && websocket_frame_header_parse(d) == -1)
+                return WSD_ERROR;
+            continue;
+        }
+        case WSD_FRAME_PAYLOAD: {
+            if(*size == 0) return WSD_NEED_MORE;
+            char *data = *buf;
+            size_t n = *size < d->payload_remaining ? *size
+                                                     : d->payload_remaining;
+            if(d->masked) {
+                websocket_mask((uint8_t *)data, n, d->mask, d->mask_offset);
+                d->mask_offset = (d->mask_offset + n) & 3;
+            }
+            *buf += n;
+            *size -= n;
+            d->payload_remaining -= n;
+            if(d->payload_remaining == 0) d->state = WSD_FRAME_END;
+            if(IS_WS_CONTROL_FRAME(d->opcode)) {
+                memcpy(&d->control[d->control_size], data, n);
+                d->control_size += n;
+                continue;
+            }
+            frame->opcode = d->opcode;
+            frame->fin = d->fin;
+            frame->rsv = d->rsv;
+            frame->compressed = d->compressed;
+            frame->data = data;
+            frame->size = n;
+            return WSD_PAYLOAD;
+        }
+        case WSD_FRAME_END:
+            d->state = WSD_FRAME_HEADER;
+            frame->opcode = d->opcode;
+            frame->fin = d->fin;
+            frame->rsv = d->rsv;
+            if(IS_WS_CONTROL_FRAME(d->opcode)) {
+                frame->compressed = 0;
+                frame->data = (char *)d->control;
+                frame->size = d->control_size;
+            } else {
+                frame->compressed = d->compressed;
+                frame->data = NULL;
+                frame->size = 0;
+            }
+            return WSD_FRAME;
+        }
+    }
+}
+
+
 
 /*
  * Detect WebSocket handshake.
@@ -193,3 +663,324 @@ http_detect_websocket(const char *buf, size_t size, char *out_buf,
 
     return HDW_NOT_ENOUGH_DATA;
 }
+
+#ifdef TCPKALI_WEBSOCKET_UNIT_TEST
+
+struct decoded_stream {
+    char payload[256];
+    size_t payload_size;
+    unsigned frames[WS_FRAME_KINDS];
+    unsigned messages;
+    unsigned upgraded;
+    char control[128];
+};
+
+/*
+ * Decode the (input) whole or in pieces of (chunk) bytes.
+ */
+static enum websocket_decode_result
+decode(enum websocket_side side, const void *input, size_t size, size_t chunk,
+       struct decoded_stream *out) {
+    struct websocket_decoder d;
+    websocket_decoder_init(&d, side);
+    memset(out, 0, sizeof(*out));
+
+    char copy[1024];
+    assert(size <= sizeof(copy));
+    memcpy(copy, input, size);
+
+    for(size_t offset = 0; offset < size;) {
+        char *buf = &copy[offset];
+        size_t piece = (size - offset) < chunk ? (size - offset) : chunk;
+        size_t left = piece;
+        offset += piece;
+        struct websocket_decoded frame;
+        for(;;) {
+            enum websocket_decode_result rv =
+                websocket_decode(&d, &buf, &left, &frame);
+            if(rv == WSD_NEED_MORE) break;
+            if(rv == WSD_ERROR) return rv;
+            if(rv == WSD_UPGRADED) {
+                out->upgraded++;
+            } else if(rv == WSD_PAYLOAD) {
+                assert(out->payload_size + frame.size <= sizeof(out->payload));
+                memcpy(&out->payload[out->payload_size], frame.data,
+                       frame.size);
+                out->payload_size += frame.size;
+            } else {
+                out->frames[websocket_frame_kind(frame.opcode)]++;
+                if(IS_WS_CONTROL_FRAME(frame.opcode)) {
+                    memcpy(out->control, frame.data, frame.size);
+                    out->control[frame.size] = '\0';
+                } else if(frame.fin) {
+                    out->messages++;
+                }
+            }
+        }
+    }
+    return WSD_NEED_MORE;
+}
+
+/*
+ * Feed the handshake (response) headers to the decoder which offered
+ * the compression, one byte at a time.
+ */
+static enum websocket_decode_result
+decode_deflate_handshake(const char *headers) {
+    char response[256];
+    struct websocket_decoder d;
+    struct websocket_decoded frame;
+    enum websocket_decode_result rv = WSD_NEED_MORE;
+
+    size_t size = snprintf(response, sizeof(response),
+                           "HTTP/1.1 101 Switching Protocols\r\n%s\r\n",
+                           headers);
+    assert(size < sizeof(response));
+    websocket_decoder_init(&d, WS_SIDE_CLIENT);
+    d.deflate_offered = 1;
+    for(size_t i = 0; i < size && rv == WSD_NEED_MORE; i++) {
+        char *buf = &response[i];
+        size_t left = 1;
+        rv = websocket_decode(&d, &buf, &left, &frame);
+    }
+    return rv;
+}
+
+static size_t
+add_frame(uint8_t *buf, enum websocket_side side, enum ws_frame_opcode opcode,
+          int fin, const char *payload, size_t payload_size) {
+    size_t hdr_size = websocket_frame_header(buf, WEBSOCKET_MAX_FRAME_HDR_SIZE,
+                                             side, opcode, 0, fin,
+                                             payload_size);
+    memcpy(buf + hdr_size, payload, payload_size);
+    return hdr_size + payload_size;
+}
+
+int
+main() {
+    uint8_t stream[1024];
+    size_t size = 0;
+    struct decoded_stream out;
+    char long_payload[200];
+    memset(long_payload, 'x', sizeof(long_payload));
+
+    /* The client sees the handshake response first. */
+    const char response[] =
+        "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n\r\n";
+    memcpy(stream, response, sizeof(response) - 1);
+    size += sizeof(response) - 1;
+    size += add_frame(stream + size, WS_SIDE_SERVER, WS_OP_TEXT_FRAME, 1,
+                      "Hello", 5);
+    size += add_frame(stream + size, WS_SIDE_SERVER, WS_OP_BINARY_FRAME, 0,
+                      "ab", 2);
+    size += add_frame(stream + size, WS_SIDE_SERVER, WS_OP_PING, 1, "ping", 4);
+    size += add_frame(stream + size, WS_SIDE_SERVER, WS_OP_CONTINUATION, 0, "",
+                      0);
+    size += add_frame(stream + size, WS_SIDE_SERVER, WS_OP_CONTINUATION, 1,
+                      long_payload, sizeof(long_payload));
+    size += add_frame(stream + size, WS_SIDE_SERVER, WS_OP_CLOSE, 1, "", 0);
+
+    size_t chunks[] = {1, 2, 3, 7, sizeof(stream)};
+    for(size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        enum websocket_decode_result rv =
+            decode(WS_SIDE_CLIENT, stream, size, chunks[i], &out);
+        assert(rv == WSD_NEED_MORE);
+        assert(out.upgraded == 1);
+        assert(out.messages == 2);
+        assert(out.frames[websocket_frame_kind(WS_OP_TEXT_FRAME)] == 1);
+        assert(out.frames[websocket_frame_kind(WS_OP_BINARY_FRAME)] == 1);
+        assert(out.frames[websocket_frame_kind(WS_OP_CONTINUATION)] == 2);
+        assert(out.frames[websocket_frame_kind(WS_OP_PING)] == 1);
+        assert(out.frames[websocket_frame_kind(WS_OP_CLOSE)] == 1);
+        assert(out.frames[websocket_frame_kind(WS_OP_PONG)] == 0);
+        assert(out.payload_size == 5 + 2 + sizeof(long_payload));
+        assert(memcmp(out.payload, "Helloab", 7) == 0);
+        assert(strcmp(out.control, "") == 0);
+    }
+
+    /* The server unmasks the client frames. */
+    const uint8_t masked[] = {0x81, 0x85, 0x37, 0xfa, 0x21, 0x3d,
+                              0x7f, 0x9f, 0x4d, 0x51, 0x58, /* Hello */
+                              0x89, 0x82, 0x01, 0x02, 0x03, 0x04,
+                              'h' ^ 0x01, 'i' ^ 0x02};
+    for(size_t chunk = 1; chunk < sizeof(masked); chunk++) {
+        enum websocket_decode_result rv =
+            decode(WS_SIDE_SERVER, masked, sizeof(masked), chunk, &out);
+        assert(rv == WSD_NEED_MORE);
+        assert(out.payload_size == 5);
+        assert(memcmp(out.payload, "Hello", 5) == 0);
+        assert(strcmp(out.control, "hi") == 0);
+    }
+
+    /* Masking with every phase and size matches the byte-wise XOR. */
+    const uint8_t key[4] = {0xa1, 0x02, 0x73, 0xf4};
+    for(unsigned phase = 0; phase < 4; phase++) {
+        for(size_t len = 0; len < sizeof(long_payload) - 1; len += 7) {
+            uint8_t data[sizeof(long_payload)];
+            memcpy(data, long_payload, sizeof(data));
+            websocket_mask(data + 1, len, key, phase);
+            assert(data[0] == 'x' && data[len + 1] == 'x');
+            for(size_t i = 0; i < len; i++)
+                assert(data[i + 1] == ('x' ^ key[(phase + i) & 3]));
+        }
+    }
+
+    /* Masked client frames come out intact, also once the key is changed. */
+    for(size_t len = 0; len <= sizeof(long_payload); len += 50) {
+        uint8_t frame[WEBSOCKET_MAX_FRAME_HDR_SIZE + sizeof(long_payload)];
+        size = add_frame(frame, WS_SIDE_CLIENT, WS_OP_TEXT_FRAME, 1,
+                         long_payload, len);
+        websocket_frame_mask(frame, size - len, len, 0x5a0f31c7);
+        uint32_t key;
+        memcpy(&key, frame + size - len - 4, 4);
+        assert(key == 0x5a0f31c7);
+        assert(len == 0
+               || memcmp(frame + size - len, long_payload, len) != 0);
+        for(int k = 0; k < 2; k++) {
+            enum websocket_decode_result rv =
+                decode(WS_SIDE_SERVER, frame, size, 3, &out);
+            assert(rv == WSD_NEED_MORE);
+            assert(out.payload_size == len);
+            assert(memcmp(out.payload, long_payload, len) == 0);
+            websocket_payload_remask(frame + size - len, len, 0x01e2d3c4);
+            memcpy(&key, frame + size - len - 4, 4);
+            assert(key == 0x01e2d3c4);
+        }
+    }
+
+    /* Server frames have no mask. */
+    size = add_frame(stream, WS_SIDE_SERVER, WS_OP_TEXT_FRAME, 1, "abc", 3);
+    websocket_frame_mask(stream, size - 3, 3, 0x5a0f31c7);
+    assert(memcmp(stream + size - 3, "abc", 3) == 0);
+
+#ifdef WEBSOCKET_DEFLATE
+    /* A compressed message survives inflating in any pieces. */
+    struct websocket_deflater *wd = websocket_deflater_new();
+    assert(wd);
+    char text[1000];
+    for(size_t i = 0; i < sizeof(text); i++) text[i] = "abcabd"[i % 6];
+    const void *z;
+    ssize_t zsize = websocket_deflate(wd, text, sizeof(text), &z);
+    assert(zsize > 0 && zsize < 100);
+    uint8_t compressed[100];
+    memcpy(compressed, z, zsize);
+    ssize_t zsize_again = websocket_deflate(wd, text, sizeof(text), &z);
+    assert(zsize_again == zsize);
+    assert(memcmp(compressed, z, zsize) == 0);
+    ssize_t zsize_larger = websocket_deflate(wd, "abcdefgh", 8, &z);
+    assert(zsize_larger == -1);
+    websocket_deflater_free(wd);
+
+    struct websocket_inflater *wi = websocket_inflater_new();
+    assert(wi);
+    for(size_t chunk = 1; chunk <= (size_t)zsize; chunk++) {
+        for(int message = 0; message < 2; message++) {
+            char inflated[sizeof(text)];
+            size_t inflated_size = 0;
+            for(size_t offset = 0; offset < (size_t)zsize; offset += chunk) {
+                size_t piece = (size_t)zsize - offset < chunk
+                                   ? (size_t)zsize - offset
+                                   : chunk;
+                websocket_inflate_input(wi, compressed + offset, piece,
+                                        offset + piece == (size_t)zsize);
+                char *piece_out;
+                ssize_t n;
+                while((n = websocket_inflate_output(wi, &piece_out)) > 0) {
+                    assert(inflated_size + n <= sizeof(inflated));
+                    memcpy(inflated + inflated_size, piece_out, n);
+                    inflated_size += n;
+                }
+                assert(n == 0);
+            }
+            assert(inflated_size == sizeof(text));
+            assert(memcmp(inflated, text, sizeof(text)) == 0);
+        }
+    }
+    websocket_inflate_input(wi, "\xff\xff\xff\xff", 4, 1);
+    char *garbage_out;
+    ssize_t garbage_size = websocket_inflate_output(wi, &garbage_out);
+    assert(garbage_size == -1);
+    websocket_inflater_free(wi);
+#endif
+
+    /* The handshake response must accept the offered compression. */
+    struct websocket_decoder d;
+    struct websocket_decoded frame;
+    const char accepted[] =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Sec-WebSocket-Extensions: permessage-deflate\r\n\r\n";
+    char *buf = (char *)accepted;
+    size_t left = sizeof(accepted) - 1;
+    websocket_decoder_init(&d, WS_SIDE_CLIENT);
+    d.deflate_offered = 1;
+    enum websocket_decode_result handshake;
+    handshake = websocket_decode(&d, &buf, &left, &frame);
+    assert(handshake == WSD_UPGRADED);
+    handshake = websocket_decode(&d, &buf, &left, &frame);
+    assert(handshake == WSD_NEED_MORE);
+    buf = (char *)response;
+    left = sizeof(response) - 1;
+    websocket_decoder_init(&d, WS_SIDE_CLIENT);
+    d.deflate_offered = 1;
+    handshake = websocket_decode(&d, &buf, &left, &frame);
+    assert(handshake == WSD_NO_DEFLATE);
+    handshake = decode_deflate_handshake(
+        "sec-websocket-extensions: x-foo, Permessage-Deflate ;"
+        " client_no_context_takeover\r\n");
+    assert(handshake == WSD_UPGRADED);
+    handshake = decode_deflate_handshake(
+        "Sec-WebSocket-Extensions: x-foo\r\n"
+        "Sec-WebSocket-Extensions: permessage-deflate\r\n");
+    assert(handshake == WSD_UPGRADED);
+    handshake = decode_deflate_handshake(
+        "Sec-WebSocket-Extensions: x-permessage-deflate-foo\r\n");
+    assert(handshake == WSD_NO_DEFLATE);
+    handshake = decode_deflate_handshake(
+        "Sec-WebSocket-Extensions: permessage-deflatex\r\n");
+    assert(handshake == WSD_NO_DEFLATE);
+    handshake = decode_deflate_handshake(
+        "Sec-WebSocket-Extensions: x-foo; a=\"b, permessage-deflate\"\r\n");
+    assert(handshake == WSD_NO_DEFLATE);
+    handshake = decode_deflate_handshake("X-Note: permessage-deflate\r\n");
+    assert(handshake == WSD_NO_DEFLATE);
+
+    /* RSV1 of the first frame marks the whole message compressed. */
+    size = add_frame(stream, WS_SIDE_SERVER, WS_OP_TEXT_FRAME, 0, "ab", 2);
+    stream[0] |= 0x40;
+    size += add_frame(stream + size, WS_SIDE_SERVER, WS_OP_CONTINUATION, 1,
+                      "c", 1);
+    buf = (char *)stream;
+    left = size;
+    websocket_decoder_init(&d, WS_SIDE_SERVER);
+    for(int i = 0; i < 4; i++) {
+        enum websocket_decode_result rv =
+            websocket_decode(&d, &buf, &left, &frame);
+        assert(rv == ((i & 1) ? WSD_FRAME : WSD_PAYLOAD));
+        assert(frame.compressed);
+    }
+
+    /* Protocol violations */
+    enum websocket_decode_result violation;
+    size = add_frame(stream, WS_SIDE_SERVER, WS_OP_CONTINUATION, 1, "a", 1);
+    violation = decode(WS_SIDE_SERVER, stream, size, size, &out);
+    assert(violation == WSD_ERROR);
+    size = add_frame(stream, WS_SIDE_SERVER, WS_OP_TEXT_FRAME, 0, "a", 1);
+    size += add_frame(stream + size, WS_SIDE_SERVER, WS_OP_TEXT_FRAME, 1, "b",
+                      1);
+    violation = decode(WS_SIDE_SERVER, stream, size, size, &out);
+    assert(violation == WSD_ERROR);
+    size = add_frame(stream, WS_SIDE_SERVER, WS_OP_PING, 0, "a", 1);
+    violation = decode(WS_SIDE_SERVER, stream, size, size, &out);
+    assert(violation == WSD_ERROR);
+    size = add_frame(stream, WS_SIDE_SERVER, WS_OP_PING, 1, long_payload,
+                     sizeof(long_payload));
+    violation = decode(WS_SIDE_SERVER, stream, size, size, &out);
+    assert(violation == WSD_ERROR);
+    size = add_frame(stream, WS_SIDE_SERVER, 0x3, 1, "a", 1);
+    violation = decode(WS_SIDE_SERVER, stream, size, size, &out);
+    assert(violation == WSD_ERROR);
+
+    return 0;
+}
+
+#endif /* TCPKALI_WEBSOCKET_UNIT_TEST */
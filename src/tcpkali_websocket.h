@@ -27,6 +27,8 @@
 #ifndef TCPKALI_WEBSOCKET_H
 #define TCPKALI_WEBSOCKET_H
 
+#include <sys/types.h>
+
 #include "tcpkali_common.h"
 
 /*
@@ -46,6 +48,14 @@ enum ws_frame_opcode {
     WS_OP_PONG = 0xA
 };
 
+/*
+ * The reserved flags as given to websocket_frame_header().
+ * RFC 7692: RSV1 marks the first frame of a compressed message.
+ */
+#define WS_RSV1 0x4
+#define WS_RSV2 0x2
+#define WS_RSV3 0x1
+
 /*
  * Write out a frame header to prefix a payload of given size.
  * RETURN VALUE:
@@ -59,6 +69,148 @@ size_t websocket_frame_header(uint8_t *buf, size_t size, enum websocket_side,
                               enum ws_frame_opcode, int reserved, int fin,
                               size_t payload_size);
 
+/*
+ * XOR the (data) with the 4-byte (mask), starting at the (phase)'th
+ * byte of the mask. Used both to mask and to unmask the payload.
+ */
+void websocket_mask(uint8_t *data, size_t size, const uint8_t mask[4],
+                    unsigned phase);
+
+/*
+ * Store the masking (key) in the header of the client frame of
+ * (hdr_size + payload_size) bytes and mask the payload in place.
+ * The frames without the mask flag (server side) are left intact.
+ * RFC 6455, 5.3: the key must be fresh and unpredictable for every frame,
+ * so it is drawn from the worker's random number generator.
+ */
+void websocket_frame_mask(uint8_t *frame, size_t hdr_size,
+                          size_t payload_size, uint32_t key);
+
+/*
+ * Replace the masking key of the already masked client frame payload,
+ * preceded by its current key, with the new (key).
+ */
+void websocket_payload_remask(uint8_t *payload, size_t payload_size,
+                              uint32_t key);
+
+/*
+ * The received frames are counted by kind, which is a compact
+ * index of the frame opcode.
+ */
+#define WS_FRAME_KINDS 6
+static inline unsigned
+websocket_frame_kind(enum ws_frame_opcode opcode) {
+    return opcode < WS_OP_CLOSE ? opcode : opcode - WS_OP_CLOSE + 3;
+}
+extern const char *const websocket_frame_kind_names[WS_FRAME_KINDS];
+
+/*
+ * Streaming decoder of the received WebSocket frames.
+ */
+struct websocket_decoder {
+    enum {
+        WSD_HTTP_RESPONSE, /* Skipping the handshake response */
+        WSD_FRAME_HEADER,
+        WSD_FRAME_PAYLOAD,
+        WSD_FRAME_END,
+    } state;
+    unsigned http_eoh_seen; /* Bytes of "\r\n\r\n" ending the response */
+    uint8_t hdr[WEBSOCKET_MAX_FRAME_HDR_SIZE];
+    size_t hdr_size;
+    enum ws_frame_opcode opcode; /* Of the current frame */
+    int fin;
+    int rsv;
+    int in_message; /* Fragmented data message continues */
+    int masked;
+    uint8_t mask[4];
+    unsigned mask_offset;
+    uint64_t payload_remaining;
+    uint8_t control[125]; /* Control frame payload */
+    size_t control_size;
+    int compressed;      /* Data message has RSV1 set (RFC 7692) */
+    int deflate_offered; /* Expect permessage-deflate in the response */
+    int deflate_accepted; /* The response lists permessage-deflate */
+    /* Scanning the Sec-WebSocket-Extensions response header */
+    enum {
+        WSX_HEADER_NAME, /* Matching the header name at the line start */
+        WSX_OTHER_LINE,  /* Some other line */
+        WSX_EXTENSION,   /* Reading the extension token */
+        WSX_PARAMETERS,  /* Skipping the rest of the extension */
+    } ext_state;
+    unsigned ext_name_seen;  /* Bytes of the header name matched */
+    unsigned ext_token_size; /* Bytes of the extension token seen */
+    int ext_token_differs;   /* It is not "permessage-deflate" */
+    int ext_quoted;          /* Inside a quoted parameter value */
+};
+
+/*
+ * The client side decoder first skips the HTTP handshake response.
+ */
+void websocket_decoder_init(struct websocket_decoder *, enum websocket_side);
+
+struct websocket_decoded {
+    enum ws_frame_opcode opcode;
+    int fin;
+    int rsv;
+    int compressed; /* Data message is compressed */
+    char *data;  /* Unmasked payload */
+    size_t size;
+};
+enum websocket_decode_result {
+    WSD_NEED_MORE, /* All the data has been consumed */
+    WSD_PAYLOAD,   /* A piece of a data frame payload */
+    WSD_FRAME,     /* A frame is complete, with payload if it is a control */
+    WSD_ERROR,     /* RFC 6455 protocol violation */
+    WSD_NO_DEFLATE, /* The server did not accept permessage-deflate */
+    WSD_UPGRADED,   /* The handshake response has ended */
+};
+/*
+ * Decode the next portion of the data, advancing the (*buf) and (*size).
+ * The payload is unmasked in place.
+ */
+enum websocket_decode_result websocket_decode(struct websocket_decoder *,
+                                              char **buf, size_t *size,
+                                              struct websocket_decoded *);
+
+/*
+ * The permessage-deflate extension (RFC 7692) requested by --ws-deflate.
+ * The client compresses every message on its own (no context takeover),
+ * so the compressed messages can be built once and shared.
+ */
+#define WEBSOCKET_DEFLATE_EXTENSION \
+    "permessage-deflate; client_no_context_takeover"
+
+/*
+ * The compressor and decompressor are NULL if built without zlib.
+ */
+struct websocket_deflater *websocket_deflater_new(void);
+void websocket_deflater_free(struct websocket_deflater *);
+/*
+ * Compress the message payload. The (*out) is valid until the next call.
+ * RETURN VALUES:
+ *  -1: The compressed payload would not be smaller, send it as is.
+ *  Size of the compressed payload otherwise.
+ */
+ssize_t websocket_deflate(struct websocket_deflater *, const void *data,
+                          size_t size, const void **out);
+
+struct websocket_inflater *websocket_inflater_new(void);
+void websocket_inflater_free(struct websocket_inflater *);
+/*
+ * Feed the next piece of the compressed message payload, then read
+ * the decompressed data with websocket_inflate_output() until it returns 0.
+ * The (data) must stay intact until then.
+ */
+void websocket_inflate_input(struct websocket_inflater *, const void *data,
+                             size_t size, int fin);
+/*
+ * RETURN VALUES:
+ *  -1: Invalid compressed data.
+ *   0: The input is exhausted.
+ *  Size of the decompressed piece of data in (*out) otherwise.
+ */
+ssize_t websocket_inflate_output(struct websocket_inflater *, char **out);
+
 /*
  * Detect the Websocket handshake in the stream and accept the handshake.
  */
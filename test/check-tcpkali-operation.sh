@@ -99,4 +99,148 @@ check 25 "Packet rate estimate: (10)" ${TCPKALI} --ws -m '\{message.marker}\{re
 
 check 26 "." ${TCPKALI} -1 '\{message.marker}' -m '\{message.marker}'
 
+# The masked client frames are decoded intact by the listener.
+check 27 "frames received: 0 continuation, [1-9]" ${TCPKALI} --ws -m ABC
+check 28 "frames received: 0 continuation, [1-9]" ${TCPKALI} --ws -m 'A\{message.seq}'
+check 29 "frames received: 0 continuation, [1-9]" ${TCPKALI} --ws-premasked -m ABC
+
+# The TLS tests need a certificate.
+SSLFILE=/tmp/.tcpkali-ssl-test.$$
+if openssl req -x509 -newkey rsa:2048 -nodes -subj /CN=127.0.0.1 -days 1 \
+        -keyout ${SSLFILE}.key -out ${SSLFILE}.pem >/dev/null 2>&1; then
+    SSLOPTS="--ssl-cert ${SSLFILE}.pem --ssl-key ${SSLFILE}.key"
+    check 30 "TLS handshakes: [0-9]+ full, [1-9][0-9]* resumed" ${TCPKALI} --ssl ${SSLOPTS} --ssl-resume 100 --channel-lifetime 0.1
+    check 31 "TLS handshake latency at percentiles: [0-9.]*[1-9]" ${TCPKALI} --ssl ${SSLOPTS} --latency-phases
+    # The kernel may lack the "tls" module, the connections fall back then.
+    check 32 "TLS handshakes: [0-9]+ full, [0-9]+ resumed, [0-9]+ with kernel TLS" ${TCPKALI} --ssl ${SSLOPTS} --ssl-ktls -m PING
+fi
+rm -f ${SSLFILE}.key ${SSLFILE}.pem
+
+# The fixed width expressions are expanded in every message.
+check 33 "\[\[0000000003\]\]" ${TCPKALI} -r3 -m '[\{global.seq}]' -d
+check 34 "\[\[1[0-9]{12}\]\]" ${TCPKALI} -r3 -m '[\{time.ms}]' -d
+check 35 "\[\[[1-9][0-9]{2}\]\]" ${TCPKALI} -r3 -m '[\{rand 100..999}]' -d
+
+# The silent listener never answers, so only the first N messages are sent.
+check 36 "Total data sent:[ ]+16 bytes" ${TCPKALI} -m PING --latency-marker PING --pipeline-depth 4
+
+# The @<Latency> searches converge on the echoing listener.
+check 37 "Best --message-rate for latency 5ms at 50% is [1-9]" ${TCPKALI} --listen-mode=active -m 'PING\{message.marker}' --message-marker -r @5ms --latency-target-percentile 50
+check 38 "Best --connections for latency 5ms at 95% is [1-9]" ${TCPKALI} --listen-mode=active -m 'PING\{message.marker}' --message-marker -r 100 -c @5ms
+
+# Every sweep step gets a row in the results table.
+check 39 "^ +100 +1 " ${TCPKALI} --listen-mode=active -m 'PING\{message.marker}' --message-marker --sweep-rate 10,100 --sweep-warmup 0.2s --sweep-step 0.5s
+
+# Every scenario phase gets a row in the results table.
+SCENARIOFILE=/tmp/.tcpkali-scenario-test.$$
+printf '[slow]\nduration = 0.5s\nmessage-rate = 10\n\n[fast]\nduration = 0.5s\nconnections = 2\nmessage-rate = 100\n' > ${SCENARIOFILE}
+check 40 "^fast +0.5 +2 " ${TCPKALI} --listen-mode=active -m 'PING\{message.marker}' --message-marker --scenario ${SCENARIOFILE}
+rm -f ${SCENARIOFILE}
+
+check 41 "Connections: 1 attempted, 0 failed" ${TCPKALI} -m PING --per-destination
+
+# Scrape the --metrics-listen endpoint while the test is running.
+scrape_metrics() {
+    local metrics_port=$((PORT+1000))
+    ${TCPKALI} "$@" --metrics-listen 127.0.0.1:${metrics_port} &
+    sleep 0.5
+    exec 3<>/dev/tcp/127.0.0.1/${metrics_port}
+    printf 'GET /metrics HTTP/1.0\r\n\r\n' >&3
+    cat <&3
+    exec 3<&-
+    wait $!
+}
+check 42 "tcpkali_connections\{state=\"outgoing\"\} 1" scrape_metrics -m PING
+
+check 43 "^\{\"type\":\"summary\",.*\"bytes_sent\":[1-9]" ${TCPKALI} -m PING --output-format=json
+check 44 "^\{\"type\":\"checkpoint\",.*\"conns_out\":1," ${TCPKALI} -m PING --json-stream -
+
+# Count the messages recorded into the --capture file.
+CAPTUREFILE=/tmp/.tcpkali-capture-test.$$
+capture_messages() {
+    ${TCPKALI} "$@" --capture ${CAPTUREFILE}
+    echo "Captured $(grep -a -o PING ${CAPTUREFILE} | wc -l) messages"
+}
+check 45 "Captured [1-9][0-9]* messages" capture_messages -m PING -r10
+rm -f ${CAPTUREFILE}
+
+# The listener receives the --stream-file contents over and over again.
+STREAMFILE=/tmp/.tcpkali-stream-test.$$
+printf 'STREAMED-FILE' > ${STREAMFILE}
+check 46 "Rcv\([0-9]+, [0-9]+\): \[STREAMED-FILE\]" ${TCPKALI} --stream-file ${STREAMFILE} --dump-all-in
+rm -f ${STREAMFILE}
+
+# Connections sharing the messages keep their own per-connection values.
+check 47 "\[\[3-3\]\]" ${TCPKALI} -c3 -r2 -m '[\{connection.uid}-\{connection.uid%10}]' --dump-all-out
+
+# The listener does not compress, so the --ws-deflate offer is declined
+# and the only connection fails.
+expect_failure() {
+    ! ${TCPKALI} "$@"
+}
+check 48 "Sec-WebSocket-Extensions: permessage-deflate" expect_failure --ws-deflate -m ABC -d
+check 49 "Server did not accept permessage-deflate" expect_failure --ws-deflate -m ABC
+
+# A separate active listener process answers the --http requests with
+# a canned response. It starts sending a bit later than the client does,
+# so that no response could ever come before its request.
+HTTPLISTENERFILE=/tmp/.tcpkali-http-test.$$
+count_http_requests() {
+    local duration="$1" listen="$2" destination="$3"
+    shift 3
+    ${TCPKALI} ${listen} --listen-mode=active -T2s --delay-send 0.15s -r10 \
+        -em 'HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nOK' \
+        > ${HTTPLISTENERFILE} 2>&1 &
+    sleep 0.2
+    local client sent received ok
+    client=$(${TCPKALI} ${duration} ${destination} "$@")
+    wait $!
+    echo "${client}"
+    sent=$(echo "${client}" | awk '/^Total data sent:/ { print $4 / 18 }')
+    ok=$(echo "${client}" | awk '/^HTTP responses:/ { print $6 + 0 }')
+    received=$(awk '/^Total data received:/ { print $4 / 18 }' \
+               ${HTTPLISTENERFILE})
+    echo "Requests sent: ${sent}, received: ${received}, 2xx: ${ok}"
+}
+check 50 "Requests sent: ([1-9][0-9]*), received: \1, 2xx: [1-9]" count_http_requests -em 'GET / HTTP/1.1\r\n\r\n' --http -r10
+rm -f ${HTTPLISTENERFILE}
+
+# The --hdr-log file starts with the V2 log header and gets a compressed
+# histogram line per interval.
+HDRLOGFILE=/tmp/.tcpkali-hdr-log-test.$$
+hdr_log_intervals() {
+    ${TCPKALI} "$@" --hdr-log ${HDRLOGFILE}
+    grep -q '^#\[Histogram log format version 1.3\]$' ${HDRLOGFILE} &&
+    echo "Logged $(grep -c '^Tag=message,[0-9.,]*,HISTF' ${HDRLOGFILE}) intervals"
+}
+check 51 "Logged [1-9][0-9]* intervals" hdr_log_intervals -m PING -r10 --latency-marker PING --hdr-log-interval 0.5s
+rm -f ${HDRLOGFILE}
+
+# Replay a raw IPv4 capture of a connection sending 14 bytes after the SYN.
+# The fast timing keeps the connection open after the replay is over.
+PCAPFILE=/tmp/.tcpkali-pcap-test.$$
+{
+    printf '\xd4\xc3\xb2\xa1\x02\x00\x04\x00\0\0\0\0\0\0\0\0\xff\xff\0\0\x65\0\0\0'
+    printf '\0\0\0\0\0\0\0\0\x28\0\0\0\x28\0\0\0'
+    printf '\x45\0\0\x28\0\0\x40\0\x40\x06\0\0\x0a\0\0\x01\x0a\0\0\x02'
+    printf '\x13\x88\0\x50\0\0\0\x64\0\0\0\0\x50\x02\xff\xff\0\0\0\0'
+    printf '\0\0\0\0\x10\x27\0\0\x36\0\0\0\x36\0\0\0'
+    printf '\x45\0\0\x36\0\0\x40\0\x40\x06\0\0\x0a\0\0\x01\x0a\0\0\x02'
+    printf '\x13\x88\0\x50\0\0\0\x65\0\0\0\0\x50\x18\xff\xff\0\0\0\0'
+    printf 'PCAP-REPLAYED\n'
+} > ${PCAPFILE}
+check 52 "Total data sent:[ ]+14 bytes"     ${TCPKALI} --pcap ${PCAPFILE} --pcap-timing fast
+check 53 "Total data received:[ ]+14 bytes" ${TCPKALI} --pcap ${PCAPFILE} --pcap-timing fast
+rm -f ${PCAPFILE}
+
+# The corpus records are sent in the file order, starting with --corpus-start.
+CORPUSFILE=/tmp/.tcpkali-corpus-test.$$
+printf 'R0\nR1\nR2\nR3\n' > ${CORPUSFILE}
+corpus_records() {
+    echo "Records sent: $(${TCPKALI} "$@" --dump-all-out 2>&1 \
+        | sed -n 's/^Snd([0-9]*, 3): \[\(R[0-9]\)\\n\]$/\1/p' | tr '\n' ' ')"
+}
+check 54 "^Records sent: R2 R3 R0 R1 R2 R3 R0 " corpus_records --corpus ${CORPUSFILE} --corpus-start 2 -r10
+rm -f ${CORPUSFILE}
+
 trap 'rm -f ${TMPFILE}' EXIT